@@ -0,0 +1,293 @@
+/*
+ * bench/accept_bench.c
+ *
+ * Connections-per-second load generator for the echo servers.
+ *
+ * Every connection lives as short a life as the protocol allows: connect,
+ * send "bye", read the echo and the server's close, close.  Each thread
+ * keeps -c such connections in flight at once on non-blocking sockets and
+ * one epoll instance, starting a new one as soon as one finishes, so the
+ * server spends its time accepting, reading one line and closing — its
+ * accept path is what is measured.  Latency is from connect() to the
+ * server's close.
+ *
+ * The demo servers exit when their last client leaves, so one extra
+ * connection is held open for the whole run and said goodbye to at the
+ * end.
+ *
+ * Usage: accept_bench [-H host] [-p port] [-c conns_per_thread] [-t threads]
+ *                     [-d secs] [-C]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../linux/common/sock_helpers.h"
+#include "../linux/common/hdr_hist.h"
+
+#define MAX_EVENTS 256
+#define BYE        "bye\n"
+#define BYE_LEN    4
+
+struct opts {
+    const char *host;
+    int         port;
+    int         conns;            /* in flight per thread */
+    int         threads;
+    double      duration;
+    int         csv;
+};
+
+struct aconn {
+    int      fd;                  /* -1 = slot idle */
+    int      connected;
+    int      got;                 /* echo bytes read */
+    uint64_t start;
+};
+
+struct athread {
+    pthread_t       tid;
+    struct aconn   *conns;
+    int             epfd;
+    uint64_t        done;         /* connections completed in the window */
+    uint64_t        errors;
+    struct hdr_hist hist;
+};
+
+static struct opts        o = { "127.0.0.1", 9003, 16, 4, 5.0, 0 };
+static struct sockaddr_in srv;
+static uint64_t           stop_at;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Start a new connection in slot c.  Returns -1 if no socket could be had. */
+static int conn_start(struct athread *t, struct aconn *c)
+{
+    c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c->fd < 0) return -1;
+    c->connected = 0;
+    c->got       = 0;
+    c->start     = now_ns();
+    if (connect(c->fd, (struct sockaddr *)&srv, sizeof(srv)) < 0 && errno != EINPROGRESS) {
+        close(c->fd);
+        c->fd = -1;
+        return -1;
+    }
+    struct epoll_event ev;
+    ev.events   = EPOLLOUT;
+    ev.data.ptr = c;
+    if (epoll_ctl(t->epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0) die("epoll_ctl add");
+    return 0;
+}
+
+static void conn_end(struct athread *t, struct aconn *c, int ok)
+{
+    close(c->fd);                 /* also leaves the epoll set */
+    c->fd = -1;
+    if (!ok) {
+        t->errors++;
+        return;
+    }
+    uint64_t now = now_ns();
+    if (now <= stop_at) {
+        t->done++;
+        hdr_record(&t->hist, now - c->start);
+    }
+}
+
+/* Advance one connection on an event.  Returns 1 once it is finished. */
+static int conn_event(struct athread *t, struct aconn *c, unsigned events)
+{
+    if (!c->connected) {
+        int err = 0;
+        socklen_t el = sizeof(err);
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &el);
+        if (err || (events & (EPOLLERR | EPOLLHUP))) {
+            conn_end(t, c, 0);
+            return 1;
+        }
+        c->connected = 1;
+        if (send(c->fd, BYE, BYE_LEN, MSG_NOSIGNAL) != BYE_LEN) {
+            conn_end(t, c, 0);
+            return 1;
+        }
+        struct epoll_event ev;
+        ev.events   = EPOLLIN;
+        ev.data.ptr = c;
+        if (epoll_ctl(t->epfd, EPOLL_CTL_MOD, c->fd, &ev) < 0) die("epoll_ctl mod");
+        return 0;
+    }
+    for (;;) {
+        char buf[64];
+        ssize_t r = recv(c->fd, buf, sizeof(buf), 0);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            conn_end(t, c, 0);
+            return 1;
+        }
+        if (r == 0) {                             /* the server closed: done */
+            conn_end(t, c, c->got == BYE_LEN);
+            return 1;
+        }
+        if (c->got + r > BYE_LEN || memcmp(buf, BYE + c->got, (size_t)r) != 0) {
+            conn_end(t, c, 0);
+            return 1;
+        }
+        c->got += (int)r;
+    }
+}
+
+static void *bench_thread(void *arg)
+{
+    struct athread *t = arg;
+    t->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (t->epfd < 0) die("epoll_create1");
+    hdr_init(&t->hist);
+    for (int i = 0; i < o.conns; i++)
+        if (conn_start(t, &t->conns[i]) < 0) t->errors++;
+
+    struct epoll_event events[MAX_EVENTS];
+    while (now_ns() < stop_at) {
+        int n = epoll_wait(t->epfd, events, MAX_EVENTS, 10);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            die("epoll_wait");
+        }
+        for (int i = 0; i < n; i++) {
+            struct aconn *c = events[i].data.ptr;
+            if (conn_event(t, c, events[i].events) && now_ns() < stop_at &&
+                conn_start(t, c) < 0)
+                t->errors++;
+        }
+        /* Slots whose socket() or connect() failed: try again. */
+        for (int i = 0; i < o.conns; i++)
+            if (t->conns[i].fd < 0 && now_ns() < stop_at && conn_start(t, &t->conns[i]) < 0)
+                t->errors++;
+    }
+    for (int i = 0; i < o.conns; i++)
+        if (t->conns[i].fd >= 0) close(t->conns[i].fd);
+    close(t->epfd);
+    return NULL;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-H host] [-p port] [-c conns_per_thread] [-t threads] [-d secs] [-C]\n"
+            "  -c conns  connections each thread keeps in flight (default 16)\n"
+            "  -C        print one CSV row instead of the human-readable report\n",
+            prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    while ((c = getopt(argc, argv, "H:p:c:t:d:C")) != -1) {
+        switch (c) {
+        case 'H': o.host     = optarg;       break;
+        case 'p': o.port     = atoi(optarg); break;
+        case 'c': o.conns    = atoi(optarg); break;
+        case 't': o.threads  = atoi(optarg); break;
+        case 'd': o.duration = atof(optarg); break;
+        case 'C': o.csv      = 1;            break;
+        default:  usage(argv[0]);
+        }
+    }
+    if (o.conns < 1 || o.threads < 1 || o.duration <= 0) usage(argv[0]);
+
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    memset(&srv, 0, sizeof(srv));
+    srv.sin_family = AF_INET;
+    srv.sin_port   = htons((uint16_t)o.port);
+    if (inet_pton(AF_INET, o.host, &srv.sin_addr) != 1) {
+        fprintf(stderr, "accept_bench: bad address %s\n", o.host);
+        return EXIT_FAILURE;
+    }
+
+    /*
+     * Keeps the server alive between the short connections.  It says
+     * something first, so that a server deferring accepts until data
+     * arrives (TCP_DEFER_ACCEPT) has it counted before the load starts.
+     */
+    char buf[BYE_LEN];
+    int anchor = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (anchor < 0) die("socket");
+    if (connect(anchor, (struct sockaddr *)&srv, sizeof(srv)) < 0) die("connect");
+    if (write_all(anchor, "hi\n", 3) < 0 || recv(anchor, buf, 3, MSG_WAITALL) != 3)
+        die("anchor connection");
+
+    struct athread *threads = calloc((size_t)o.threads, sizeof(*threads));
+    struct aconn   *conns   = calloc((size_t)o.threads * (size_t)o.conns, sizeof(*conns));
+    if (!threads || !conns) die("calloc");
+    stop_at = now_ns() + (uint64_t)(o.duration * 1e9);
+    for (int i = 0; i < o.threads; i++) {
+        threads[i].conns = conns + (size_t)i * (size_t)o.conns;
+        int rc = pthread_create(&threads[i].tid, NULL, bench_thread, &threads[i]);
+        if (rc != 0) { errno = rc; die("pthread_create"); }
+    }
+
+    struct hdr_hist *all = malloc(sizeof(*all));
+    if (!all) die("malloc");
+    hdr_init(all);
+    uint64_t done = 0, errors = 0;
+    for (int i = 0; i < o.threads; i++) {
+        pthread_join(threads[i].tid, NULL);
+        hdr_merge(all, &threads[i].hist);
+        done   += threads[i].done;
+        errors += threads[i].errors;
+    }
+
+    if (write_all(anchor, BYE, BYE_LEN) < 0 || recv(anchor, buf, sizeof(buf), MSG_WAITALL) != BYE_LEN)
+        perror("anchor connection");
+    close(anchor);
+
+    double cps  = (double)done / o.duration;
+    double p50  = (double)hdr_percentile(all, 50.0) / 1e3;
+    double p99  = (double)hdr_percentile(all, 99.0) / 1e3;
+    double p999 = (double)hdr_percentile(all, 99.9) / 1e3;
+    double pmax = (double)(all->total ? all->max : 0) / 1e3;
+    if (o.csv) {
+        printf("threads,conns_per_thread,duration_s,connections,conn_s,"
+               "p50_us,p99_us,p999_us,max_us,mean_us,errors\n");
+        printf("%d,%d,%.2f,%llu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%llu\n",
+               o.threads, o.conns, o.duration, (unsigned long long)done, cps,
+               p50, p99, p999, pmax, hdr_mean(all) / 1e3, (unsigned long long)errors);
+    } else {
+        printf("[bench] %s:%d  threads=%d in-flight=%d per thread\n",
+               o.host, o.port, o.threads, o.conns);
+        printf("[bench] %llu connections in %.2f s: %.1f conn/s\n",
+               (unsigned long long)done, o.duration, cps);
+        printf("[bench] connect to close (us): p50=%.1f p99=%.1f p99.9=%.1f max=%.1f mean=%.1f\n",
+               p50, p99, p999, pmax, hdr_mean(all) / 1e3);
+        if (errors) printf("[bench] %llu failed connection(s)\n", (unsigned long long)errors);
+    }
+
+    free(all);
+    free(conns);
+    free(threads);
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,581 @@
+/*
+ * bench/attack_bench.c
+ *
+ * Adversarial load for the echo servers: well-behaved clients measured
+ * while hostile ones abuse the same server.
+ *
+ * A few good connections, driven from one epoll thread, each keep one
+ * -s byte request in flight and schedule them at -R requests a second in
+ * total (0 = closed loop).  Latency is taken from the intended send time,
+ * as echo_bench's open loop does, so a request held up by a stalled loop
+ * is charged for the whole stall.  The run has two phases of -d seconds:
+ * a baseline with the good clients alone, then the same load with the
+ * attacks of -A running, one thread each, on -n connections apiece:
+ *
+ *   slow   slowloris: one byte of a line that never ends, on every
+ *          connection once a second.  Costs the server a connection and
+ *          a carry buffer each; a first-request deadline ends them.
+ *   bytes  byte at a time: complete lines sent one byte per send(), round
+ *          robin over the connections, each echo read back.  One wakeup
+ *          and one recv() on the server per byte.
+ *   noread requests pipelined as fast as the socket takes them, echoes
+ *          never read.  The server's output queues fill; a server without
+ *          backpressure buffers without bound.
+ *   half   connect, send a line, shutdown(SHUT_WR) and hold the socket:
+ *          the server sees EOF with an answer still owed.  The oldest of
+ *          the -n held is drained and closed to make room for the next.
+ *   rst    connect, send half a line, close with SO_LINGER 0: a reset
+ *          instead of a FIN, with data unread on the server.
+ *   churn  connect and close at once, without a byte.
+ *
+ * -r caps each attack thread at that many operations a second (a byte, a
+ * request, a connection), 0 = as fast as it goes.  Pacing matters on a
+ * machine with few CPUs: an attacker spinning flat out measures the
+ * scheduler rather than the server.  The report gives both phases'
+ * percentiles, the ratio of their p99s, and what each attack managed and
+ * how often the server cut it off.
+ *
+ * The demo servers exit when their last client leaves; the good
+ * connections are closed last, which ends the server too.
+ *
+ * Usage: attack_bench [-H host] [-p port] [-c good_conns] [-R good_rate]
+ *                     [-s size] [-d secs] [-A attacks] [-n conns_per_attack]
+ *                     [-r attack_ops] [-C]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "../linux/common/sock_helpers.h"
+#include "../linux/common/hdr_hist.h"
+
+#define MAX_EVENTS  64
+#define MAX_SIZE    4096          /* largest good request */
+#define SLOW_MS     1000          /* slowloris: one byte per connection this often */
+#define LINE        "abcdefghijklmno\n"
+#define LINE_LEN    16
+#define NOREAD_CHUNK 4096         /* noread: bytes of lines per send() */
+#define IO_TMO_MS   1000          /* attackers' connect/recv timeout */
+#define CATCH_UP_MS 100           /* a pacer further behind than this resets */
+
+struct opts {
+    const char *host;
+    int         port;
+    int         conns;            /* good connections */
+    double      rate;             /* good req/s in total; 0 = closed loop */
+    int         size;
+    double      duration;         /* per phase */
+    const char *attacks;
+    int         per_attack;       /* connections per attack */
+    double      ops;              /* per attack thread per second; 0 = unpaced */
+    int         csv;
+};
+
+struct good {
+    int      fd;
+    int      busy;                /* request in flight */
+    int      got;                 /* echo bytes read */
+    uint64_t due;                 /* intended send time of the current/next request */
+};
+
+struct attacker {
+    const char *name;
+    void      (*run)(struct attacker *);
+    int         on;
+    pthread_t   tid;
+    uint64_t    next;             /* pacing: time of the next operation */
+    uint64_t    ops;
+    uint64_t    bytes;
+    uint64_t    answered;         /* half: echoes that came back after the FIN */
+    uint64_t    cut;              /* connections the server closed or reset */
+    uint64_t    errors;           /* connects that failed */
+};
+
+static struct opts        o = { "127.0.0.1", 9003, 16, 2000.0, 64, 5.0,
+                                "slow,bytes,noread,half,rst,churn", 32, 1000.0, 0 };
+static struct sockaddr_in srv;
+static char               req[MAX_SIZE];
+static int                stop;          /* attackers and good clients finish */
+static int                phase;         /* 0 baseline, 1 under attack */
+static struct hdr_hist   *hist[2];
+static uint64_t           done[2], good_errors;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_ns(uint64_t ns)
+{
+    struct timespec ts = { (time_t)(ns / 1000000000ull), (long)(ns % 1000000000ull) };
+    nanosleep(&ts, NULL);
+}
+
+static int stopping(void)
+{
+    return __atomic_load_n(&stop, __ATOMIC_RELAXED);
+}
+
+/* Wait for the attacker's next operation slot, period ns after the last. */
+static void pace(struct attacker *a, uint64_t period)
+{
+    if (!period) return;
+    uint64_t now = now_ns();
+    a->next += period;
+    if (a->next > now) sleep_ns(a->next - now);
+    else if (now - a->next > (uint64_t)CATCH_UP_MS * 1000000ull) a->next = now;
+}
+
+static uint64_t op_period(void)
+{
+    return o.ops > 0 ? (uint64_t)(1e9 / o.ops) : 0;
+}
+
+/* Blocking connect with IO_TMO_MS timeouts on connect, send and recv. */
+static int attack_connect(struct attacker *a)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) die("socket");
+    struct timeval tv = { IO_TMO_MS / 1000, (IO_TMO_MS % 1000) * 1000 };
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (struct sockaddr *)&srv, sizeof(srv)) < 0) {
+        a->errors++;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Keep fds[i] connected: reconnect a slot the server dropped. */
+static void attack_refill(struct attacker *a, int *fds, int i)
+{
+    if (fds[i] < 0) fds[i] = attack_connect(a);
+}
+
+static void attack_drop(struct attacker *a, int *fds, int i)
+{
+    close(fds[i]);
+    fds[i] = -1;
+    a->cut++;
+}
+
+static void run_slow(struct attacker *a)
+{
+    int *fds = malloc((size_t)o.per_attack * sizeof(*fds));
+    if (!fds) die("malloc");
+    for (int i = 0; i < o.per_attack; i++) fds[i] = -1;
+    uint64_t period = (uint64_t)SLOW_MS * 1000000ull / (uint64_t)o.per_attack;
+    for (int i = 0; !stopping(); i = (i + 1) % o.per_attack, pace(a, period)) {
+        attack_refill(a, fds, i);
+        if (fds[i] < 0) continue;
+        if (send(fds[i], "x", 1, MSG_NOSIGNAL) != 1) {
+            attack_drop(a, fds, i);
+            continue;
+        }
+        a->ops++;
+        a->bytes++;
+    }
+    for (int i = 0; i < o.per_attack; i++)
+        if (fds[i] >= 0) close(fds[i]);
+    free(fds);
+}
+
+static void run_bytes(struct attacker *a)
+{
+    int *fds = malloc((size_t)o.per_attack * sizeof(*fds));
+    if (!fds) die("malloc");
+    for (int i = 0; i < o.per_attack; i++) fds[i] = -1;
+    uint64_t period = op_period();
+    /* Byte k of the line goes to every connection before byte k + 1. */
+    for (int k = 0; !stopping(); k = (k + 1) % LINE_LEN) {
+        for (int i = 0; i < o.per_attack && !stopping(); i++, pace(a, period)) {
+            attack_refill(a, fds, i);
+            if (fds[i] < 0) continue;
+            if (send(fds[i], LINE + k, 1, MSG_NOSIGNAL) != 1) {
+                attack_drop(a, fds, i);
+                continue;
+            }
+            a->ops++;
+            a->bytes++;
+        }
+        if (k != LINE_LEN - 1) continue;
+        for (int i = 0; i < o.per_attack; i++) {
+            char buf[LINE_LEN];
+            if (fds[i] < 0) continue;
+            if (recv(fds[i], buf, LINE_LEN, MSG_WAITALL) != LINE_LEN ||
+                memcmp(buf, LINE, LINE_LEN) != 0)
+                attack_drop(a, fds, i);
+        }
+    }
+    for (int i = 0; i < o.per_attack; i++)
+        if (fds[i] >= 0) close(fds[i]);
+    free(fds);
+}
+
+static void run_noread(struct attacker *a)
+{
+    static char chunk[NOREAD_CHUNK];
+    for (int i = 0; i < NOREAD_CHUNK; i += LINE_LEN) memcpy(chunk + i, LINE, LINE_LEN);
+    int *fds = malloc((size_t)o.per_attack * sizeof(*fds));
+    if (!fds) die("malloc");
+    for (int i = 0; i < o.per_attack; i++) fds[i] = -1;
+    uint64_t period = op_period();
+    for (int i = 0; !stopping(); i = (i + 1) % o.per_attack, pace(a, period)) {
+        attack_refill(a, fds, i);
+        if (fds[i] < 0) continue;
+        ssize_t n = send(fds[i], chunk, sizeof(chunk), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+        if (n <= 0) {
+            attack_drop(a, fds, i);
+            continue;
+        }
+        a->ops++;
+        a->bytes += (uint64_t)n;
+    }
+    for (int i = 0; i < o.per_attack; i++)
+        if (fds[i] >= 0) close(fds[i]);
+    free(fds);
+}
+
+/* Read what the server sent a half-closed socket; the echo should be there. */
+static void half_reap(struct attacker *a, int fd)
+{
+    char buf[LINE_LEN];
+    int got = 0;
+    ssize_t n;
+    while (got < LINE_LEN &&
+           (n = recv(fd, buf + got, (size_t)(LINE_LEN - got), MSG_DONTWAIT)) > 0)
+        got += (int)n;
+    if (got == LINE_LEN && memcmp(buf, LINE, LINE_LEN) == 0) a->answered++;
+    close(fd);
+}
+
+static void run_half(struct attacker *a)
+{
+    int *fds = malloc((size_t)o.per_attack * sizeof(*fds));
+    if (!fds) die("malloc");
+    for (int i = 0; i < o.per_attack; i++) fds[i] = -1;
+    uint64_t period = op_period();
+    for (int i = 0; !stopping(); i = (i + 1) % o.per_attack, pace(a, period)) {
+        if (fds[i] >= 0) half_reap(a, fds[i]);
+        fds[i] = attack_connect(a);
+        if (fds[i] < 0) continue;
+        if (send(fds[i], LINE, LINE_LEN, MSG_NOSIGNAL) != LINE_LEN) {
+            attack_drop(a, fds, i);
+            continue;
+        }
+        shutdown(fds[i], SHUT_WR);
+        a->ops++;
+        a->bytes += LINE_LEN;
+    }
+    for (int i = 0; i < o.per_attack; i++)
+        if (fds[i] >= 0) half_reap(a, fds[i]);
+    free(fds);
+}
+
+static void run_rst(struct attacker *a)
+{
+    struct linger lg = { 1, 0 };
+    uint64_t period = op_period();
+    for (; !stopping(); pace(a, period)) {
+        int fd = attack_connect(a);
+        if (fd < 0) continue;
+        if (send(fd, LINE, LINE_LEN / 2, MSG_NOSIGNAL) == LINE_LEN / 2) a->bytes += LINE_LEN / 2;
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        close(fd);
+        a->ops++;
+    }
+}
+
+static void run_churn(struct attacker *a)
+{
+    uint64_t period = op_period();
+    for (; !stopping(); pace(a, period)) {
+        int fd = attack_connect(a);
+        if (fd < 0) continue;
+        close(fd);
+        a->ops++;
+    }
+}
+
+static struct attacker attackers[] = {
+    { "slow",   run_slow,   0, 0, 0, 0, 0, 0, 0, 0 },
+    { "bytes",  run_bytes,  0, 0, 0, 0, 0, 0, 0, 0 },
+    { "noread", run_noread, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { "half",   run_half,   0, 0, 0, 0, 0, 0, 0, 0 },
+    { "rst",    run_rst,    0, 0, 0, 0, 0, 0, 0, 0 },
+    { "churn",  run_churn,  0, 0, 0, 0, 0, 0, 0, 0 },
+};
+#define NATTACK ((int)(sizeof(attackers) / sizeof(attackers[0])))
+
+static void *attack_thread(void *arg)
+{
+    struct attacker *a = arg;
+    a->next = now_ns();
+    a->run(a);
+    return NULL;
+}
+
+/* Parse -A: a comma-separated list of attack names, or "none". */
+static int select_attacks(const char *list)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", list);
+    if (strcmp(buf, "none") == 0) return 0;
+    for (char *save = NULL, *t = strtok_r(buf, ",", &save); t; t = strtok_r(NULL, ",", &save)) {
+        int i;
+        for (i = 0; i < NATTACK && strcmp(t, attackers[i].name) != 0; i++)
+            ;
+        if (i == NATTACK) {
+            fprintf(stderr, "attack_bench: unknown attack %s\n", t);
+            return -1;
+        }
+        attackers[i].on = 1;
+    }
+    return 0;
+}
+
+static int good_send(struct good *g)
+{
+    ssize_t n = send(g->fd, req, (size_t)o.size, MSG_NOSIGNAL);
+    if (n != o.size) return -1;   /* a small request into an empty socket goes whole */
+    g->busy = 1;
+    g->got  = 0;
+    return 0;
+}
+
+static int good_recv(struct good *g, uint64_t period)
+{
+    char buf[MAX_SIZE];
+    for (;;) {
+        ssize_t n = recv(g->fd, buf, (size_t)(o.size - g->got), MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        if (n <= 0 || memcmp(buf, req + g->got, (size_t)n) != 0) return -1;
+        g->got += (int)n;
+        if (g->got < o.size) continue;
+        uint64_t now = now_ns();
+        int ph = __atomic_load_n(&phase, __ATOMIC_RELAXED);
+        hdr_record(hist[ph], now - g->due);
+        done[ph]++;
+        g->busy = 0;
+        g->due  = period ? g->due + period : now;
+        return 0;
+    }
+}
+
+/* The good clients: o.conns connections on one epoll instance. */
+static void *good_thread(void *arg)
+{
+    struct good *gs = arg;
+    uint64_t period = o.rate > 0 ? (uint64_t)(1e9 * o.conns / o.rate) : 0;
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    int tfd  = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epfd < 0 || tfd < 0) die("epoll_create1/timerfd_create");
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev) < 0) die("epoll_ctl add");
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < o.conns; i++) {
+        ev.data.ptr = &gs[i];
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, gs[i].fd, &ev) < 0) die("epoll_ctl add");
+        gs[i].due = t0 + (period ? period * (uint64_t)i / (uint64_t)o.conns : 0);
+    }
+
+    struct epoll_event evs[MAX_EVENTS];
+    while (!stopping()) {
+        /* Send what is due; arm the timer for the next one that is not. */
+        uint64_t now = now_ns(), next = 0;
+        for (int i = 0; i < o.conns; i++) {
+            struct good *g = &gs[i];
+            if (g->fd < 0 || g->busy) continue;
+            if (g->due <= now) {
+                if (good_send(g) < 0) {
+                    good_errors++;
+                    close(g->fd);
+                    g->fd = -1;
+                }
+            } else if (!next || g->due < next) {
+                next = g->due;
+            }
+        }
+        struct itimerspec its = { { 0, 0 }, { 0, 0 } };
+        if (next) {
+            its.it_value.tv_sec  = (time_t)(next / 1000000000ull);
+            its.it_value.tv_nsec = (long)(next % 1000000000ull);
+        }
+        timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
+
+        int n = epoll_wait(epfd, evs, MAX_EVENTS, 100);
+        if (n < 0 && errno != EINTR) die("epoll_wait");
+        for (int i = 0; i < n; i++) {
+            struct good *g = evs[i].data.ptr;
+            if (!g) {
+                uint64_t ticks;
+                if (read(tfd, &ticks, sizeof(ticks)) < 0) { /* spurious */ }
+                continue;
+            }
+            if (g->fd >= 0 && good_recv(g, period) < 0) {
+                good_errors++;
+                close(g->fd);
+                g->fd = -1;
+            }
+        }
+    }
+    close(tfd);
+    close(epfd);
+    return NULL;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-H host] [-p port] [-c good_conns] [-R good_rate] [-s size] [-d secs]\n"
+            "          [-A attacks] [-n conns_per_attack] [-r attack_ops] [-C]\n"
+            "  -c conns   well-behaved connections, one request in flight each (default 16)\n"
+            "  -R rate    their requests per second in total, 0 = closed loop (default 2000)\n"
+            "  -s size    their request size in bytes, newline included (default 64)\n"
+            "  -d secs    length of each phase, baseline then under attack (default 5)\n"
+            "  -A list    attacks: slow,bytes,noread,half,rst,churn or none (default all)\n"
+            "  -n conns   connections per attack (default 32)\n"
+            "  -r ops     operations per second per attack, 0 = unpaced (default 1000)\n"
+            "  -C         print one CSV row instead of the human-readable report\n",
+            prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    while ((c = getopt(argc, argv, "H:p:c:R:s:d:A:n:r:C")) != -1) {
+        switch (c) {
+        case 'H': o.host       = optarg;       break;
+        case 'p': o.port       = atoi(optarg); break;
+        case 'c': o.conns      = atoi(optarg); break;
+        case 'R': o.rate       = atof(optarg); break;
+        case 's': o.size       = atoi(optarg); break;
+        case 'd': o.duration   = atof(optarg); break;
+        case 'A': o.attacks    = optarg;       break;
+        case 'n': o.per_attack = atoi(optarg); break;
+        case 'r': o.ops        = atof(optarg); break;
+        case 'C': o.csv        = 1;            break;
+        default:  usage(argv[0]);
+        }
+    }
+    if (o.conns < 1 || o.rate < 0 || o.size < 2 || o.size > MAX_SIZE || o.duration <= 0 ||
+        o.per_attack < 1 || o.ops < 0 || select_attacks(o.attacks) < 0)
+        usage(argv[0]);
+
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    memset(&srv, 0, sizeof(srv));
+    srv.sin_family = AF_INET;
+    srv.sin_port   = htons((uint16_t)o.port);
+    if (inet_pton(AF_INET, o.host, &srv.sin_addr) != 1) {
+        fprintf(stderr, "attack_bench: bad address %s\n", o.host);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < o.size - 1; i++) req[i] = (char)('a' + i % 26);
+    req[o.size - 1] = '\n';
+
+    struct good *gs = calloc((size_t)o.conns, sizeof(*gs));
+    hist[0] = malloc(sizeof(*hist[0]));
+    hist[1] = malloc(sizeof(*hist[1]));
+    if (!gs || !hist[0] || !hist[1]) die("malloc");
+    hdr_init(hist[0]);
+    hdr_init(hist[1]);
+    for (int i = 0; i < o.conns; i++) {
+        int one = 1;
+        gs[i].fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (gs[i].fd < 0) die("socket");
+        if (connect(gs[i].fd, (struct sockaddr *)&srv, sizeof(srv)) < 0) die("connect");
+        setsockopt(gs[i].fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    pthread_t gt;
+    if (pthread_create(&gt, NULL, good_thread, gs) != 0) die("pthread_create");
+    uint64_t phase_ns = (uint64_t)(o.duration * 1e9);
+    sleep_ns(phase_ns);
+
+    __atomic_store_n(&phase, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < NATTACK; i++)
+        if (attackers[i].on && pthread_create(&attackers[i].tid, NULL, attack_thread, &attackers[i]) != 0)
+            die("pthread_create");
+    sleep_ns(phase_ns);
+
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < NATTACK; i++)
+        if (attackers[i].on) pthread_join(attackers[i].tid, NULL);
+    pthread_join(gt, NULL);
+    for (int i = 0; i < o.conns; i++)
+        if (gs[i].fd >= 0) close(gs[i].fd);
+
+    double us[2][5];
+    for (int p = 0; p < 2; p++) {
+        us[p][0] = (double)done[p] / o.duration;
+        us[p][1] = (double)hdr_percentile(hist[p], 50.0) / 1e3;
+        us[p][2] = (double)hdr_percentile(hist[p], 99.0) / 1e3;
+        us[p][3] = (double)hdr_percentile(hist[p], 99.9) / 1e3;
+        us[p][4] = (double)(hist[p]->total ? hist[p]->max : 0) / 1e3;
+    }
+    double ratio = us[0][2] > 0 ? us[1][2] / us[0][2] : 0;
+    if (o.csv) {
+        char list[256];                          /* the attack list, joined with '+' */
+        snprintf(list, sizeof(list), "%s", o.attacks);
+        for (char *q = list; (q = strchr(q, ',')) != NULL; ) *q = '+';
+        printf("attacks,per_attack,attack_ops,good_conns,good_rate,size,"
+               "base_rps,base_p50_us,base_p99_us,base_p999_us,base_max_us,"
+               "attack_rps,attack_p50_us,attack_p99_us,attack_p999_us,attack_max_us,p99_ratio,good_errors\n");
+        printf("%s,%d,%.0f,%d,%.0f,%d,%.0f,%.1f,%.1f,%.1f,%.1f,%.0f,%.1f,%.1f,%.1f,%.1f,%.2f,%llu\n",
+               list, o.per_attack, o.ops, o.conns, o.rate, o.size,
+               us[0][0], us[0][1], us[0][2], us[0][3], us[0][4],
+               us[1][0], us[1][1], us[1][2], us[1][3], us[1][4], ratio,
+               (unsigned long long)good_errors);
+    } else {
+        printf("[attack] %s:%d  %d good connection(s), %.0f req/s%s, %d-byte requests, %.1f s per phase\n",
+               o.host, o.port, o.conns, o.rate, o.rate > 0 ? "" : " (closed loop)", o.size, o.duration);
+        const char *label[2] = { "baseline", "attacked" };
+        for (int p = 0; p < 2; p++)
+            printf("[attack] %s: %8.0f req/s  p50=%.1f p99=%.1f p99.9=%.1f max=%.1f (us)\n",
+                   label[p], us[p][0], us[p][1], us[p][2], us[p][3], us[p][4]);
+        printf("[attack] p99 under attack: %.2fx baseline; %llu good connection(s) lost\n",
+               ratio, (unsigned long long)good_errors);
+        for (int i = 0; i < NATTACK; i++) {
+            struct attacker *a = &attackers[i];
+            if (!a->on) continue;
+            printf("[attack] %-6s %llu op(s), %llu byte(s) sent, %llu cut by the server, "
+                   "%llu failed connect(s)",
+                   a->name, (unsigned long long)a->ops, (unsigned long long)a->bytes,
+                   (unsigned long long)a->cut, (unsigned long long)a->errors);
+            if (a->run == run_half) printf(", %llu answered", (unsigned long long)a->answered);
+            printf("\n");
+        }
+    }
+
+    free(hist[1]);
+    free(hist[0]);
+    free(gs);
+    return good_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,450 @@
+/*
+ * bench/c1m_bench.c
+ *
+ * Idle-connection benchmark for the echo servers: opens a great many
+ * connections, leaves them idle, and reports what each one costs the
+ * server and how fast an idle one is answered when it wakes up.
+ *
+ *   open:  up to -w non-blocking connects in flight on one epoll
+ *          instance.  Each connection sends "hi" and waits for the echo,
+ *          so the server has read from it once (and its first-request
+ *          deadline, if any, is met) before it goes idle.
+ *   idle:  after -s seconds the server's VmRSS (/proc/PID/status, with
+ *          -S PID) and the kernel's slab total (/proc/meminfo) are read
+ *          again; the growth over the open phase, divided by the number of
+ *          connections, is the cost of one idle connection.  The slab
+ *          figure counts both ends, since client and server share the
+ *          kernel on loopback.
+ *   wake:  -k rounds, each sending one line on -b randomly chosen idle
+ *          connections at once and timing each until its echo is back.
+ *
+ * One source address has about 28k ephemeral ports towards one server
+ * port, so connection i binds to source address 127.1.0.1 + i / per_addr
+ * (IP_BIND_ADDRESS_NO_PORT leaves the port to connect(), which picks it
+ * per 4-tuple).  -a sets how many addresses; by default one per 5000
+ * connections, since connect() searches longer for a free port the fuller
+ * an address gets: at 19000 connections one address opened 3.6k a second
+ * and four 17.5k.  Every address in 127.0.0.0/8 is local on Linux, so no
+ * setup is needed.  The fds are the limit: both processes need one per
+ * connection, so a million needs `ulimit -Hn` and fs.nr_open above that.
+ * The count is capped at the soft limit this process can raise itself to.
+ *
+ * The demo servers exit when their last client leaves; closing every
+ * connection at the end ends the server too.
+ *
+ * Usage: c1m_bench [-H host] [-p port] [-n conns] [-a source_addrs]
+ *                  [-S server_pid] [-w window] [-s settle_secs]
+ *                  [-k rounds] [-b burst] [-C]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../linux/common/sock_helpers.h"
+#include "../linux/common/hdr_hist.h"
+
+#ifndef IP_BIND_ADDRESS_NO_PORT
+#define IP_BIND_ADDRESS_NO_PORT 24
+#endif
+
+#define MAX_EVENTS 256
+#define HELLO      "hi\n"
+#define HELLO_LEN  3
+#define PING       "ping\n"
+#define PING_LEN   5
+#define PER_ADDR   5000           /* default connections per source address */
+#define STALL_MS   10000          /* no progress for this long: give up */
+
+struct opts {
+    const char *host;
+    int         port;
+    long        conns;
+    long        addrs;            /* source addresses; 0 = one per PER_ADDR */
+    int         pid;              /* server, for its RSS; 0 = not measured */
+    int         window;           /* connects in flight */
+    double      settle;
+    int         rounds;
+    int         burst;
+    int         csv;
+};
+
+/* A connection being opened: slot of the in-flight window. */
+struct pend {
+    int      fd;
+    int      connected;
+    int      got;                 /* echo bytes read */
+    uint64_t start;
+};
+
+static struct opts        o = { "127.0.0.1", 9003, 1000000, 0, 0, 256, 1.0, 1000, 1, 0 };
+static struct sockaddr_in srv;
+static int               *fds;   /* the idle connections */
+static long               per_addr;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* The kB figure on the line of a /proc file starting with key, or -1. */
+static long proc_kb(const char *path, const char *key)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[256];
+    long kb = -1;
+    size_t kl = strlen(key);
+    while (fgets(line, sizeof(line), f))
+        if (strncmp(line, key, kl) == 0) {
+            kb = strtol(line + kl, NULL, 10);
+            break;
+        }
+    fclose(f);
+    return kb;
+}
+
+static long server_rss_kb(void)
+{
+    char path[64];
+    if (!o.pid) return -1;
+    snprintf(path, sizeof(path), "/proc/%d/status", o.pid);
+    return proc_kb(path, "VmRSS:");
+}
+
+/* Start connection idx in slot p.  Returns -1 with errno set on failure. */
+static int pend_start(int epfd, struct pend *p, long idx)
+{
+    struct sockaddr_in src = { .sin_family = AF_INET };
+    src.sin_addr.s_addr = htonl(0x7f010001u + (uint32_t)(idx / per_addr));
+
+    int one = 1;
+    p->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (p->fd < 0) return -1;
+    setsockopt(p->fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+    if (bind(p->fd, (struct sockaddr *)&src, sizeof(src)) < 0 ||
+        (connect(p->fd, (struct sockaddr *)&srv, sizeof(srv)) < 0 && errno != EINPROGRESS)) {
+        int e = errno;
+        close(p->fd);
+        errno = e;
+        return -1;
+    }
+    p->connected = 0;
+    p->got       = 0;
+    p->start     = now_ns();
+    struct epoll_event ev;
+    ev.events   = EPOLLOUT;
+    ev.data.ptr = p;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, p->fd, &ev) < 0) die("epoll_ctl add");
+    return 0;
+}
+
+/* Advance a connection being opened.  Returns 1 when it is done with: *ok says how. */
+static int pend_event(int epfd, struct pend *p, unsigned events, int *ok)
+{
+    *ok = 0;
+    if (!p->connected) {
+        int err = 0;
+        socklen_t el = sizeof(err);
+        getsockopt(p->fd, SOL_SOCKET, SO_ERROR, &err, &el);
+        if (err || (events & (EPOLLERR | EPOLLHUP))) {
+            errno = err ? err : ECONNRESET;
+            return 1;
+        }
+        p->connected = 1;
+        if (send(p->fd, HELLO, HELLO_LEN, MSG_NOSIGNAL) != HELLO_LEN) return 1;
+        struct epoll_event ev;
+        ev.events   = EPOLLIN;
+        ev.data.ptr = p;
+        if (epoll_ctl(epfd, EPOLL_CTL_MOD, p->fd, &ev) < 0) die("epoll_ctl mod");
+        return 0;
+    }
+    char buf[HELLO_LEN];
+    ssize_t r = recv(p->fd, buf, (size_t)(HELLO_LEN - p->got), 0);
+    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return 0;
+    if (r <= 0 || memcmp(buf, HELLO + p->got, (size_t)r) != 0) {
+        if (r == 0) errno = ECONNRESET;
+        return 1;
+    }
+    p->got += (int)r;
+    if (p->got < HELLO_LEN) return 0;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, p->fd, NULL);
+    *ok = 1;
+    return 1;
+}
+
+/* Open o.conns connections into fds[].  Returns how many were opened. */
+static long open_all(struct hdr_hist *h)
+{
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) die("epoll_create1");
+    struct pend  *pend = malloc((size_t)o.window * sizeof(*pend));
+    struct pend **idle = malloc((size_t)o.window * sizeof(*idle));
+    if (!pend || !idle) die("malloc");
+    int nidle = 0;
+    for (int i = o.window - 1; i >= 0; i--) {
+        pend[i].fd    = -1;
+        idle[nidle++] = &pend[i];
+    }
+
+    long next = 0, opened = 0;
+    int  first_err = 0;
+    uint64_t progress = now_ns();
+    struct epoll_event events[MAX_EVENTS];
+    for (;;) {
+        while (nidle > 0 && next < o.conns && !first_err) {
+            struct pend *p = idle[nidle - 1];
+            if (pend_start(epfd, p, next) < 0) {
+                p->fd     = -1;
+                first_err = errno;
+                break;
+            }
+            nidle--;
+            next++;
+        }
+        if (nidle == o.window) break;             /* nothing in flight or left to start */
+        int n = epoll_wait(epfd, events, MAX_EVENTS, 1000);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            die("epoll_wait");
+        }
+        for (int i = 0; i < n; i++) {
+            struct pend *p = events[i].data.ptr;
+            int ok;
+            if (!pend_event(epfd, p, events[i].events, &ok)) continue;
+            if (ok) {
+                fds[opened++] = p->fd;
+                hdr_record(h, now_ns() - p->start);
+            } else {
+                if (!first_err) first_err = errno ? errno : EIO;
+                close(p->fd);
+            }
+            p->fd         = -1;
+            idle[nidle++] = p;
+            progress      = now_ns();
+        }
+        if (now_ns() - progress > (uint64_t)STALL_MS * 1000000) {
+            if (!first_err) first_err = ETIMEDOUT;
+            break;
+        }
+    }
+    for (int i = 0; i < o.window; i++)           /* left in flight by a stall */
+        if (pend[i].fd >= 0) close(pend[i].fd);
+    if (first_err)
+        fprintf(stderr, "c1m_bench: stopped at %ld connection(s): %s\n", opened, strerror(first_err));
+    free(idle);
+    free(pend);
+    close(epfd);
+    return opened;
+}
+
+static uint64_t rng = 0x9e3779b97f4a7c15ull;
+
+static uint64_t xorshift(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+/*
+ * Wake -b random idle connections at once, -k times, and time each from
+ * its send() to the last byte of its echo.  Returns -1 if one went wrong.
+ */
+static int wake(long n, struct hdr_hist *h)
+{
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) die("epoll_create1");
+    long     *pick  = malloc((size_t)o.burst * sizeof(*pick));
+    uint64_t *start = malloc((size_t)o.burst * sizeof(*start));
+    int      *got   = malloc((size_t)o.burst * sizeof(*got));
+    if (!pick || !start || !got) die("malloc");
+    int burst = o.burst < n ? o.burst : (int)n;
+    int rc = 0;
+
+    struct epoll_event events[MAX_EVENTS];
+    for (int r = 0; r < o.rounds && rc == 0; r++) {
+        for (int k = 0; k < burst; k++) {
+            int dup;
+            do {                                   /* distinct connections */
+                pick[k] = (long)(xorshift() % (uint64_t)n);
+                dup = 0;
+                for (int j = 0; j < k; j++) dup |= pick[j] == pick[k];
+            } while (dup);
+            struct epoll_event ev;
+            ev.events   = EPOLLIN;
+            ev.data.u32 = (uint32_t)k;
+            if (epoll_ctl(epfd, EPOLL_CTL_ADD, fds[pick[k]], &ev) < 0) die("epoll_ctl add");
+            got[k]   = 0;
+            start[k] = now_ns();
+            if (send(fds[pick[k]], PING, PING_LEN, MSG_NOSIGNAL) != PING_LEN) die("send");
+        }
+        for (int left = burst; left > 0 && rc == 0; ) {
+            int ne = epoll_wait(epfd, events, MAX_EVENTS, STALL_MS);
+            if (ne < 0) {
+                if (errno == EINTR) continue;
+                die("epoll_wait");
+            }
+            if (ne == 0) {
+                fprintf(stderr, "c1m_bench: no echo within %d s\n", STALL_MS / 1000);
+                rc = -1;
+            }
+            for (int i = 0; i < ne; i++) {
+                int k = (int)events[i].data.u32;
+                char buf[PING_LEN];
+                ssize_t m = recv(fds[pick[k]], buf, (size_t)(PING_LEN - got[k]), 0);
+                if (m < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+                if (m <= 0 || memcmp(buf, PING + got[k], (size_t)m) != 0) {
+                    fprintf(stderr, "c1m_bench: bad echo on a woken connection\n");
+                    rc = -1;
+                    break;
+                }
+                got[k] += (int)m;
+                if (got[k] == PING_LEN) {
+                    hdr_record(h, now_ns() - start[k]);
+                    epoll_ctl(epfd, EPOLL_CTL_DEL, fds[pick[k]], NULL);
+                    left--;
+                }
+            }
+        }
+        for (int k = 0; k < burst; k++)          /* after a failure: leave none behind */
+            epoll_ctl(epfd, EPOLL_CTL_DEL, fds[pick[k]], NULL);
+    }
+    free(got);
+    free(start);
+    free(pick);
+    close(epfd);
+    return rc;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-H host] [-p port] [-n conns] [-a source_addrs] [-S server_pid]\n"
+            "          [-w window] [-s settle_secs] [-k rounds] [-b burst] [-C]\n"
+            "  -n conns   connections to open and hold (default 1000000, capped by the fd limit)\n"
+            "  -a addrs   source addresses from 127.1.0.1 up (default: one per %d connections)\n"
+            "  -S pid     the server's pid, to report its RSS per connection\n"
+            "  -w window  connects in flight while opening (default 256)\n"
+            "  -s secs    idle time before memory is measured (default 1)\n"
+            "  -k rounds  wake-up rounds (default 1000)\n"
+            "  -b burst   idle connections woken at once per round (default 1)\n"
+            "  -C         print one CSV row instead of the human-readable report\n",
+            prog, PER_ADDR);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    while ((c = getopt(argc, argv, "H:p:n:a:S:w:s:k:b:C")) != -1) {
+        switch (c) {
+        case 'H': o.host   = optarg;       break;
+        case 'p': o.port   = atoi(optarg); break;
+        case 'n': o.conns  = atol(optarg); break;
+        case 'a': o.addrs  = atol(optarg); break;
+        case 'S': o.pid    = atoi(optarg); break;
+        case 'w': o.window = atoi(optarg); break;
+        case 's': o.settle = atof(optarg); break;
+        case 'k': o.rounds = atoi(optarg); break;
+        case 'b': o.burst  = atoi(optarg); break;
+        case 'C': o.csv    = 1;            break;
+        default:  usage(argv[0]);
+        }
+    }
+    if (o.conns < 1 || o.addrs < 0 || o.window < 1 || o.settle < 0 || o.rounds < 0 || o.burst < 1)
+        usage(argv[0]);
+
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY &&
+        (rlim_t)o.conns + 16 > rl.rlim_cur) {
+        long cap = rl.rlim_cur > 16 ? (long)rl.rlim_cur - 16 : 1;
+        fprintf(stderr, "c1m_bench: fd limit %llu: %ld connection(s) instead of %ld\n",
+                (unsigned long long)rl.rlim_cur, cap, o.conns);
+        o.conns = cap;
+    }
+    if (o.addrs == 0) o.addrs = (o.conns + PER_ADDR - 1) / PER_ADDR;
+    per_addr = (o.conns + o.addrs - 1) / o.addrs;
+
+    memset(&srv, 0, sizeof(srv));
+    srv.sin_family = AF_INET;
+    srv.sin_port   = htons((uint16_t)o.port);
+    if (inet_pton(AF_INET, o.host, &srv.sin_addr) != 1) {
+        fprintf(stderr, "c1m_bench: bad address %s\n", o.host);
+        return EXIT_FAILURE;
+    }
+    fds = malloc((size_t)o.conns * sizeof(*fds));
+    struct hdr_hist *open_h = malloc(sizeof(*open_h));
+    struct hdr_hist *wake_h = malloc(sizeof(*wake_h));
+    if (!fds || !open_h || !wake_h) die("malloc");
+    hdr_init(open_h);
+    hdr_init(wake_h);
+
+    long rss0  = server_rss_kb();
+    long slab0 = proc_kb("/proc/meminfo", "Slab:");
+    uint64_t t0 = now_ns();
+    long n = open_all(open_h);
+    double open_s = (double)(now_ns() - t0) / 1e9;
+    if (n == 0) return EXIT_FAILURE;
+
+    struct timespec ts = { (time_t)o.settle, (long)((o.settle - (double)(time_t)o.settle) * 1e9) };
+    nanosleep(&ts, NULL);
+    long rss1  = server_rss_kb();
+    long slab1 = proc_kb("/proc/meminfo", "Slab:");
+    double rss_per  = rss0 >= 0 && rss1 >= 0 ? (double)(rss1 - rss0) * 1024.0 / (double)n : -1;
+    double slab_per = slab0 >= 0 && slab1 >= 0 ? (double)(slab1 - slab0) * 1024.0 / (double)n : -1;
+
+    int rc = wake(n, wake_h);
+
+    for (long i = 0; i < n; i++) close(fds[i]);
+
+    double p50  = (double)hdr_percentile(wake_h, 50.0) / 1e3;
+    double p99  = (double)hdr_percentile(wake_h, 99.0) / 1e3;
+    double p999 = (double)hdr_percentile(wake_h, 99.9) / 1e3;
+    double pmax = (double)(wake_h->total ? wake_h->max : 0) / 1e3;
+    if (o.csv) {
+        printf("conns,addrs,open_s,conn_s,rss_before_kb,rss_after_kb,rss_bytes_per_conn,"
+               "slab_bytes_per_conn,wake_burst,wake_p50_us,wake_p99_us,wake_p999_us,wake_max_us\n");
+        printf("%ld,%ld,%.2f,%.0f,%ld,%ld,%.0f,%.0f,%d,%.1f,%.1f,%.1f,%.1f\n",
+               n, o.addrs, open_s, (double)n / open_s, rss0, rss1, rss_per, slab_per,
+               o.burst, p50, p99, p999, pmax);
+    } else {
+        printf("[c1m] %s:%d  %ld connection(s) from %ld source address(es) in %.2f s: %.0f conn/s\n",
+               o.host, o.port, n, o.addrs, open_s, (double)n / open_s);
+        printf("[c1m] connect to first echo (us): p50=%.1f p99=%.1f max=%.1f\n",
+               (double)hdr_percentile(open_h, 50.0) / 1e3, (double)hdr_percentile(open_h, 99.0) / 1e3,
+               (double)open_h->max / 1e3);
+        if (rss_per >= 0)
+            printf("[c1m] server RSS %.1f MB -> %.1f MB: %.0f bytes per idle connection\n",
+                   (double)rss0 / 1024, (double)rss1 / 1024, rss_per);
+        else
+            printf("[c1m] server RSS not measured (-S PID)\n");
+        if (slab_per >= 0)
+            printf("[c1m] kernel slab +%.1f MB: %.0f bytes per connection, both ends\n",
+                   (double)(slab1 - slab0) / 1024, slab_per);
+        printf("[c1m] wake-up, %d round(s) of %d (us): p50=%.1f p99=%.1f p99.9=%.1f max=%.1f mean=%.1f\n",
+               o.rounds, o.burst, p50, p99, p999, pmax, hdr_mean(wake_h) / 1e3);
+    }
+
+    free(wake_h);
+    free(open_h);
+    free(fds);
+    return rc < 0 || n < o.conns ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,631 @@
+/*
+ * bench/echo_bench.c
+ *
+ * Multi-connection load generator for the echo servers.
+ *
+ * Opens many concurrent connections from several threads (each thread owns
+ * a slice of the connections and one epoll instance) and keeps them busy
+ * with fixed-size, newline-terminated requests — or, with -b, binary
+ * frames of the same total size for the server's length-prefixed protocol
+ * listener.  Every echoed byte is checked against what was sent.
+ *
+ * -U PATH runs the same requests over an AF_UNIX stream socket instead of
+ * TCP; -Q PATH over a SOCK_SEQPACKET one, each request one message of -s
+ * bytes and each echo checked to come back as one message of that size.
+ *
+ *   closed loop (default): each connection keeps -P requests outstanding
+ *                          and issues the next one as soon as an echo
+ *                          completes.  Latency = echo time - send time.
+ *   open loop (-r rate):   requests fall due on a fixed schedule no matter
+ *                          how fast the server answers.  Latency is taken
+ *                          from the *intended* send time, so a stalled
+ *                          server is charged for every request it delayed
+ *                          (coordinated-omission correction).  -P caps how
+ *                          many requests a connection may have in flight.
+ *
+ * -T breaks TCP round trips into stages with kernel timestamps
+ * (SO_TIMESTAMPING, linux/common/tstamp.h).  One request per connection
+ * at a time is sampled: its send() asks for a TX stamp, and the recv()
+ * that completes its echo brings the RX stamp.  Stages: send() to the TX
+ * stamp (the client's send path), TX stamp to RX stamp (the wire both
+ * ways and the whole server), RX stamp to recv() return (the client's
+ * receive queue and wakeup).  Run the server with -T too to split the
+ * middle one.
+ *
+ * Usage: echo_bench [-H host] [-p port] [-c conns] [-t threads] [-d secs]
+ *                   [-w warmup_secs] [-s size] [-P depth] [-r rate] [-C] [-b]
+ *                   [-T] [-U unix_path | -Q seqpacket_path]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "../linux/common/sock_helpers.h"
+#include "../linux/common/hdr_hist.h"
+#include "../linux/common/binframe.h"
+#include "../linux/common/unix_sock.h"
+#include "../linux/common/tstamp.h"
+
+#define MAX_EVENTS  256
+#define RX_BUF      (64 * 1024)
+#define TX_MIN      (64 * 1024)   /* payload is repeated to at least this */
+#define SEQ_BATCH   32            /* -Q: messages per sendmmsg() */
+
+/* -T: stages of a sampled round trip. */
+enum { ST_TX, ST_NET, ST_RX, NSTAGES };
+static const char *const stage_name[NSTAGES] = { "client tx", "wire+server", "client rx" };
+static const char *const stage_csv[NSTAGES]  = { "tx", "net", "rx" };
+
+struct opts {
+    const char *host;
+    int         port;
+    int         conns;
+    int         threads;
+    double      duration;
+    double      warmup;
+    int         size;
+    int         depth;
+    double      rate;             /* total req/s; 0 = closed loop */
+    int         csv;
+    int         binary;           /* length-prefixed frames instead of lines */
+    const char *upath;            /* -U / -Q: AF_UNIX instead of TCP */
+    int         seq;              /* -Q: SOCK_SEQPACKET, one message per request */
+    int         stamps;           /* -T: kernel timestamps, per-stage latency */
+};
+
+struct bconn {
+    int       fd;
+    int       connected;
+    int       want_out;           /* EPOLLOUT currently registered */
+    uint64_t  issued;             /* requests queued for sending */
+    uint64_t  done;               /* echoes fully received */
+    uint64_t  owed;               /* open loop: due but not yet issued */
+    uint64_t  tx_bytes;
+    uint64_t  rx_bytes;
+    uint64_t *stamps;             /* ring[depth]: send/intended time */
+    uint64_t  ts_send;            /* -T, realtime: the sampled send() was made */
+    uint64_t  ts_tx;              /* its TX stamp, 0 = not back yet */
+    uint64_t  ts_end;             /* rx_bytes that complete its echo, 0 = no sample */
+};
+
+struct bthread {
+    int             id;
+    pthread_t       tid;
+    struct bconn   *conns;
+    int             nconns;
+    int             epfd;
+    int             tfd;          /* open loop pacing timer */
+    uint64_t        measured;     /* echoes completed inside the window */
+    uint64_t        errors;
+    struct hdr_hist hist;
+    struct hdr_hist stage[NSTAGES];   /* -T */
+};
+
+static struct opts        o = {
+    .host     = "127.0.0.1",
+    .conns    = 100,
+    .threads  = 4,
+    .duration = 10.0,
+    .warmup   = 1.0,
+    .size     = 16,
+    .depth    = 1,
+};                                        /* everything else off / 0 */
+static unsigned char     *payload;       /* request repeated, >= TX_MIN bytes */
+static size_t             payload_len;
+static pthread_barrier_t  start_barrier;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void set_events(struct bthread *t, struct bconn *c, int out)
+{
+    struct epoll_event ev;
+    ev.events   = EPOLLIN | (out ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    if (epoll_ctl(t->epfd, EPOLL_CTL_MOD, c->fd, &ev) < 0) die("epoll_ctl mod");
+    c->want_out = out;
+}
+
+/* -Q: the queued requests as one message each, SEQ_BATCH per sendmmsg(). */
+static int flush_tx_msgs(struct bthread *t, struct bconn *c)
+{
+    struct mmsghdr mm[SEQ_BATCH];
+    struct iovec   iov = { payload, (size_t)o.size };
+    uint64_t target = c->issued * (uint64_t)o.size;
+    while (c->tx_bytes < target) {
+        uint64_t k = (target - c->tx_bytes) / (uint64_t)o.size;
+        if (k > SEQ_BATCH) k = SEQ_BATCH;
+        memset(mm, 0, sizeof(mm[0]) * k);
+        for (uint64_t i = 0; i < k; i++) {
+            mm[i].msg_hdr.msg_iov    = &iov;
+            mm[i].msg_hdr.msg_iovlen = 1;
+        }
+        int n = sendmmsg(c->fd, mm, (unsigned)k, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (!c->want_out) set_events(t, c, 1);
+                return 0;
+            }
+            return -1;
+        }
+        c->tx_bytes += (uint64_t)n * (uint64_t)o.size;
+    }
+    if (c->want_out) set_events(t, c, 0);
+    return 0;
+}
+
+/*
+ * -T: send() that asks for a TX stamp.  The request holding the last byte
+ * it sends becomes the connection's sample.
+ */
+static ssize_t send_stamped(struct bconn *c, const void *p, size_t len)
+{
+    struct ts_ctl ctl;
+    struct iovec  iov = { (void *)p, len };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    ts_tx_ctl(&ctl);
+    msg.msg_control    = ctl.buf;
+    msg.msg_controllen = sizeof(ctl.buf);
+    uint64_t now = ts_now();
+    ssize_t n = sendmsg(c->fd, &msg, MSG_NOSIGNAL);
+    if (n > 0) {
+        c->ts_send = now;
+        c->ts_tx   = 0;
+        c->ts_end  = c->tx_bytes + (uint64_t)n;
+    }
+    return n;
+}
+
+/* -T: the sample's TX stamp is on the error queue. */
+static int reap_tx(struct bconn *c)
+{
+    uint64_t tx = 0;
+    if (ts_reap_tx(c->fd, &tx) < 0) return -1;
+    if (tx && c->ts_end && !c->ts_tx) c->ts_tx = tx;
+    return 0;
+}
+
+/* Write as much of the queued requests as the socket takes. */
+static int flush_tx(struct bthread *t, struct bconn *c)
+{
+    if (o.seq) return flush_tx_msgs(t, c);
+    uint64_t target = c->issued * (uint64_t)o.size;
+    while (c->tx_bytes < target) {
+        size_t off = (size_t)(c->tx_bytes % (uint64_t)o.size);
+        size_t len = payload_len - off;
+        if (len > target - c->tx_bytes) len = (size_t)(target - c->tx_bytes);
+        ssize_t n = o.stamps && !c->ts_end ? send_stamped(c, payload + off, len)
+                                           : send(c->fd, payload + off, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (!c->want_out) set_events(t, c, 1);
+                return 0;
+            }
+            return -1;
+        }
+        c->tx_bytes += (uint64_t)n;
+    }
+    if (c->want_out) set_events(t, c, 0);
+    return 0;
+}
+
+static void issue(struct bconn *c, uint64_t stamp)
+{
+    c->stamps[c->issued % (uint64_t)o.depth] = stamp;
+    c->issued++;
+}
+
+/* Open loop: intended send time of connection c's j-th request. */
+static uint64_t intended(const struct bthread *t, int c, uint64_t j, uint64_t t0,
+                         double period)
+{
+    return t0 + (uint64_t)(((double)j * t->nconns + c) * period);
+}
+
+static int read_rx(struct bthread *t, struct bconn *c, uint64_t warm_end,
+                   uint64_t t0, double period)
+{
+    static __thread unsigned char buf[RX_BUF];
+    for (;;) {
+        uint64_t rx = 0;
+        ssize_t n = o.stamps ? ts_recv(c->fd, buf, sizeof(buf), 0, &rx)
+                             : recv(c->fd, buf, sizeof(buf), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+        if (n == 0) return -1;
+        if (o.seq && n != o.size) t->errors++;    /* a message split or merged */
+
+        /* Verify the echo byte-for-byte against the payload pattern. */
+        size_t off = (size_t)(c->rx_bytes % (uint64_t)o.size);
+        for (size_t i = 0; i < (size_t)n; ) {
+            size_t len = payload_len - off;
+            if (len > (size_t)n - i) len = (size_t)n - i;
+            if (memcmp(buf + i, payload + off, len) != 0) t->errors++;
+            i  += len;
+            off = 0;
+        }
+        c->rx_bytes += (uint64_t)n;
+        if (c->ts_end && c->rx_bytes >= c->ts_end) {
+            /* The sample's echo is in: its stages, if both stamps came. */
+            uint64_t back = ts_now();
+            if (!c->ts_tx && reap_tx(c) < 0) return -1;
+            if (c->ts_tx && rx && now_ns() >= warm_end) {
+                hdr_record(&t->stage[ST_TX], c->ts_tx - c->ts_send);
+                hdr_record(&t->stage[ST_NET], rx - c->ts_tx);
+                hdr_record(&t->stage[ST_RX], back - rx);
+            }
+            c->ts_end = 0;
+        }
+
+        uint64_t complete = c->rx_bytes / (uint64_t)o.size;
+        if (complete > c->issued) return -1;      /* server sent extra bytes */
+        if (complete == c->done) continue;
+        uint64_t now = now_ns();
+        for (; c->done < complete; c->done++) {
+            uint64_t stamp = c->stamps[c->done % (uint64_t)o.depth];
+            if (now >= warm_end) {
+                hdr_record(&t->hist, now - stamp);
+                t->measured++;
+            }
+        }
+    }
+
+    /* Refill the pipeline. */
+    int idx = (int)(c - t->conns);
+    if (o.rate > 0) {
+        while (c->owed > 0 && c->issued - c->done < (uint64_t)o.depth) {
+            issue(c, intended(t, idx, c->issued, t0, period));
+            c->owed--;
+        }
+    } else {
+        uint64_t now = now_ns();
+        while (c->issued - c->done < (uint64_t)o.depth) issue(c, now);
+    }
+    return flush_tx(t, c);
+}
+
+/*
+ * Unix sockets: connect() completes at once or fails with EAGAIN while
+ * the listen queue is full, so connect blocking, then switch.
+ */
+static void connect_all_unix(struct bthread *t)
+{
+    for (int i = 0; i < t->nconns; i++) {
+        struct bconn *c = &t->conns[i];
+        c->fd = unix_connect(o.upath, o.seq ? SOCK_SEQPACKET : SOCK_STREAM);
+        if (c->fd < 0) die(o.upath);
+        set_nonblocking(c->fd);
+        c->connected = 1;
+
+        struct epoll_event ev;
+        ev.events   = EPOLLIN;
+        ev.data.ptr = c;
+        if (epoll_ctl(t->epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0) die("epoll_ctl add");
+    }
+}
+
+/* Non-blocking connect of every connection this thread owns. */
+static void connect_all(struct bthread *t)
+{
+    if (o.upath) {
+        connect_all_unix(t);
+        return;
+    }
+    struct sockaddr_in addr = {0};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(o.host);
+    addr.sin_port        = htons((uint16_t)o.port);
+
+    for (int i = 0; i < t->nconns; i++) {
+        struct bconn *c = &t->conns[i];
+        c->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (c->fd < 0) die("socket");
+        int one = 1;
+        setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (o.stamps && ts_enable(c->fd) < 0) die("setsockopt SO_TIMESTAMPING");
+        if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 &&
+            errno != EINPROGRESS)
+            die("connect");
+
+        struct epoll_event ev;
+        ev.events   = EPOLLOUT;
+        ev.data.ptr = c;
+        if (epoll_ctl(t->epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0) die("epoll_ctl add");
+    }
+
+    int pending = t->nconns;
+    struct epoll_event events[MAX_EVENTS];
+    while (pending > 0) {
+        int n = epoll_wait(t->epfd, events, MAX_EVENTS, 5000);
+        if (n < 0) { if (errno == EINTR) continue; die("epoll_wait"); }
+        if (n == 0) {
+            fprintf(stderr, "[bench] thread %d: %d connects timed out\n", t->id, pending);
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < n; i++) {
+            struct bconn *c = events[i].data.ptr;
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err) {
+                errno = err;
+                die("connect");
+            }
+            c->connected = 1;
+            set_events(t, c, 0);
+            pending--;
+        }
+    }
+}
+
+static void *bench_thread(void *arg)
+{
+    struct bthread *t = arg;
+    hdr_init(&t->hist);
+    for (int s = 0; s < NSTAGES; s++) hdr_init(&t->stage[s]);
+
+    t->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (t->epfd < 0) die("epoll_create1");
+    connect_all(t);
+
+    /* Per-thread open-loop schedule: request q goes to conn q % nconns. */
+    double period = 0.0;
+    if (o.rate > 0) {
+        period = 1e9 / (o.rate * (double)t->nconns / (double)o.conns);
+        t->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (t->tfd < 0) die("timerfd_create");
+        struct epoll_event ev;
+        ev.events   = EPOLLIN;
+        ev.data.ptr = NULL;
+        if (epoll_ctl(t->epfd, EPOLL_CTL_ADD, t->tfd, &ev) < 0) die("epoll_ctl timerfd");
+    }
+
+    pthread_barrier_wait(&start_barrier);
+    uint64_t t0       = now_ns();
+    uint64_t warm_end = t0 + (uint64_t)(o.warmup * 1e9);
+    uint64_t end      = warm_end + (uint64_t)(o.duration * 1e9);
+    uint64_t q        = 0;      /* next request of the thread-wide schedule */
+
+    if (o.rate <= 0) {
+        for (int i = 0; i < t->nconns; i++) {
+            struct bconn *c = &t->conns[i];
+            while (c->issued < (uint64_t)o.depth) issue(c, t0);
+            if (flush_tx(t, c) < 0) die("send");
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    for (;;) {
+        uint64_t now = now_ns();
+        if (now >= end) break;
+
+        int timeout = (int)((end - now) / 1000000) + 1;
+        if (o.rate > 0) {
+            /* Hand out every request that has fallen due. */
+            for (;;) {
+                uint64_t due = t0 + (uint64_t)((double)q * period);
+                if (due > now) {
+                    struct itimerspec its = {0};
+                    its.it_value.tv_sec  = (time_t)(due / 1000000000ull);
+                    its.it_value.tv_nsec = (long)(due % 1000000000ull);
+                    timerfd_settime(t->tfd, TFD_TIMER_ABSTIME, &its, NULL);
+                    break;
+                }
+                struct bconn *c = &t->conns[q % (uint64_t)t->nconns];
+                c->owed++;
+                if (c->issued - c->done < (uint64_t)o.depth) {
+                    issue(c, intended(t, (int)(c - t->conns), c->issued, t0, period));
+                    c->owed--;
+                    if (flush_tx(t, c) < 0) die("send");
+                }
+                q++;
+            }
+        }
+
+        int n = epoll_wait(t->epfd, events, MAX_EVENTS, timeout);
+        if (n < 0) { if (errno == EINTR) continue; die("epoll_wait"); }
+        for (int i = 0; i < n; i++) {
+            struct bconn *c = events[i].data.ptr;
+            if (!c) {                       /* pacing timer */
+                uint64_t ticks;
+                if (read(t->tfd, &ticks, sizeof(ticks)) < 0) { /* spurious */ }
+                continue;
+            }
+            if (o.stamps && (events[i].events & EPOLLERR) && reap_tx(c) < 0)
+                die("recvmsg errqueue");
+            if ((events[i].events & EPOLLOUT) && flush_tx(t, c) < 0) die("send");
+            if ((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) &&
+                read_rx(t, c, warm_end, t0, period) < 0) {
+                fprintf(stderr, "[bench] connection closed by server\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    for (int i = 0; i < t->nconns; i++) close(t->conns[i].fd);
+    if (o.rate > 0) close(t->tfd);
+    close(t->epfd);
+    return NULL;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-H host] [-p port] [-c conns] [-t threads] [-d secs]\n"
+            "          [-w warmup_secs] [-s size] [-P depth] [-r rate] [-C] [-b]\n"
+            "          [-T] [-U unix_path | -Q seqpacket_path]\n"
+            "  -r rate   open loop at <rate> requests/s in total (default: closed loop)\n"
+            "  -C        print one CSV row instead of the human-readable report\n"
+            "  -b        binary protocol: -s-byte frames, default port 9103\n"
+            "  -T        split sampled TCP round trips into stages with kernel timestamps\n"
+            "  -U path   line protocol over an AF_UNIX stream socket\n"
+            "  -Q path   one -s-byte message per request over SOCK_SEQPACKET\n",
+            prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    while ((c = getopt(argc, argv, "H:p:c:t:d:w:s:P:r:CbTU:Q:")) != -1) {
+        switch (c) {
+        case 'H': o.host     = optarg;       break;
+        case 'p': o.port     = atoi(optarg); break;
+        case 'c': o.conns    = atoi(optarg); break;
+        case 't': o.threads  = atoi(optarg); break;
+        case 'd': o.duration = atof(optarg); break;
+        case 'w': o.warmup   = atof(optarg); break;
+        case 's': o.size     = atoi(optarg); break;
+        case 'P': o.depth    = atoi(optarg); break;
+        case 'r': o.rate     = atof(optarg); break;
+        case 'C': o.csv      = 1;            break;
+        case 'b': o.binary   = 1;            break;
+        case 'T': o.stamps   = 1;            break;
+        case 'U': o.upath    = optarg;       break;
+        case 'Q': o.upath    = optarg;
+                  o.seq      = 1;            break;
+        default:  usage(argv[0]);
+        }
+    }
+    if (o.upath && (o.binary || o.stamps)) usage(argv[0]);
+    if (o.port == 0) o.port = o.binary ? 9103 : 9003;
+    if (o.conns < 1 || o.threads < 1 || o.size < (o.binary ? BIN_HDR + 1 : 2) || o.depth < 1 ||
+        o.duration <= 0 || o.warmup < 0)
+        usage(argv[0]);
+    if (o.threads > o.conns) o.threads = o.conns;
+
+    /* Thousands of sockets need more than the usual 1024 fds. */
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    /* Request = size-1 letters + '\n'; consecutive letters never spell "bye". */
+    size_t reps = (TX_MIN + (size_t)o.size - 1) / (size_t)o.size;
+    payload_len = reps * (size_t)o.size;
+    payload     = malloc(payload_len);
+    if (!payload) die("malloc");
+    for (size_t i = 0; i < payload_len; i++) {
+        size_t k = i % (size_t)o.size;
+        payload[i] = (k == (size_t)o.size - 1) ? '\n' : (unsigned char)('a' + k % 26);
+    }
+    if (o.binary) {
+        /* Same size on the wire: a 16-byte header, then size-16 body bytes. */
+        struct bin_hdr h = { (uint32_t)o.size - BIN_HDR, BIN_ECHO, 0, 0 };
+        for (size_t i = 0; i < payload_len; i += (size_t)o.size)
+            bin_hdr_encode(payload + i, &h);
+    }
+
+    struct bthread *threads = calloc((size_t)o.threads, sizeof(*threads));
+    struct bconn   *conns   = calloc((size_t)o.conns, sizeof(*conns));
+    uint64_t       *stamps  = calloc((size_t)o.conns * (size_t)o.depth, sizeof(*stamps));
+    if (!threads || !conns || !stamps) die("calloc");
+    for (int i = 0; i < o.conns; i++) conns[i].stamps = stamps + (size_t)i * (size_t)o.depth;
+
+    pthread_barrier_init(&start_barrier, NULL, (unsigned)o.threads);
+    int first = 0;      /* global index of the thread's first connection */
+    for (int i = 0; i < o.threads; i++) {
+        struct bthread *t = &threads[i];
+        t->id     = i;
+        t->nconns = o.conns / o.threads + (i < o.conns % o.threads);
+        t->conns  = conns + first;
+        first    += t->nconns;
+        int rc = pthread_create(&t->tid, NULL, bench_thread, t);
+        if (rc != 0) { errno = rc; die("pthread_create"); }
+    }
+
+    struct hdr_hist *all   = malloc(sizeof(*all));
+    struct hdr_hist *stage = malloc(NSTAGES * sizeof(*stage));
+    if (!all || !stage) die("malloc");
+    hdr_init(all);
+    for (int s = 0; s < NSTAGES; s++) hdr_init(&stage[s]);
+    uint64_t measured = 0, errors = 0;
+    for (int i = 0; i < o.threads; i++) {
+        pthread_join(threads[i].tid, NULL);
+        hdr_merge(all, &threads[i].hist);
+        for (int s = 0; s < NSTAGES; s++) hdr_merge(&stage[s], &threads[i].stage[s]);
+        measured += threads[i].measured;
+        errors   += threads[i].errors;
+    }
+
+    double rps  = (double)measured / o.duration;
+    double mbps = rps * (double)o.size * 2.0 / 1e6;   /* both directions */
+    double p50  = (double)hdr_percentile(all, 50.0)  / 1e3;
+    double p99  = (double)hdr_percentile(all, 99.0)  / 1e3;
+    double p999 = (double)hdr_percentile(all, 99.9)  / 1e3;
+    double pmax = (double)(all->total ? all->max : 0) / 1e3;
+    const char *mode  = o.rate > 0 ? "open" : "closed";
+    const char *proto = o.binary ? "binary" : o.seq ? "seqpacket" : o.upath ? "unix" : "line";
+
+    if (o.csv) {
+        printf("mode,proto,conns,threads,size,depth,rate,duration_s,requests,rps,mb_s,"
+               "p50_us,p99_us,p999_us,max_us,mean_us,errors");
+        for (int s = 0; o.stamps && s < NSTAGES; s++)
+            printf(",%s_p50_us,%s_p99_us", stage_csv[s], stage_csv[s]);
+        printf("\n%s,%s,%d,%d,%d,%d,%.0f,%.2f,%llu,%.1f,%.2f,%.1f,%.1f,%.1f,%.1f,%.1f,%llu",
+               mode, proto, o.conns, o.threads, o.size, o.depth, o.rate, o.duration,
+               (unsigned long long)measured, rps, mbps, p50, p99, p999, pmax,
+               hdr_mean(all) / 1e3, (unsigned long long)errors);
+        for (int s = 0; o.stamps && s < NSTAGES; s++)
+            printf(",%.1f,%.1f", (double)hdr_percentile(&stage[s], 50.0) / 1e3,
+                   (double)hdr_percentile(&stage[s], 99.0) / 1e3);
+        printf("\n");
+    } else {
+        if (o.upath) printf("[bench] %s", o.upath);
+        else         printf("[bench] %s:%d", o.host, o.port);
+        printf("  mode=%s proto=%s conns=%d threads=%d size=%d depth=%d",
+               mode, proto, o.conns, o.threads, o.size, o.depth);
+        if (o.rate > 0) printf(" rate=%.0f/s", o.rate);
+        printf("\n[bench] %llu requests in %.2f s: %.1f req/s, %.2f MB/s\n",
+               (unsigned long long)measured, o.duration, rps, mbps);
+        printf("[bench] latency (us): p50=%.1f p99=%.1f p99.9=%.1f max=%.1f mean=%.1f\n",
+               p50, p99, p999, pmax, hdr_mean(all) / 1e3);
+        if (o.stamps) {
+            printf("[bench] stages (us) of %llu sampled round trips:\n",
+                   (unsigned long long)stage[ST_NET].total);
+            for (int s = 0; s < NSTAGES; s++)
+                printf("[bench]   %-12s p50=%.1f p99=%.1f p99.9=%.1f max=%.1f\n", stage_name[s],
+                       (double)hdr_percentile(&stage[s], 50.0) / 1e3,
+                       (double)hdr_percentile(&stage[s], 99.0) / 1e3,
+                       (double)hdr_percentile(&stage[s], 99.9) / 1e3,
+                       (double)(stage[s].total ? stage[s].max : 0) / 1e3);
+        }
+        if (errors) printf("[bench] %llu echo mismatches!\n", (unsigned long long)errors);
+    }
+
+    pthread_barrier_destroy(&start_barrier);
+    free(all);
+    free(stage);
+    free(stamps);
+    free(conns);
+    free(threads);
+    free(payload);
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+/*
+ * bench/framing_bench.c
+ *
+ * Newline framing microbenchmark for linux/common/framing.h.
+ *
+ * Builds a large buffer of pipelined lines (fixed length per run) and
+ * measures how fast each scanner turns it into (pointer, length) pairs:
+ * the scalar, SSE2 and AVX2 block splitters, a memchr()-per-line baseline,
+ * and the full framer_feed() path fed in recv()-sized chunks so carry-over
+ * between chunks is included.  Reports GB/s and ns per line, best of N.
+ *
+ * Usage: framing_bench [-m megabytes] [-n repetitions] [-c chunk_bytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../linux/common/sock_helpers.h"
+#include "../linux/common/framing.h"
+
+#define BATCH 256
+
+static struct frame_line lines[BATCH];
+static volatile size_t   sink;       /* keeps the results observable */
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+typedef int (*split_fn)(const char *, const char *, struct frame_line *, int,
+                        const char **);
+
+static size_t run_split(split_fn fn, const char *buf, size_t len)
+{
+    const char *p = buf, *end = buf + len;
+    size_t nlines = 0, bytes = 0;
+    while (p < end) {
+        const char *stop;
+        int n = fn(p, end, lines, BATCH, &stop);
+        if (n == 0) break;
+        for (int i = 0; i < n; i++) bytes += lines[i].len;
+        nlines += (size_t)n;
+        p = stop;
+    }
+    sink = bytes;
+    return nlines;
+}
+
+static size_t run_memchr(const char *buf, size_t len)
+{
+    const char *p = buf, *end = buf + len;
+    size_t nlines = 0, bytes = 0;
+    for (;;) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        if (!nl) break;
+        bytes += (size_t)(nl + 1 - p);
+        nlines++;
+        p = nl + 1;
+    }
+    sink = bytes;
+    return nlines;
+}
+
+static size_t run_framer(const char *buf, size_t len, size_t chunk)
+{
+    struct framer f;
+    framer_init(&f);
+    size_t nlines = 0, bytes = 0;
+    for (size_t off = 0; off < len; off += chunk) {
+        const char *p = buf + off;
+        size_t n = len - off < chunk ? len - off : chunk;
+        while (n > 0) {
+            size_t used;
+            int k = framer_feed(&f, p, n, lines, BATCH, &used);
+            if (k < 0) die("framer_feed");
+            for (int i = 0; i < k; i++) bytes += lines[i].len;
+            nlines += (size_t)k;
+            p += used;
+            n -= used;
+        }
+    }
+    framer_free(&f);
+    sink = bytes;
+    return nlines;
+}
+
+enum { V_SCALAR, V_SSE2, V_AVX2, V_MEMCHR, V_FRAMER };
+static const char *vnames[] = { "scalar", "sse2", "avx2", "memchr", "framer_feed" };
+
+static size_t run(int v, const char *buf, size_t len, size_t chunk)
+{
+    switch (v) {
+    case V_SCALAR: return run_split(frame_split_scalar, buf, len);
+#ifdef FRAMING_X86
+    case V_SSE2:   return run_split(frame_split_sse2, buf, len);
+    case V_AVX2:   return run_split(frame_split_avx2, buf, len);
+#endif
+    case V_MEMCHR: return run_memchr(buf, len);
+    default:       return run_framer(buf, len, chunk);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t mb = 64, chunk = 64 * 1024;
+    int reps = 5, c;
+    while ((c = getopt(argc, argv, "m:n:c:")) != -1) {
+        switch (c) {
+        case 'm': mb    = (size_t)atol(optarg); break;
+        case 'n': reps  = atoi(optarg);         break;
+        case 'c': chunk = (size_t)atol(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-m megabytes] [-n repetitions] [-c chunk_bytes]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (mb < 1 || reps < 1 || chunk < 1) return EXIT_FAILURE;
+
+    size_t len = mb << 20;
+    char *buf = malloc(len);
+    if (!buf) die("malloc");
+
+    static const size_t line_lens[] = { 8, 16, 64, 256, 1024, 4096 };
+    printf("[bench] framing: %zu MB buffer, best of %d, framer chunk %zu B, simd level %d\n",
+           mb, reps, chunk, frame_simd_level());
+    printf("%-8s %-12s %10s %10s\n", "line_len", "scanner", "GB/s", "ns/line");
+
+    for (size_t li = 0; li < sizeof(line_lens) / sizeof(line_lens[0]); li++) {
+        size_t ll = line_lens[li];
+        for (size_t i = 0; i < len; i++)
+            buf[i] = (i % ll == ll - 1) ? '\n' : (char)('a' + i % 26);
+
+        for (int v = V_SCALAR; v <= V_FRAMER; v++) {
+#ifndef FRAMING_X86
+            if (v == V_SSE2 || v == V_AVX2) continue;
+#else
+            if (v == V_AVX2 && frame_simd_level() < 2) continue;
+#endif
+            uint64_t best = UINT64_MAX;
+            size_t nlines = 0;
+            for (int r = 0; r < reps; r++) {
+                uint64_t t0 = now_ns();
+                nlines = run(v, buf, len, chunk);
+                uint64_t dt = now_ns() - t0;
+                if (dt < best) best = dt;
+            }
+            if (nlines != len / ll) {
+                fprintf(stderr, "[bench] %s: %zu lines, expected %zu\n",
+                        vnames[v], nlines, len / ll);
+                return EXIT_FAILURE;
+            }
+            printf("%-8zu %-12s %10.2f %10.2f\n", ll, vnames[v],
+                   (double)len / (double)best, (double)best / (double)nlines);
+        }
+    }
+
+    free(buf);
+    return EXIT_SUCCESS;
+}
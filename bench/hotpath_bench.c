@@ -0,0 +1,264 @@
+/*
+ * bench/hotpath_bench.c
+ *
+ * Microbenchmarks for linux/common/sock_helpers.h and the per-message hot
+ * path of the echo servers, on the harness in bench/microbench.h:
+ *
+ *   write_all_devnull_64    write_all() of 64 bytes to /dev/null
+ *   write_all_pipe_64       write_all() of 64 bytes into a pipe, read back
+ *   set_nonblocking         fcntl(F_GETFL) + fcntl(F_SETFL) on a socket
+ *   frame_is_bye            "bye" check of one line
+ *   frame_split_4k          every line of a 4 KB buffer of 32-byte lines
+ *   framer_feed_4k          the same through a connection's framer
+ *   tcp_roundtrip_64        64 bytes client -> server -> client on loopback
+ *   coro_yield              co_yield() and back: two switches through the
+ *                           linux/common/coro.h scheduler
+ *   ucontext_swap           swapcontext() there and back, the fallback's cost
+ *
+ * The round trip runs both ends in this thread on blocking sockets:
+ * send(), recv() on the accepted socket, send() back, recv() — four
+ * system calls and two trips through the TCP stack, no scheduler.
+ *
+ * Human-readable lines go to stderr, the JSON report to stdout (or -o).
+ *
+ * Usage: hotpath_bench [-r reps] [-w warmup_ms] [-t target_ms] [-f filter]
+ *                      [-o out.json]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ucontext.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "../linux/common/sock_helpers.h"
+#include "../linux/common/framing.h"
+#include "../linux/common/coro.h"
+#include "microbench.h"
+
+#define MSG   64
+#define BLOCK 4096
+#define LINE  32
+
+struct fds {
+    int a, b;
+};
+
+static char msg[MSG];
+static char block[BLOCK];
+
+static void bench_write_devnull(void *arg, uint64_t iters)
+{
+    int fd = *(int *)arg;
+    for (uint64_t i = 0; i < iters; i++)
+        if (write_all(fd, msg, MSG) < 0) die("write_all");
+}
+
+static void bench_write_pipe(void *arg, uint64_t iters)
+{
+    struct fds *p = arg;
+    char buf[MSG];
+    for (uint64_t i = 0; i < iters; i++) {
+        if (write_all(p->b, msg, MSG) < 0) die("write_all");
+        if (read(p->a, buf, MSG) != MSG) die("read");
+        mb_keep(buf[0]);
+    }
+}
+
+static void bench_set_nonblocking(void *arg, uint64_t iters)
+{
+    int fd = *(int *)arg;
+    for (uint64_t i = 0; i < iters; i++) set_nonblocking(fd);
+}
+
+static void bench_is_bye(void *arg, uint64_t iters)
+{
+    (void)arg;
+    static const char text[] = "ping\n";
+    struct frame_line l = { text, sizeof(text) - 1 };
+    for (uint64_t i = 0; i < iters; i++) {
+        mb_opaque(l.p);
+        int bye = frame_is_bye(&l);
+        mb_keep(bye);
+    }
+}
+
+static void bench_split(void *arg, uint64_t iters)
+{
+    (void)arg;
+    struct frame_line lines[BLOCK / LINE];
+    for (uint64_t i = 0; i < iters; i++) {
+        const char *p = block, *stop;
+        mb_opaque(p);
+        int n = frame_split(p, block + BLOCK, lines, BLOCK / LINE, &stop);
+        mb_keep(n);
+        mb_keep(lines[n - 1].len);
+    }
+}
+
+static void bench_framer(void *arg, uint64_t iters)
+{
+    struct framer *f = arg;
+    struct frame_line lines[BLOCK / LINE];
+    for (uint64_t i = 0; i < iters; i++) {
+        const char *p = block;
+        size_t used = 0;
+        mb_opaque(p);
+        int n = framer_feed(f, p, BLOCK, lines, BLOCK / LINE, &used);
+        mb_keep(n);
+        mb_keep(used);
+    }
+}
+
+static void bench_roundtrip(void *arg, uint64_t iters)
+{
+    struct fds *c = arg;
+    char buf[MSG];
+    for (uint64_t i = 0; i < iters; i++) {
+        if (send(c->a, msg, MSG, 0) != MSG) die("send");
+        if (recv(c->b, buf, MSG, MSG_WAITALL) != MSG) die("recv");
+        if (send(c->b, buf, MSG, 0) != MSG) die("send");
+        if (recv(c->a, buf, MSG, MSG_WAITALL) != MSG) die("recv");
+        mb_keep(buf[0]);
+    }
+}
+
+static uint64_t yields_left;
+
+static void yield_loop(void *arg)
+{
+    (void)arg;
+    while (yields_left-- > 0) co_yield();
+}
+
+static void bench_coro_yield(void *arg, uint64_t iters)
+{
+    struct co_sched *s = arg;
+    yields_left = iters;
+    if (co_spawn(s, yield_loop, NULL) < 0 || co_run(s) < 0) die("co_run");
+}
+
+static ucontext_t uc_main, uc_co;
+
+static void uc_loop(void)
+{
+    for (;;) swapcontext(&uc_co, &uc_main);
+}
+
+/*
+ * Out of main(): getcontext() returns twice as far as the compiler knows,
+ * which would leave main()'s locals open to -Wclobbered.
+ */
+static void uc_setup(void)
+{
+    static char uc_stack[64 * 1024];
+    getcontext(&uc_co);
+    uc_co.uc_stack.ss_sp   = uc_stack;
+    uc_co.uc_stack.ss_size = sizeof(uc_stack);
+    makecontext(&uc_co, uc_loop, 0);
+}
+
+static void bench_ucontext(void *arg, uint64_t iters)
+{
+    (void)arg;
+    for (uint64_t i = 0; i < iters; i++) swapcontext(&uc_main, &uc_co);
+}
+
+/* A connected loopback TCP pair: a is the client, b the accepted end. */
+static struct fds tcp_pair(void)
+{
+    struct fds c;
+    struct sockaddr_in addr;
+    socklen_t al = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (lfd < 0) die("socket");
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) die("bind");
+    if (listen(lfd, 1) < 0) die("listen");
+    if (getsockname(lfd, (struct sockaddr *)&addr, &al) < 0) die("getsockname");
+
+    c.a = socket(AF_INET, SOCK_STREAM, 0);
+    if (c.a < 0) die("socket");
+    if (connect(c.a, (struct sockaddr *)&addr, sizeof(addr)) < 0) die("connect");
+    c.b = accept(lfd, NULL, NULL);
+    if (c.b < 0) die("accept");
+    close(lfd);
+
+    int one = 1;
+    setsockopt(c.a, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(c.b, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return c;
+}
+
+int main(int argc, char **argv)
+{
+    struct mb_opts o = { 15, 200, 50, NULL };
+    const char *out_path = NULL;
+    int c;
+    while ((c = getopt(argc, argv, "r:w:t:f:o:")) != -1) {
+        switch (c) {
+        case 'r': o.reps      = atoi(optarg); break;
+        case 'w': o.warmup_ms = atoi(optarg); break;
+        case 't': o.target_ms = atoi(optarg); break;
+        case 'f': o.filter    = optarg;       break;
+        case 'o': out_path    = optarg;       break;
+        default:
+            fprintf(stderr, "usage: %s [-r reps] [-w warmup_ms] [-t target_ms] [-f filter]\n"
+                            "          [-o out.json]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    memset(msg, 'm', MSG - 1);
+    msg[MSG - 1] = '\n';
+    for (int i = 0; i < BLOCK; i++) block[i] = (i % LINE == LINE - 1) ? '\n' : 'x';
+
+    int devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (devnull < 0) die("open /dev/null");
+    int pfd[2];
+    if (pipe(pfd) < 0) die("pipe");
+    struct fds pipe_fds = { pfd[0], pfd[1] };
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) die("socket");
+    struct framer f;
+    framer_init(&f);
+    struct fds tcp = tcp_pair();
+    struct co_sched sched;
+    if (co_sched_init(&sched, 0, 0) < 0) die("co_sched_init");
+    uc_setup();
+
+    mb_run(&o, "write_all_devnull_64", bench_write_devnull, &devnull);
+    mb_run(&o, "write_all_pipe_64",    bench_write_pipe,    &pipe_fds);
+    mb_run(&o, "set_nonblocking",      bench_set_nonblocking, &sock);
+    mb_run(&o, "frame_is_bye",         bench_is_bye,        NULL);
+    mb_run(&o, "frame_split_4k",       bench_split,         NULL);
+    mb_run(&o, "framer_feed_4k",       bench_framer,        &f);
+    mb_run(&o, "tcp_roundtrip_64",     bench_roundtrip,     &tcp);
+    mb_run(&o, "coro_yield",           bench_coro_yield,    &sched);
+    mb_run(&o, "ucontext_swap",        bench_ucontext,      NULL);
+
+    FILE *out = stdout;
+    if (out_path && !(out = fopen(out_path, "w"))) die(out_path);
+    mb_report_json(out, "hotpath");
+    if (out != stdout) fclose(out);
+
+    co_sched_destroy(&sched);
+    framer_free(&f);
+    close(tcp.a);
+    close(tcp.b);
+    close(sock);
+    close(pfd[0]);
+    close(pfd[1]);
+    close(devnull);
+    return 0;
+}
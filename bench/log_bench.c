@@ -0,0 +1,133 @@
+/*
+ * bench/log_bench.c
+ *
+ * Producer-side cost of one log call: printf() through stdio versus
+ * LOG_INFO() from linux/common/log.h, with 1..N threads logging at once.
+ *
+ * Each thread makes -n calls shaped like the servers' per-line message
+ * ("[server] recv (fd=%d): %.*s") in bursts of half a ring, pausing
+ * between bursts so the writer thread can drain; only the bursts are
+ * timed.  Reported is the wall time per call as seen by the logging
+ * thread — what the event loop would pay — and, for the async logger,
+ * how many records were dropped anyway.  Log output goes to /dev/null;
+ * results are printed to stderr.
+ *
+ * Usage: log_bench [-n calls_per_thread] [-t max_threads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../linux/common/sock_helpers.h"
+#include "../linux/common/log.h"
+
+static long             ncalls = 100000;
+static int              use_log;
+static pthread_barrier_t start;
+
+static const char line[] = "GET /index.html HTTP/1.1 hello world\n";
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#define BURST (LOG_RING_SLOTS / 2)
+
+static void *producer(void *arg)
+{
+    uint64_t *ns = arg;
+    int fd = 5, len = (int)sizeof(line) - 1;
+    struct timespec pause = { 0, 3 * LOG_IDLE_NS };
+
+    if (use_log) {                       /* set up this thread's ring untimed */
+        log_ring_get();
+        nanosleep(&pause, NULL);
+    }
+    pthread_barrier_wait(&start);
+    *ns = 0;
+    for (long done = 0; done < ncalls; done += BURST) {
+        uint64_t t0 = now_ns();
+        if (use_log) {
+            for (int i = 0; i < BURST; i++)
+                LOG_INFO("[server] recv (fd=%d): %.*s", fd, len, line);
+        } else {
+            for (int i = 0; i < BURST; i++)
+                printf("[server] recv (fd=%d): %.*s", fd, len, line);
+        }
+        *ns += now_ns() - t0;
+        nanosleep(&pause, NULL);
+    }
+    return NULL;
+}
+
+static uint64_t dropped_total(void)
+{
+    uint64_t d = 0;
+    for (unsigned i = 0; i < LOG_MAX_RINGS; i++)
+        if (log_rings[i]) d += log_rings[i]->dropped;
+    return d;
+}
+
+int main(int argc, char **argv)
+{
+    int maxthreads = 4, c;
+    while ((c = getopt(argc, argv, "n:t:")) != -1) {
+        switch (c) {
+        case 'n': ncalls     = atol(optarg); break;
+        case 't': maxthreads = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n calls_per_thread] [-t max_threads]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    /* Every run gets fresh threads, so rings add up to 2 * maxthreads. */
+    if (ncalls < 1 || maxthreads < 1 || maxthreads > 16) return EXIT_FAILURE;
+
+    /* Both loggers write to /dev/null, as a fully buffered file. */
+    int null = open("/dev/null", O_WRONLY);
+    if (null < 0 || dup2(null, STDOUT_FILENO) < 0) die("/dev/null");
+    setvbuf(stdout, NULL, _IOFBF, 64 * 1024);
+    log_init();
+    log_set_level(LOG_LVL_INFO);
+
+    fprintf(stderr, "[bench] log: %ld calls per thread\n", ncalls);
+    fprintf(stderr, "%-8s %-8s %12s %12s\n", "threads", "logger", "ns/call", "dropped");
+
+    for (int t = 1; t <= maxthreads; t *= 2) {
+        for (use_log = 0; use_log <= 1; use_log++) {
+            pthread_t tid[LOG_MAX_RINGS];
+            uint64_t  ns[LOG_MAX_RINGS];
+            uint64_t  d0 = dropped_total();
+            pthread_barrier_init(&start, NULL, (unsigned)t);
+            for (int i = 0; i < t; i++)
+                if (pthread_create(&tid[i], NULL, producer, &ns[i]) != 0) die("pthread_create");
+            uint64_t sum = 0;
+            for (int i = 0; i < t; i++) {
+                pthread_join(tid[i], NULL);
+                sum += ns[i];
+            }
+            pthread_barrier_destroy(&start);
+            fflush(stdout);
+
+            /* Let the writer catch up so each run starts with empty rings. */
+            struct timespec idle = { 0, 50 * 1000000 };
+            nanosleep(&idle, NULL);
+
+            fprintf(stderr, "%-8d %-8s %12.1f %12llu\n", t, use_log ? "async" : "printf",
+                    (double)sum / (double)((ncalls + BURST - 1) / BURST * BURST * t),
+                    (unsigned long long)(dropped_total() - d0));
+        }
+    }
+
+    log_shutdown();
+    return EXIT_SUCCESS;
+}
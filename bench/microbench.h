@@ -0,0 +1,192 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+/*
+ * bench/microbench.h
+ *
+ * Header-only microbenchmark harness.
+ *
+ * A benchmark is a function that runs its operation `iters` times.  The
+ * harness first calibrates `iters` so one repetition takes about
+ * target_ms, runs the function for warmup_ms without measuring (caches,
+ * branch predictors, page faults, CPU frequency), then times `reps`
+ * repetitions with CLOCK_MONOTONIC and, on x86, the TSC.  Per-operation
+ * figures are a repetition's time divided by `iters`; the minimum, median
+ * and mean across repetitions are kept, the median being the one to
+ * compare.
+ *
+ * The TSC counts at a constant reference rate, not in core clock cycles,
+ * so "cycles" only matches the core clock when it runs at nominal speed.
+ *
+ * Work whose result is unused may be deleted by the compiler: pass results
+ * through mb_keep() and inputs through mb_opaque().
+ *
+ * mb_report_json() writes every result with the compiler, build flags and
+ * host, so runs of two builds can be diffed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#if defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#  define MB_HAVE_TSC 1
+#else
+#  define MB_HAVE_TSC 0
+#endif
+
+#if defined(__clang__)
+#  define MB_COMPILER "clang " __clang_version__
+#elif defined(__GNUC__)
+#  define MB_COMPILER "gcc " __VERSION__
+#else
+#  define MB_COMPILER "unknown"
+#endif
+
+#define MB_MAX_RESULTS 64
+#define MB_MAX_REPS    1000
+
+typedef void (*mb_fn)(void *arg, uint64_t iters);
+
+struct mb_opts {
+    int         reps;                        /* measured repetitions */
+    int         warmup_ms;
+    int         target_ms;                   /* wanted length of one repetition */
+    const char *filter;                      /* run only names containing this */
+};
+
+struct mb_result {
+    const char *name;
+    uint64_t    iters;                       /* operations per repetition */
+    int         reps;
+    double      ns_min, ns_median, ns_mean;  /* per operation */
+    double      cyc_min, cyc_median;         /* per operation, TSC; 0 without */
+};
+
+static struct mb_result mb_results[MB_MAX_RESULTS];
+static int              mb_nresults;
+
+/* The compiler must assume v is read: its computation cannot be dropped. */
+#define mb_keep(v)   __asm__ volatile("" : : "r,m"(v) : "memory")
+/* The compiler must assume v may have changed: it cannot be constant-folded. */
+#define mb_opaque(v) __asm__ volatile("" : "+r"(v) : : "memory")
+
+static inline uint64_t mb_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t mb_cycles(void)
+{
+#if MB_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static inline int mb_cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Calibrate, warm up and measure fn.  Returns the stored result, or NULL
+ * if the filter skips it.
+ */
+static inline const struct mb_result *mb_run(const struct mb_opts *o, const char *name,
+                                             mb_fn fn, void *arg)
+{
+    if (o->filter && !strstr(name, o->filter)) return NULL;
+    if (mb_nresults == MB_MAX_RESULTS) {
+        fprintf(stderr, "microbench: more than %d results\n", MB_MAX_RESULTS);
+        exit(EXIT_FAILURE);
+    }
+
+    /* Double iters until one repetition takes at least a tenth of the target. */
+    uint64_t iters = 1, target = (uint64_t)o->target_ms * 1000000ull, t;
+    for (;;) {
+        t = mb_now_ns();
+        fn(arg, iters);
+        t = mb_now_ns() - t;
+        if (t >= target / 10 || iters >= (1ull << 40)) break;
+        iters *= 2;
+    }
+    if (t > 0) iters = (uint64_t)((double)iters * (double)target / (double)t);
+    if (iters == 0) iters = 1;
+
+    uint64_t until = mb_now_ns() + (uint64_t)o->warmup_ms * 1000000ull;
+    while (mb_now_ns() < until) fn(arg, iters / 4 + 1);
+
+    int    reps = o->reps < 1 ? 1 : o->reps > MB_MAX_REPS ? MB_MAX_REPS : o->reps;
+    double ns[MB_MAX_REPS], cyc[MB_MAX_REPS], sum = 0;
+    for (int r = 0; r < reps; r++) {
+        uint64_t c0 = mb_cycles(), t0 = mb_now_ns();
+        fn(arg, iters);
+        uint64_t t1 = mb_now_ns(), c1 = mb_cycles();
+        ns[r]  = (double)(t1 - t0) / (double)iters;
+        cyc[r] = (double)(c1 - c0) / (double)iters;
+        sum   += ns[r];
+    }
+    qsort(ns, (size_t)reps, sizeof(double), mb_cmp_double);
+    qsort(cyc, (size_t)reps, sizeof(double), mb_cmp_double);
+
+    struct mb_result *res = &mb_results[mb_nresults++];
+    res->name       = name;
+    res->iters      = iters;
+    res->reps       = reps;
+    res->ns_min     = ns[0];
+    res->ns_median  = ns[reps / 2];
+    res->ns_mean    = sum / reps;
+    res->cyc_min    = cyc[0];
+    res->cyc_median = cyc[reps / 2];
+    fprintf(stderr, "%-28s %10.1f ns %10.1f cycles  (min %.1f ns, %d x %llu)\n", name,
+            res->ns_median, res->cyc_median, res->ns_min, reps, (unsigned long long)iters);
+    return res;
+}
+
+/* Every result so far as one JSON document, with what built and ran it. */
+static inline void mb_report_json(FILE *out, const char *suite)
+{
+    struct utsname u;
+    if (uname(&u) < 0) memset(&u, 0, sizeof(u));
+    fprintf(out, "{\n  \"suite\": \"%s\",\n", suite);
+    fprintf(out, "  \"build\": {\"compiler\": \"%s\", \"optimized\": %s, \"asserts\": %s},\n",
+            MB_COMPILER,
+#ifdef __OPTIMIZE__
+            "true",
+#else
+            "false",
+#endif
+#ifdef NDEBUG
+            "false"
+#else
+            "true"
+#endif
+            );
+    fprintf(out, "  \"host\": {\"sysname\": \"%s\", \"release\": \"%s\", \"machine\": \"%s\", "
+                 "\"cpus\": %ld},\n",
+            u.sysname, u.release, u.machine, sysconf(_SC_NPROCESSORS_ONLN));
+    fprintf(out, "  \"time\": %lld,\n  \"results\": [", (long long)time(NULL));
+    for (int i = 0; i < mb_nresults; i++) {
+        const struct mb_result *r = &mb_results[i];
+        fprintf(out, "%s\n    {\"name\": \"%s\", \"iters\": %llu, \"reps\": %d, "
+                     "\"ns_min\": %.3f, \"ns_median\": %.3f, \"ns_mean\": %.3f, ",
+                i ? "," : "", r->name, (unsigned long long)r->iters, r->reps,
+                r->ns_min, r->ns_median, r->ns_mean);
+        if (MB_HAVE_TSC)
+            fprintf(out, "\"cycles_min\": %.3f, \"cycles_median\": %.3f}", r->cyc_min, r->cyc_median);
+        else
+            fprintf(out, "\"cycles_min\": null, \"cycles_median\": null}");
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+#endif /* MICROBENCH_H */
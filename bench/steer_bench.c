@@ -0,0 +1,440 @@
+/*
+ * bench/steer_bench.c
+ *
+ * Request rate and cache misses of a listener-per-CPU echo server with
+ * the kernel's SO_REUSEPORT hash against CBPF steering by incoming CPU
+ * (linux/common/reuseport.h, linux03_reactor -C).
+ *
+ * For each mode it starts, in this process, one server worker per CPU —
+ * pinned, with its own SO_REUSEPORT listener on a loopback port and its
+ * own epoll loop — and one client thread per CPU, pinned the same way,
+ * each holding -c connections that echo -s bytes back and forth.  On
+ * loopback a SYN is processed on the CPU of the thread that sent it, so
+ * with steering a client's connections all go to the worker on its own
+ * CPU, and every request stays on one CPU; with the hash, most go to a
+ * worker elsewhere, and every request crosses CPUs twice.
+ *
+ * Each thread counts its own cache misses (user and kernel, which takes
+ * in the loopback softirq run on its behalf) and context switches over
+ * the measured window with perf_event_open(); they are reported per
+ * request.  Without a PMU (most VMs) the cache misses show as n/a.  The
+ * workers also count how many connections they accepted from their own
+ * CPU (SO_INCOMING_CPU).  With one CPU both modes are the same thing.
+ *
+ * Usage: steer_bench [-t workers] [-c conns_per_thread] [-d secs] [-s size]
+ *                    [-m hash|cpu] [-C]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <linux/perf_event.h>
+
+#include "../linux/common/sock_helpers.h"
+#include "../linux/common/hdr_hist.h"
+#include "../linux/common/reuseport.h"
+
+#define MAX_THREADS 256
+#define MAX_EVENTS  64
+#define MAX_SIZE    65536
+
+enum { PC_MISSES, PC_CSW, NCOUNTERS };
+
+struct opts {
+    int    threads;               /* workers, and client threads */
+    int    conns;                 /* per client thread */
+    double duration;              /* per mode */
+    int    size;
+    int    modes;                 /* bit 0: hash, bit 1: cpu */
+    int    csv;
+};
+
+/* A server worker or a client thread; both count their own events. */
+struct sthread {
+    pthread_t       tid;
+    int             cpu;
+    int             lfd;          /* worker: its listener */
+    int             pc[NCOUNTERS];
+    uint64_t        accepted, local;
+    uint64_t        done;         /* client: requests in the window */
+    uint64_t        errors;
+    struct hdr_hist hist;
+};
+
+struct result {
+    uint64_t requests, accepted, local, errors;
+    uint64_t count[NCOUNTERS];    /* UINT64_MAX: not available */
+    double   p50, p99;
+};
+
+static struct opts        o = { 0, 8, 5.0, 64, 3, 0 };
+static struct sthread     workers[MAX_THREADS], clients[MAX_THREADS];
+static struct sockaddr_in srv;
+static pthread_barrier_t  ready;
+static atomic_int         measuring, stopping;
+static atomic_int         open_conns;   /* server side, until the clients hang up */
+static int                user_only;  /* perf_event_paranoid kept the kernel out */
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void pin(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0) fprintf(stderr, "steer_bench: pin to cpu %d: %s\n", cpu, strerror(rc));
+}
+
+/* Disabled counter for the calling thread; -1 when there is none. */
+static int counter_open(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.size           = sizeof(a);
+    a.type           = type;
+    a.config         = config;
+    a.disabled       = 1;
+    a.exclude_kernel = user_only;
+    a.exclude_hv     = 1;
+    int fd = (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+    if (fd < 0 && errno == EACCES && !user_only) {
+        user_only = 1;
+        return counter_open(type, config);
+    }
+    return fd;
+}
+
+static void counters_open(struct sthread *t)
+{
+    t->pc[PC_MISSES] = counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    t->pc[PC_CSW]    = counter_open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+}
+
+static void counters_switch(struct sthread *t, unsigned long req)
+{
+    for (int k = 0; k < NCOUNTERS; k++)
+        if (t->pc[k] >= 0) ioctl(t->pc[k], req, 0);
+}
+
+/* Add t's counts into sum; a counter any thread lacks becomes UINT64_MAX. */
+static void counters_close(struct sthread *t, uint64_t *sum)
+{
+    for (int k = 0; k < NCOUNTERS; k++) {
+        uint64_t v = 0;
+        if (t->pc[k] < 0 || read(t->pc[k], &v, sizeof(v)) != sizeof(v)) sum[k] = UINT64_MAX;
+        else if (sum[k] != UINT64_MAX) sum[k] += v;
+        if (t->pc[k] >= 0) close(t->pc[k]);
+    }
+}
+
+/* Accept and echo until stopped and every client connection is closed. */
+static void *worker_main(void *arg)
+{
+    struct sthread *w = arg;
+    pin(w->cpu);
+    counters_open(w);
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) die("epoll_create1");
+    struct epoll_event ev;
+    ev.events  = EPOLLIN;
+    ev.data.fd = w->lfd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, w->lfd, &ev) < 0) die("epoll_ctl add lfd");
+    pthread_barrier_wait(&ready);
+
+    char *buf = malloc(MAX_SIZE);
+    if (!buf) die("malloc");
+    struct epoll_event events[MAX_EVENTS];
+    while (!atomic_load(&stopping) || atomic_load(&open_conns) > 0) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, 10);
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == w->lfd) {
+                int cfd;
+                while ((cfd = accept4(w->lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    w->accepted++;
+                    if (rp_incoming_cpu(cfd) == w->cpu) w->local++;
+                    int one = 1;
+                    setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    ev.events  = EPOLLIN;
+                    ev.data.fd = cfd;
+                    if (epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &ev) < 0) die("epoll_ctl add");
+                }
+                continue;
+            }
+            ssize_t r = recv(fd, buf, MAX_SIZE, 0);
+            if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+            /* Echoes are never bigger than what the client waits for: no EAGAIN. */
+            if (r <= 0 || send(fd, buf, (size_t)r, MSG_NOSIGNAL) != r) {
+                if (r != 0 && !atomic_load(&stopping)) w->errors++;  /* else a hang-up's RST */
+                close(fd);
+                atomic_fetch_sub(&open_conns, 1);
+            }
+        }
+    }
+    free(buf);
+    close(epfd);
+    return NULL;
+}
+
+/* Keep every connection echoing -s bytes; time each round trip. */
+static void *client_main(void *arg)
+{
+    struct sthread *t = arg;
+    pin(t->cpu);
+    counters_open(t);
+    hdr_init(&t->hist);
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) die("epoll_create1");
+    int      *fds   = calloc((size_t)o.conns, sizeof(*fds));
+    int      *got   = calloc((size_t)o.conns, sizeof(*got));
+    uint64_t *start = calloc((size_t)o.conns, sizeof(*start));
+    char     *msg   = malloc((size_t)o.size), *buf = malloc(MAX_SIZE);
+    if (!fds || !got || !start || !msg || !buf) die("calloc");
+    memset(msg, 'x', (size_t)o.size);
+    for (int i = 0; i < o.conns; i++) {
+        fds[i] = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fds[i] < 0) die("socket");
+        if (connect(fds[i], (struct sockaddr *)&srv, sizeof(srv)) < 0) die("connect");
+        int one = 1;
+        setsockopt(fds[i], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        struct epoll_event ev;
+        ev.events   = EPOLLIN;
+        ev.data.u32 = (uint32_t)i;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev) < 0) die("epoll_ctl add");
+    }
+    pthread_barrier_wait(&ready);
+
+    for (int i = 0; i < o.conns; i++) {
+        start[i] = now_ns();
+        if (write_all(fds[i], msg, (size_t)o.size) < 0) die("send");
+    }
+    struct epoll_event events[MAX_EVENTS];
+    while (!atomic_load(&stopping)) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, 10);
+        for (int e = 0; e < n; e++) {
+            int i = (int)events[e].data.u32;
+            ssize_t r = recv(fds[i], buf, MAX_SIZE, MSG_DONTWAIT);
+            if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+            if (r <= 0) die("recv");
+            if ((got[i] += (int)r) < o.size) continue;
+            uint64_t now = now_ns();
+            if (atomic_load(&measuring)) {
+                t->done++;
+                hdr_record(&t->hist, now - start[i]);
+            }
+            got[i]   = 0;
+            start[i] = now;
+            if (write_all(fds[i], msg, (size_t)o.size) < 0) die("send");
+        }
+    }
+    for (int i = 0; i < o.conns; i++) close(fds[i]);
+    close(epfd);
+    free(fds);
+    free(got);
+    free(start);
+    free(msg);
+    free(buf);
+    return NULL;
+}
+
+/* Listeners in worker order: the steering program returns an index. */
+static void open_listeners(int steer)
+{
+    memset(&srv, 0, sizeof(srv));
+    srv.sin_family      = AF_INET;
+    srv.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int cpus[MAX_THREADS];
+    for (int i = 0; i < o.threads; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) die("socket");
+        int one = 1;
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0)
+            die("setsockopt SO_REUSEPORT");
+        if (bind(fd, (struct sockaddr *)&srv, sizeof(srv)) < 0) die("bind");
+        if (listen(fd, 4096) < 0) die("listen");
+        socklen_t sl = sizeof(srv);
+        if (i == 0 && getsockname(fd, (struct sockaddr *)&srv, &sl) < 0) die("getsockname");
+        workers[i].lfd = fd;
+        cpus[i] = workers[i].cpu;
+    }
+    if (steer && rp_steer_by_cpu(workers[0].lfd, cpus, o.threads) < 0)
+        die("SO_ATTACH_REUSEPORT_CBPF");
+}
+
+static struct result run_mode(int steer)
+{
+    struct result res;
+    memset(&res, 0, sizeof(res));
+    open_listeners(steer);
+    atomic_store(&measuring, 0);
+    atomic_store(&stopping, 0);
+    atomic_store(&open_conns, o.threads * o.conns);
+    pthread_barrier_init(&ready, NULL, (unsigned)(2 * o.threads + 1));
+    for (int i = 0; i < o.threads; i++) {
+        struct sthread *w = &workers[i], *c = &clients[i];
+        int lfd = w->lfd, cpu = w->cpu;
+        memset(w, 0, sizeof(*w));
+        memset(c, 0, sizeof(*c));
+        w->lfd = lfd;
+        w->cpu = c->cpu = cpu;
+        int rc = pthread_create(&w->tid, NULL, worker_main, w);
+        if (rc == 0) rc = pthread_create(&c->tid, NULL, client_main, c);
+        if (rc != 0) { errno = rc; die("pthread_create"); }
+    }
+
+    /* Everyone is connected: the window opens. */
+    pthread_barrier_wait(&ready);
+    for (int i = 0; i < o.threads; i++) {
+        counters_switch(&workers[i], PERF_EVENT_IOC_ENABLE);
+        counters_switch(&clients[i], PERF_EVENT_IOC_ENABLE);
+    }
+    atomic_store(&measuring, 1);
+    struct timespec d = { (time_t)o.duration,
+                          (long)((o.duration - (double)(time_t)o.duration) * 1e9) };
+    while (nanosleep(&d, &d) < 0 && errno == EINTR) {}
+    atomic_store(&measuring, 0);
+    for (int i = 0; i < o.threads; i++) {
+        counters_switch(&workers[i], PERF_EVENT_IOC_DISABLE);
+        counters_switch(&clients[i], PERF_EVENT_IOC_DISABLE);
+    }
+    atomic_store(&stopping, 1);
+
+    struct hdr_hist *all = malloc(sizeof(*all));
+    if (!all) die("malloc");
+    hdr_init(all);
+    for (int i = 0; i < o.threads; i++) {
+        pthread_join(clients[i].tid, NULL);
+        pthread_join(workers[i].tid, NULL);
+        hdr_merge(all, &clients[i].hist);
+        res.requests += clients[i].done;
+        res.accepted += workers[i].accepted;
+        res.local    += workers[i].local;
+        res.errors   += workers[i].errors;
+        counters_close(&workers[i], res.count);
+        counters_close(&clients[i], res.count);
+        close(workers[i].lfd);
+    }
+    res.p50 = (double)hdr_percentile(all, 50.0) / 1e3;
+    res.p99 = (double)hdr_percentile(all, 99.0) / 1e3;
+    pthread_barrier_destroy(&ready);
+    free(all);
+    return res;
+}
+
+/* Events per request, or -1 when not counted. */
+static double per_req(const struct result *r, int k)
+{
+    if (r->count[k] == UINT64_MAX || !r->requests) return -1.0;
+    return (double)r->count[k] / (double)r->requests;
+}
+
+static void report(const char *mode, const struct result *r)
+{
+    double rps = (double)r->requests / o.duration;
+    double miss = per_req(r, PC_MISSES), csw = per_req(r, PC_CSW);
+    if (o.csv) {
+        printf("%s,%d,%d,%d,%.2f,%llu,%.1f,%.1f,%.1f,%llu,%llu,%.2f,%.3f\n",
+               mode, o.threads, o.conns, o.size, o.duration,
+               (unsigned long long)r->requests, rps, r->p50, r->p99,
+               (unsigned long long)r->local, (unsigned long long)r->accepted, miss, csw);
+        return;
+    }
+    char ms[32] = "n/a";
+    if (miss >= 0) snprintf(ms, sizeof(ms), "%.2f", miss);
+    printf("[bench] %-4s %10.1f req/s  p50=%.1f p99=%.1f us  %llu/%llu conns on their cpu"
+           "  cache misses/req=%s%s  ctx switches/req=%.3f\n",
+           mode, rps, r->p50, r->p99, (unsigned long long)r->local,
+           (unsigned long long)r->accepted, ms, user_only && miss >= 0 ? " (user)" : "", csw);
+    if (r->errors) printf("[bench] %llu connection error(s)\n", (unsigned long long)r->errors);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-t workers] [-c conns_per_thread] [-d secs] [-s size] [-m hash|cpu] [-C]\n"
+            "  -t workers  server workers and client threads, one each per CPU (default: all CPUs)\n"
+            "  -m mode     run only the kernel's hash or only CPU steering (default: both)\n"
+            "  -C          print CSV rows instead of the human-readable report\n",
+            prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+    cpu_set_t avail;
+    if (sched_getaffinity(0, sizeof(avail), &avail) < 0) die("sched_getaffinity");
+    o.threads = CPU_COUNT(&avail);
+
+    int c;
+    while ((c = getopt(argc, argv, "t:c:d:s:m:C")) != -1) {
+        switch (c) {
+        case 't': o.threads  = atoi(optarg); break;
+        case 'c': o.conns    = atoi(optarg); break;
+        case 'd': o.duration = atof(optarg); break;
+        case 's': o.size     = atoi(optarg); break;
+        case 'm':
+            if      (strcmp(optarg, "hash") == 0) o.modes = 1;
+            else if (strcmp(optarg, "cpu") == 0)  o.modes = 2;
+            else usage(argv[0]);
+            break;
+        case 'C': o.csv = 1; break;
+        default:  usage(argv[0]);
+        }
+    }
+    if (o.threads < 1 || o.threads > MAX_THREADS || o.conns < 1 || o.duration <= 0 ||
+        o.size < 1 || o.size > MAX_SIZE)
+        usage(argv[0]);
+
+    /* CPUs round-robin from the allowed set, as linux03_reactor does. */
+    int cpu = -1;
+    for (int i = 0; i < o.threads; i++) {
+        do cpu = (cpu + 1) % CPU_SETSIZE; while (!CPU_ISSET(cpu, &avail));
+        workers[i].cpu = cpu;
+    }
+
+    if (o.csv)
+        printf("mode,workers,conns_per_thread,size,duration_s,requests,req_s,p50_us,p99_us,"
+               "local_conns,conns,cache_misses_per_req,ctx_switches_per_req\n");
+    else
+        printf("[bench] %d worker(s) and client thread(s), %d connections each, %d-byte echoes, "
+               "%.0f s per mode\n", o.threads, o.conns, o.size, o.duration);
+    if (o.threads > CPU_COUNT(&avail) && !o.csv)
+        printf("[bench] more workers than CPUs: with steering, only the first on each CPU "
+               "gets connections\n");
+
+    uint64_t errors = 0;
+    if (o.modes & 1) {
+        struct result r = run_mode(0);
+        report("hash", &r);
+        errors += r.errors;
+    }
+    if (o.modes & 2) {
+        struct result r = run_mode(1);
+        report("cpu", &r);
+        errors += r.errors;
+    }
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+/*
+ * bench/twheel_bench.c
+ *
+ * Per-request cost of idle timeouts: the timing wheel in
+ * linux/common/twheel.h against an indexed binary min-heap, the usual
+ * alternative.
+ *
+ * Simulates -n connections with a -t ms idle timeout for -d seconds of
+ * virtual time, one millisecond per tick.  Each tick, -r requests land on
+ * random connections and push their deadlines out (the server's
+ * conn_active()), then the timer structure is advanced and whatever
+ * expired is armed again as a fresh connection.  Reports ns per request,
+ * tick work included, and how many timers expired.
+ *
+ * Usage: twheel_bench [-n connections] [-t timeout_ms] [-r requests_per_ms]
+ *                     [-d seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../linux/common/sock_helpers.h"
+#include "../linux/common/twheel.h"
+
+static int      nconn   = 500000;
+static long     tmo     = 30000;
+static int      per_ms  = 1000;
+static int      seconds = 30;
+static uint64_t rng     = 0x9e3779b97f4a7c15ull;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t rnd(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (uint32_t)(rng >> 32);
+}
+
+/* ── Indexed binary min-heap: pos[id] finds a timer for re-keying ─────── */
+
+struct heap {
+    int      *id;            /* heap order */
+    uint64_t *key;           /* by id */
+    int      *pos;           /* by id: index in id[], -1 = not armed */
+    int       n;
+};
+
+static void heap_swap(struct heap *h, int a, int b)
+{
+    int t = h->id[a];
+    h->id[a] = h->id[b];
+    h->id[b] = t;
+    h->pos[h->id[a]] = a;
+    h->pos[h->id[b]] = b;
+}
+
+static void heap_fix(struct heap *h, int i)
+{
+    while (i > 0 && h->key[h->id[(i - 1) / 2]] > h->key[h->id[i]]) {
+        heap_swap(h, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        int l = 2 * i + 1, m = i;
+        if (l < h->n && h->key[h->id[l]] < h->key[h->id[m]]) m = l;
+        if (l + 1 < h->n && h->key[h->id[l + 1]] < h->key[h->id[m]]) m = l + 1;
+        if (m == i) return;
+        heap_swap(h, i, m);
+        i = m;
+    }
+}
+
+static void heap_arm(struct heap *h, int id, uint64_t key)
+{
+    h->key[id] = key;
+    if (h->pos[id] < 0) {
+        h->id[h->n] = id;
+        h->pos[id]  = h->n++;
+    }
+    heap_fix(h, h->pos[id]);
+}
+
+static int heap_expired(struct heap *h, uint64_t now)
+{
+    if (h->n == 0 || h->key[h->id[0]] > now) return -1;
+    int id = h->id[0];
+    heap_swap(h, 0, --h->n);
+    h->pos[id] = -1;
+    if (h->n) heap_fix(h, 0);
+    return id;
+}
+
+/* ── Runs ─────────────────────────────────────────────────────────────── */
+
+static double run_wheel(unsigned long long *expired)
+{
+    struct twheel w;
+    tw_init(&w, 0);
+    if (tw_reserve(&w, nconn) < 0) die("tw_reserve");
+    rng = 0x9e3779b97f4a7c15ull;
+    for (int i = 0; i < nconn; i++) tw_arm(&w, i, 1 + rnd() % (uint64_t)tmo, 0);
+
+    uint64_t t0 = now_ns(), ticks = (uint64_t)seconds * 1000;
+    for (uint64_t now = 1; now <= ticks; now++) {
+        for (int k = 0; k < per_ms; k++) tw_arm(&w, (int)(rnd() % (uint32_t)nconn), now + (uint64_t)tmo, 0);
+        tw_advance(&w, now);
+        for (int id; (id = tw_expired(&w)) >= 0; (*expired)++) tw_arm(&w, id, now + (uint64_t)tmo, 0);
+    }
+    double ns = (double)(now_ns() - t0);
+    tw_destroy(&w);
+    return ns;
+}
+
+static double run_heap(unsigned long long *expired)
+{
+    struct heap h;
+    h.id  = malloc((size_t)nconn * sizeof(*h.id));
+    h.key = malloc((size_t)nconn * sizeof(*h.key));
+    h.pos = malloc((size_t)nconn * sizeof(*h.pos));
+    if (!h.id || !h.key || !h.pos) die("malloc");
+    memset(h.pos, 0xff, (size_t)nconn * sizeof(*h.pos));
+    h.n = 0;
+    rng = 0x9e3779b97f4a7c15ull;
+    for (int i = 0; i < nconn; i++) heap_arm(&h, i, 1 + rnd() % (uint64_t)tmo);
+
+    uint64_t t0 = now_ns(), ticks = (uint64_t)seconds * 1000;
+    for (uint64_t now = 1; now <= ticks; now++) {
+        for (int k = 0; k < per_ms; k++) heap_arm(&h, (int)(rnd() % (uint32_t)nconn), now + (uint64_t)tmo);
+        for (int id; (id = heap_expired(&h, now)) >= 0; (*expired)++) heap_arm(&h, id, now + (uint64_t)tmo);
+    }
+    double ns = (double)(now_ns() - t0);
+    free(h.id);
+    free(h.key);
+    free(h.pos);
+    return ns;
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    while ((c = getopt(argc, argv, "n:t:r:d:")) != -1) {
+        switch (c) {
+        case 'n': nconn   = atoi(optarg); break;
+        case 't': tmo     = atol(optarg); break;
+        case 'r': per_ms  = atoi(optarg); break;
+        case 'd': seconds = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n connections] [-t timeout_ms] [-r requests_per_ms]\n"
+                            "          [-d seconds]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (nconn < 1 || tmo < 1 || per_ms < 0 || seconds < 1) {
+        fprintf(stderr, "bad arguments\n");
+        return EXIT_FAILURE;
+    }
+
+    double requests = (double)per_ms * 1000.0 * seconds;
+    printf("%d connections, %ld ms idle timeout, %d requests/ms, %d s simulated\n",
+           nconn, tmo, per_ms, seconds);
+    printf("%-8s %12s %12s\n", "timers", "ns/request", "expired");
+
+    unsigned long long exp_w = 0, exp_h = 0;
+    double ns_w = run_wheel(&exp_w);
+    double ns_h = run_heap(&exp_h);
+    printf("%-8s %12.1f %12llu\n", "wheel", ns_w / requests, exp_w);
+    printf("%-8s %12.1f %12llu\n", "heap",  ns_h / requests, exp_h);
+    return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * bench/udp_bench.c
+ *
+ * Packets-per-second load generator for the UDP echo server (linux/05_udp).
+ *
+ * Opens -c connected UDP sockets and keeps -w datagrams of -s bytes in
+ * flight on each: whenever echoes come back, the freed window is refilled
+ * with one sendmmsg() — or, with -g, one UDP_SEGMENT (GSO) send — and
+ * echoes are read with recvmmsg(), with UDP_GRO on under -g.  The load
+ * generator batches its own I/O so that the server's per-datagram cost is
+ * what shows; run the server in each of its modes to compare them:
+ *
+ *   linux05_server -1   one recvfrom() + one sendto() per datagram
+ *   linux05_server      recvmmsg() / sendmmsg(), up to 64 datagrams a call
+ *   linux05_server -g   the same, plus GRO on receive and GSO on send
+ *
+ * UDP may drop: a socket that hears nothing for 20 ms writes its window
+ * off as lost and starts over.  At the end every socket sends "bye",
+ * which ends its session on the server.
+ *
+ * Usage: udp_bench [-H host] [-p port] [-c sockets] [-d secs] [-s size]
+ *                  [-w window] [-g]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../linux/common/sock_helpers.h"
+#include "../linux/common/udp_batch.h"
+
+#define MAX_EVENTS 64
+#define STALL_NS   20000000ull    /* silence that writes a window off */
+
+struct opts {
+    const char *host;
+    int         port;
+    int         socks;
+    double      duration;
+    int         size;
+    int         window;
+    int         gso;
+};
+
+struct usock {
+    int      fd;
+    int      inflight;            /* datagrams sent, echo not seen */
+    uint64_t last_rx;             /* last echo, or last write-off */
+};
+
+static struct opts      o = { "127.0.0.1", 9005, 4, 5.0, 64, 64, 0 };
+static struct udp_batch tx, rx;
+static int              gso_max;  /* segments per GSO send */
+static uint64_t         echoed, sent, lost, bad;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int is_again(int err)
+{
+    return err == EAGAIN || err == EWOULDBLOCK || err == ENOBUFS;
+}
+
+/* Fill s's window back up.  Dies if the server is not there. */
+static void refill(struct usock *s)
+{
+    int want = o.window - s->inflight;
+    while (want > 0) {
+        int r, k;
+        if (o.gso) {
+            k = want < gso_max ? want : gso_max;
+            udp_batch_set(&tx, 0, (size_t)k * (size_t)o.size, (uint16_t)o.size, 0);
+            r = udp_batch_send(s->fd, &tx, 0, 1, MSG_DONTWAIT);
+            if (r == 1) r = k;
+        } else {
+            k = want < UDP_BATCH ? want : UDP_BATCH;
+            r = udp_batch_send(s->fd, &tx, 0, k, MSG_DONTWAIT);
+        }
+        if (r < 0) {
+            if (is_again(errno)) return;
+            die(errno == ECONNREFUSED ? "send (is linux05_server running?)" : "send");
+        }
+        s->inflight += r;
+        sent        += (uint64_t)r;
+        want        -= r;
+    }
+}
+
+/* Read every echo that has arrived on s. */
+static void drain(struct usock *s, uint64_t now)
+{
+    for (;;) {
+        int n = udp_batch_recv(s->fd, &rx, UDP_BATCH, MSG_DONTWAIT);
+        if (n < 0) {
+            if (is_again(errno)) return;
+            die(errno == ECONNREFUSED ? "recv (is linux05_server running?)" : "recv");
+        }
+        for (int i = 0; i < n; i++) {
+            unsigned segs = udp_batch_segs(&rx, i);
+            if (rx.msg[i].msg_len != segs * (unsigned)o.size) bad++;
+            echoed      += segs;
+            s->inflight -= (int)segs;
+            if (s->inflight < 0) s->inflight = 0;   /* echo of a written-off one */
+        }
+        s->last_rx = now;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    while ((c = getopt(argc, argv, "H:p:c:d:s:w:g")) != -1) {
+        switch (c) {
+        case 'H': o.host     = optarg;       break;
+        case 'p': o.port     = atoi(optarg); break;
+        case 'c': o.socks    = atoi(optarg); break;
+        case 'd': o.duration = atof(optarg); break;
+        case 's': o.size     = atoi(optarg); break;
+        case 'w': o.window   = atoi(optarg); break;
+        case 'g': o.gso      = 1;            break;
+        default:
+            fprintf(stderr, "usage: %s [-H host] [-p port] [-c sockets] [-d secs] [-s size]\n"
+                            "          [-w window] [-g]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (o.socks < 1 || o.window < 1 || o.size < 2 || o.size > 1472 || o.duration <= 0) {
+        fprintf(stderr, "bad arguments (size must be 2..1472 bytes)\n");
+        return EXIT_FAILURE;
+    }
+
+    gso_max = UDP_MAX_MSG / o.size;
+    if (gso_max > UDP_MAX_SEGS) gso_max = UDP_MAX_SEGS;
+
+    /* Every datagram: size-1 filler bytes and a newline. */
+    size_t slot = o.gso ? (size_t)gso_max * (size_t)o.size : (size_t)o.size;
+    if (udp_batch_init(&tx, slot) < 0 || udp_batch_init(&rx, 65536) < 0) die("udp_batch_init");
+    for (int i = 0; i < UDP_BATCH; i++) {
+        char *p = udp_batch_data(&tx, i);
+        memset(p, 'u', slot);
+        for (size_t off = (size_t)o.size - 1; off < slot; off += (size_t)o.size) p[off] = '\n';
+        udp_batch_set(&tx, i, (size_t)o.size, 0, 0);
+    }
+
+    struct sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port   = htons((uint16_t)o.port);
+    if (inet_pton(AF_INET, o.host, &a.sin_addr) != 1) die("inet_pton");
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) die("epoll_create1");
+    struct usock *socks = calloc((size_t)o.socks, sizeof(*socks));
+    if (!socks) die("calloc");
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < o.socks; i++) {
+        struct usock *s = &socks[i];
+        s->fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (s->fd < 0) die("socket");
+        if (connect(s->fd, (struct sockaddr *)&a, sizeof(a)) < 0) die("connect");
+        set_nonblocking(s->fd);
+        if (o.gso && udp_gro_enable(s->fd) < 0) die("UDP_GRO");
+        s->last_rx = t0;
+
+        struct epoll_event ev;
+        ev.events   = EPOLLIN;
+        ev.data.ptr = s;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, s->fd, &ev) < 0) die("epoll_ctl");
+    }
+
+    fprintf(stderr, "[bench] udp: %d socket(s) -> %s:%d, %d-byte datagrams, window %d%s\n",
+            o.socks, o.host, o.port, o.size, o.window, o.gso ? ", GSO/GRO" : "");
+
+    for (int i = 0; i < o.socks; i++) refill(&socks[i]);
+    uint64_t end = t0 + (uint64_t)(o.duration * 1e9), last_check = t0, now;
+    while ((now = now_ns()) < end) {
+        struct epoll_event events[MAX_EVENTS];
+        int n = epoll_wait(epfd, events, MAX_EVENTS, 5);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            die("epoll_wait");
+        }
+        now = now_ns();
+        for (int i = 0; i < n; i++) {
+            struct usock *s = events[i].data.ptr;
+            drain(s, now);
+            refill(s);
+        }
+        if (now - last_check < STALL_NS / 4) continue;
+        last_check = now;
+        for (int i = 0; i < o.socks; i++) {
+            struct usock *s = &socks[i];
+            if (s->inflight > 0 && now - s->last_rx > STALL_NS) {
+                lost       += (uint64_t)s->inflight;
+                s->inflight = 0;
+                s->last_rx  = now;
+                refill(s);
+            }
+        }
+    }
+    double secs = (double)(now - t0) / 1e9;
+
+    for (int i = 0; i < o.socks; i++) {
+        if (send(socks[i].fd, "bye\n", 4, 0) < 0) perror("send bye");
+        close(socks[i].fd);
+    }
+    close(epfd);
+
+    fprintf(stderr, "[bench] %llu datagrams echoed in %.2f s: %.0f pps, %.1f MB/s\n",
+            (unsigned long long)echoed, secs, (double)echoed / secs,
+            (double)echoed * o.size / secs / 1e6);
+    fprintf(stderr, "[bench] %llu sent, %llu written off as lost, %llu bad echoes\n",
+            (unsigned long long)sent, (unsigned long long)lost, (unsigned long long)bad);
+    free(socks);
+    udp_batch_free(&tx);
+    udp_batch_free(&rx);
+    return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,231 @@
+/*
+ * bench/zc_bench.c
+ *
+ * Bulk-send cost of copying send() versus MSG_ZEROCOPY (linux/common/zcopy.h).
+ *
+ * For each send size, streams -m MB over one TCP connection twice — once
+ * with plain blocking send(), once with zero-copy sends from pool buffers
+ * that are recycled as completions come back — and reports throughput and
+ * the sender thread's CPU time per GB.  The CPU column is the one that
+ * matters: zero-copy trades the memcpy into the socket buffer for page
+ * pinning and completion handling, which only pays off for large sends.
+ *
+ * Without -H, a sink thread on a loopback port receives and discards the
+ * data.  Loopback delivery always copies (the completions report it), so
+ * the zero-copy numbers there show the overhead only; for the real
+ * comparison run "zc_bench -l" on another host and point -H at it.
+ *
+ * Usage: zc_bench [-H host] [-p port] [-m megabytes] [-l]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../linux/common/sock_helpers.h"
+#include "../linux/common/zcopy.h"
+
+static const size_t sizes[] = { 4096, 16384, 65536, 262144 };
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* User + system time of the calling thread. */
+static uint64_t thread_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Accept connections forever; read each one to EOF and close it. */
+static void *sink(void *arg)
+{
+    int lfd = *(int *)arg;
+    char *buf = malloc(1 << 20);
+    if (!buf) die("malloc");
+    for (;;) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            die("accept");
+        }
+        while (recv(fd, buf, 1 << 20, 0) > 0) {}
+        close(fd);
+    }
+    return NULL;
+}
+
+static int sink_listen(uint16_t port)
+{
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (lfd < 0) die("socket");
+    int one = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family      = AF_INET;
+    a.sin_addr.s_addr = htonl(port ? INADDR_ANY : INADDR_LOOPBACK);
+    a.sin_port        = htons(port);
+    if (bind(lfd, (struct sockaddr *)&a, sizeof(a)) < 0) die("bind");
+    if (listen(lfd, 16) < 0) die("listen");
+    return lfd;
+}
+
+static int connect_to(const struct sockaddr_in *a)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) die("socket");
+    if (connect(fd, (const struct sockaddr *)a, sizeof(*a)) < 0) die("connect");
+    return fd;
+}
+
+/* Finish the stream and wait until the sink has read all of it. */
+static void finish(int fd)
+{
+    char c;
+    shutdown(fd, SHUT_WR);
+    while (recv(fd, &c, 1, 0) > 0) {}
+    close(fd);
+}
+
+static void send_copy(int fd, size_t size, uint64_t total)
+{
+    char *buf = malloc(size);
+    if (!buf) die("malloc");
+    memset(buf, 'c', size);
+    for (uint64_t sent = 0; sent < total; sent += size)
+        if (write_all(fd, buf, size) < 0) die("send");
+    free(buf);
+}
+
+/* Returns the number of completions the kernel reported as copied. */
+static uint64_t send_zerocopy(int fd, size_t size, uint64_t total)
+{
+    size_t bufsz = 64;
+    while (bufsz < size + sizeof(struct zc_buf)) bufsz *= 2;
+    struct bufpool pool;
+    bufpool_init(&pool, bufsz);
+
+    /* Touch every buffer the run can have in flight before timing starts. */
+    struct zc_buf *warm[ZC_INFLIGHT + 1];
+    for (int i = 0; i <= ZC_INFLIGHT; i++) {
+        if (!(warm[i] = zc_buf_get(&pool))) die("bufpool_get");
+        memset(warm[i]->data, 'z', size);
+    }
+    for (int i = 0; i <= ZC_INFLIGHT; i++) zc_buf_unref(&pool, warm[i]);
+
+    struct zc_tx z;
+    zc_tx_init(&z);
+    if (zc_enable(fd) < 0) die("SO_ZEROCOPY");
+
+    for (uint64_t sent = 0; sent < total; ) {
+        z.off = 0;                           /* measure zero-copy even when copied */
+        if (!zc_ready(&z)) {
+            struct pollfd p = { fd, 0, 0 };  /* wait for POLLERR */
+            poll(&p, 1, 100);
+            if (zc_reap(&z, fd, &pool) < 0) die("recvmsg errqueue");
+            continue;
+        }
+        struct zc_buf *b = zc_buf_get(&pool);
+        if (!b) die("bufpool_get");
+        size_t off = 0;
+        while (off < size) {
+            ssize_t w = zc_send(&z, fd, b, b->data + off, size - off, 0);
+            if (w < 0) {
+                if (errno == ENOBUFS) {      /* notification memory: reap first */
+                    zc_reap(&z, fd, &pool);
+                    continue;
+                }
+                die("send");
+            }
+            off += (size_t)w;
+        }
+        zc_buf_unref(&pool, b);
+        sent += size;
+        if (zc_reap(&z, fd, &pool) < 0) die("recvmsg errqueue");
+    }
+    while (z.inflight > 0) {
+        struct pollfd p = { fd, 0, 0 };
+        poll(&p, 1, 100);
+        if (zc_reap(&z, fd, &pool) < 0) die("recvmsg errqueue");
+    }
+    bufpool_destroy(&pool);
+    return z.copied;
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = NULL;
+    int port = 9100, listen_only = 0, c;
+    long mb = 1024;
+    while ((c = getopt(argc, argv, "H:p:m:l")) != -1) {
+        switch (c) {
+        case 'H': host        = optarg;       break;
+        case 'p': port        = atoi(optarg); break;
+        case 'm': mb          = atol(optarg); break;
+        case 'l': listen_only = 1;            break;
+        default:
+            fprintf(stderr, "usage: %s [-H host] [-p port] [-m megabytes] [-l]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (mb < 1 || port < 1 || port > 65535) return EXIT_FAILURE;
+
+    if (listen_only) {
+        int lfd = sink_listen((uint16_t)port);
+        fprintf(stderr, "[bench] sink listening on port %d\n", port);
+        sink(&lfd);
+        return EXIT_SUCCESS;
+    }
+
+    struct sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    if (host) {
+        a.sin_port = htons((uint16_t)port);
+        if (inet_pton(AF_INET, host, &a.sin_addr) != 1) die("inet_pton");
+    } else {
+        static int lfd;
+        pthread_t tid;
+        lfd = sink_listen(0);
+        socklen_t al = sizeof(a);
+        if (getsockname(lfd, (struct sockaddr *)&a, &al) < 0) die("getsockname");
+        if (pthread_create(&tid, NULL, sink, &lfd) != 0) die("pthread_create");
+    }
+
+    uint64_t total = (uint64_t)mb << 20;
+    fprintf(stderr, "[bench] zerocopy: %ld MB per run to %s\n", mb, host ? host : "loopback sink");
+    fprintf(stderr, "%-8s %-9s %10s %14s %8s\n", "size", "send", "GB/s", "cpu ms/GB", "copied");
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (int zc = 0; zc <= 1; zc++) {
+            int fd = connect_to(&a);
+            uint64_t copied = 0;
+            uint64_t t0 = now_ns(), c0 = thread_cpu_ns();
+            if (zc) copied = send_zerocopy(fd, sizes[i], total);
+            else    send_copy(fd, sizes[i], total);
+            finish(fd);
+            uint64_t wall = now_ns() - t0, cpu = thread_cpu_ns() - c0;
+
+            double gb = (double)total / 1e9;
+            fprintf(stderr, "%-8zu %-9s %10.2f %14.1f %8s\n", sizes[i],
+                    zc ? "zerocopy" : "copy", gb / ((double)wall / 1e9),
+                    (double)cpu / 1e6 / gb, zc ? (copied ? "yes" : "no") : "-");
+        }
+    }
+    return EXIT_SUCCESS;
+}
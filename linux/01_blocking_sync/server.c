@@ -5,6 +5,8 @@
  *
  * Model: single thread — accept one client, echo text lines until "bye",
  *        then exit.  Simplest possible TCP server; no concurrency.
+ *        Input goes through a line framer, so a line split across two
+ *        recv() calls is still echoed and checked for "bye" as one line.
  */
 
 #include <stdio.h>
@@ -16,31 +18,55 @@
 #include <arpa/inet.h>
 
 #include "../common/sock_helpers.h"
+#include "../common/log.h"
+#include "../common/framing.h"
 
-#define PORT    9001
-#define BACKLOG 4
-#define BUF     256
+#define PORT      9001
+#define BACKLOG   4
+#define BUF       256
+#define MAX_LINES 16
 
 static void handle_client(int cfd)
 {
     char buf[BUF];
+    struct framer in;
+    struct frame_line lines[MAX_LINES];
     ssize_t n;
+    int bye = 0;
 
-    while ((n = recv(cfd, buf, sizeof(buf) - 1, 0)) > 0) {
-        buf[n] = '\0';
-        printf("[server] recv: %s", buf);
-        if (write_all(cfd, buf, (size_t)n) < 0) {
-            perror("send");
-            break;
+    framer_init(&in);
+    while (!bye && (n = recv(cfd, buf, sizeof(buf), 0)) > 0) {
+        const char *p = buf;
+        size_t len = (size_t)n;
+        while (!bye && len > 0) {
+            size_t used;
+            int k = framer_feed(&in, p, len, lines, MAX_LINES, &used);
+            if (k < 0) {
+                LOG_WARN("[server] line too long\n");
+                bye = 1;
+                break;
+            }
+            for (int i = 0; i < k && !bye; i++) {
+                LOG_DEBUG("[server] recv: %.*s", (int)lines[i].len, lines[i].p);
+                if (write_all(cfd, lines[i].p, lines[i].len) < 0) {
+                    perror("send");
+                    bye = 1;
+                    break;
+                }
+                bye = frame_is_bye(&lines[i]);
+            }
+            p   += used;
+            len -= used;
         }
-        if (strncmp(buf, "bye", 3) == 0)
-            break;
     }
+    framer_free(&in);
     close(cfd);
 }
 
 int main(void)
 {
+    log_init();
+
     int sfd = socket(AF_INET, SOCK_STREAM, 0);
     if (sfd < 0) die("socket");
 
@@ -54,18 +80,19 @@ int main(void)
 
     if (bind(sfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) die("bind");
     if (listen(sfd, BACKLOG) < 0) die("listen");
-    printf("[server] listening on port %d\n", PORT);
+    LOG_INFO("[server] listening on port %d\n", PORT);
 
     struct sockaddr_in ca;
     socklen_t cl = sizeof(ca);
     int cfd = accept(sfd, (struct sockaddr *)&ca, &cl);
     if (cfd < 0) die("accept");
-    printf("[server] client connected: %s\n", inet_ntoa(ca.sin_addr));
+    LOG_INFO("[server] client connected: %s\n", inet_ntoa(ca.sin_addr));
 
     handle_client(cfd);
 
     close(sfd);
-    printf("[server] done.\n");
+    LOG_INFO("[server] done.\n");
+    log_shutdown();
     return 0;
 }
 
@@ -1,38 +1,79 @@
 /*
  * linux/02_nonblocking_select_sync/server.c
  *
- * Non-blocking select()-based TCP echo server.
+ * Non-blocking select()-based TCP echo server, on libsockloop.
  *
  * Model: single thread, all sockets in non-blocking mode.
- *        select() multiplexes the listening socket and up to MAX_CLIENTS
- *        connected clients.  Exits when the last client disconnects.
+ *        select() multiplexes the listening socket and every connected
+ *        client (fds below FD_SETSIZE): the loop is libsockloop's select
+ *        backend (linux/sockloop/sl_select.c), which keeps the read and
+ *        write sets between rounds and copies them into each call.  The
+ *        line echo is the one 06 and 03 -b serve
+ *        (linux/sockloop/sl_echo.h): each client has its own line framer,
+ *        so only complete lines are echoed and "bye" is found wherever it
+ *        falls in a recv().  Echoes the socket cannot take right away are
+ *        queued per client and flushed when select() reports it writable;
+ *        a client whose queue passes the high-water mark is left out of
+ *        the read set until it drains.  Each select() round accepts at
+ *        most SL_ACCEPT_BUDGET connections, one accept4() each
+ *        (O_NONBLOCK included), so a burst of connects cannot starve the
+ *        clients already connected.  -l sets the listen backlog, -D turns
+ *        on TCP_DEFER_ACCEPT.  -u PATH also listens on an AF_UNIX stream
+ *        socket ("@name": abstract) for same-host clients; its clients
+ *        are served by the same loop.  -b runs the same server on another
+ *        backend, for comparison.  Exits when the last client disconnects.
+ *
+ * Usage: linux02_server [-l backlog] [-D defer_accept_secs] [-u unix_path]
+ *                       [-b backend]
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
-#include <sys/select.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
-#include <arpa/inet.h>
+#include <netinet/tcp.h>
 
 #include "../common/sock_helpers.h"
+#include "../common/log.h"
+#include "../common/unix_sock.h"
+#include "sl_echo.h"
 
 #define PORT        9002
-#define BACKLOG     4
-#define BUF         256
-#define MAX_CLIENTS 63   /* FD_SETSIZE is 1024; keep array small for demo */
+#define BACKLOG     4096      /* default -l; capped at net.core.somaxconn */
 
-int main(void)
+int main(int argc, char **argv)
 {
-    int sfd = socket(AF_INET, SOCK_STREAM, 0);
+    log_init();
+
+    int c, backend = SL_SELECT, backlog = BACKLOG, defer_secs = 0;
+    const char *upath = NULL;
+    while ((c = getopt(argc, argv, "l:D:u:b:")) != -1) {
+        switch (c) {
+        case 'l': backlog    = atoi(optarg);             break;
+        case 'D': defer_secs = atoi(optarg);             break;
+        case 'u': upath      = optarg;                   break;
+        case 'b': backend    = sl_backend_parse(optarg); break;
+        default:  backend    = -1;                       break;
+        }
+        if (backend < 0) {
+            fprintf(stderr, "usage: %s [-l backlog] [-D defer_accept_secs] [-u unix_path]\n"
+                            "          [-b select|poll|epoll|epoll-et|uring]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int sfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (sfd < 0) die("socket");
 
     int opt = 1;
     setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    set_nonblocking(sfd);
+    if (defer_secs > 0 &&
+        setsockopt(sfd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &defer_secs, sizeof(defer_secs)) < 0)
+        perror("setsockopt TCP_DEFER_ACCEPT");
 
     struct sockaddr_in addr = {0};
     addr.sin_family      = AF_INET;
@@ -40,85 +81,22 @@ int main(void)
     addr.sin_port        = htons(PORT);
 
     if (bind(sfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) die("bind");
-    if (listen(sfd, BACKLOG) < 0) die("listen");
-    printf("[server] listening on port %d\n", PORT);
-
-    int clients[MAX_CLIENTS];
-    int nclients = 0;
-    for (int i = 0; i < MAX_CLIENTS; i++) clients[i] = -1;
-
-    int running = 1;
-    while (running) {
-        fd_set rset;
-        FD_ZERO(&rset);
-        FD_SET(sfd, &rset);
-        int maxfd = sfd;
-
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            if (clients[i] >= 0) {
-                FD_SET(clients[i], &rset);
-                if (clients[i] > maxfd) maxfd = clients[i];
-            }
-        }
+    if (listen(sfd, backlog) < 0) die("listen");
+    LOG_INFO("[server] listening on port %d\n", PORT);
 
-        int ready = select(maxfd + 1, &rset, NULL, NULL, NULL);
-        if (ready < 0) { perror("select"); break; }
-
-        /* Accept new connections */
-        if (FD_ISSET(sfd, &rset)) {
-            struct sockaddr_in ca;
-            socklen_t cl = sizeof(ca);
-            int cfd = accept(sfd, (struct sockaddr *)&ca, &cl);
-            if (cfd >= 0) {
-                set_nonblocking(cfd);
-                printf("[server] client connected: %s\n", inet_ntoa(ca.sin_addr));
-                int placed = 0;
-                for (int i = 0; i < MAX_CLIENTS; i++) {
-                    if (clients[i] < 0) {
-                        clients[i] = cfd;
-                        nclients++;
-                        placed = 1;
-                        break;
-                    }
-                }
-                if (!placed) {
-                    fprintf(stderr, "[server] too many clients\n");
-                    close(cfd);
-                }
-            }
-        }
-
-        /* Service existing clients */
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            if (clients[i] < 0 || !FD_ISSET(clients[i], &rset))
-                continue;
-
-            char buf[BUF];
-            ssize_t n = recv(clients[i], buf, sizeof(buf) - 1, 0);
-            if (n <= 0) {
-                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
-                    continue;
-                printf("[server] client disconnected (fd=%d)\n", clients[i]);
-                close(clients[i]);
-                clients[i] = -1;
-                if (--nclients == 0) running = 0;
-                continue;
-            }
-
-            buf[n] = '\0';
-            printf("[server] recv (fd=%d): %s", clients[i], buf);
-            write_all(clients[i], buf, (size_t)n);
-
-            if (strncmp(buf, "bye", 3) == 0) {
-                close(clients[i]);
-                clients[i] = -1;
-                if (--nclients == 0) running = 0;
-            }
-        }
+    int lfds[2] = { sfd, -1 }, n = 1;
+    if (upath) {
+        if ((lfds[n++] = unix_listen(upath, SOCK_STREAM, backlog)) < 0) die(upath);
+        LOG_INFO("[server] unix stream socket %s\n", upath);
     }
 
-    close(sfd);
-    printf("[server] done.\n");
-    return 0;
-}
+    /* No idle deadline: a client may stay connected and silent. */
+    int rc = sl_echo_serve(backend, lfds, n, 0);
+    if (rc < 0) perror(sl_backend_name(backend));
 
+    for (int i = 0; i < n; i++) close(lfds[i]);
+    if (upath) unix_unlink(upath);
+    LOG_INFO("[server] done.\n");
+    log_shutdown();
+    return rc < 0 ? EXIT_FAILURE : 0;
+}
@@ -2,6 +2,24 @@
  * linux/03_epoll/client.c
  *
  * epoll demo client — same echo protocol as the other demos.
+ *
+ * With -b it talks the length-prefixed binary protocol to the server's
+ * PORT_BIN listener instead: the same three messages as frames, plus one
+ * 1 MB body holding every byte value, newlines and NULs included.
+ *
+ * With -P DEPTH it also pipelines: NPIPE numbered requests go out with up
+ * to DEPTH of them unanswered at any time, sent in bursts without waiting,
+ * and the echo stream is checked against the request stream as it comes
+ * back.
+ *
+ * With -u PATH it talks the line protocol over the server's AF_UNIX stream
+ * socket instead of TCP.  With -q PATH it uses the SOCK_SEQPACKET socket:
+ * every request is one message, without a newline, and every echo must
+ * come back as exactly that message.
+ *
+ * -p PORT talks the line protocol to another TCP port, e.g. linux06_server's.
+ *
+ * Usage: linux03_client [-b] [-P depth] [-p port] [-u unix_path | -q seqpacket_path]
  */
 
 #include <stdio.h>
@@ -13,10 +31,15 @@
 #include <arpa/inet.h>
 
 #include "../common/sock_helpers.h"
+#include "../common/binframe.h"
+#include "../common/unix_sock.h"
 
 #define HOST "127.0.0.1"
 #define PORT 9003
+#define PORT_BIN 9103
+#define BIG  (1024 * 1024)
 #define BUF  256
+#define NPIPE 1000
 
 static void send_echo(int fd, const char *msg)
 {
@@ -36,22 +59,199 @@ static void send_echo(int fd, const char *msg)
     }
 }
 
-int main(void)
+static void read_all(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n <= 0) die("recv");
+        p   += n;
+        len -= (size_t)n;
+    }
+}
+
+/* Send one frame and check that the echo is the same frame. */
+static void send_frame(int fd, uint16_t type, uint64_t id, const void *body, uint32_t len)
+{
+    struct bin_hdr h = { len, type, 0, id }, e;
+    char hdr[BIN_HDR];
+    bin_hdr_encode(hdr, &h);
+    if (write_all(fd, hdr, sizeof(hdr)) < 0 || write_all(fd, body, len) < 0) die("send");
+
+    char *echo = malloc(len ? len : 1);
+    if (!echo) die("malloc");
+    read_all(fd, hdr, sizeof(hdr));
+    bin_hdr_decode(hdr, &e);
+    if (e.len != len || e.type != type || e.id != id) {
+        fprintf(stderr, "[client] frame header mismatch!\n");
+        exit(EXIT_FAILURE);
+    }
+    read_all(fd, echo, len);
+    if (memcmp(echo, body, len) != 0) {
+        fprintf(stderr, "[client] frame body mismatch!\n");
+        exit(EXIT_FAILURE);
+    }
+    if (len < 64) printf("[client] echo frame %llu: %.*s\n", (unsigned long long)id, (int)len, echo);
+    else          printf("[client] echo frame %llu: %u bytes\n", (unsigned long long)id, len);
+    free(echo);
+}
+
+/*
+ * Keep up to depth requests in flight: whenever answers free up room,
+ * send the next requests in one burst, then read whatever has come back.
+ * Echoes are the requests byte for byte, in order.
+ */
+static void run_pipelined(int fd, int binary, int depth)
+{
+    char   *stream = malloc(NPIPE * (BIN_HDR + 16));
+    size_t *ends   = malloc(NPIPE * sizeof(*ends));
+    char   *echo   = malloc(64 * 1024);
+    if (!stream || !ends || !echo) die("malloc");
+
+    size_t len = 0;
+    for (int i = 0; i < NPIPE; i++) {
+        char body[16];
+        int  n = snprintf(body, sizeof(body), "msg %d\n", i);
+        if (binary) {
+            struct bin_hdr h = { (uint32_t)n, BIN_ECHO, 0, (uint64_t)(100 + i) };
+            bin_hdr_encode(stream + len, &h);
+            len += BIN_HDR;
+        }
+        memcpy(stream + len, body, (size_t)n);
+        len += (size_t)n;
+        ends[i] = len;
+    }
+
+    int sent = 0, answered = 0;
+    size_t got = 0;
+    while (answered < NPIPE) {
+        int upto = answered + depth < NPIPE ? answered + depth : NPIPE;
+        if (sent < upto) {
+            size_t from = sent ? ends[sent - 1] : 0;
+            if (write_all(fd, stream + from, ends[upto - 1] - from) < 0) die("send");
+            sent = upto;
+        }
+        ssize_t n = recv(fd, echo, 64 * 1024, 0);
+        if (n <= 0) die("recv");
+        if ((size_t)n > len - got || memcmp(echo, stream + got, (size_t)n) != 0) {
+            fprintf(stderr, "[client] pipelined echo mismatch at byte %zu!\n", got);
+            exit(EXIT_FAILURE);
+        }
+        got += (size_t)n;
+        while (answered < NPIPE && ends[answered] <= got) answered++;
+    }
+    printf("[client] pipelined %d requests, depth %d: all echoes match\n", NPIPE, depth);
+    free(stream);
+    free(ends);
+    free(echo);
+}
+
+/* One message out, the same message back: exactly one recv(), same length. */
+static void send_msg(int fd, const char *msg)
+{
+    char buf[BUF];
+    size_t len = strlen(msg);
+    if (send(fd, msg, len, 0) != (ssize_t)len) die("send");
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) die("recv");
+    if ((size_t)n != len || memcmp(buf, msg, len) != 0) {
+        fprintf(stderr, "[client] message echo mismatch!\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("[client] echo: %.*s\n", (int)n, buf);
+}
+
+/* run_pipelined() for messages: each echo is one recv(), in order. */
+static void run_pipelined_msg(int fd, int depth)
+{
+    int sent = 0, answered = 0;
+    while (answered < NPIPE) {
+        for (; sent < NPIPE && sent < answered + depth; sent++) {
+            char m[16];
+            int  l = snprintf(m, sizeof(m), "msg %d", sent);
+            if (send(fd, m, (size_t)l, 0) != l) die("send");
+        }
+        char m[16], echo[BUF];
+        int  l = snprintf(m, sizeof(m), "msg %d", answered);
+        ssize_t n = recv(fd, echo, sizeof(echo), 0);
+        if (n <= 0) die("recv");
+        if (n != l || memcmp(echo, m, (size_t)l) != 0) {
+            fprintf(stderr, "[client] pipelined message %d mismatch!\n", answered);
+            exit(EXIT_FAILURE);
+        }
+        answered++;
+    }
+    printf("[client] pipelined %d messages, depth %d: all echoes match\n", NPIPE, depth);
+}
+
+static void run_binary(int fd, int depth)
+{
+    unsigned char *big = malloc(BIG);
+    if (!big) die("malloc");
+    for (size_t i = 0; i < BIG; i++) big[i] = (unsigned char)(i * 7);
+
+    send_frame(fd, BIN_ECHO, 1, "hello", 5);
+    send_frame(fd, BIN_ECHO, 2, "ping", 4);
+    send_frame(fd, BIN_ECHO, 3, big, BIG);
+    if (depth > 0) run_pipelined(fd, 1, depth);
+    send_frame(fd, BIN_BYE,  4, "bye", 3);
+    free(big);
+}
+
+int main(int argc, char **argv)
 {
-    int fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (fd < 0) die("socket");
+    int binary = 0, depth = 0, port = 0, opt;
+    const char *upath = NULL, *qpath = NULL;
+    while ((opt = getopt(argc, argv, "bP:p:u:q:")) != -1) {
+        switch (opt) {
+        case 'b': binary = 1;            break;
+        case 'P': depth  = atoi(optarg); break;
+        case 'p': port   = atoi(optarg); break;
+        case 'u': upath  = optarg;       break;
+        case 'q': qpath  = optarg;       break;
+        default:
+            binary = -1;
+        }
+    }
+    if (binary < 0 || (binary && (upath || qpath || port)) || (upath && qpath)) {
+        fprintf(stderr, "usage: %s [-b] [-P depth] [-p port] [-u unix_path | -q seqpacket_path]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
 
-    struct sockaddr_in addr = {0};
-    addr.sin_family      = AF_INET;
-    addr.sin_addr.s_addr = inet_addr(HOST);
-    addr.sin_port        = htons(PORT);
+    int fd;
+    if (upath || qpath) {
+        const char *path = qpath ? qpath : upath;
+        fd = unix_connect(path, qpath ? SOCK_SEQPACKET : SOCK_STREAM);
+        if (fd < 0) die("connect");
+        printf("[client] connected to %s\n", path);
+    } else {
+        if (!port) port = binary ? PORT_BIN : PORT;
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) die("socket");
 
-    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) die("connect");
-    printf("[client] connected to %s:%d\n", HOST, PORT);
+        struct sockaddr_in addr = {0};
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = inet_addr(HOST);
+        addr.sin_port        = htons((uint16_t)port);
 
-    send_echo(fd, "hello\n");
-    send_echo(fd, "ping\n");
-    send_echo(fd, "bye\n");
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) die("connect");
+        printf("[client] connected to %s:%d\n", HOST, port);
+    }
+
+    if (qpath) {
+        send_msg(fd, "hello");
+        send_msg(fd, "ping");
+        if (depth > 0) run_pipelined_msg(fd, depth);
+        send_msg(fd, "bye");
+    } else if (binary) {
+        run_binary(fd, depth);
+    } else {
+        send_echo(fd, "hello\n");
+        send_echo(fd, "ping\n");
+        if (depth > 0) run_pipelined(fd, 0, depth);
+        send_echo(fd, "bye\n");
+    }
 
     close(fd);
     printf("[client] done.\n");
@@ -0,0 +1,516 @@
+/*
+ * linux/03_epoll/reactor.c
+ *
+ * Thread-per-core epoll echo server (multi-reactor).
+ *
+ * Model: N worker threads, each pinned to one CPU.  Every worker owns its
+ *        own SO_REUSEPORT listening socket, epoll instance and connection
+ *        table, so the kernel spreads new connections across the workers
+ *        and a connection then lives its whole life on one thread.  The
+ *        main thread opens the listeners, in worker order, before it
+ *        starts the workers, so the port takes connections as soon as
+ *        "listening" is logged.  The
+ *        per-message path touches only worker-local state — no locks, no
+ *        shared cache lines.  Each worker's connection table and output
+ *        buffer pool are first touched on its own CPU, so they stay on
+ *        its NUMA node.  Each worker publishes its counters to its own
+ *        slot of a shared-memory segment for tools/sockstat.
+ *        Connections are accepted with accept4(), at most ACCEPT_BUDGET
+ *        per round and after the round's other events, and read at most
+ *        RX_BUDGET bytes each per round; -l sets the listen backlog, -D
+ *        turns on TCP_DEFER_ACCEPT.
+ *        -u PATH adds an AF_UNIX stream listener for same-host clients.
+ *        SO_REUSEPORT does not apply to Unix sockets, so there is one,
+ *        shared: every worker watches it with EPOLLEXCLUSIVE, which wakes
+ *        one of them per new connection instead of all.
+ *        -B USEC makes every worker spin on epoll_wait() with a zero
+ *        timeout before it blocks, for a budget that adapts to its own
+ *        traffic (linux/common/busypoll.h) — a pinned worker waiting for
+ *        its next request never sleeps while requests keep coming.
+ *        -C steers each new TCP connection to the worker pinned to the
+ *        CPU that processed its SYN, with a classic BPF program on the
+ *        SO_REUSEPORT group (linux/common/reuseport.h), instead of the
+ *        kernel's hash; the program returns a listener's index, which is
+ *        its worker's because of the order they are opened in.
+ *        With -C each worker also counts the connections it accepted
+ *        from its own CPU.
+ *        Exits when the last client disconnects.
+ *
+ * Usage: linux03_reactor [-t threads] [-l backlog] [-D defer_accept_secs]
+ *                        [-u unix_path] [-B busy_poll_usec] [-C]
+ *        (threads default: one per available CPU)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "../common/sock_helpers.h"
+#include "../common/log.h"
+#include "../common/bufpool.h"
+#include "../common/outq.h"
+#include "../common/framing.h"
+#include "../common/metrics.h"
+#include "../common/unix_sock.h"
+#include "../common/busypoll.h"
+#include "../common/reuseport.h"
+
+#define PORT        9003
+#define BACKLOG     4096      /* default -l; capped at net.core.somaxconn */
+#define ACCEPT_BUDGET 64      /* accept4() calls per round */
+#define BUF         4096
+#define RX_BUDGET   (64 * 1024) /* bytes read from one connection per round */
+#define MAX_EVENTS  32
+#define MAX_WORKERS 256
+#define MAX_LINES   64
+
+/*
+ * Per-connection state, indexed by fd inside the owning worker.  One cache
+ * line, hot fields first.
+ */
+struct rconn {
+    unsigned      events;     /* epoll interest currently registered */
+    unsigned char open;
+    unsigned char paused;     /* out above high water: stop reading */
+    unsigned char closing;    /* "bye" echoed: close once out drains */
+    struct outq   out;        /* echoes the socket has not taken yet */
+    struct framer in;         /* partial line carried between recv() calls */
+} __attribute__((aligned(64)));
+
+_Static_assert(sizeof(struct rconn) == 64, "struct rconn should fill one cache line");
+
+/*
+ * Everything a worker touches on the hot path.  Aligned to a cache line so
+ * two workers never share one.
+ */
+struct worker {
+    int            id;
+    int            cpu;
+    pthread_t      tid;
+    int            lfd;       /* opened by main, in worker order */
+    int            epfd;
+    struct rconn  *conns;     /* fd-indexed, grown on demand */
+    int            nconns;    /* capacity of conns[] */
+    struct bufpool pool;      /* OUTQ_CHUNK buffers for this worker's outqs */
+    struct metrics m;         /* published to slot[id] once per loop */
+    int            accept_more[2];    /* TCP / Unix listener may have more queued */
+    struct busypoll bp;               /* -B: this worker's spin budget */
+    unsigned long  local;             /* TCP accepts whose SYN came in on cpu */
+} __attribute__((aligned(64)));
+
+static struct worker workers[MAX_WORKERS];
+static int           stop_fd = -1;   /* eventfd in every epoll set */
+static atomic_int    live_clients;   /* touched on accept/close only */
+static struct metrics_shm *shm;      /* NULL: no sockstat */
+static int           backlog = BACKLOG;
+static int           defer_secs;     /* -D: TCP_DEFER_ACCEPT, 0 = off */
+static int           unix_fd = -1;   /* -u: shared by every worker */
+static long          busy_us;        /* -B: spin ceiling, 0 = always block */
+static int           steer;          /* -C: reuseport by incoming CPU */
+
+/* Wake every worker by making the shared eventfd permanently readable. */
+static void stop_all(void)
+{
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) < 0) perror("write eventfd");
+}
+
+/* Make sure conns[fd] exists; the table is first-touched by the worker. */
+static struct rconn *conn_slot(struct worker *w, int fd)
+{
+    if (fd >= w->nconns) {
+        int n = w->nconns ? w->nconns : 64;
+        while (n <= fd) n *= 2;
+        struct rconn *p = aligned_alloc(64, (size_t)n * sizeof(*p));
+        if (!p) die("aligned_alloc");
+        if (w->nconns) memcpy(p, w->conns, (size_t)w->nconns * sizeof(*p));
+        memset(p + w->nconns, 0, (size_t)(n - w->nconns) * sizeof(*p));
+        free(w->conns);
+        w->conns  = p;
+        w->nconns = n;
+    }
+    return &w->conns[fd];
+}
+
+static int open_listener(void)
+{
+    int sfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sfd < 0) die("socket");
+
+    int opt = 1;
+    setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (setsockopt(sfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)
+        die("setsockopt SO_REUSEPORT");
+    if (defer_secs > 0 &&
+        setsockopt(sfd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &defer_secs, sizeof(defer_secs)) < 0)
+        perror("setsockopt TCP_DEFER_ACCEPT");
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port        = htons(PORT);
+
+    if (bind(sfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) die("bind");
+    if (listen(sfd, backlog) < 0) die("listen");
+    return sfd;
+}
+
+/* EPOLLIN unless paused, EPOLLOUT only while output is queued. */
+static void update_events(struct worker *w, int fd)
+{
+    struct rconn *c = &w->conns[fd];
+    unsigned want = EPOLLET;
+    if (!c->paused && !c->closing) want |= EPOLLIN;
+    if (outq_bytes(&c->out) > 0)   want |= EPOLLOUT;
+    if (want == c->events) return;
+
+    struct epoll_event ev;
+    ev.events  = want;
+    ev.data.fd = fd;
+    if (epoll_ctl(w->epfd, EPOLL_CTL_MOD, fd, &ev) < 0) perror("epoll_ctl mod");
+    c->events = want;
+}
+
+/* Budget spent with data maybe left: MOD queues fd behind the ready ones. */
+static void requeue(struct worker *w, int fd)
+{
+    struct rconn *c = &w->conns[fd];
+    if (!(c->events & EPOLLIN)) return;
+
+    struct epoll_event ev;
+    ev.events  = c->events;
+    ev.data.fd = fd;
+    if (epoll_ctl(w->epfd, EPOLL_CTL_MOD, fd, &ev) < 0) perror("epoll_ctl mod");
+}
+
+static void close_conn(struct worker *w, int fd)
+{
+    LOG_DEBUG("[server] client disconnected (fd=%d, worker %d)\n", fd, w->id);
+    epoll_ctl(w->epfd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    outq_clear(&w->conns[fd].out);
+    framer_free(&w->conns[fd].in);
+    w->conns[fd].open = 0;
+    w->m.c[M_CLOSES]++;
+    if (atomic_fetch_sub(&live_clients, 1) == 1)
+        stop_all();
+}
+
+/*
+ * Accept up to ACCEPT_BUDGET queued connections from the worker's TCP
+ * listener (l = 0) or the shared Unix one (l = 1).  Listeners are
+ * edge-triggered: if the budget runs out first, accept_more says to come
+ * back next round.  Another worker emptying the shared queue first just
+ * means EAGAIN here.
+ */
+static void accept_some(struct worker *w, int l)
+{
+    w->accept_more[l] = 0;
+    for (int k = 0; k < ACCEPT_BUDGET; k++) {
+        struct sockaddr_in ca;
+        socklen_t cl = sizeof(ca);
+        int cfd = accept4(l ? unix_fd : w->lfd, l ? NULL : (struct sockaddr *)&ca,
+                          l ? NULL : &cl, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (cfd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept4");
+            return;
+        }
+        LOG_DEBUG("[server] client connected: %s (worker %d)\n",
+                  l ? "local (unix)" : inet_ntoa(ca.sin_addr), w->id);
+        if (steer && !l && rp_incoming_cpu(cfd) == w->cpu) w->local++;   /* a syscall: -C only */
+
+        struct rconn *c = conn_slot(w, cfd);
+        memset(c, 0, sizeof(*c));
+        framer_init(&c->in);
+        outq_init_pool(&c->out, &w->pool);
+        c->open   = 1;
+        c->events = EPOLLIN | EPOLLET;
+
+        struct epoll_event ev;
+        ev.events  = c->events;
+        ev.data.fd = cfd;
+        epoll_ctl(w->epfd, EPOLL_CTL_ADD, cfd, &ev);
+        atomic_fetch_add(&live_clients, 1);
+        w->m.c[M_ACCEPTS]++;
+    }
+    w->accept_more[l] = 1;
+}
+
+/*
+ * Echo every complete line in buf, up to and including "bye".  Lines that
+ * sit back to back in buf go out in one send.  Returns -1 to close.
+ */
+static int echo_lines(struct worker *w, int fd, const char *buf, size_t len)
+{
+    struct rconn *c = &w->conns[fd];
+    struct frame_line lines[MAX_LINES];
+
+    while (len > 0 && !c->closing) {
+        size_t used;
+        int n = framer_feed(&c->in, buf, len, lines, MAX_LINES, &used);
+        if (n < 0) return -1;               /* line too long */
+        for (int i = 0; i < n && !c->closing; ) {
+            const char *p = lines[i].p;
+            size_t      l = 0;
+            do {
+                LOG_DEBUG("[server] recv (fd=%d, worker %d): %.*s",
+                          fd, w->id, (int)lines[i].len, lines[i].p);
+                if (frame_is_bye(&lines[i])) c->closing = 1;
+                l += lines[i++].len;
+                w->m.c[M_MSGS]++;
+            } while (!c->closing && i < n && lines[i].p == p + l);
+
+            int r = outq_send(&c->out, fd, p, l);
+            if (r < 0) return -1;
+            if (r > 0) w->m.c[M_TX_EAGAIN]++;
+            w->m.c[M_BYTES_OUT] += l;
+        }
+        buf += used;
+        len -= used;
+    }
+    return 0;
+}
+
+/*
+ * Read and echo until EAGAIN, "bye", backpressure or RX_BUDGET bytes.
+ * Returns -1 to close, 1 if the budget ran out.
+ */
+static int on_readable(struct worker *w, int fd)
+{
+    struct rconn *c = &w->conns[fd];
+    size_t took = 0;
+    while (!c->paused && !c->closing) {
+        char buf[BUF];
+        ssize_t r = recv(fd, buf, sizeof(buf), 0);
+        if (r < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                w->m.c[M_RX_EAGAIN]++;
+                framer_idle(&c->in);             /* idle: no carry buffer kept */
+                break;
+            }
+            perror("recv");
+            return -1;
+        }
+        if (r == 0) return -1;
+        w->m.c[M_BYTES_IN] += (uint64_t)r;
+        w->m.recv_hist[metrics_bucket((uint64_t)r)]++;
+
+        if (echo_lines(w, fd, buf, (size_t)r) < 0) return -1;
+        if (outq_bytes(&c->out) > OUTQ_HIGH_WATER) c->paused = 1;
+        if ((took += (size_t)r) >= RX_BUDGET) return 1;
+    }
+    return 0;
+}
+
+static void conn_ready(struct worker *w, int fd, unsigned events)
+{
+    struct rconn *c = &w->conns[fd];
+    if (!c->open) return;
+
+    int close_fd = 0, again = 0;
+    if (events & EPOLLOUT) {
+        close_fd = outq_flush(&c->out, fd) < 0;
+        if (c->paused && outq_bytes(&c->out) < OUTQ_LOW_WATER) c->paused = 0;
+    }
+    if (!close_fd && (events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+        again    = on_readable(w, fd);
+        close_fd = again < 0;
+    }
+    if (!close_fd && c->closing && outq_bytes(&c->out) == 0)
+        close_fd = 1;
+
+    if (close_fd) {
+        close_conn(w, fd);
+        return;
+    }
+    update_events(w, fd);
+    if (again > 0) requeue(w, fd);
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+
+    /*
+     * Pin first, allocate second: Linux places pages on the NUMA node of
+     * the CPU that first touches them, so everything below is node-local.
+     */
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0)
+        LOG_WARN("[server] worker %d: pin to cpu %d: %s\n",
+                w->id, w->cpu, strerror(rc));
+
+    bufpool_init(&w->pool, OUTQ_CHUNK);
+    w->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (w->epfd < 0) die("epoll_create1");
+
+    struct epoll_event ev;
+    ev.events  = EPOLLIN | EPOLLET;
+    ev.data.fd = w->lfd;
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->lfd, &ev) < 0) die("epoll_ctl add lfd");
+    if (unix_fd >= 0) {
+        ev.events  = EPOLLIN | EPOLLET | EPOLLEXCLUSIVE;
+        ev.data.fd = unix_fd;
+        if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, unix_fd, &ev) < 0) die("epoll_ctl add unix_fd");
+    }
+    ev.events  = EPOLLIN;     /* level-triggered: never drained, wakes everyone */
+    ev.data.fd = stop_fd;
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, stop_fd, &ev) < 0) die("epoll_ctl add stop_fd");
+    if (busy_us > 0) {
+        bp_init(&w->bp, (uint64_t)busy_us * 1000);
+        bp_kernel_epoll(w->epfd, (unsigned)busy_us);      /* a NIC queue only, not loopback */
+        bp_kernel_sock(w->lfd, (int)busy_us);
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    for (;;) {
+        int timeout = w->accept_more[0] || w->accept_more[1] ? 0 : -1;
+        int n = busy_us > 0 ? bp_wait(&w->bp, w->epfd, events, MAX_EVENTS, timeout)
+                            : epoll_wait(w->epfd, events, MAX_EVENTS, timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        w->m.c[M_LOOPS]++;
+        w->m.c[M_EVENTS] += (uint64_t)n;
+        w->m.events_hist[metrics_bucket((uint64_t)n)]++;
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == stop_fd)      goto done;
+            else if (fd == w->lfd)  w->accept_more[0] = 1;     /* below */
+            else if (fd == unix_fd) w->accept_more[1] = 1;
+            else                    conn_ready(w, fd, events[i].events);
+        }
+        for (int l = 0; l < 2; l++)
+            if (w->accept_more[l]) accept_some(w, l);
+        if (shm) metrics_publish(&shm->slot[w->id], &w->m);
+    }
+
+done:
+    if (shm) metrics_publish(&shm->slot[w->id], &w->m);
+    for (int fd = 0; fd < w->nconns; fd++) {
+        if (!w->conns[fd].open) continue;
+        outq_clear(&w->conns[fd].out);
+        framer_free(&w->conns[fd].in);
+        close(fd);
+    }
+    free(w->conns);
+    close(w->epfd);
+    close(w->lfd);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    log_init();
+
+    cpu_set_t avail;
+    if (sched_getaffinity(0, sizeof(avail), &avail) < 0) die("sched_getaffinity");
+    int nthreads = CPU_COUNT(&avail);
+
+    int c;
+    const char *upath = NULL;
+    while ((c = getopt(argc, argv, "t:l:D:u:B:C")) != -1) {
+        switch (c) {
+        case 't': nthreads   = atoi(optarg); break;
+        case 'l': backlog    = atoi(optarg); break;
+        case 'D': defer_secs = atoi(optarg); break;
+        case 'u': upath      = optarg;       break;
+        case 'B': busy_us    = strtol(optarg, NULL, 10); break;
+        case 'C': steer      = 1;            break;
+        default:
+            fprintf(stderr, "usage: %s [-t threads] [-l backlog] [-D defer_accept_secs]"
+                            " [-u unix_path] [-B busy_poll_usec] [-C]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > MAX_WORKERS) nthreads = MAX_WORKERS;
+
+    stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (stop_fd < 0) die("eventfd");
+    if (upath && (unix_fd = unix_listen(upath, SOCK_STREAM, backlog)) < 0) die(upath);
+    shm = metrics_create("linux03_reactor", (unsigned)nthreads);
+    if (!shm) perror("metrics_create (running without sockstat)");
+    else      LOG_INFO("[server] metrics: sockstat %d\n", (int)getpid());
+
+    /* Hand out CPUs round-robin from the set we are allowed to run on. */
+    int cpu = -1, cpus[MAX_WORKERS];
+    for (int i = 0; i < nthreads; i++) {
+        do cpu = (cpu + 1) % CPU_SETSIZE; while (!CPU_ISSET(cpu, &avail));
+        workers[i].id  = i;
+        workers[i].cpu = cpus[i] = cpu;
+    }
+
+    /*
+     * Every listener is in listen() before "listening" is logged, so a
+     * client that waits for that line is not refused.  The steering
+     * program also picks a listener by its index in the group, which is
+     * listen() order: worker order, as they are opened here.
+     */
+    for (int i = 0; i < nthreads; i++) workers[i].lfd = open_listener();
+    if (steer) {
+        if (rp_steer_by_cpu(workers[0].lfd, cpus, nthreads) < 0) {
+            perror("SO_ATTACH_REUSEPORT_CBPF (hashing instead)");
+            steer = 0;
+        }
+        if (nthreads > CPU_COUNT(&avail))
+            LOG_WARN("[server] -C with more workers than CPUs: workers %d.. get no TCP "
+                     "connections\n", CPU_COUNT(&avail));
+    }
+    for (int i = 0; i < nthreads; i++) {
+        int rc = pthread_create(&workers[i].tid, NULL, worker_main, &workers[i]);
+        if (rc != 0) { errno = rc; die("pthread_create"); }
+    }
+    LOG_INFO("[server] listening on port %d (%d workers)\n", PORT, nthreads);
+    if (upath) LOG_INFO("[server] unix stream socket %s\n", upath);
+    if (steer) LOG_INFO("[server] connections steered to the worker on their incoming CPU\n");
+    if (busy_us > 0) LOG_INFO("[server] busy poll: spin up to %ld us before blocking\n", busy_us);
+
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(workers[i].tid, NULL);
+        if (steer)
+            LOG_INFO("[server] worker %d (cpu %d): %lu connections (%lu from its cpu), "
+                     "%lu messages, %zu buffer slab(s)\n", i, workers[i].cpu,
+                     (unsigned long)workers[i].m.c[M_ACCEPTS], workers[i].local,
+                     (unsigned long)workers[i].m.c[M_MSGS], workers[i].pool.nslabs);
+        else
+            LOG_INFO("[server] worker %d (cpu %d): %lu connections, %lu messages, "
+                     "%zu buffer slab(s)\n", i, workers[i].cpu,
+                     (unsigned long)workers[i].m.c[M_ACCEPTS],
+                     (unsigned long)workers[i].m.c[M_MSGS], workers[i].pool.nslabs);
+        if (busy_us > 0)
+            LOG_INFO("[server] worker %d busy poll: %llu answered spinning, %llu spun out, "
+                     "%.1f ms spinning\n", i, (unsigned long long)workers[i].bp.hits,
+                     (unsigned long long)workers[i].bp.misses,
+                     (double)workers[i].bp.spin_ns / 1e6);
+        bufpool_destroy(&workers[i].pool);
+    }
+
+    close(stop_fd);
+    if (unix_fd >= 0) {
+        close(unix_fd);
+        unix_unlink(upath);
+    }
+    metrics_destroy(shm);
+    LOG_INFO("[server] done.\n");
+    log_shutdown();
+    return 0;
+}
@@ -5,114 +5,1752 @@
  *
  * Model: epoll_create1() with EPOLLET (edge-triggered) + non-blocking fds.
  *        Each fd must be fully drained on each readable event.
+ *        Echoes the socket cannot take right away are queued per connection
+ *        and flushed on EPOLLOUT, which is only registered while output is
+ *        pending.  A connection whose queue passes the high-water mark is
+ *        not read from until it drains, so a slow reader only slows itself.
+ *        Input is split into lines by a per-connection framer, so "bye" is
+ *        found wherever it lands in a recv() and a line split across two
+ *        recv() calls is echoed once, whole.
+ *        Connection state lives in an fd-indexed table of one-cache-line
+ *        entries; output chunks come from a huge-page-backed slab pool, so
+ *        steady-state traffic does no malloc()/free().  An idle connection
+ *        holds no buffer: partial requests are given back at EAGAIN, and
+ *        the fd tables are mappings whose unused entries cost nothing.
+ *        With -z BYTES, echoes of at least BYTES go out with MSG_ZEROCOPY
+ *        straight from the receive buffer, which is then held until the
+ *        kernel reports the send complete on the socket's error queue.
+ *        A second listener on PORT_BIN speaks the length-prefixed binary
+ *        protocol instead: frame ends come from the header, and the rest
+ *        of a large body is recv()'d straight into the frame's buffer.
+ *        Echoes are not sent as they are parsed: requests are read into a
+ *        shared arena, the answers are gathered per connection, and after
+ *        each epoll_wait() round every connection gets one sendmsg() for
+ *        all of them, so a pipelining client costs one write per round
+ *        instead of one per request.  With -d USEC, answers are held for
+ *        up to USEC microseconds (a timerfd) to gather across rounds.
+ *        Every connection has one deadline on a hierarchical timing wheel,
+ *        which sets the epoll_wait() timeout: its first request must come
+ *        within -a ms of accept, later ones within -i ms of the previous
+ *        one, and queued output must make progress every -w ms.  A
+ *        connection that misses its deadline is closed.
+ *        Counters and histograms are published once per loop iteration to
+ *        a shared-memory segment (linux/common/metrics.h) that
+ *        tools/sockstat reads.
+ *        Hot restart: started with -R, the server connects to the running
+ *        one over a Unix socket and is handed its listening sockets and
+ *        every live connection (SCM_RIGHTS), each with its deadline, its
+ *        unfinished request and its unsent answers.  The old process exits
+ *        once the new one has them all; no connection is closed and no
+ *        SYN refused.
+ *        Accepting costs one accept4() per connection, which also sets
+ *        O_NONBLOCK; at most ACCEPT_BUDGET per listener per round, after
+ *        the round's other events, so a connection storm cannot starve
+ *        clients already connected.  Reading is budgeted the same way: a
+ *        connection gives up the loop after RX_BUDGET bytes in a round
+ *        and is re-queued behind the others, so a client that never stops
+ *        sending cannot hold everyone else up.  -l sets the listen
+ *        backlog and -D turns on TCP_DEFER_ACCEPT, so a connection is only
+ *        handed over once its first request has arrived.
+ *        Same-host clients can skip TCP: -u PATH adds an AF_UNIX stream
+ *        listener speaking the line protocol, -q PATH a SOCK_SEQPACKET one
+ *        where every message is one request and its echo one message, so
+ *        there is nothing to frame (linux/common/unix_sock.h; "@name" is
+ *        an abstract socket).  All listeners feed the same event loop.
+ *        With -B USEC the loop busy-polls: epoll_wait() is called with a
+ *        zero timeout for up to a spin budget before it blocks, so a
+ *        request that arrives meanwhile is handled without a sleep and a
+ *        wakeup.  The budget adapts to the gap between requests and drops
+ *        to zero, plain blocking, when they come further apart than USEC
+ *        (linux/common/busypoll.h); the kernel is asked to busy-poll the
+ *        NIC queue as well where it allows.
+ *        With -T, TCP connections are timestamped by the kernel
+ *        (SO_TIMESTAMPING, linux/common/tstamp.h) and every stamped read
+ *        is broken into stages: receive queue until epoll_wait() returns
+ *        (queued behind a busy loop, or waking it), the rest of the round
+ *        until recv() returns, the handler until the answer's sendmsg(),
+ *        and one sampled send per connection until the kernel stamps it
+ *        on the way out.  Each stage has a histogram in the metrics
+ *        segment (sockstat -S) and its percentiles are printed at exit.
+ *        With -W N, line requests are handled on a pool of N worker
+ *        threads (linux/common/wspool.h) so a slow handler cannot stall
+ *        the loop: each line goes to the pool as a job, idle workers steal
+ *        jobs from one another and from the loop, and finished jobs come
+ *        back through an eventfd in the epoll set.  A connection's answers
+ *        still go out in request order; one with JOB_MAX jobs in flight is
+ *        not read from until some come back.  "work USEC" is the demo's
+ *        slow request: its handler takes USEC microseconds, inline or not.
+ *        With -b BACKEND the plain line echo runs on libsockloop instead
+ *        (linux/sockloop/sl_echo.h, shared with 02 and 06), with that
+ *        backend underneath: the line port and -u, with -l, -D and the -i
+ *        idle deadline, and none of the above that works below the
+ *        library's API: no binary port, gather, metrics or "work", no
+ *        first-request or write-stall deadline, and -z -d -q -B -W -T -R
+ *        -a -w are refused.
  *        Exits when the last client disconnects.
+ *
+ * Usage: linux03_server [-z zerocopy_threshold_bytes] [-d flush_delay_usec]
+ *                       [-a first_request_ms] [-i idle_ms] [-w write_stall_ms]
+ *                       [-l backlog] [-D defer_accept_secs]
+ *                       [-u unix_path] [-q seqpacket_path] [-B busy_poll_usec]
+ *                       [-W pool_workers] [-T] [-R] [-b backend]
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/time.h>
 #include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 
 #include "../common/sock_helpers.h"
+#include "../common/log.h"
+#include "../common/bufpool.h"
+#include "../common/outq.h"
+#include "../common/framing.h"
+#include "../common/binframe.h"
+#include "../common/zcopy.h"
+#include "../common/gather.h"
+#include "../common/twheel.h"
+#include "../common/metrics.h"
+#include "../common/handoff.h"
+#include "../common/unix_sock.h"
+#include "../common/busypoll.h"
+#include "../common/fdtab.h"
+#include "../common/wspool.h"
+#include "../common/tstamp.h"
+#include "../common/hdr_hist.h"
+#include "sl_echo.h"
 
 #define PORT       9003
-#define BACKLOG    4
-#define BUF        256
+#define PORT_BIN   9103          /* binary protocol listener */
+#define BACKLOG    4096          /* default -l; capped at net.core.somaxconn */
+#define ACCEPT_BUDGET 64         /* accept4() calls per listener per round */
+#define BUF        4096
 #define MAX_EVENTS 32
+#define MAX_LINES  64
+#define ZC_BUF     (64 * 1024)   /* receive buffer in zero-copy mode */
+#define ARENA      (1024 * 1024) /* requests read per flush round */
+#define GATHER_MAX 4096          /* answers per flush round */
+#define RECV_MAX   (64 * 1024)   /* largest single recv() into the arena */
+#define RX_BUDGET  (64 * 1024)   /* bytes read from one connection per round */
+#define CTL_NAME   "linux03_server"  /* Unix socket a successor connects to */
+#define SEQ_MAX    (64 * 1024)   /* largest message on the SOCK_SEQPACKET listener */
+#define SEQ_BATCH  32            /* messages per recvmmsg()/sendmmsg() */
+#define JOB_SMALL  240           /* request bytes in a recycled job */
+#define JOB_MAX    64            /* jobs in flight per connection before reading stops */
+#define WORK_MAX_US 1000000      /* longest "work" request */
+#define TX_SAMPLE  16            /* -T: one answer flush in this many asks for a TX stamp */
+
+/* What a connection speaks; decided by the listener that accepted it. */
+enum { PROTO_LINE, PROTO_BIN, PROTO_MSG };
+
+/* Listeners: TCP line and binary ports, then the optional -u and -q sockets. */
+enum { L_TCP, L_BIN, L_UNIX, L_SEQ, NLISTEN };
+static const unsigned char l_proto[NLISTEN] = { PROTO_LINE, PROTO_BIN, PROTO_LINE, PROTO_MSG };
+
+/* What a connection's deadline is for; the wheel keeps it as the tag. */
+enum { TMO_FIRST, TMO_IDLE, TMO_STALL };
+static const char *const tmo_name[] = { "first request", "idle", "write stall" };
+
+/*
+ * Hot restart records.  The successor says hello; the old process answers
+ * with its listeners, then one record per connection (the socket attached,
+ * its unfinished request and queued answers following the struct), then
+ * the end; the successor acknowledges with one byte.  Both ends are the
+ * same binary, so the struct goes as is.
+ */
+enum { XFER_HELLO = 1, XFER_LISTENERS, XFER_CONN, XFER_END };
+#define XFER_VERSION 2
+#define XFER_NO_TMO  0xff
+
+struct xfer {
+    uint32_t type;
+    uint32_t version;
+    uint8_t  proto, paused, closing;
+    uint8_t  tmo_kind;        /* XFER_NO_TMO: no deadline */
+    uint32_t listeners;       /* XFER_LISTENERS: bit per L_* sent, in order */
+    uint32_t tmo_left;        /* ms to the deadline */
+    uint32_t in_len;          /* unfinished line or frame */
+    uint32_t out_len;         /* queued answers */
+    uint32_t zc_next;         /* kernel's next zero-copy send number */
+    uint32_t zc_pinned;       /* bit per ZC_INFLIGHT slot not completed yet */
+    uint8_t  zc_off;
+};
+
+/*
+ * Per-connection state, indexed by fd.  Exactly one cache line: the fields
+ * every event touches come first, the rarely used carry buffer last.
+ */
+struct conn {
+    unsigned      events;     /* epoll interest currently registered */
+    unsigned char open;
+    unsigned char paused;     /* out above high water: stop reading */
+    unsigned char closing;    /* "bye" echoed: close once out drains */
+    unsigned char proto;      /* PROTO_*, from the listener */
+    struct outq   out;        /* echoes the socket has not taken yet */
+    union {
+        struct framer in;     /* line protocol: partial line between recv()s */
+        struct bin_rx bin;    /* binary protocol: frame in progress */
+    };
+} __attribute__((aligned(64)));
+
+_Static_assert(sizeof(struct conn) == 64, "struct conn should fill one cache line");
+
+/*
+ * A line handed to the worker pool (-W), answered in place by the handler.
+ * A connection's jobs are listed oldest first, and an answer goes out only
+ * once every earlier one on the connection has.
+ */
+struct job {
+    struct ws_task task;      /* first: what the pool sees */
+    struct job    *next;      /* the connection's jobs; free list */
+    int            fd;
+    unsigned char  done;      /* back from the pool, not sent yet */
+    unsigned char  orphan;    /* connection closed meanwhile: just free it */
+    uint32_t       len, cap;
+    char           data[];
+};
+
+/* Jobs of one connection, in a table of its own like struct zconn. */
+struct jconn {
+    struct job *head, *tail;
+    unsigned    n;
+};
+
+/* Zero-copy state, in a table of its own so struct conn stays one line. */
+struct zconn {
+    struct zc_tx   tx;
+    struct zc_buf *rbuf;      /* receive buffer; echoes are sent from it */
+};
+
+/*
+ * Timestamps (-T), in a table of their own like struct zconn.  Realtime
+ * ns, the clock of the kernel's stamps; 0 = nothing pending.
+ */
+struct tsconn {
+    uint64_t rx_ns;           /* first stamped read not answered yet returned */
+    uint64_t tx_ns;           /* the sampled send was made; its stamp is due */
+};
+
+static struct conn   *conns;
+static struct zconn  *zconns;    /* parallel to conns, only with -z */
+static int            nconns;
+static struct bufpool pool;      /* OUTQ_CHUNK buffers for every outq */
+static struct bufpool zpool;     /* ZC_BUF receive buffers, only with -z */
+static size_t         zc_threshold;  /* 0 = zero-copy off */
+static uint64_t       zc_sends, zc_bytes, zc_copied;   /* closed connections */
+static struct gather  gat;       /* this round's requests and answers */
+static struct gather_q *gqs;     /* parallel to conns: answers not sent yet */
+static long           flush_us;  /* -d: hold answers this long, 0 = per round */
+static int            tfd = -1;  /* flush deadline timer, only with -d */
+static int            timer_armed;
+static struct twheel  wheel;     /* one deadline per fd, in milliseconds */
+static uint64_t       now_ms;    /* read once per epoll_wait() round */
+static long           tmo_ms[] = { 10000, 60000, 30000 };  /* -a -i -w, 0 = off */
+static unsigned long long ntimeouts;
+static struct metrics mx;        /* this thread's counters, see metrics.h */
+static int            backlog = BACKLOG;
+static int            defer_secs;    /* -D: TCP_DEFER_ACCEPT, 0 = off */
+static int            lfds[NLISTEN] = { -1, -1, -1, -1 };
+static const char    *lpath[NLISTEN];    /* -u / -q: unlinked at exit */
+static char           lpath_buf[NLISTEN][sizeof(((struct sockaddr_un *)0)->sun_path) + 1];
+static int            accept_more[NLISTEN];  /* listener may have more queued */
+static long           busy_us;       /* -B: spin ceiling, 0 = always block */
+static struct busypoll bp;
+static int            npool;         /* -W: worker threads, 0 = handle inline */
+static struct wspool  wpool;
+static struct jconn  *jconns;        /* parallel to conns, only with -W */
+static struct job    *job_free;      /* recycled JOB_SMALL jobs */
+static unsigned long  jobs_out;      /* submitted, not reaped yet */
+static char           seqbuf[SEQ_BATCH][SEQ_MAX];  /* one batch of messages */
+static struct iovec   seq_iov[SEQ_BATCH];
+static struct mmsghdr seq_mm[SEQ_BATCH];
+static int            stamps;        /* -T: per-stage latency from kernel stamps */
+static struct tsconn *tsconns;       /* parallel to conns, only with -T */
+static uint64_t       wait_ns, woke_ns;  /* this round's epoll_wait(), realtime */
+static struct hdr_hist stage_hdr[M_NSTAGES];   /* for the exit summary */
+
+static uint64_t clock_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/*
+ * Grow a per-fd table from nconns to n entries.  The tables are fdtabs:
+ * new entries are zero, and pages of fds never used cost no memory.
+ */
+static void *table_grow(void *t, size_t size, int n)
+{
+    t = fdtab_grow(t, (size_t)nconns * size, (size_t)n * size);
+    if (!t) die("mremap");
+    return t;
+}
+
+static struct conn *conn_get(int fd)
+{
+    if (fd >= nconns) {
+        int n = nconns ? nconns : 64;
+        while (n <= fd) n *= 2;
+        conns = table_grow(conns, sizeof(*conns), n);
+        gqs   = table_grow(gqs, sizeof(*gqs), n);
+        if (tw_reserve(&wheel, n) < 0) die("tw_reserve");
+        if (zc_threshold) zconns = table_grow(zconns, sizeof(*zconns), n);
+        if (npool)        jconns = table_grow(jconns, sizeof(*jconns), n);
+        if (stamps)       tsconns = table_grow(tsconns, sizeof(*tsconns), n);
+        nconns = n;
+    }
+    return &conns[fd];
+}
+
+/* Give fd a deadline of the given kind, from now; kinds set to 0 are off. */
+static void conn_timer(int fd, unsigned kind)
+{
+    if (tmo_ms[kind] > 0) tw_arm(&wheel, fd, now_ms + (uint64_t)tmo_ms[kind], kind);
+    else                  tw_cancel(&wheel, fd);
+}
+
+/*
+ * A request came in: push the idle deadline out.  Usually a single store,
+ * see twheel.h.  While output is stuck, the stall deadline stays.
+ */
+static void conn_active(int fd)
+{
+    if (tw_armed(&wheel, fd) && tw_tag(&wheel, fd) == TMO_STALL) return;
+    conn_timer(fd, TMO_IDLE);
+}
+
+/* One request's time in stage s; a step of the realtime clock is dropped. */
+static void stage(unsigned s, uint64_t ns)
+{
+    if ((int64_t)ns < 0) return;
+    mx.stage_hist[s][metrics_lat_bucket(ns)]++;
+    hdr_record(&stage_hdr[s], ns);
+}
+
+/*
+ * recv(), and with -T the stages up to it: from the kernel's RX stamp to
+ * the round's epoll_wait() return, split by whether the loop was busy or
+ * asleep when the data came, then on to the recv() return.  The first
+ * stamped read since fd's last answer starts its handler stage.
+ */
+static ssize_t conn_recv(int fd, void *buf, size_t cap)
+{
+    if (!stamps) return recv(fd, buf, cap, 0);
+    uint64_t rx;
+    ssize_t r = ts_recv(fd, buf, cap, 0, &rx);
+    if (r <= 0 || !rx) return r;
+    uint64_t now = ts_now();
+    if (rx < wait_ns)       stage(S_QUEUED, woke_ns - rx);
+    else if (rx <= woke_ns) stage(S_WAKEUP, woke_ns - rx);
+    stage(S_DISPATCH, now - (rx > woke_ns ? rx : woke_ns));
+    mx.c[M_STAMPED]++;
+    if (!tsconns[fd].rx_ns) tsconns[fd].rx_ns = now;
+    return r;
+}
+
+/*
+ * gather_flush() for fd.  With -T this is where the handler stage of a
+ * stamped read ends.  One flush in TX_SAMPLE also asks the kernel for a
+ * TX stamp, unless one is still due on fd: each stamp costs an EPOLLERR
+ * wakeup and two error-queue reads, too much to pay on every answer.
+ * Zero-copy completions would take the stamps off the error queue, so
+ * with -z no send asks.
+ */
+static int conn_flush(int fd)
+{
+    static unsigned flushes;
+    struct tsconn *t = stamps ? &tsconns[fd] : NULL;
+    if (!t || !t->rx_ns) return gather_flush(&gat, &gqs[fd], fd, &conns[fd].out);
+
+    struct ts_ctl ctl;
+    uint64_t now = ts_now();
+    int ask = !t->tx_ns && !zc_threshold && flushes++ % TX_SAMPLE == 0;
+    stage(S_HANDLER, now - t->rx_ns);
+    t->rx_ns = 0;
+    if (ask) {
+        ts_tx_ctl(&ctl);
+        gat.ctl    = ctl.buf;
+        gat.ctllen = sizeof(ctl.buf);
+    }
+    int r = gather_flush(&gat, &gqs[fd], fd, &conns[fd].out);
+    if (ask && !gat.ctl) t->tx_ns = now;         /* went out with bytes */
+    gat.ctl = NULL;
+    return r;
+}
+
+/*
+ * The TX stamp of fd's sampled send is on the error queue.  Returns the
+ * stamps read, or -1 to close.
+ */
+static int on_tx_stamp(int fd)
+{
+    uint64_t tx = 0;
+    int got = ts_reap_tx(fd, &tx);
+    if (got < 0) {
+        perror("recvmsg errqueue");
+        return -1;
+    }
+    struct tsconn *t = &tsconns[fd];
+    if (got && t->tx_ns) {
+        stage(S_TX, tx - t->tx_ns);
+        t->tx_ns = 0;
+    }
+    return got;
+}
+
+/* Too many of fd's requests are on the pool: read no more for now. */
+static int jobs_full(int fd)
+{
+    return npool && jconns[fd].n >= JOB_MAX;
+}
+
+/*
+ * Register exactly the interest the connection needs: EPOLLIN unless
+ * reading is paused, EPOLLOUT only while output is queued.  MOD re-checks
+ * readiness, so resuming a paused reader picks up data already buffered.
+ * Waiting for EPOLLOUT is what the write stall deadline covers.
+ */
+static unsigned conn_interest(int fd)
+{
+    const struct conn *c = &conns[fd];
+    unsigned want = EPOLLET;
+    if (!c->paused && !c->closing && !jobs_full(fd)) want |= EPOLLIN;
+    if (outq_bytes(&c->out) > 0)   want |= EPOLLOUT;
+    /* Zero-copy completions need no interest bit: EPOLLERR is always on. */
+    return want;
+}
+
+static void update_events(int epfd, int fd)
+{
+    struct conn *c = &conns[fd];
+    unsigned want = conn_interest(fd);
+    if (want == c->events) return;
+
+    struct epoll_event ev;
+    ev.events  = want;
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) < 0) perror("epoll_ctl mod");
+    if ((want ^ c->events) & EPOLLOUT) conn_timer(fd, want & EPOLLOUT ? TMO_STALL : TMO_IDLE);
+    c->events = want;
+}
+
+/*
+ * The read budget ran out before EAGAIN.  The edge is spent, but MOD
+ * re-checks readiness and queues fd behind the fds already ready, so the
+ * next epoll_wait() returns at once and every other connection is read
+ * before this one is again.
+ */
+static void conn_requeue(int epfd, int fd)
+{
+    struct conn *c = &conns[fd];
+    if (!(c->events & EPOLLIN)) return;          /* paused: MOD on resume does it */
+
+    struct epoll_event ev;
+    ev.events  = c->events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) < 0) perror("epoll_ctl mod");
+}
+
+/* "bye" handled and every answer out of user space: time to close. */
+static int conn_done(int fd)
+{
+    const struct conn *c = &conns[fd];
+    /* A zero-copy send still reads from its buffer until completed. */
+    return c->closing && outq_bytes(&c->out) == 0 && gather_q_empty(&gqs[fd]) &&
+           (!zc_threshold || zconns[fd].tx.inflight == 0) &&
+           (!npool || !jconns[fd].head);
+}
+
+/* A job with room for len request bytes: recycled if small. */
+static struct job *job_get(size_t len)
+{
+    struct job *j = job_free;
+    if (len <= JOB_SMALL && j) {
+        job_free = j->next;
+        return j;
+    }
+    uint32_t cap = len <= JOB_SMALL ? JOB_SMALL : (uint32_t)len;
+    if (!(j = malloc(sizeof(*j) + cap))) die("malloc");
+    j->cap = cap;
+    return j;
+}
+
+static void job_put(struct job *j)
+{
+    if (j->cap != JOB_SMALL) {
+        free(j);
+        return;
+    }
+    j->next  = job_free;
+    job_free = j;
+}
+
+/*
+ * Forget fd and free what it holds.  Closes only this process's
+ * descriptor: a socket handed to a successor lives on there.
+ */
+static void conn_free(int epfd, int fd)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    tw_cancel(&wheel, fd);
+    outq_clear(&conns[fd].out);
+    if (conns[fd].proto == PROTO_BIN)       bin_rx_free(&conns[fd].bin);
+    else if (conns[fd].proto == PROTO_LINE) framer_free(&conns[fd].in);
+    conns[fd].open = 0;
+    if (npool) {
+        /* Jobs still on the pool are freed when they come back. */
+        for (struct job *j = jconns[fd].head, *next; j; j = next) {
+            next = j->next;
+            if (j->done) job_put(j);
+            else         j->orphan = 1;
+        }
+        memset(&jconns[fd], 0, sizeof(jconns[fd]));
+    }
+    if (zc_threshold) {
+        struct zconn *z = &zconns[fd];
+        zc_sends  += z->tx.sends;
+        zc_bytes  += z->tx.bytes;
+        zc_copied += z->tx.copied;
+        zc_tx_abort(&z->tx, &zpool);
+        if (z->rbuf) zc_buf_unref(&zpool, z->rbuf);
+        z->rbuf = NULL;
+    }
+}
+
+/*
+ * A read pass ended in EAGAIN: give back what only a request in progress
+ * needs, so an idle connection holds no buffer — just its table entries.
+ */
+static void conn_idle(int fd)
+{
+    struct conn *c = &conns[fd];
+    if (c->proto == PROTO_BIN)       bin_rx_idle(&c->bin);
+    else if (c->proto == PROTO_LINE) framer_idle(&c->in);
+    if (zc_threshold && zconns[fd].rbuf) {
+        zc_buf_unref(&zpool, zconns[fd].rbuf);   /* a send pinning it keeps it */
+        zconns[fd].rbuf = NULL;
+    }
+}
+
+static void close_conn(int epfd, int fd)
+{
+    LOG_DEBUG("[server] client disconnected (fd=%d)\n", fd);
+    /* Answers to requests that came in before EOF still go out. */
+    if (!gather_q_empty(&gqs[fd])) gather_flush(&gat, &gqs[fd], fd, &conns[fd].out);
+    conn_free(epfd, fd);
+    mx.c[M_CLOSES]++;
+}
+
+/* With -d, the first answer of a round starts the flush deadline. */
+static void arm_flush_timer(void)
+{
+    if (!flush_us || timer_armed) return;
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec  = flush_us / 1000000;
+    its.it_value.tv_nsec = (flush_us % 1000000) * 1000;
+    if (timerfd_settime(tfd, 0, &its, NULL) < 0) perror("timerfd_settime");
+    else timer_armed = 1;
+}
+
+/*
+ * Answer with one run of echoed lines or frames.  Normally it is only
+ * gathered, to go out with the rest of the round's answers; when the round
+ * is out of room it is sent now instead, behind what is gathered.  Large
+ * runs that sit in the zero-copy receive buffer go out at once without a
+ * copy.  Whatever the socket does not take is queued (copied) as usual.
+ */
+static int echo_send(int fd, const char *p, size_t l)
+{
+    struct conn *c = &conns[fd];
+    struct gather_q *q = &gqs[fd];
+    conn_active(fd);
+    mx.c[M_BYTES_OUT] += l;
+    if (zc_threshold && l >= zc_threshold) {
+        struct zconn *z = &zconns[fd];
+        struct zc_buf *b = z->rbuf;
+        if (b && zc_ready(&z->tx) && p >= b->data && p + l <= b->data + b->len) {
+            int f = gather_flush(&gat, q, fd, &c->out);
+            if (f < 0) return -1;
+            if (f > 0) return outq_append(&c->out, p, l) < 0 ? -1 : 1;
+            ssize_t w = zc_send(&z->tx, fd, b, p, l, MSG_DONTWAIT);
+            if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS)
+                return -1;
+            if (w < 0 && errno == ENOBUFS) return outq_send(&c->out, fd, p, l);
+            if (w < 0) w = 0;
+            if ((size_t)w == l) return 0;
+            return outq_append(&c->out, p + w, l - (size_t)w) < 0 ? -1 : 1;
+        }
+    }
+    if (gather_add(&gat, q, fd, p, l) == 0) {
+        arm_flush_timer();
+        return 0;
+    }
+    if (gather_flush(&gat, q, fd, &c->out) < 0) return -1;
+    return outq_send(&c->out, fd, p, l);
+}
+
+/* Completions on the error queue: release the receive buffers they pin. */
+static int on_zc_complete(int fd)
+{
+    if (zc_reap(&zconns[fd].tx, fd, &zpool) < 0) {
+        perror("recvmsg errqueue");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * The buffer to recv() into: the current one, unless a zero-copy send
+ * still pins it, in which case it is left to the kernel and a new one
+ * taken from the pool.
+ */
+static struct zc_buf *zc_rbuf(int fd)
+{
+    struct zconn *z = &zconns[fd];
+    if (z->rbuf && z->rbuf->refs == 1) return z->rbuf;
+    if (z->rbuf) zc_buf_unref(&zpool, z->rbuf);
+    z->rbuf = zc_buf_get(&zpool);
+    return z->rbuf;
+}
+
+/*
+ * A line's handler.  An echo costs nothing, so "work USEC" stands in for
+ * an expensive request — a query, a hash, a disk read: it takes USEC
+ * microseconds, at most WORK_MAX_US, before it is echoed.
+ */
+static void handle_line(const char *p, size_t len)
+{
+    if (len < 5 || memcmp(p, "work ", 5) != 0) return;
+    unsigned long us = 0;
+    for (size_t i = 5; i < len && p[i] >= '0' && p[i] <= '9' && us <= WORK_MAX_US; i++)
+        us = us * 10 + (unsigned long)(p[i] - '0');
+    if (us > WORK_MAX_US) us = WORK_MAX_US;
+    struct timespec ts = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+/* Runs on a pool worker: nothing but the job itself is touched. */
+static void job_run(struct ws_task *t)
+{
+    struct job *j = (struct job *)t;
+    handle_line(j->data, j->len);
+}
+
+/* Hand one line of fd to the pool; its answer comes back in on_pool_done(). */
+static void job_submit(int fd, const char *p, size_t len)
+{
+    struct job *j = job_get(len);
+    memcpy(j->data, p, len);
+    j->len     = (uint32_t)len;
+    j->fd      = fd;
+    j->done    = 0;
+    j->orphan  = 0;
+    j->next    = NULL;
+    j->task.fn = job_run;
+    struct jconn *q = &jconns[fd];
+    if (q->tail) q->tail->next = j;
+    else         q->head       = j;
+    q->tail = j;
+    q->n++;
+    if (wsp_submit(&wpool, &j->task) < 0) die("wsp_submit");
+    jobs_out++;
+    conn_active(fd);
+}
+
+/*
+ * The pool's eventfd fired: answer what came back.  A job that finished
+ * before an earlier one of its connection waits for it; then both go, in
+ * order.  A job is freed once sent: gather_add() and the output queue
+ * copy its bytes.  Returns the number of connections closed.
+ */
+static int on_pool_done(int epfd)
+{
+    int closed = 0;
+    for (struct ws_task *t = wsp_reap(&wpool), *next; t; t = next) {
+        next = t->next;
+        struct job *j = (struct job *)t;
+        jobs_out--;
+        if (j->orphan) {
+            job_put(j);
+            continue;
+        }
+        j->done = 1;
+        int fd = j->fd, failed = 0;
+        struct jconn *q = &jconns[fd];
+        while (q->head && q->head->done) {
+            struct job *h = q->head;
+            if (!(q->head = h->next)) q->tail = NULL;
+            q->n--;
+            int w = echo_send(fd, h->data, h->len);
+            job_put(h);
+            if (w < 0) {
+                perror("send");
+                failed = 1;
+                break;
+            }
+            if (w > 0) mx.c[M_TX_EAGAIN]++;
+        }
+        struct conn *c = &conns[fd];
+        if (failed || conn_done(fd)) {
+            close_conn(epfd, fd);
+            closed++;
+            continue;
+        }
+        if (outq_bytes(&c->out) > OUTQ_HIGH_WATER) c->paused = 1;
+        update_events(epfd, fd);
+    }
+    return closed;
+}
+
+/* Hot restart: jobs do not travel, so wait until every one is back. */
+static int drain_jobs(int epfd)
+{
+    int closed = 0;
+    while (jobs_out > 0) {
+        struct pollfd pfd = { wpool.efd, POLLIN, 0 };
+        if (poll(&pfd, 1, 1000) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        closed += on_pool_done(epfd);
+    }
+    return closed;
+}
+
+/*
+ * Echo every complete line in buf, up to and including "bye"; anything
+ * after "bye" is dropped.  Lines that sit back to back in buf are
+ * answered as one run.  With -W each line is a job for the pool instead,
+ * answered when it comes back.  Returns -1 to close.
+ */
+static int echo_lines(int fd, const char *buf, size_t len)
+{
+    struct conn *c = &conns[fd];
+    struct frame_line lines[MAX_LINES];
+
+    while (len > 0 && !c->closing) {
+        size_t used;
+        int n = framer_feed(&c->in, buf, len, lines, MAX_LINES, &used);
+        if (n < 0) {
+            LOG_WARN("[server] line too long (fd=%d)\n", fd);
+            return -1;
+        }
+        for (int i = 0; i < n && !c->closing; ) {
+            if (npool) {
+                LOG_DEBUG("[server] recv (fd=%d): %.*s", fd, (int)lines[i].len, lines[i].p);
+                if (frame_is_bye(&lines[i])) c->closing = 1;
+                job_submit(fd, lines[i].p, lines[i].len);
+                mx.c[M_MSGS]++;
+                i++;
+                continue;
+            }
+            const char *p = lines[i].p;
+            size_t      l = 0;
+            do {
+                LOG_DEBUG("[server] recv (fd=%d): %.*s", fd, (int)lines[i].len, lines[i].p);
+                if (frame_is_bye(&lines[i])) c->closing = 1;
+                handle_line(lines[i].p, lines[i].len);
+                l += lines[i++].len;
+                mx.c[M_MSGS]++;
+            } while (!c->closing && i < n && lines[i].p == p + l);
+
+            int w = echo_send(fd, p, l);
+            if (w < 0) {
+                perror("send");
+                return -1;
+            }
+            if (w > 0) mx.c[M_TX_EAGAIN]++;
+        }
+        buf += used;
+        len -= used;
+    }
+    return 0;
+}
+
+/*
+ * Echo every complete frame, up to and including BYE, unchanged: same
+ * header, same body.  Frames that sit back to back are answered as one
+ * run.  Returns -1 to close.
+ */
+static int echo_frames(int fd, const char *buf, size_t len)
+{
+    struct conn *c = &conns[fd];
+    struct bin_frame frames[MAX_LINES];
+
+    do {
+        size_t used;
+        int n = bin_feed(&c->bin, buf, len, frames, MAX_LINES, &used);
+        if (n < 0) {
+            LOG_WARN("[server] frame too large (fd=%d)\n", fd);
+            return -1;
+        }
+        for (int i = 0; i < n && !c->closing; ) {
+            const char *p = frames[i].p;
+            size_t      l = 0;
+            do {
+                const struct bin_hdr *h = &frames[i].h;
+                if (h->type != BIN_ECHO && h->type != BIN_BYE) {
+                    LOG_WARN("[server] unknown frame type %u (fd=%d)\n", (unsigned)h->type, fd);
+                    return -1;
+                }
+                LOG_DEBUG("[server] frame (fd=%d): type %u, id %llu, %u bytes\n",
+                          fd, (unsigned)h->type, (unsigned long long)h->id, (unsigned)h->len);
+                if (h->type == BIN_BYE) c->closing = 1;
+                l += frames[i++].len;
+                mx.c[M_MSGS]++;
+            } while (!c->closing && i < n && frames[i].p == p + l);
+
+            int w = echo_send(fd, p, l);
+            if (w < 0) {
+                perror("send");
+                return -1;
+            }
+            if (w > 0) mx.c[M_TX_EAGAIN]++;
+        }
+        buf += used;
+        len -= used;
+    } while (len > 0 && !c->closing);
+    return 0;
+}
+
+/*
+ * Where the next recv() goes: the gather arena, so answers can point at
+ * the request bytes, or a stack buffer once the arena is full for this
+ * round.
+ */
+static char *recv_space(char *stack_buf, size_t *cap)
+{
+    size_t avail;
+    char *p = gather_space(&gat, &avail);
+    if (avail < BUF) {
+        *cap = BUF;
+        return stack_buf;
+    }
+    *cap = avail < RECV_MAX ? avail : RECV_MAX;
+    return p;
+}
+
+/* on_readable() for binary connections. */
+static int on_readable_bin(int fd)
+{
+    struct conn *c = &conns[fd];
+    size_t took = 0;
+    while (!c->paused && !c->closing) {
+        char stack_buf[BUF], *dst;
+        size_t cap, direct = bin_rx_direct(&c->bin, &dst);
+        char *buf = recv_space(stack_buf, &cap);
+        ssize_t r = direct ? conn_recv(fd, dst, direct) : conn_recv(fd, buf, cap);
+        if (r < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                mx.c[M_RX_EAGAIN]++;
+                conn_idle(fd);
+                break;
+            }
+            perror("recv");
+            return -1;
+        }
+        if (r == 0) return -1;
+        mx.c[M_BYTES_IN] += (uint64_t)r;
+        mx.recv_hist[metrics_bucket((uint64_t)r)]++;
+        took += (size_t)r;
+
+        if (!direct && buf != stack_buf) gather_commit(&gat, (size_t)r);
+        if (direct) {
+            /* Body bytes landed in place; let bin_feed() see if it is whole. */
+            bin_rx_commit(&c->bin, (size_t)r);
+            r = 0;
+        }
+        if (echo_frames(fd, buf, (size_t)r) < 0) return -1;
+        if (outq_bytes(&c->out) > OUTQ_HIGH_WATER) c->paused = 1;
+        if (took >= RX_BUDGET) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Echo seq_mm[0..n): one message each, in one sendmmsg().  Messages the
+ * socket does not take are queued as records — a 4-byte length, then the
+ * bytes — and the caller stops reading until flush_msgs() has sent them,
+ * so records never pile up behind one another.  Returns 0 when all went
+ * out, 1 if some were queued, -1 on error.
+ */
+static int send_msgs(int fd, int n)
+{
+    struct outq *q = &conns[fd].out;
+    int m = sendmmsg(fd, seq_mm, (unsigned)n, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (m < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) return -1;
+        m = 0;
+    }
+    for (int i = m; i < n; i++) {
+        uint32_t len = (uint32_t)seq_iov[i].iov_len;
+        if (outq_append(q, &len, sizeof(len)) < 0 || outq_append(q, seq_iov[i].iov_base, len) < 0)
+            return -1;
+    }
+    return m < n;
+}
+
+/*
+ * The records send_msgs() queued, again one message each.  Returns 0 when
+ * the queue is empty, 1 if the socket is still full, -1 on error.
+ */
+static int flush_msgs(int fd)
+{
+    struct outq *q = &conns[fd].out;
+    size_t len = outq_bytes(q), off = 0;
+    char *buf = malloc(len);
+    if (!buf) return -1;
+    outq_copy(q, buf);
+    int n = 0;
+    while (off + sizeof(uint32_t) <= len && n < SEQ_BATCH) {
+        uint32_t l;
+        memcpy(&l, buf + off, sizeof(l));
+        seq_iov[n].iov_base = buf + off + sizeof(l);
+        seq_iov[n].iov_len  = l;
+        memset(&seq_mm[n], 0, sizeof(seq_mm[n]));
+        seq_mm[n].msg_hdr.msg_iov    = &seq_iov[n];
+        seq_mm[n].msg_hdr.msg_iovlen = 1;
+        off += sizeof(l) + l;
+        n++;
+    }
+    int m = sendmmsg(fd, seq_mm, (unsigned)n, MSG_DONTWAIT | MSG_NOSIGNAL);
+    int rc = 0;
+    if (m < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) rc = -1;
+    } else if (m > 0) {
+        /* Keep the records not sent. */
+        size_t sent = (size_t)((char *)seq_iov[m - 1].iov_base + seq_iov[m - 1].iov_len - buf);
+        outq_clear(q);
+        if (outq_append(q, buf + sent, len - sent) < 0) rc = -1;
+    }
+    free(buf);
+    return rc < 0 ? -1 : outq_bytes(q) > 0;
+}
+
+/*
+ * on_readable() for SOCK_SEQPACKET connections.  A message is a whole
+ * request and its echo one message back, so there is nothing to frame,
+ * and nothing is gathered: one sendmsg() would merge the answers into a
+ * single message.  Up to SEQ_BATCH messages come in per recvmmsg() and go
+ * back out with one sendmmsg(), so a client with many in flight still
+ * costs two calls per batch rather than two per message.
+ */
+static int on_readable_msg(int fd)
+{
+    struct conn *c = &conns[fd];
+    size_t took = 0;
+    while (!c->paused && !c->closing) {
+        for (int i = 0; i < SEQ_BATCH; i++) {
+            seq_iov[i].iov_base = seqbuf[i];
+            seq_iov[i].iov_len  = SEQ_MAX;
+            memset(&seq_mm[i], 0, sizeof(seq_mm[i]));
+            seq_mm[i].msg_hdr.msg_iov    = &seq_iov[i];
+            seq_mm[i].msg_hdr.msg_iovlen = 1;
+        }
+        int r = recvmmsg(fd, seq_mm, SEQ_BATCH, MSG_DONTWAIT, NULL);
+        if (r < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                mx.c[M_RX_EAGAIN]++;
+                conn_idle(fd);
+                break;
+            }
+            perror("recv");
+            return -1;
+        }
+        int n = 0, eof = 0;
+        for (; n < r && !c->closing; n++) {
+            size_t len = seq_mm[n].msg_len;
+            if (len == 0) {                      /* EOF, or an empty message */
+                eof = 1;
+                break;
+            }
+            if (seq_mm[n].msg_hdr.msg_flags & MSG_TRUNC) {
+                LOG_WARN("[server] message too large (fd=%d)\n", fd);
+                return -1;
+            }
+            mx.c[M_BYTES_IN] += len;
+            mx.recv_hist[metrics_bucket(len)]++;
+            mx.c[M_MSGS]++;
+            took += len;
+            LOG_DEBUG("[server] message (fd=%d): %zu bytes\n", fd, len);
+            if (len >= 3 && memcmp(seqbuf[n], "bye", 3) == 0) c->closing = 1;
+            seq_iov[n].iov_len = len;
+            mx.c[M_BYTES_OUT] += len;
+        }
+        if (n > 0) {
+            conn_active(fd);
+            int w = send_msgs(fd, n);
+            if (w < 0) {
+                perror("send");
+                return -1;
+            }
+            if (w > 0) {
+                mx.c[M_TX_EAGAIN]++;
+                c->paused = 1;
+            }
+        }
+        if (eof) return -1;
+        if (r < SEQ_BATCH) break;                /* recvmmsg() stopped at EAGAIN */
+        if (took >= RX_BUDGET) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Read and echo until EAGAIN, "bye", backpressure or RX_BUDGET bytes.
+ * Returns -1 to close, 1 if the budget ran out with data maybe left.
+ */
+static int on_readable(int fd)
+{
+    struct conn *c = &conns[fd];
+    if (c->proto == PROTO_BIN) return on_readable_bin(fd);
+    if (c->proto == PROTO_MSG) return on_readable_msg(fd);
+    size_t took = 0;
+    while (!c->paused && !c->closing && !jobs_full(fd)) {
+        char stack_buf[BUF], *buf;
+        size_t cap;
+        struct zc_buf *zb = NULL;
+        if (!zc_threshold) {
+            buf = recv_space(stack_buf, &cap);
+        } else {
+            if (!(zb = zc_rbuf(fd))) {
+                perror("zero-copy buffer");
+                return -1;
+            }
+            buf = zb->data;
+            cap = zc_buf_cap(&zpool);
+        }
+        ssize_t r = conn_recv(fd, buf, cap);
+        if (r < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                mx.c[M_RX_EAGAIN]++;
+                conn_idle(fd);
+                break;
+            }
+            perror("recv");
+            return -1;
+        }
+        if (r == 0) {
+            /* Requests still on the pool get their answers first. */
+            if (!npool || !jconns[fd].head) return -1;
+            c->closing = 1;
+            break;
+        }
+        mx.c[M_BYTES_IN] += (uint64_t)r;
+        mx.recv_hist[metrics_bucket((uint64_t)r)]++;
+        if (zb) zb->len = (unsigned)r;
+        else if (buf != stack_buf) gather_commit(&gat, (size_t)r);
+
+        if (echo_lines(fd, buf, (size_t)r) < 0) return -1;
+        if (outq_bytes(&c->out) > OUTQ_HIGH_WATER) c->paused = 1;
+        if ((took += (size_t)r) >= RX_BUDGET) return 1;
+    }
+    return 0;
+}
+
+/* Flush queued output.  Returns -1 to close. */
+static int on_writable(int fd)
+{
+    struct conn *c = &conns[fd];
+    size_t before = outq_bytes(&c->out);
+    if ((c->proto == PROTO_MSG ? flush_msgs(fd) : outq_flush(&c->out, fd)) < 0) {
+        perror("send");
+        return -1;
+    }
+    /* Progress, but not done: the peer gets another stall period. */
+    if (outq_bytes(&c->out) > 0 && outq_bytes(&c->out) < before) conn_timer(fd, TMO_STALL);
+    if (c->paused && outq_bytes(&c->out) < (c->proto == PROTO_MSG ? 1 : OUTQ_LOW_WATER))
+        c->paused = 0;
+    return 0;
+}
+
+/*
+ * End of a round: send each connection its gathered answers in one
+ * sendmsg(), then settle it — close it if it said bye and everything is
+ * out, stop reading it if its queue is over high water.  Returns the
+ * number of connections closed.
+ */
+static int flush_round(int epfd)
+{
+    int closed = 0;
+    for (int k = 0; k < gat.ntouched; k++) {
+        int fd = gat.touched[k];
+        struct conn *c = &conns[fd];
+        if (!c->open || gather_q_empty(&gqs[fd])) continue;   /* closed, or seen */
+
+        int r = conn_flush(fd);
+        if (r < 0) perror("send");
+        if (r > 0) mx.c[M_TX_EAGAIN]++;
+        if (r < 0 || conn_done(fd)) {
+            close_conn(epfd, fd);
+            closed++;
+            continue;
+        }
+        if (outq_bytes(&c->out) > OUTQ_HIGH_WATER) c->paused = 1;
+        update_events(epfd, fd);
+    }
+    gather_reset(&gat);
+    return closed;
+}
 
-int main(void)
+static int open_listener(int port)
 {
-    int sfd = socket(AF_INET, SOCK_STREAM, 0);
+    int sfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (sfd < 0) die("socket");
 
     int opt = 1;
     setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    set_nonblocking(sfd);
+    /* The kernel completes the handshake but holds the connection back
+     * until data arrives (or, after about defer_secs, hands it over anyway). */
+    if (defer_secs > 0 &&
+        setsockopt(sfd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &defer_secs, sizeof(defer_secs)) < 0)
+        perror("setsockopt TCP_DEFER_ACCEPT");
 
     struct sockaddr_in addr = {0};
     addr.sin_family      = AF_INET;
     addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port        = htons(PORT);
+    addr.sin_port        = htons((uint16_t)port);
 
     if (bind(sfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) die("bind");
-    if (listen(sfd, BACKLOG) < 0) die("listen");
-    printf("[server] listening on port %d\n", PORT);
+    if (listen(sfd, backlog) < 0) die("listen");
+    return sfd;
+}
+
+/* Fresh state for a connection on fd speaking the given protocol. */
+static struct conn *conn_init(int fd, int proto)
+{
+    struct conn *c = conn_get(fd);
+    memset(c, 0, sizeof(*c));
+    c->proto = (unsigned char)proto;
+    if (proto == PROTO_BIN)       bin_rx_init(&c->bin);
+    else if (proto == PROTO_LINE) framer_init(&c->in);
+    outq_init_pool(&c->out, &pool);
+    gather_q_init(&gqs[fd]);
+    if (npool) memset(&jconns[fd], 0, sizeof(jconns[fd]));
+    if (stamps) {
+        memset(&tsconns[fd], 0, sizeof(tsconns[fd]));
+        /* Unix sockets take the option but stamp nothing. */
+        if (proto != PROTO_MSG && ts_enable(fd) < 0) perror("setsockopt SO_TIMESTAMPING");
+    }
+    if (zc_threshold) {
+        zc_tx_init(&zconns[fd].tx);
+        zconns[fd].rbuf = NULL;
+        if (zc_enable(fd) < 0) zconns[fd].tx.off = 1;
+    }
+    c->open = 1;
+    return c;
+}
+
+/*
+ * Accept up to ACCEPT_BUDGET pending connections on listener l, which
+ * decides the protocol.  The listener is edge-triggered, so if the budget
+ * runs out before the queue does, accept_more[] says to come back next
+ * round.  Returns the number accepted.
+ */
+static int accept_some(int epfd, int l)
+{
+    int accepted = 0;
+    accept_more[l] = 0;
+    while (accepted < ACCEPT_BUDGET) {
+        struct sockaddr_in ca;
+        socklen_t cl = sizeof(ca);
+        int cfd = accept4(lfds[l], l < L_UNIX ? (struct sockaddr *)&ca : NULL,
+                          l < L_UNIX ? &cl : NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (cfd < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return accepted;
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept4");
+            return accepted;
+        }
+        static const char *const via[NLISTEN] = { "", " (binary)", " (unix)", " (seqpacket)" };
+        LOG_DEBUG("[server] client connected: %s%s\n",
+                  l < L_UNIX ? inet_ntoa(ca.sin_addr) : "local", via[l]);
+
+        struct conn *c = conn_init(cfd, l_proto[l]);
+        c->events = EPOLLIN | EPOLLET;
+        conn_timer(cfd, TMO_FIRST);
+        mx.c[M_ACCEPTS]++;
+
+        struct epoll_event ev;
+        ev.events  = c->events;
+        ev.data.fd = cfd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &ev);
+        accepted++;
+    }
+    accept_more[l] = 1;
+    return accepted;
+}
+
+/*
+ * Hot restart, old side: send fd to the successor with everything this
+ * process holds for it.  Answers gathered but not sent go out first.
+ * Returns 0, -1 if the connection itself failed, -2 if the handoff did.
+ */
+static int send_conn(int hs, int fd)
+{
+    struct conn *c = &conns[fd];
+    if (!gather_q_empty(&gqs[fd]) && gather_flush(&gat, &gqs[fd], fd, &c->out) < 0) return -1;
+
+    const char *in;
+    size_t in_len;
+    if (c->proto == PROTO_BIN) {
+        in_len = bin_rx_pending(&c->bin, &in);
+    } else if (c->proto == PROTO_LINE) {
+        in     = c->in.carry + c->in.carry_done;
+        in_len = framer_pending(&c->in);
+    } else {
+        in     = NULL;                           /* messages arrive whole */
+        in_len = 0;
+    }
+    struct xfer x;
+    memset(&x, 0, sizeof(x));
+    x.type     = XFER_CONN;
+    x.version  = XFER_VERSION;
+    x.proto    = c->proto;
+    x.paused   = c->paused;
+    x.closing  = c->closing;
+    x.tmo_kind = XFER_NO_TMO;
+    if (tw_armed(&wheel, fd)) {
+        uint64_t due = tw_expires(&wheel, fd);
+        x.tmo_kind = (uint8_t)tw_tag(&wheel, fd);
+        x.tmo_left = due > now_ms ? (uint32_t)(due - now_ms) : 0;
+    }
+    x.in_len  = (uint32_t)in_len;
+    x.out_len = (uint32_t)outq_bytes(&c->out);
+    if (zc_threshold) {
+        const struct zc_tx *z = &zconns[fd].tx;
+        x.zc_next = z->next;
+        x.zc_off  = z->off;
+        for (unsigned i = 0; i < ZC_INFLIGHT; i++)
+            if (z->pinned[i]) x.zc_pinned |= 1u << i;
+    }
+
+    size_t len = sizeof(x) + in_len + x.out_len;
+    char *buf = malloc(len);
+    if (!buf) return -1;
+    memcpy(buf, &x, sizeof(x));
+    if (in_len) memcpy(buf + sizeof(x), in, in_len);
+    outq_copy(&c->out, buf + sizeof(x) + in_len);
+    int r = handoff_send(hs, &fd, 1, buf, len);
+    free(buf);
+    return r < 0 ? -2 : 0;
+}
+
+/*
+ * Hot restart, old side: hand the listeners and every connection to the
+ * successor on hs, closing them here.  A connection that cannot be sent
+ * stays, and this process keeps serving it without listeners.  Returns the
+ * number of connections gone, or -1 if the successor was refused and
+ * nothing changed.
+ */
+static int hand_over(int epfd, int hs)
+{
+    struct xfer x;
+    if (recv(hs, &x, sizeof(x), 0) != (ssize_t)sizeof(x) ||
+        x.type != XFER_HELLO || x.version != XFER_VERSION) {
+        LOG_WARN("[server] hot restart: successor speaks another version, refused\n");
+        return -1;
+    }
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int fds[NLISTEN], nfds = 0;
+    memset(&x, 0, sizeof(x));
+    x.type    = XFER_LISTENERS;
+    x.version = XFER_VERSION;
+    for (int i = 0; i < NLISTEN; i++) {
+        if (lfds[i] < 0) continue;
+        x.listeners |= 1u << i;
+        fds[nfds++]  = lfds[i];
+    }
+    if (handoff_send(hs, fds, nfds, &x, sizeof(x)) < 0) {
+        perror("hot restart: send listeners");
+        return -1;
+    }
+    for (int i = 0; i < NLISTEN; i++) {
+        if (lfds[i] < 0) continue;
+        epoll_ctl(epfd, EPOLL_CTL_DEL, lfds[i], NULL);
+        close(lfds[i]);
+        lfds[i]        = -1;
+        lpath[i]       = NULL;               /* the path is the successor's now */
+        accept_more[i] = 0;
+    }
+
+    int gone = 0, moved = 0, failed = 0;
+    for (int fd = 0; fd < nconns && !failed; fd++) {
+        if (!conns[fd].open) continue;
+        int r = send_conn(hs, fd);
+        if (r == 0) {
+            conn_free(epfd, fd);
+            moved++;
+        } else if (r == -2) {
+            perror("hot restart: send connection");
+            failed = 1;
+            continue;
+        } else {
+            close_conn(epfd, fd);                /* its socket failed */
+        }
+        gone++;
+    }
+    char ack;
+    x.type = XFER_END;
+    if (failed || handoff_send(hs, NULL, 0, &x, sizeof(x)) < 0 || recv(hs, &ack, 1, 0) != 1)
+        LOG_WARN("[server] hot restart: successor did not confirm\n");
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    LOG_INFO("[server] hot restart: %d connection(s) handed over in %.2f ms\n", moved,
+             (double)(t1.tv_sec - t0.tv_sec) * 1e3 + (double)(t1.tv_nsec - t0.tv_nsec) / 1e6);
+    return gone;
+}
+
+/* Hot restart, new side: set up a connection received from the old process. */
+static int adopt_conn(int epfd, int fd, const struct xfer *x, const char *data)
+{
+    struct conn *c = conn_init(fd, x->proto);
+    c->paused  = x->paused;
+    c->closing = x->closing;
+    if (x->in_len) {
+        size_t used;
+        int n;
+        if (c->proto == PROTO_BIN) {
+            struct bin_frame f[1];
+            n = bin_feed(&c->bin, data, x->in_len, f, 1, &used);
+        } else if (c->proto == PROTO_MSG) {
+            n = -1;                              /* messages arrive whole */
+        } else {
+            struct frame_line l[1];
+            n = framer_feed(&c->in, data, x->in_len, l, 1, &used);
+        }
+        if (n != 0) return -1;                   /* was not unfinished */
+    }
+    if (outq_append(&c->out, data + x->in_len, x->out_len) < 0) return -1;
+    if (x->tmo_kind != XFER_NO_TMO)
+        tw_arm(&wheel, fd, now_ms + x->tmo_left, x->tmo_kind);
+    if (zc_threshold) {
+        /* Completions still due name sends the old process made. */
+        struct zc_tx *z = &zconns[fd].tx;
+        z->next = x->zc_next;
+        z->off |= x->zc_off;
+        for (unsigned i = 0; i < ZC_INFLIGHT; i++) {
+            if (!(x->zc_pinned & (1u << i)) || !(z->pinned[i] = zc_buf_get(&zpool))) continue;
+            z->inflight++;
+        }
+    }
+    /* Counted as accepted, so accepts - closes stays the number open. */
+    mx.c[M_ACCEPTS]++;
+
+    struct epoll_event ev;
+    ev.events  = c->events = conn_interest(fd);
+    ev.data.fd = fd;
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+/*
+ * Hot restart, new side: take the listeners and every connection from the
+ * running server.  Returns the number of connections adopted.
+ */
+static int take_over(int epfd)
+{
+    int hs = handoff_connect(CTL_NAME);
+    if (hs < 0) die("hot restart: no running server to take over from");
+    struct xfer x;
+    memset(&x, 0, sizeof(x));
+    x.type    = XFER_HELLO;
+    x.version = XFER_VERSION;
+    if (send(hs, &x, sizeof(x), MSG_NOSIGNAL) < 0) die("hot restart: send");
+
+    int adopted = 0;
+    for (;;) {
+        int    fds[HANDOFF_MAXFD], nfds;
+        size_t len;
+        struct xfer *r = handoff_recv(hs, fds, HANDOFF_MAXFD, &nfds, &len);
+        if (!r) die("hot restart: receive");
+        int ok = len >= sizeof(*r) && r->version == XFER_VERSION;
+        if (ok && r->type == XFER_END) {
+            free(r);
+            break;
+        }
+        if (ok && r->type == XFER_LISTENERS && nfds == __builtin_popcount(r->listeners) &&
+            (r->listeners & 3) == 3 && r->listeners < 1u << NLISTEN) {
+            for (int i = 0, k = 0; i < NLISTEN; i++) {
+                if (!(r->listeners & (1u << i))) continue;
+                lfds[i] = fds[k++];
+                /* Ours to unlink at exit now; the name comes with the socket. */
+                if (i >= L_UNIX && unix_path(lfds[i], lpath_buf[i], sizeof(lpath_buf[i])) == 0)
+                    lpath[i] = lpath_buf[i];
+            }
+        } else if (ok && r->type == XFER_CONN && nfds == 1 &&
+                   len == sizeof(*r) + r->in_len + r->out_len) {
+            if (adopt_conn(epfd, fds[0], r, (const char *)(r + 1)) == 0) {
+                adopted++;
+            } else {
+                LOG_WARN("[server] hot restart: could not adopt fd %d\n", fds[0]);
+                conn_free(epfd, fds[0]);
+            }
+        } else {
+            fprintf(stderr, "hot restart: unexpected record\n");
+            exit(EXIT_FAILURE);
+        }
+        free(r);
+    }
+    char ack = 1;
+    if (send(hs, &ack, 1, MSG_NOSIGNAL) < 0) perror("hot restart: send ack");
+    close(hs);
+    LOG_INFO("[server] hot restart: took over %d connection(s)\n", adopted);
+    return adopted;
+}
+
+/*
+ * -b: the plain line echo, on libsockloop with the given backend instead of
+ * the loop in main(): the line port and -u, with -l, -D and the -i idle
+ * deadline.  It is the echo 02 and 06 serve (linux/sockloop/sl_echo.h).
+ */
+static int serve_sockloop(int backend, const char *upath)
+{
+    int lfds[2] = { open_listener(PORT), -1 }, n = 1;
+    LOG_INFO("[server] listening on port %d (libsockloop, %s backend)\n",
+             PORT, sl_backend_name(backend));
+    if (upath) {
+        if ((lfds[n++] = unix_listen(upath, SOCK_STREAM, backlog)) < 0) die(upath);
+        LOG_INFO("[server] unix stream socket %s\n", upath);
+    }
+
+    int rc = sl_echo_serve(backend, lfds, n, tmo_ms[TMO_IDLE]);
+    if (rc < 0) perror(sl_backend_name(backend));
+
+    for (int i = 0; i < n; i++) close(lfds[i]);
+    if (upath) unix_unlink(upath);
+    LOG_INFO("[server] done.\n");
+    log_shutdown();
+    return rc < 0 ? EXIT_FAILURE : 0;
+}
+
+int main(int argc, char **argv)
+{
+    log_init();
+
+    int opt, restart = 0, sockloop = -1, deadlines = 0;
+    const char *upath = NULL, *qpath = NULL;
+    while ((opt = getopt(argc, argv, "z:d:a:i:w:l:D:u:q:B:W:TRb:")) != -1) {
+        switch (opt) {
+        case 'z': zc_threshold        = (size_t)strtoul(optarg, NULL, 10); break;
+        case 'd': flush_us            = strtol(optarg, NULL, 10);          break;
+        case 'a': tmo_ms[TMO_FIRST]   = strtol(optarg, NULL, 10); deadlines = 1; break;
+        case 'i': tmo_ms[TMO_IDLE]    = strtol(optarg, NULL, 10);          break;
+        case 'w': tmo_ms[TMO_STALL]   = strtol(optarg, NULL, 10); deadlines = 1; break;
+        case 'l': backlog             = atoi(optarg);                      break;
+        case 'D': defer_secs          = atoi(optarg);                      break;
+        case 'u': upath               = optarg;                            break;
+        case 'q': qpath               = optarg;                            break;
+        case 'B': busy_us             = strtol(optarg, NULL, 10);          break;
+        case 'W': npool               = atoi(optarg);                      break;
+        case 'T': stamps              = 1;                                 break;
+        case 'R': restart             = 1;                                 break;
+        case 'b':
+            if ((sockloop = sl_backend_parse(optarg)) >= 0) break;
+            /* fall through */
+        default:
+            fprintf(stderr, "usage: %s [-z zerocopy_threshold_bytes] [-d flush_delay_usec]\n"
+                            "          [-a first_request_ms] [-i idle_ms] [-w write_stall_ms]\n"
+                            "          [-l backlog] [-D defer_accept_secs]\n"
+                            "          [-u unix_path] [-q seqpacket_path] [-B busy_poll_usec]\n"
+                            "          [-W pool_workers] [-T] [-R]\n"
+                            "          [-b select|poll|epoll|epoll-et|uring]\n"
+                            "  -b: the plain line echo on libsockloop, with only the -i deadline\n"
+                            "      (no -a first-request or -w write-stall one) and no binary port\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    /* These work below libsockloop's API, in the loop here. */
+    if (sockloop >= 0 && (zc_threshold || flush_us || qpath || busy_us || npool || stamps ||
+                          restart || deadlines)) {
+        fprintf(stderr, "%s: -b serves the plain line echo; -z -d -q -B -W -T -R -a -w need the "
+                        "epoll loop\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* An idle connection costs ~100 bytes here; the fd limit is what runs out. */
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    if (sockloop >= 0) return serve_sockloop(sockloop, upath);
+
+    /* With -R the listeners come from the running server, below. */
+    if (!restart) {
+        lfds[L_TCP] = open_listener(PORT);
+        lfds[L_BIN] = open_listener(PORT_BIN);
+    }
+
+    struct metrics_shm *shm = metrics_create("linux03_server", 1);
+    if (!shm) perror("metrics_create (running without sockstat)");
+    else      LOG_INFO("[server] metrics: sockstat %d\n", (int)getpid());
+
+    now_ms = clock_ms();
+    tw_init(&wheel, now_ms);
+    bufpool_init(&pool, OUTQ_CHUNK);
+    if (gather_init(&gat, ARENA, GATHER_MAX) < 0) die("gather_init");
+    if (zc_threshold) {
+        bufpool_init(&zpool, ZC_BUF);
+        LOG_INFO("[server] zero-copy sends from %zu bytes\n", zc_threshold);
+    }
+
+    if (stamps) {
+        for (int s = 0; s < M_NSTAGES; s++) hdr_init(&stage_hdr[s]);
+        LOG_INFO("[server] kernel timestamps on: request stages in sockstat -S%s\n",
+                 zc_threshold ? ", no tx stage with -z" : "");
+    }
 
     int epfd = epoll_create1(EPOLL_CLOEXEC);
     if (epfd < 0) die("epoll_create1");
-
     struct epoll_event ev;
-    ev.events  = EPOLLIN | EPOLLET;
-    ev.data.fd = sfd;
-    if (epoll_ctl(epfd, EPOLL_CTL_ADD, sfd, &ev) < 0) die("epoll_ctl add sfd");
+    if (npool > 0) {
+        if (wsp_init(&wpool, npool) < 0) die("wsp_init");
+        ev.events  = EPOLLIN;
+        ev.data.fd = wpool.efd;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, wpool.efd, &ev) < 0) die("epoll_ctl add pool");
+        LOG_INFO("[server] line requests handled on %d worker thread(s)\n", npool);
+    }
+
+    int nclients = restart ? take_over(epfd) : 0;
+    /* Unix sockets the running server did not have are opened here. */
+    const char *want[NLISTEN] = { NULL, NULL, upath, qpath };
+    for (int l = L_UNIX; l < NLISTEN; l++) {
+        if (lfds[l] >= 0 || !want[l]) continue;
+        lfds[l] = unix_listen(want[l], l == L_SEQ ? SOCK_SEQPACKET : SOCK_STREAM, backlog);
+        if (lfds[l] < 0) die(want[l]);
+        lpath[l] = want[l];
+    }
+    LOG_INFO("[server] listening on port %d\n", PORT);
+    LOG_INFO("[server] binary protocol on port %d\n", PORT_BIN);
+    if (lpath[L_UNIX]) LOG_INFO("[server] unix stream socket %s\n", lpath[L_UNIX]);
+    if (lpath[L_SEQ])  LOG_INFO("[server] unix seqpacket socket %s\n", lpath[L_SEQ]);
+
+    ev.events = EPOLLIN | EPOLLET;
+    for (int l = 0; l < NLISTEN; l++) {
+        if (lfds[l] < 0) continue;
+        ev.data.fd = lfds[l];
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, lfds[l], &ev) < 0) die("epoll_ctl add listener");
+    }
+    if (busy_us > 0) {
+        bp_init(&bp, (uint64_t)busy_us * 1000);
+        /* Only helps where a NIC queue is behind the sockets: not on loopback. */
+        if (bp_kernel_epoll(epfd, (unsigned)busy_us) < 0)
+            LOG_INFO("[server] kernel busy polling for epoll unavailable: %s\n", strerror(errno));
+        for (int l = L_TCP; l <= L_BIN; l++)
+            if (lfds[l] >= 0 && bp_kernel_sock(lfds[l], (int)busy_us) < 0)
+                LOG_INFO("[server] SO_BUSY_POLL on port %d: %s\n",
+                         l == L_TCP ? PORT : PORT_BIN, strerror(errno));
+        LOG_INFO("[server] busy poll: spin up to %ld us before blocking\n", busy_us);
+    }
+    if (flush_us > 0) {
+        tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (tfd < 0) die("timerfd_create");
+        ev.events  = EPOLLIN;
+        ev.data.fd = tfd;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev) < 0) die("epoll_ctl add tfd");
+        LOG_INFO("[server] answers held up to %ld us\n", flush_us);
+    }
+    /* Where a successor started with -R finds this process. */
+    int hfd = handoff_listen(CTL_NAME), hs = -1;
+    if (hfd < 0) {
+        perror("handoff_listen (hot restart off)");
+    } else {
+        ev.events  = EPOLLIN | EPOLLET;
+        ev.data.fd = hfd;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, hfd, &ev) < 0) die("epoll_ctl add hfd");
+    }
 
     struct epoll_event events[MAX_EVENTS];
-    int nclients = 0;
 
     for (;;) {
-        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        int more = 0;
+        for (int l = 0; l < NLISTEN; l++) more |= accept_more[l];
+        int timeout = more ? 0 : (int)tw_next(&wheel);
+        if (stamps) wait_ns = ts_now();
+        int n = busy_us > 0 ? bp_wait(&bp, epfd, events, MAX_EVENTS, timeout)
+                            : epoll_wait(epfd, events, MAX_EVENTS, timeout);
         if (n < 0) { perror("epoll_wait"); break; }
+        if (stamps) woke_ns = ts_now();
+        now_ms = clock_ms();
+        mx.c[M_LOOPS]++;
+        mx.c[M_EVENTS] += (uint64_t)n;
+        mx.events_hist[metrics_bucket((uint64_t)n)]++;
 
         for (int i = 0; i < n; i++) {
             int fd = events[i].data.fd;
+            int l  = 0;
+            while (l < NLISTEN && fd != lfds[l]) l++;
 
-            if (fd == sfd) {
-                /* Accept all pending connections (ET: must drain accept queue) */
-                for (;;) {
-                    struct sockaddr_in ca;
-                    socklen_t cl = sizeof(ca);
-                    int cfd = accept(sfd, (struct sockaddr *)&ca, &cl);
-                    if (cfd < 0) {
-                        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
-                        perror("accept");
-                        break;
-                    }
-                    set_nonblocking(cfd);
-                    printf("[server] client connected: %s\n", inet_ntoa(ca.sin_addr));
-                    ev.events  = EPOLLIN | EPOLLET;
-                    ev.data.fd = cfd;
-                    epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &ev);
-                    nclients++;
-                }
+            if (l < NLISTEN) {
+                accept_more[l] = 1;              /* after the connections, below */
+            } else if (fd == hfd) {
+                if (hs < 0 && (hs = handoff_accept(hfd)) < 0 && errno != EAGAIN)
+                    perror("handoff_accept");
+            } else if (fd == tfd) {
+                uint64_t expirations;
+                if (read(tfd, &expirations, sizeof(expirations)) < 0) perror("read timerfd");
+                timer_armed = 0;
+                int closed = flush_round(epfd);
+                if (closed && (nclients -= closed) == 0) goto done;
+            } else if (npool > 0 && fd == wpool.efd) {
+                int closed = on_pool_done(epfd);
+                if (closed && (nclients -= closed) == 0) goto done;
             } else {
-                /* Read all available data (ET: must drain until EAGAIN) */
-                int close_fd = 0;
-                for (;;) {
-                    char buf[BUF];
-                    ssize_t r = recv(fd, buf, sizeof(buf) - 1, 0);
-                    if (r < 0) {
-                        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
-                        perror("recv");
-                        close_fd = 1;
-                        break;
-                    }
-                    if (r == 0) { close_fd = 1; break; }
-
-                    buf[r] = '\0';
-                    printf("[server] recv (fd=%d): %s", fd, buf);
-                    write_all(fd, buf, (size_t)r);
-
-                    if (strncmp(buf, "bye", 3) == 0) { close_fd = 1; break; }
+                struct conn *c = &conns[fd];
+                if (!c->open) continue;
+
+                int close_fd = 0, again = 0;
+                unsigned rd = EPOLLIN | EPOLLERR | EPOLLHUP;
+                if (zc_threshold && (events[i].events & EPOLLERR)) {
+                    close_fd = on_zc_complete(fd) < 0;
+                } else if (stamps && (events[i].events & EPOLLERR)) {
+                    int got  = on_tx_stamp(fd);
+                    close_fd = got < 0;
+                    if (got > 0) rd &= ~(unsigned)EPOLLERR;    /* it was only the stamp */
                 }
+                if (!close_fd && (events[i].events & EPOLLOUT))
+                    close_fd = on_writable(fd) < 0;
+                if (!close_fd && (events[i].events & rd)) {
+                    again    = on_readable(fd);
+                    close_fd = again < 0;
+                }
+                if (!close_fd && conn_done(fd)) close_fd = 1;
+
                 if (close_fd) {
-                    printf("[server] client disconnected (fd=%d)\n", fd);
-                    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
-                    close(fd);
+                    close_conn(epfd, fd);
                     if (--nclients == 0) goto done;
+                } else {
+                    update_events(epfd, fd);
+                    if (again > 0) conn_requeue(epfd, fd);
                 }
             }
         }
+        for (int l = 0; l < NLISTEN; l++)
+            if (accept_more[l]) nclients += accept_some(epfd, l);
+        if (!flush_us) {
+            int closed = flush_round(epfd);
+            if (closed && (nclients -= closed) == 0) goto done;
+        }
+
+        tw_advance(&wheel, now_ms);
+        for (int fd; (fd = tw_expired(&wheel)) >= 0; ) {
+            LOG_INFO("[server] %s timeout (fd=%d)\n", tmo_name[tw_tag(&wheel, fd)], fd);
+            close_conn(epfd, fd);
+            ntimeouts++;
+            mx.c[M_TIMEOUTS]++;
+            if (--nclients == 0) goto done;
+        }
+
+        /* A successor is waiting: hand everything over, between rounds. */
+        if (hs >= 0) {
+            if (npool > 0) {
+                int closed = drain_jobs(epfd);
+                closed += flush_round(epfd);
+                if (closed && (nclients -= closed) == 0) goto done;
+            }
+            struct timeval tv = { 5, 0 };
+            setsockopt(hs, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            epoll_ctl(epfd, EPOLL_CTL_DEL, hfd, NULL);
+            close(hfd);                          /* the successor listens next */
+            hfd = -1;
+            int gone = hand_over(epfd, hs);
+            close(hs);
+            hs = -1;
+            if (gone < 0) {
+                if ((hfd = handoff_listen(CTL_NAME)) >= 0) {
+                    ev.events  = EPOLLIN | EPOLLET;
+                    ev.data.fd = hfd;
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, hfd, &ev);
+                }
+            } else if ((nclients -= gone) == 0) {
+                goto done;
+            }
+        }
+        if (shm) metrics_publish(&shm->slot[0], &mx);
     }
 
 done:
     close(epfd);
-    close(sfd);
-    printf("[server] done.\n");
+    for (int l = 0; l < NLISTEN; l++) {
+        if (lfds[l] < 0) continue;
+        close(lfds[l]);
+        unix_unlink(lpath[l]);
+    }
+    if (hfd >= 0) close(hfd);
+    if (tfd >= 0) close(tfd);
+    LOG_INFO("[server] %llu echo run(s) gathered into %llu sendmsg call(s)\n",
+             gat.added, gat.sends);
+    if (ntimeouts) LOG_INFO("[server] %llu connection(s) closed on a deadline\n", ntimeouts);
+    if (stamps) {
+        LOG_INFO("[server] request stages, us: %llu stamped read(s)\n",
+                 (unsigned long long)mx.c[M_STAMPED]);
+        for (int s = 0; s < M_NSTAGES; s++) {
+            const struct hdr_hist *h = &stage_hdr[s];
+            if (!h->total) continue;
+            LOG_INFO("[server]   %-8s %9llu  p50 %8.1f  p99 %8.1f  p99.9 %8.1f  max %8.1f\n",
+                     metrics_stages[s], (unsigned long long)h->total,
+                     (double)hdr_percentile(h, 50.0) / 1e3, (double)hdr_percentile(h, 99.0) / 1e3,
+                     (double)hdr_percentile(h, 99.9) / 1e3, (double)h->max / 1e3);
+        }
+        fdtab_free(tsconns, (size_t)nconns * sizeof(*tsconns));
+    }
+    if (busy_us > 0)
+        LOG_INFO("[server] busy poll: %llu wait(s) answered spinning, %llu spun out, "
+                 "%llu blocked at once, %.1f ms spinning\n",
+                 (unsigned long long)bp.hits, (unsigned long long)bp.misses,
+                 (unsigned long long)bp.blocks, (double)bp.spin_ns / 1e6);
+    if (npool > 0) {
+        uint64_t ran = 0, stolen = 0;
+        for (int i = 0; i < npool; i++) {
+            ran    += wpool.w[i].ran;
+            stolen += wpool.w[i].stolen;
+        }
+        LOG_INFO("[server] worker pool: %llu request(s) handled, %llu stolen\n",
+                 (unsigned long long)ran, (unsigned long long)stolen);
+        wsp_destroy(&wpool);
+        for (struct ws_task *t = wsp_reap(&wpool), *next; t; t = next) {
+            next = t->next;
+            job_put((struct job *)t);
+        }
+        for (struct job *j = job_free, *next; j; j = next) {
+            next = j->next;
+            free(j);
+        }
+        fdtab_free(jconns, (size_t)nconns * sizeof(*jconns));
+    }
+    gather_destroy(&gat);
+    tw_destroy(&wheel);
+    metrics_destroy(shm);
+    fdtab_free(conns, (size_t)nconns * sizeof(*conns));
+    fdtab_free(gqs, (size_t)nconns * sizeof(*gqs));
+    LOG_INFO("[server] buffer pool: %zu slab(s), %zu on hugetlb pages\n",
+           pool.nslabs, pool.nhuge);
+    bufpool_destroy(&pool);
+    if (zc_threshold) {
+        LOG_INFO("[server] zero-copy: %llu send(s), %llu bytes, %llu copied by the kernel\n",
+                 (unsigned long long)zc_sends, (unsigned long long)zc_bytes,
+                 (unsigned long long)zc_copied);
+        fdtab_free(zconns, (size_t)nconns * sizeof(*zconns));
+        bufpool_destroy(&zpool);
+    }
+    LOG_INFO("[server] done.\n");
+    log_shutdown();
     return 0;
 }
-
@@ -0,0 +1,426 @@
+/*
+ * linux/04_io_uring/server.c
+ *
+ * io_uring TCP echo server (completion-based, no readiness polling).
+ *
+ * Model: one multishot accept and one multishot recv per connection stay
+ *        armed for the connection's lifetime.  Received data lands in a
+ *        registered provided-buffer ring, is echoed straight out of that
+ *        buffer with a linked chain of sends, and the buffer goes back to
+ *        the ring when its send completes.  Every SQE produced while
+ *        handling one batch of completions is submitted by the single
+ *        io_uring_enter() that also waits for the next batch.  A per-
+ *        connection line framer tracks line boundaries across buffers so
+ *        the echo stops right after a "bye" line, wherever it falls.
+ *        -u PATH arms a second multishot accept on an AF_UNIX stream
+ *        socket for same-host clients; from there on its connections are
+ *        handled exactly like TCP ones.
+ *        Out of fds (EMFILE, ENFILE), a multishot accept ends; it is armed
+ *        again only once a connection's close completes, since re-arming
+ *        at once would just fail again in a loop.
+ *        Exits when the last client disconnects.
+ *
+ * Usage: linux04_server [-u unix_path]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../common/sock_helpers.h"
+#include "../common/log.h"
+#include "../common/uring_helpers.h"
+#include "../common/framing.h"
+#include "../common/unix_sock.h"
+
+#define PORT       9004
+#define BACKLOG    4
+#define QD         512     /* SQ entries */
+#define NBUFS      256     /* provided buffers, power of two */
+#define BUFSZ      2048
+#define BGID       0
+#define MAX_CHAIN  64      /* sends linked into one chain */
+#define MAX_LINES  64
+
+enum { OP_ACCEPT = 1, OP_RECV, OP_SEND, OP_CANCEL, OP_CLOSE };
+
+/* user_data layout: op (8 bits) | buffer id (16 bits) | fd (32 bits) */
+#define UD(op, bid, fd) (((uint64_t)(op) << 56) | ((uint64_t)(bid) << 32) | (uint32_t)(fd))
+#define UD_OP(u)        ((int)((u) >> 56))
+#define UD_BID(u)       ((unsigned)(((u) >> 32) & 0xffff))
+#define UD_FD(u)        ((int)(uint32_t)(u))
+
+struct conn {
+    struct framer in;           /* line boundaries across recv buffers */
+    unsigned char open;
+    unsigned char recv_armed;   /* multishot recv still producing CQEs */
+    unsigned char starved;      /* recv stopped on ENOBUFS; re-arm later */
+    unsigned char closing;      /* "bye", EOF or error: close once idle */
+    unsigned char dirty;        /* on the flush list */
+    int           inflight;     /* sends in the current linked chain */
+    int           pend_head;    /* FIFO of buffer ids to send, -1 = empty */
+    int           pend_tail;
+};
+
+static struct uring         ring;
+static struct uring_bufring bufs;
+static struct conn         *conns;       /* fd-indexed */
+static int                  nconns;
+static int                  buf_next[NBUFS];
+static unsigned             buf_len[NBUFS];
+static int                 *dirty;       /* fds to flush after this batch */
+static int                  ndirty;
+static int                  starved_any;
+static int                  stalled[2];  /* listeners out of fds: re-armed on a close */
+static int                  nstalled;
+
+static struct io_uring_sqe *get_sqe(void)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+    if (!sqe) die("io_uring submit");
+    return sqe;
+}
+
+static struct conn *conn_get(int fd)
+{
+    if (fd >= nconns) {
+        int n = nconns ? nconns : 64;
+        while (n <= fd) n *= 2;
+        struct conn *p = realloc(conns, (size_t)n * sizeof(*p));
+        if (!p) die("realloc");
+        memset(p + nconns, 0, (size_t)(n - nconns) * sizeof(*p));
+        int *d = realloc(dirty, (size_t)n * sizeof(*d));
+        if (!d) die("realloc");
+        conns  = p;
+        dirty  = d;
+        nconns = n;
+    }
+    return &conns[fd];
+}
+
+static void arm_accept(int sfd)
+{
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode    = IORING_OP_ACCEPT;
+    sqe->fd        = sfd;
+    sqe->ioprio    = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = UD(OP_ACCEPT, 0, sfd);
+}
+
+static void arm_recv(int fd)
+{
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = fd;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BGID;
+    sqe->user_data = UD(OP_RECV, 0, fd);
+    conns[fd].recv_armed = 1;
+    conns[fd].starved    = 0;
+}
+
+static void mark_dirty(int fd)
+{
+    if (!conns[fd].dirty) {
+        conns[fd].dirty = 1;
+        dirty[ndirty++] = fd;
+    }
+}
+
+/* Stop reading; the fd is closed once the recv and all sends are done. */
+static void begin_close(int fd)
+{
+    struct conn *c = &conns[fd];
+    if (c->closing) return;
+    c->closing = 1;
+    if (c->recv_armed) {
+        struct io_uring_sqe *sqe = get_sqe();
+        sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+        sqe->addr      = UD(OP_RECV, 0, fd);
+        sqe->user_data = UD(OP_CANCEL, 0, fd);
+    }
+    mark_dirty(fd);
+}
+
+/* Returns 1 if that was the last client. */
+static int maybe_close(int fd, int *nclients)
+{
+    struct conn *c = &conns[fd];
+    if (!c->open || !c->closing || c->recv_armed || c->inflight || c->pend_head >= 0)
+        return 0;
+
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode    = IORING_OP_CLOSE;
+    sqe->fd        = fd;
+    sqe->user_data = UD(OP_CLOSE, 0, fd);
+    c->open = 0;
+    framer_free(&c->in);
+    LOG_DEBUG("[server] client disconnected (fd=%d)\n", fd);
+    return --*nclients == 0;
+}
+
+static void enqueue(struct conn *c, unsigned bid, unsigned len)
+{
+    buf_len[bid]  = len;
+    buf_next[bid] = -1;
+    if (c->pend_head < 0) c->pend_head = (int)bid;
+    else                  buf_next[c->pend_tail] = (int)bid;
+    c->pend_tail = (int)bid;
+}
+
+/*
+ * Send everything queued on fd as one IOSQE_IO_LINK chain.  Links keep the
+ * sends in order without a round trip per buffer; MSG_WAITALL makes each
+ * send complete fully or fail, which cancels the rest of the chain.
+ */
+static void flush_conn(int fd)
+{
+    struct conn *c = &conns[fd];
+    if (!c->open || c->inflight || c->pend_head < 0) return;
+
+    /* A chain must not straddle two submissions, so make room up front. */
+    if (uring_sq_space(&ring) < MAX_CHAIN + 2 && uring_submit_and_wait(&ring, 0) < 0)
+        die("io_uring_enter");
+
+    struct io_uring_sqe *sqe = NULL;
+    while (c->pend_head >= 0 && c->inflight < MAX_CHAIN) {
+        unsigned bid = (unsigned)c->pend_head;
+        c->pend_head = buf_next[bid];
+        if (sqe) sqe->flags |= IOSQE_IO_LINK;
+        sqe = get_sqe();
+        sqe->opcode    = IORING_OP_SEND;
+        sqe->fd        = fd;
+        sqe->addr      = (unsigned long)uring_bufring_addr(&bufs, bid);
+        sqe->len       = buf_len[bid];
+        sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+        sqe->user_data = UD(OP_SEND, bid, fd);
+        c->inflight++;
+    }
+}
+
+/*
+ * How much of p[0..len) to echo: all of it, or up to the end of the first
+ * "bye" line (*bye set).  Bytes are echoed as they arrive, but a line
+ * only counts as "bye" once it is complete.  Returns -1 on an over-long
+ * line.
+ */
+static long echo_len(struct conn *c, const char *p, size_t len, int *bye)
+{
+    struct frame_line lines[MAX_LINES];
+    size_t off = 0;
+
+    while (off < len) {
+        size_t held = framer_pending(&c->in), used;
+        int n = framer_feed(&c->in, p + off, len - off, lines, MAX_LINES, &used);
+        if (n < 0) return -1;
+        for (int i = 0; i < n; i++) {
+            if (!frame_is_bye(&lines[i])) continue;
+            /* A line completed from the carry buffer ends held bytes early. */
+            size_t end = (lines[i].p >= p && lines[i].p < p + len)
+                       ? (size_t)(lines[i].p - p) + lines[i].len
+                       : off + lines[i].len - held;
+            *bye = 1;
+            return (long)end;
+        }
+        off += used;
+    }
+    framer_idle(&c->in);                         /* no partial line: no carry buffer kept */
+    return (long)len;
+}
+
+static void on_recv(struct io_uring_cqe *cqe, int fd)
+{
+    struct conn *c = &conns[fd];
+    int res = cqe->res;
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        if (res > 0 && !c->closing) {
+            const char *p = (const char *)uring_bufring_addr(&bufs, bid);
+            int bye = 0;
+            long len = echo_len(c, p, (size_t)res, &bye);
+            if (len > 0) {
+                LOG_DEBUG("[server] recv (fd=%d): %.*s", fd, (int)len, p);
+                enqueue(c, bid, (unsigned)len);
+            } else {
+                uring_bufring_recycle(&bufs, bid);
+            }
+            if (len < 0) LOG_WARN("[server] line too long (fd=%d)\n", fd);
+            if (bye || len < 0) begin_close(fd);
+        } else {
+            uring_bufring_recycle(&bufs, bid);
+        }
+    }
+
+    if (!(cqe->flags & IORING_CQE_F_MORE)) c->recv_armed = 0;
+
+    if (res == -ENOBUFS) {
+        /* Ring ran dry: wait for sends to hand buffers back. */
+        c->starved  = 1;
+        starved_any = 1;
+    } else if (res == 0) {
+        begin_close(fd);
+    } else if (res < 0 && res != -ECANCELED) {
+        LOG_ERROR("[server] recv (fd=%d): %s\n", fd, strerror(-res));
+        begin_close(fd);
+    } else if (!c->recv_armed && !c->closing) {
+        arm_recv(fd);
+    }
+}
+
+static void on_send(struct io_uring_cqe *cqe, int fd)
+{
+    struct conn *c = &conns[fd];
+    uring_bufring_recycle(&bufs, UD_BID(cqe->user_data));
+    c->inflight--;
+    if (cqe->res < 0 && cqe->res != -ECANCELED) {
+        LOG_ERROR("[server] send (fd=%d): %s\n", fd, strerror(-cqe->res));
+        begin_close(fd);
+    }
+    if (c->closing && cqe->res < 0) {
+        /* Chain broken: drop whatever was still queued. */
+        while (c->pend_head >= 0) {
+            unsigned bid = (unsigned)c->pend_head;
+            c->pend_head = buf_next[bid];
+            uring_bufring_recycle(&bufs, bid);
+        }
+    }
+    mark_dirty(fd);
+}
+
+int main(int argc, char **argv)
+{
+    log_init();
+
+    int opt;
+    const char *upath = NULL;
+    while ((opt = getopt(argc, argv, "u:")) != -1) {
+        switch (opt) {
+        case 'u': upath = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-u unix_path]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int sfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sfd < 0) die("socket");
+
+    opt = 1;
+    setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port        = htons(PORT);
+
+    if (uring_init(&ring, QD, IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN) < 0)
+        die("io_uring_setup");
+    if (uring_bufring_setup(&ring, &bufs, BGID, NBUFS, BUFSZ) < 0)
+        die("io_uring_register PBUF_RING");
+
+    if (bind(sfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) die("bind");
+    if (listen(sfd, BACKLOG) < 0) die("listen");
+    LOG_INFO("[server] listening on port %d\n", PORT);
+
+    arm_accept(sfd);
+
+    int ufd = -1;
+    if (upath) {
+        if ((ufd = unix_listen(upath, SOCK_STREAM, BACKLOG)) < 0) die(upath);
+        /* Blocking like sfd, so the accept waits in the ring instead of failing EAGAIN. */
+        if (fcntl(ufd, F_SETFL, fcntl(ufd, F_GETFL) & ~O_NONBLOCK) < 0) die("fcntl");
+        LOG_INFO("[server] unix stream socket %s\n", upath);
+        arm_accept(ufd);
+    }
+
+    int nclients = 0, done = 0;
+    while (!done) {
+        if (uring_submit_and_wait(&ring, 1) < 0) { perror("io_uring_enter"); break; }
+
+        struct io_uring_cqe *cqe;
+        unsigned seen = 0;
+        while ((cqe = uring_peek_cqe(&ring)) != NULL) {
+            uint64_t ud = cqe->user_data;
+            int fd = UD_FD(ud);
+            switch (UD_OP(ud)) {
+            case OP_ACCEPT:
+                if (cqe->res >= 0) {
+                    int cfd = cqe->res;
+                    struct conn *c = conn_get(cfd);
+                    memset(c, 0, sizeof(*c));
+                    framer_init(&c->in);
+                    c->open      = 1;
+                    c->pend_head = -1;
+                    LOG_DEBUG("[server] client connected (fd=%d)\n", cfd);
+                    arm_recv(cfd);
+                    nclients++;
+                    if (!(cqe->flags & IORING_CQE_F_MORE)) arm_accept(fd);   /* the listener */
+                } else if ((cqe->res == -EMFILE || cqe->res == -ENFILE) &&
+                           !(cqe->flags & IORING_CQE_F_MORE)) {
+                    /* Re-armed now it would fail at once, again and again. */
+                    if (!nstalled)
+                        LOG_WARN("[server] accept: %s; waiting for a connection to close\n",
+                                 strerror(-cqe->res));
+                    stalled[nstalled++] = fd;
+                } else {
+                    LOG_ERROR("[server] accept: %s\n", strerror(-cqe->res));
+                    if (!(cqe->flags & IORING_CQE_F_MORE)) arm_accept(fd);
+                }
+                break;
+            case OP_RECV:
+                on_recv(cqe, fd);
+                mark_dirty(fd);
+                break;
+            case OP_SEND:
+                on_send(cqe, fd);
+                break;
+            case OP_CLOSE:      /* an fd is free: stalled listeners may accept again */
+                while (nstalled > 0) arm_accept(stalled[--nstalled]);
+                break;
+            default:            /* OP_CANCEL: nothing to do */
+                break;
+            }
+            uring_cq_advance(&ring, 1);
+            seen++;
+        }
+
+        /* Queue this batch's sends and closes for the next io_uring_enter(). */
+        for (int i = 0; i < ndirty; i++) {
+            int fd = dirty[i];
+            conns[fd].dirty = 0;
+            flush_conn(fd);
+            if (maybe_close(fd, &nclients)) done = 1;
+        }
+        ndirty = 0;
+
+        uring_bufring_publish(&bufs);
+        if (starved_any && seen) {
+            starved_any = 0;
+            for (int fd = 0; fd < nconns; fd++)
+                if (conns[fd].open && conns[fd].starved && !conns[fd].closing)
+                    arm_recv(fd);
+        }
+    }
+
+    uring_submit_and_wait(&ring, 0);    /* push out the final close */
+    uring_bufring_free(&ring, &bufs);
+    uring_exit(&ring);
+    free(conns);
+    free(dirty);
+    close(sfd);
+    if (ufd >= 0) {
+        close(ufd);
+        unix_unlink(upath);
+    }
+    LOG_INFO("[server] done.\n");
+    log_shutdown();
+    return 0;
+}
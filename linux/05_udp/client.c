@@ -0,0 +1,105 @@
+/*
+ * linux/05_udp/client.c
+ *
+ * UDP demo client — the echo protocol of the other demos, one message per
+ * datagram.  The socket is connect()ed, so only the server's datagrams
+ * are received, and a lost datagram shows up as a receive timeout.
+ *
+ * With -g it also sends a burst of NSEG equal-sized datagrams as a single
+ * sendmsg() with a UDP_SEGMENT control message (UDP GSO), and checks that
+ * each one comes back as a datagram of its own.
+ *
+ * Usage: linux05_client [-g]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../common/sock_helpers.h"
+#include "../common/udp_batch.h"
+
+#define HOST "127.0.0.1"
+#define PORT 9005
+#define BUF  256
+#define NSEG 8
+#define SEG  16                    /* bytes per datagram of the burst */
+
+static void send_echo(int fd, const char *msg)
+{
+    char buf[BUF];
+    size_t len = strlen(msg);
+
+    if (send(fd, msg, len, 0) < 0) die("send");
+
+    ssize_t n = recv(fd, buf, sizeof(buf) - 1, 0);
+    if (n < 0) die("recv");
+    buf[n] = '\0';
+    printf("[client] echo: %s", buf);
+
+    if ((size_t)n != len || memcmp(buf, msg, len) != 0) {
+        fprintf(stderr, "[client] echo mismatch!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* NSEG datagrams in one GSO send; each must come back on its own. */
+static void send_burst(int fd)
+{
+    static struct udp_batch b;
+    if (udp_batch_init(&b, NSEG * SEG) < 0) die("udp_batch_init");
+    char *p = udp_batch_data(&b, 0);
+    for (int i = 0; i < NSEG; i++) {
+        char line[SEG + 1];
+        snprintf(line, sizeof(line), "segment %7d\n", i);
+        memcpy(p + i * SEG, line, SEG);
+    }
+    udp_batch_set(&b, 0, NSEG * SEG, SEG, 0);
+    if (udp_batch_send(fd, &b, 0, 1, 0) != 1) die("sendmsg UDP_SEGMENT");
+
+    for (int i = 0; i < NSEG; i++) {
+        char buf[BUF];
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0) die("recv");
+        if (n != SEG || memcmp(buf, p + i * SEG, SEG) != 0) {
+            fprintf(stderr, "[client] segment %d mismatch!\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("[client] %d datagrams sent in one GSO send, %d echoed\n", NSEG, NSEG);
+    udp_batch_free(&b);
+}
+
+int main(int argc, char **argv)
+{
+    int gso = argc > 1 && strcmp(argv[1], "-g") == 0;
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) die("socket");
+
+    struct timeval tv = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(HOST);
+    addr.sin_port        = htons(PORT);
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) die("connect");
+    printf("[client] sending to %s:%d (udp)\n", HOST, PORT);
+
+    send_echo(fd, "hello\n");
+    send_echo(fd, "ping\n");
+    if (gso) send_burst(fd);
+    send_echo(fd, "bye\n");
+
+    close(fd);
+    printf("[client] done.\n");
+    return 0;
+}
@@ -0,0 +1,211 @@
+/*
+ * linux/05_udp/server.c
+ *
+ * UDP echo server with batched datagram I/O.
+ *
+ * Model: one blocking UDP socket.  Every datagram is one message of the
+ *        line protocol and is echoed to its sender unchanged; a "bye"
+ *        datagram ends that sender's session.  By default up to UDP_BATCH
+ *        datagrams come in with one recvmmsg(MSG_WAITFORONE) and go back
+ *        out with one sendmmsg().  With -g the socket also accepts UDP
+ *        GRO: datagrams of one flow may arrive coalesced into a single
+ *        buffer, which is echoed with a UDP_SEGMENT control message so the
+ *        kernel cuts it back into the same datagrams.  With -1 every
+ *        datagram costs one recvfrom() and one sendto(), the baseline for
+ *        bench/udp_bench.
+ *        UDP has no connections: senders are tracked in an address table,
+ *        and the server exits once every sender it has seen said "bye".
+ *
+ * Usage: linux05_server [-1 | -g]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../common/sock_helpers.h"
+#include "../common/log.h"
+#include "../common/framing.h"
+#include "../common/udp_batch.h"
+
+#define PORT    9005
+#define BUFSZ   65536              /* one slot: a whole datagram or GRO buffer */
+#define SOCKBUF (4 * 1024 * 1024)  /* requested SO_RCVBUF / SO_SNDBUF */
+#define PEERS   4096               /* tracked senders, power of two */
+
+/* A sender, keyed by address and port.  Entries are never removed. */
+struct peer {
+    uint32_t      addr;
+    uint16_t      port;
+    unsigned char state;           /* 0 free, 1 in session, 2 said bye */
+};
+
+static struct peer peers[PEERS];
+static int         nactive;        /* senders in session */
+static int         nended;         /* sessions ended by "bye" */
+static unsigned long long ndgrams, nmsgs, nrecv_calls, nsend_calls;
+
+/* The table entry for a, claimed if new; NULL when the table is full. */
+static struct peer *peer_get(const struct sockaddr_in *a)
+{
+    uint32_t h = (a->sin_addr.s_addr ^ ((uint32_t)a->sin_port << 16)) * 2654435761u;
+    for (unsigned i = 0; i < PEERS; i++) {
+        struct peer *p = &peers[(h + i) & (PEERS - 1)];
+        if (p->state == 0) {
+            p->addr = a->sin_addr.s_addr;
+            p->port = a->sin_port;
+            return p;
+        }
+        if (p->addr == a->sin_addr.s_addr && p->port == a->sin_port) return p;
+    }
+    return NULL;
+}
+
+/* One datagram from a: starts its sender's session, or ends it on "bye". */
+static void on_datagram(const struct sockaddr_in *a, const char *p, size_t len)
+{
+    struct frame_line l = { p, len };
+    int bye = frame_is_bye(&l);
+    LOG_DEBUG("[server] recv from %s:%u: %.*s", inet_ntoa(a->sin_addr),
+              (unsigned)ntohs(a->sin_port), (int)len, p);
+    ndgrams++;
+
+    struct peer *peer = peer_get(a);
+    if (!peer) return;             /* table full: echoed, not tracked */
+    if (peer->state != 1 && !bye) {
+        LOG_INFO("[server] client %s:%u\n", inet_ntoa(a->sin_addr), (unsigned)ntohs(a->sin_port));
+        peer->state = 1;
+        nactive++;
+    } else if (bye && peer->state != 2) {
+        LOG_INFO("[server] client %s:%u said bye\n", inet_ntoa(a->sin_addr),
+                 (unsigned)ntohs(a->sin_port));
+        if (peer->state == 1) nactive--;
+        peer->state = 2;
+        nended++;
+    }
+}
+
+static int done(void)
+{
+    return nended > 0 && nactive == 0;
+}
+
+/* Baseline: one recvfrom() and one sendto() per datagram. */
+static void run_single(int fd)
+{
+    char *buf = malloc(BUFSZ);
+    if (!buf) die("malloc");
+    while (!done()) {
+        struct sockaddr_in from;
+        socklen_t fl = sizeof(from);
+        ssize_t r = recvfrom(fd, buf, BUFSZ, 0, (struct sockaddr *)&from, &fl);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            die("recvfrom");
+        }
+        nrecv_calls++;
+        nmsgs++;
+        on_datagram(&from, buf, (size_t)r);
+        if (sendto(fd, buf, (size_t)r, 0, (struct sockaddr *)&from, fl) < 0) perror("sendto");
+        nsend_calls++;
+    }
+    free(buf);
+}
+
+/*
+ * recvmmsg() a batch, look at every datagram (every segment of a GRO
+ * buffer), then sendmmsg() the whole batch back from the same slots.
+ */
+static void run_batched(int fd)
+{
+    static struct udp_batch b;
+    if (udp_batch_init(&b, BUFSZ) < 0) die("udp_batch_init");
+    while (!done()) {
+        int n = udp_batch_recv(fd, &b, UDP_BATCH, MSG_WAITFORONE);
+        if (n < 0) die("recvmmsg");
+        nrecv_calls++;
+        nmsgs += (unsigned)n;
+
+        for (int i = 0; i < n; i++) {
+            const char *p   = udp_batch_data(&b, i);
+            size_t      len = b.msg[i].msg_len;
+            uint16_t    gso = b.gso[i];
+            size_t      seg = gso && gso < len ? gso : len;
+            size_t      off = 0;
+            do {
+                size_t l = len - off < seg ? len - off : seg;
+                on_datagram(&b.addr[i], p + off, l);
+                off += l;
+            } while (off < len);
+            udp_batch_set(&b, i, len, gso, 1);
+        }
+
+        for (int i = 0; i < n; ) {
+            int w = udp_batch_send(fd, &b, i, n - i, 0);
+            nsend_calls++;
+            if (w < 0) {
+                perror("sendmmsg");
+                w = 1;             /* drop the datagram that failed */
+            }
+            i += w;
+        }
+    }
+    udp_batch_free(&b);
+}
+
+int main(int argc, char **argv)
+{
+    log_init();
+
+    int single = 0, gro = 0, opt;
+    while ((opt = getopt(argc, argv, "1g")) != -1) {
+        switch (opt) {
+        case '1': single = 1; break;
+        case 'g': gro    = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-1 | -g]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (single && gro) {
+        fprintf(stderr, "usage: %s [-1 | -g]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) die("socket");
+    int one = 1, sz = SOCKBUF;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    /* Bursts from many senders must fit until the next recvmmsg(). */
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+    if (gro && udp_gro_enable(fd) < 0) {
+        perror("UDP_GRO");
+        gro = 0;
+    }
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port        = htons(PORT);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) die("bind");
+    LOG_INFO("[server] listening on udp port %d (%s)\n", PORT,
+             single ? "recvfrom/sendto" : gro ? "recvmmsg/sendmmsg + GRO/GSO" : "recvmmsg/sendmmsg");
+
+    if (single) run_single(fd);
+    else        run_batched(fd);
+
+    close(fd);
+    LOG_INFO("[server] %llu datagram(s) in %llu message(s), %llu receive and %llu send call(s)\n",
+             ndgrams, nmsgs, nrecv_calls, nsend_calls);
+    LOG_INFO("[server] done.\n");
+    log_shutdown();
+    return 0;
+}
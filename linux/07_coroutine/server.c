@@ -0,0 +1,173 @@
+/*
+ * linux/07_coroutine/server.c
+ *
+ * TCP echo server with one coroutine per connection.
+ *
+ * Model: handle_client() is demo 01's, line for line, except that
+ *        recv(), write_all() and close() became co_recv(), co_send() and
+ *        co_close() (linux/common/coro.h).  Each connection runs it in a
+ *        coroutine of its own on a small pooled stack, so it reads as
+ *        blocking code and many clients are served at once.  Where 01
+ *        would block, the coroutine parks on its socket and the epoll
+ *        scheduler runs another.  The accept loop is a coroutine too.
+ *        One thread; exits when the last client disconnects, and reports
+ *        connections, peak concurrency, switches and stack memory.
+ *
+ * Usage: linux07_server [-s stack_kb] [-g] [-l backlog]
+ *        -s  stack per connection, default 16 KB
+ *        -g  guard page under each stack (at most ~32k connections)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../common/sock_helpers.h"
+#include "../common/log.h"
+#include "../common/framing.h"
+#include "../common/coro.h"
+
+#define PORT      9007
+#define BACKLOG   4096           /* default -l; capped at net.core.somaxconn */
+#define BUF       256
+#define MAX_LINES 16
+
+static struct co_sched sched;
+static struct co      *acceptor;     /* parked while out of fds */
+static long nclients, served;
+
+static void handle_client(int cfd)
+{
+    char buf[BUF];
+    struct framer in;
+    struct frame_line lines[MAX_LINES];
+    ssize_t n;
+    int bye = 0;
+
+    framer_init(&in);
+    while (!bye && (n = co_recv(cfd, buf, sizeof(buf), 0)) > 0) {
+        const char *p = buf;
+        size_t len = (size_t)n;
+        while (!bye && len > 0) {
+            size_t used;
+            int k = framer_feed(&in, p, len, lines, MAX_LINES, &used);
+            if (k < 0) {
+                LOG_WARN("[server] line too long\n");
+                bye = 1;
+                break;
+            }
+            for (int i = 0; i < k && !bye; i++) {
+                LOG_DEBUG("[server] recv: %.*s", (int)lines[i].len, lines[i].p);
+                if (co_send(cfd, lines[i].p, lines[i].len, 0) < 0) {
+                    perror("send");
+                    bye = 1;
+                    break;
+                }
+                bye = frame_is_bye(&lines[i]);
+            }
+            p   += used;
+            len -= used;
+        }
+    }
+    framer_free(&in);
+    co_close(cfd);
+}
+
+static void client_co(void *arg)
+{
+    int cfd = (int)(intptr_t)arg;
+    handle_client(cfd);
+    LOG_DEBUG("[server] client disconnected (fd=%d)\n", cfd);
+    if (--nclients == 0) co_stop(&sched);
+    else                 co_wake(&sched, &acceptor);     /* an fd is free again */
+}
+
+static void accept_co(void *arg)
+{
+    int sfd = *(int *)arg, warned = 0;
+    for (;;) {
+        int cfd = co_accept(sfd, NULL, NULL);
+        if (cfd < 0) {
+            int out = errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM;
+            if (!out || !warned++) perror("accept");
+            /*
+             * Out of fds, the pending connections wait in the backlog until
+             * a client closes; retrying at once would spin without ever
+             * letting the clients run.  Any other error: after the others.
+             */
+            if (out && nclients > 0) co_park(&acceptor);
+            else                     co_yield();
+            continue;
+        }
+        if (co_spawn(&sched, client_co, (void *)(intptr_t)cfd) < 0) {
+            perror("co_spawn");
+            close(cfd);
+            continue;
+        }
+        LOG_DEBUG("[server] client connected (fd=%d)\n", cfd);
+        served++;
+        nclients++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    log_init();
+
+    int opt, guard = 0, backlog = BACKLOG;
+    size_t stack = 0;
+    while ((opt = getopt(argc, argv, "s:gl:")) != -1) {
+        switch (opt) {
+        case 's': stack   = (size_t)atoi(optarg) * 1024; break;
+        case 'g': guard   = 1;                           break;
+        case 'l': backlog = atoi(optarg);                break;
+        default:
+            fprintf(stderr, "usage: %s [-s stack_kb] [-g] [-l backlog]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* A coroutine per connection is cheap; the fd limit is what runs out. */
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    int sfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sfd < 0) die("socket");
+
+    int one = 1;
+    setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port        = htons(PORT);
+
+    if (bind(sfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) die("bind");
+    if (listen(sfd, backlog) < 0) die("listen");
+    if (co_sched_init(&sched, stack, guard) < 0) die("epoll_create1");
+    LOG_INFO("[server] listening on port %d (%zu KB stacks, %s switch%s)\n", PORT,
+             sched.stack_size / 1024, CO_SWITCH_NAME, guard ? ", guard pages" : "");
+
+    if (co_spawn(&sched, accept_co, &sfd) < 0) die("co_spawn");
+    if (co_run(&sched) < 0) perror("epoll_wait");
+
+    LOG_INFO("[server] %ld connection(s), at most %ld at once; %llu switch(es), %llu wait(s); "
+             "%zu KB of stacks mapped\n", served, sched.peak - 1,
+             (unsigned long long)sched.switches, (unsigned long long)sched.waits,
+             co_stack_bytes(&sched) / 1024);
+    co_sched_destroy(&sched);                    /* and the parked accept loop with it */
+    close(sfd);
+    LOG_INFO("[server] done.\n");
+    log_shutdown();
+    return 0;
+}
@@ -0,0 +1,245 @@
+#ifndef BINFRAME_H
+#define BINFRAME_H
+
+/*
+ * linux/common/binframe.h
+ *
+ * Header-only framing for the length-prefixed binary protocol
+ * (docs/protocol.md).
+ *
+ * Every frame is a fixed 16-byte header followed by len body bytes of
+ * anything at all:
+ *
+ *     0      4      6       8              16
+ *     | len  | type | flags |      id      | body[len] ...
+ *
+ * all big-endian.  The header says where the frame ends, so nothing is
+ * scanned: bin_feed() hops from header to header and hands complete frames
+ * back as pointers into the caller's buffer.  Only a frame cut off by the
+ * end of a recv() is copied, into a per-connection buffer.  That buffer
+ * grows with the bytes that actually arrive, doubling, up to the frame's
+ * size; a header alone, however large the body it announces, costs at
+ * most BIN_RX_CHUNK more.  So peers that send headers and stop cannot make
+ * the server allocate for bodies they never send.  bin_rx_direct() offers
+ * the rest of a large body as a recv() target, so the bulk of it is read
+ * straight into its final place instead of going through a bounce buffer.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+
+#define BIN_HDR         16
+#define BIN_MAX_BODY    (16u * 1024 * 1024)  /* larger is a protocol error */
+#define BIN_DIRECT_MIN  4096                 /* body left to read it in place */
+#define BIN_KEEP        (64 * 1024)          /* larger rx buffers are freed */
+#define BIN_RX_CHUNK    (16 * 1024)          /* first body room, ahead of the bytes */
+
+/* Frame types.  The server echoes both; after BYE it closes. */
+#define BIN_ECHO 1
+#define BIN_BYE  2
+
+struct bin_hdr {
+    uint32_t len;             /* body bytes, header not included */
+    uint16_t type;
+    uint16_t flags;           /* reserved, 0 */
+    uint64_t id;              /* request id, echoed back unchanged */
+};
+
+/* One complete frame, header included. */
+struct bin_frame {
+    const char     *p;
+    size_t          len;
+    struct bin_hdr  h;
+};
+
+/* A frame being received across recv() calls.  24 bytes, like a framer. */
+struct bin_rx {
+    char     *buf;
+    uint32_t  cap;
+    uint32_t  got;            /* bytes of the frame in buf */
+    uint32_t  need;           /* whole frame size, 0 until the header is in */
+    uint32_t  done;           /* buf holds an emitted frame, reset next feed */
+};
+
+static inline void bin_hdr_encode(void *out, const struct bin_hdr *h)
+{
+    unsigned char *p = (unsigned char *)out;
+    uint32_t len   = htobe32(h->len);
+    uint16_t type  = htobe16(h->type);
+    uint16_t flags = htobe16(h->flags);
+    uint64_t id    = htobe64(h->id);
+    memcpy(p,     &len,   4);
+    memcpy(p + 4, &type,  2);
+    memcpy(p + 6, &flags, 2);
+    memcpy(p + 8, &id,    8);
+}
+
+static inline void bin_hdr_decode(const void *in, struct bin_hdr *h)
+{
+    const unsigned char *p = (const unsigned char *)in;
+    uint32_t len;
+    uint16_t type, flags;
+    uint64_t id;
+    memcpy(&len,   p,     4);
+    memcpy(&type,  p + 4, 2);
+    memcpy(&flags, p + 6, 2);
+    memcpy(&id,    p + 8, 8);
+    h->len   = be32toh(len);
+    h->type  = be16toh(type);
+    h->flags = be16toh(flags);
+    h->id    = be64toh(id);
+}
+
+static inline void bin_rx_init(struct bin_rx *rx)
+{
+    memset(rx, 0, sizeof(*rx));
+}
+
+static inline void bin_rx_free(struct bin_rx *rx)
+{
+    free(rx->buf);
+    bin_rx_init(rx);
+}
+
+/*
+ * Free the buffer unless an unfinished frame is in it, so that an idle
+ * connection keeps none.  Frames from the last bin_feed() must be done
+ * with.
+ */
+static inline void bin_rx_idle(struct bin_rx *rx)
+{
+    if (rx->done || rx->got == 0) bin_rx_free(rx);
+}
+
+/* Bytes of an unfinished frame currently held, at *p. */
+static inline size_t bin_rx_pending(const struct bin_rx *rx, const char **p)
+{
+    *p = rx->buf;
+    return rx->done ? 0 : rx->got;
+}
+
+static inline int bin_rx_reserve(struct bin_rx *rx, size_t n)
+{
+    if (n <= rx->cap) return 0;
+    char *b = (char *)realloc(rx->buf, n);
+    if (!b) return -1;
+    rx->buf = b;
+    rx->cap = (uint32_t)n;
+    return 0;
+}
+
+/*
+ * Room for at least n bytes: double the buffer (BIN_RX_CHUNK of body to
+ * start with), but never past the frame in progress.
+ */
+static inline int bin_rx_grow(struct bin_rx *rx, size_t n)
+{
+    if (n <= rx->cap) return 0;
+    size_t c = rx->cap ? 2 * (size_t)rx->cap : BIN_HDR + BIN_RX_CHUNK;
+    if (c < n) c = n;
+    if (rx->need && c > rx->need) c = rx->need;
+    return bin_rx_reserve(rx, c);
+}
+
+/*
+ * If the frame in progress still lacks at least BIN_DIRECT_MIN body bytes,
+ * point *dst at where the next of them go and return how much room there
+ * is, growing the buffer once what came so far has filled it; recv() into
+ * that, then bin_rx_commit() and bin_feed() with no new bytes.  Returns 0
+ * when a normal recv() + bin_feed() is the better choice.
+ */
+static inline size_t bin_rx_direct(struct bin_rx *rx, char **dst)
+{
+    if (rx->done || rx->need == 0 || rx->need - rx->got < BIN_DIRECT_MIN) return 0;
+    if (bin_rx_grow(rx, (size_t)rx->got + BIN_DIRECT_MIN) < 0) return 0;
+    *dst = rx->buf + rx->got;
+    return rx->cap - rx->got;
+}
+
+static inline void bin_rx_commit(struct bin_rx *rx, size_t n)
+{
+    rx->got += (uint32_t)n;
+}
+
+/*
+ * Split buf[0..len) into complete frames, continuing any frame left
+ * unfinished by earlier calls.  Up to max frames go to out[]; *used
+ * reports how many bytes of buf were consumed.  If *used < len, call
+ * again with buf + *used once the frames have been handled.
+ *
+ * Frames point into buf, except a frame finished from the rx buffer,
+ * which is returned alone as out[0]; either way they stay valid until the
+ * next bin_feed().  Returns the number of frames, or -1 if a header
+ * announces more than BIN_MAX_BODY bytes (or memory ran out).
+ */
+static inline int bin_feed(struct bin_rx *rx, const char *buf, size_t len,
+                           struct bin_frame *out, int max, size_t *used)
+{
+    const char *p = buf, *end = buf + len;
+    int n = 0;
+
+    if (rx->done) {
+        rx->got = rx->need = rx->done = 0;
+        if (rx->cap > BIN_KEEP) bin_rx_free(rx);
+    }
+    if (rx->got > 0 && max > 0) {
+        if (rx->need == 0) {
+            size_t take = BIN_HDR - rx->got;
+            if (take > len) take = len;
+            memcpy(rx->buf + rx->got, p, take);
+            rx->got += (uint32_t)take;
+            p       += take;
+            if (rx->got < BIN_HDR) { *used = len; return 0; }
+            struct bin_hdr h;
+            bin_hdr_decode(rx->buf, &h);
+            if (h.len > BIN_MAX_BODY) return -1;
+            rx->need = BIN_HDR + h.len;
+        }
+        size_t take = rx->need - rx->got;
+        if (take > (size_t)(end - p)) take = (size_t)(end - p);
+        if (bin_rx_grow(rx, (size_t)rx->got + take) < 0) return -1;
+        memcpy(rx->buf + rx->got, p, take);
+        rx->got += (uint32_t)take;
+        p       += take;
+        *used = (size_t)(p - buf);
+        if (rx->got < rx->need) return 0;
+        out[0].p   = rx->buf;
+        out[0].len = rx->need;
+        bin_hdr_decode(rx->buf, &out[0].h);
+        rx->done = 1;
+        return 1;
+    }
+
+    while (n < max && (size_t)(end - p) >= BIN_HDR) {
+        struct bin_hdr h;
+        bin_hdr_decode(p, &h);
+        if (h.len > BIN_MAX_BODY) return -1;
+        size_t flen = BIN_HDR + (size_t)h.len;
+        if ((size_t)(end - p) < flen) break;
+        out[n].p   = p;
+        out[n].len = flen;
+        out[n].h   = h;
+        n++;
+        p += flen;
+    }
+    if (n < max && p < end) {
+        /* Unfinished frame: keep it, with body room once the header is in. */
+        size_t rest = (size_t)(end - p);
+        rx->need = 0;
+        if (rest >= BIN_HDR) {
+            struct bin_hdr h;
+            bin_hdr_decode(p, &h);
+            rx->need = BIN_HDR + h.len;
+        }
+        if ((rx->need ? bin_rx_grow(rx, rest) : bin_rx_reserve(rx, BIN_HDR)) < 0) return -1;
+        memcpy(rx->buf, p, rest);
+        rx->got = (uint32_t)rest;
+        p = end;
+    }
+    *used = (size_t)(p - buf);
+    return n;
+}
+
+#endif /* BINFRAME_H */
@@ -0,0 +1,137 @@
+#ifndef BUFPOOL_H
+#define BUFPOOL_H
+
+/*
+ * linux/common/bufpool.h
+ *
+ * Header-only slab pool of fixed-size I/O buffers.
+ *
+ * Buffers are carved out of 2 MB slabs and recycled through a free list,
+ * so once the pool has grown to the working set, steady-state traffic
+ * does no malloc()/free() at all.  Each slab is one huge page when the
+ * system has some reserved (MAP_HUGETLB); otherwise it is a 2 MB-aligned
+ * anonymous mapping with MADV_HUGEPAGE, which transparent huge pages can
+ * still back with a single TLB entry.  Slabs are only returned to the
+ * kernel by bufpool_destroy().
+ *
+ * Not thread-safe: give each thread its own pool.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#define BUFPOOL_SLAB (2u << 20)               /* one x86-64 huge page */
+
+/* Slab header, stored in the slab's first buffer. */
+struct bufpool_slab {
+    struct bufpool_slab *next;
+    unsigned char        huge;                /* MAP_HUGETLB backed */
+};
+
+struct bufpool {
+    void                *free;                /* free buffers, linked through word 0 */
+    struct bufpool_slab *slabs;
+    size_t               bufsz;
+    size_t               nslabs;
+    size_t               nhuge;               /* slabs backed by MAP_HUGETLB */
+    size_t               in_use;
+};
+
+/*
+ * Map len bytes (a multiple of BUFPOOL_SLAB), huge-page backed if at all
+ * possible.  *huge is set to 1 for MAP_HUGETLB.  Returns NULL on failure.
+ */
+static inline void *bufpool_map(size_t len, int *huge)
+{
+    *huge = 0;
+#ifdef MAP_HUGETLB
+    void *p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        *huge = 1;
+        return p;
+    }
+#endif
+    /* Over-map, then trim to a 2 MB boundary so THP can use the range. */
+    char *raw = (char *)mmap(NULL, len + BUFPOOL_SLAB, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    char *base = (char *)(((uintptr_t)raw + BUFPOOL_SLAB - 1) & ~(uintptr_t)(BUFPOOL_SLAB - 1));
+    if (base > raw) munmap(raw, (size_t)(base - raw));
+    munmap(base + len, (size_t)(raw + BUFPOOL_SLAB - base));
+#ifdef MADV_HUGEPAGE
+    madvise(base, len, MADV_HUGEPAGE);
+#endif
+    return base;
+}
+
+static inline void bufpool_unmap(void *p, size_t len)
+{
+    if (p) munmap(p, len);
+}
+
+/* bufsz must be a power of two between 64 and BUFPOOL_SLAB / 2. */
+static inline void bufpool_init(struct bufpool *p, size_t bufsz)
+{
+    p->free   = NULL;
+    p->slabs  = NULL;
+    p->bufsz  = bufsz;
+    p->nslabs = 0;
+    p->nhuge  = 0;
+    p->in_use = 0;
+}
+
+/* Add one slab's worth of buffers to the free list.  Returns -1 on ENOMEM. */
+static inline int bufpool_grow(struct bufpool *p)
+{
+    int huge;
+    char *base = (char *)bufpool_map(BUFPOOL_SLAB, &huge);
+    if (!base) return -1;
+
+    struct bufpool_slab *s = (struct bufpool_slab *)base;
+    s->next  = p->slabs;
+    s->huge  = (unsigned char)huge;
+    p->slabs = s;
+    p->nslabs++;
+    p->nhuge += (size_t)huge;
+
+    /* Link back to front so buffers are handed out in address order. */
+    for (size_t off = BUFPOOL_SLAB - p->bufsz; off >= p->bufsz; off -= p->bufsz) {
+        void **b = (void **)(base + off);
+        *b = p->free;
+        p->free = b;
+    }
+    return 0;
+}
+
+/* A bufsz-aligned buffer, or NULL if memory ran out. */
+static inline void *bufpool_get(struct bufpool *p)
+{
+    if (!p->free && bufpool_grow(p) < 0) return NULL;
+    void **b = (void **)p->free;
+    p->free = *b;
+    p->in_use++;
+    return b;
+}
+
+static inline void bufpool_put(struct bufpool *p, void *buf)
+{
+    *(void **)buf = p->free;
+    p->free = buf;
+    p->in_use--;
+}
+
+/* Unmap every slab.  Buffers still in use become invalid. */
+static inline void bufpool_destroy(struct bufpool *p)
+{
+    struct bufpool_slab *s = p->slabs;
+    while (s) {
+        struct bufpool_slab *next = s->next;
+        munmap(s, BUFPOOL_SLAB);
+        s = next;
+    }
+    bufpool_init(p, p->bufsz);
+}
+
+#endif /* BUFPOOL_H */
@@ -0,0 +1,151 @@
+#ifndef BUSYPOLL_H
+#define BUSYPOLL_H
+
+/*
+ * linux/common/busypoll.h
+ *
+ * Header-only adaptive spin-then-block for an epoll loop.
+ *
+ * bp_wait() is epoll_wait() that first polls with a zero timeout for up to
+ * a spin budget and only then blocks.  An event caught while spinning is
+ * handled without the sleep and wakeup a blocking wait costs (several
+ * microseconds, more if the CPU dropped into an idle state meanwhile); an
+ * event that does not come within the budget cost a busy CPU for nothing.
+ *
+ * So the budget follows the traffic.  Every round that finds events feeds
+ * the gap since the previous such round into a moving average (1/8 weight);
+ * the budget is twice that average, at most the ceiling given to bp_init(),
+ * and 0 once the average is above the ceiling.  A loop that sees requests
+ * every few microseconds spins just long enough to catch the next one; an
+ * idle one blocks at once and uses no CPU.  Gaps count at most twice the
+ * ceiling, so a burst after a quiet minute brings the spin back within a
+ * dozen rounds.  A zero timeout (the caller has work waiting) is never
+ * spun on.
+ *
+ * bp_kernel_epoll() and bp_kernel_sock() ask the kernel to busy-poll too:
+ * while a wait finds nothing, it polls the NIC's receive queue itself
+ * instead of waiting for the interrupt.  That needs a NIC queue with a NAPI
+ * ID behind the sockets — loopback and Unix sockets have none, and there
+ * only the user-space spin counts.  EPIOCSPARAMS is per epoll instance
+ * (Linux 6.9); SO_BUSY_POLL and SO_PREFER_BUSY_POLL are per socket and,
+ * above the net.core.busy_read default, need CAP_NET_ADMIN.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL        46
+#endif
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+#ifndef EPIOCSPARAMS                             /* <linux/eventpoll.h>, Linux 6.9 */
+struct epoll_params {
+    uint32_t busy_poll_usecs;
+    uint16_t busy_poll_budget;
+    uint8_t  prefer_busy_poll;
+    uint8_t  __pad;
+};
+#define EPIOCSPARAMS _IOW(0x8A, 0x01, struct epoll_params)
+#endif
+
+struct busypoll {
+    uint64_t max_ns;                             /* budget ceiling, 0 = never spin */
+    uint64_t budget_ns;                          /* spin before the next block */
+    uint64_t gap_ns;                             /* average gap between event rounds */
+    uint64_t last_ns;                            /* last round with events, 0 = none yet */
+    uint64_t polls;                              /* zero-timeout epoll_wait() calls */
+    uint64_t hits;                               /* waits answered while spinning */
+    uint64_t misses;                             /* spins that ran out, then blocked */
+    uint64_t blocks;                             /* waits that went straight to blocking */
+    uint64_t spin_ns;                            /* time spent spinning */
+};
+
+static inline uint64_t bp_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Start out blocking: the spin is earned by traffic. */
+static inline void bp_init(struct busypoll *b, uint64_t max_ns)
+{
+    memset(b, 0, sizeof(*b));
+    b->max_ns = max_ns;
+    b->gap_ns = 2 * max_ns;
+}
+
+/* A round found events at time now: update the average gap and the budget. */
+static inline void bp_event(struct busypoll *b, uint64_t now)
+{
+    if (b->last_ns) {
+        uint64_t gap = now - b->last_ns;
+        if (gap > 2 * b->max_ns) gap = 2 * b->max_ns;
+        b->gap_ns = b->gap_ns - b->gap_ns / 8 + gap / 8;
+        b->budget_ns = b->gap_ns > b->max_ns     ? 0
+                     : 2 * b->gap_ns > b->max_ns ? b->max_ns
+                     :                             2 * b->gap_ns;
+    }
+    b->last_ns = now;
+}
+
+/* epoll_wait(), spinning first while the budget allows. */
+static inline int bp_wait(struct busypoll *b, int epfd, struct epoll_event *ev,
+                          int maxevents, int timeout_ms)
+{
+    if (b->budget_ns && timeout_ms != 0) {
+        uint64_t start = bp_now(), now;
+        do {
+            int n = epoll_wait(epfd, ev, maxevents, 0);
+            b->polls++;
+            now = bp_now();
+            if (n != 0) {
+                b->spin_ns += now - start;
+                if (n > 0) {
+                    b->hits++;
+                    bp_event(b, now);
+                }
+                return n;
+            }
+            sched_yield();
+        } while (now - start < b->budget_ns);
+        b->spin_ns += now - start;
+        b->misses++;
+    } else if (timeout_ms != 0) {
+        b->blocks++;
+    }
+    int n = epoll_wait(epfd, ev, maxevents, timeout_ms);
+    if (n > 0) bp_event(b, bp_now());
+    return n;
+}
+
+/* Kernel busy polling for every socket in epfd.  Returns 0, or -1 with errno. */
+static inline int bp_kernel_epoll(int epfd, unsigned usecs)
+{
+    struct epoll_params p;
+    memset(&p, 0, sizeof(p));
+    p.busy_poll_usecs  = usecs;
+    p.busy_poll_budget = 8;                      /* the kernel's own default */
+    p.prefer_busy_poll = 1;
+    return ioctl(epfd, EPIOCSPARAMS, &p);
+}
+
+/*
+ * Kernel busy polling for blocking reads on fd; sockets accepted from a
+ * listener inherit it.  Returns 0, or -1 with errno.
+ */
+static inline int bp_kernel_sock(int fd, int usecs)
+{
+    int one = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)) < 0) return -1;
+    return setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &one, sizeof(one));
+}
+
+#endif /* BUSYPOLL_H */
@@ -0,0 +1,473 @@
+#ifndef CORO_H
+#define CORO_H
+
+/*
+ * linux/common/coro.h
+ *
+ * Header-only stackful coroutines on an epoll scheduler, so a connection
+ * handler can be written as straight-line blocking code.
+ *
+ * co_recv(), co_send() and co_accept() behave like their blocking socket
+ * calls, on non-blocking fds.  When the call would block (EAGAIN), the
+ * calling coroutine parks on the fd and switches back to the scheduler.
+ * The scheduler runs the coroutines that are ready, and epoll_wait()s
+ * when none is left, or with a zero timeout now and then (below).  Every
+ * fd is added to the epoll set once, at its first wait: edge-triggered,
+ * for both directions.  Waiting again costs no epoll_ctl().  A wakeup may
+ * be spurious (an edge left over from data already read), so each call
+ * retries until it gets something other than EAGAIN.
+ *
+ * Switching saves the callee-saved registers on the old stack and loads
+ * them from the new one, in a few instructions of assembly on x86-64
+ * (co_switch()).  Elsewhere, or built with -DCO_UCONTEXT,
+ * swapcontext() does the same.  It is several times slower, because it
+ * also saves the signal mask with a system call.
+ *
+ * Stacks are small (CO_STACK by default) and come from a pool; a
+ * coroutine's own record lives at the top of its stack.  They are
+ * mmap()ed CO_SLAB at a time and reused when a coroutine ends, so
+ * starting a connection's coroutine costs no system call once the pool
+ * is warm.  Pages are only touched as a stack grows; a handler that stays
+ * shallow keeps about one resident page.  Overflow is caught in one of
+ * two ways:
+ *   - A guard page below each stack faults at once.  It costs two VMAs
+ *     per stack, and vm.max_map_count (65530 by default) then caps the
+ *     coroutines at about 32k.
+ *   - Without guards, a canary word at the bottom of each stack is
+ *     checked every time the coroutine switches out.  An overflow found
+ *     there aborts, but only after the fact.
+ *
+ * A coroutine that never meets EAGAIN would keep the thread to itself.
+ * After CO_RUN_BUDGET calls without waiting, it goes to the back of the
+ * run queue.  Each pass of the scheduler runs just the coroutines that
+ * were ready when it began, and once CO_RUN_BUDGET switches have gone by
+ * since the last epoll_wait(), the next pass waits for a zero-timeout one.
+ * Without that, a few coroutines taking turns with each other would keep
+ * the scheduler from polling, and a coroutine parked on a socket would not
+ * be woken however long its data had been waiting.
+ *
+ * One scheduler per thread: co_run() makes it the current one, and the
+ * co_* calls act on it.
+ *
+ * co_accept() uses accept4(), a GNU extension: define _GNU_SOURCE before
+ * the first #include.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#if !defined(__x86_64__) && !defined(CO_UCONTEXT)
+#define CO_UCONTEXT 1
+#endif
+#ifdef CO_UCONTEXT
+#include <ucontext.h>
+#endif
+
+#define CO_STACK      (16 * 1024)                /* default stack size */
+#define CO_SLAB       64                         /* stacks per mmap() */
+#define CO_RUN_BUDGET 64                         /* calls before a forced yield */
+#define CO_CANARY     0x5ca1ab1edeadbeefull
+#define CO_EVENTS     256                        /* epoll events per wait */
+
+#ifdef CO_UCONTEXT
+struct co_ctx {
+    ucontext_t uc;
+};
+#define co_switch(from, to) swapcontext(&(from)->uc, &(to)->uc)
+#define CO_SWITCH_NAME "ucontext"
+#else
+struct co_ctx {
+    void *sp;                                    /* saved stack pointer */
+};
+#define CO_SWITCH_NAME "asm"
+
+/*
+ * Save the callee-saved registers, MXCSR and the x87 control word on the
+ * current stack, store the stack pointer in *from, load to's and restore
+ * the same from there.  The ret returns into whatever called co_switch()
+ * on that stack, or into co_boot() the first time.
+ */
+__attribute__((naked, noinline, unused))
+static void co_switch(struct co_ctx *from __attribute__((unused)),
+                      struct co_ctx *to __attribute__((unused)))
+{
+    __asm__ volatile(
+        "pushq %rbp\n\t"
+        "pushq %rbx\n\t"
+        "pushq %r12\n\t"
+        "pushq %r13\n\t"
+        "pushq %r14\n\t"
+        "pushq %r15\n\t"
+        "subq $8, %rsp\n\t"
+        "stmxcsr (%rsp)\n\t"
+        "fnstcw 4(%rsp)\n\t"
+        "movq %rsp, (%rdi)\n\t"
+        "movq (%rsi), %rsp\n\t"
+        "ldmxcsr (%rsp)\n\t"
+        "fldcw 4(%rsp)\n\t"
+        "addq $8, %rsp\n\t"
+        "popq %r15\n\t"
+        "popq %r14\n\t"
+        "popq %r13\n\t"
+        "popq %r12\n\t"
+        "popq %rbx\n\t"
+        "popq %rbp\n\t"
+        "ret\n\t");
+}
+#endif
+
+struct co_sched;
+
+struct co {
+    struct co_ctx    ctx;
+    void           (*fn)(void *);
+    void            *arg;
+    char            *stack;                      /* lowest usable byte: the canary */
+    struct co       *next;                       /* run queue */
+    unsigned         ops;                        /* calls since the last wait */
+    int              done;
+};
+
+/* Who waits on an fd, by fd. */
+struct co_fd {
+    struct co     *rd, *wr;
+    unsigned char  added;                        /* in the epoll set */
+};
+
+struct co_sched {
+    int            epfd;
+    struct co_ctx  main;                         /* co_run()'s own context */
+    struct co     *cur;
+    struct co     *head, *tail;                  /* ready to run */
+    struct co_fd  *fds;
+    int            nfds;
+    char         **free_stacks;                  /* pooled stacks */
+    int            nfree, cap_free;
+    void         **slabs;
+    int            nslabs;
+    size_t         stack_size;
+    int            guard;
+    int            stop;
+    long           live, peak;
+    uint64_t       spawned, switches, waits;
+};
+
+static __thread struct co_sched *co_self;        /* the scheduler running this thread */
+
+/* stack_size 0 means CO_STACK; guard adds a PROT_NONE page under each stack. */
+static inline int co_sched_init(struct co_sched *s, size_t stack_size, int guard)
+{
+    memset(s, 0, sizeof(*s));
+    long pg = sysconf(_SC_PAGESIZE);
+    if (!stack_size) stack_size = CO_STACK;
+    s->stack_size = (stack_size + (size_t)pg - 1) & ~((size_t)pg - 1);
+    s->guard      = guard;
+    s->epfd       = epoll_create1(EPOLL_CLOEXEC);
+    return s->epfd < 0 ? -1 : 0;
+}
+
+/* CO_SLAB more stacks into the pool. */
+static inline int co_stacks_grow(struct co_sched *s)
+{
+    size_t pg   = (size_t)sysconf(_SC_PAGESIZE);
+    size_t step = s->stack_size + (s->guard ? pg : 0);
+    int total = (s->nslabs + 1) * CO_SLAB;       /* every stack may come back */
+    if (total > s->cap_free) {
+        int cap = s->cap_free ? s->cap_free * 2 : 256;
+        while (cap < total) cap *= 2;
+        char **f = realloc(s->free_stacks, (size_t)cap * sizeof(*f));
+        if (!f) return -1;
+        s->free_stacks = f;
+        s->cap_free    = cap;
+    }
+    void **sl = realloc(s->slabs, (size_t)(s->nslabs + 1) * sizeof(*sl));
+    if (!sl) return -1;
+    s->slabs = sl;
+    char *m = mmap(NULL, step * CO_SLAB, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (m == MAP_FAILED) return -1;
+    s->slabs[s->nslabs++] = m;
+    for (int i = 0; i < CO_SLAB; i++) {
+        char *base = m + (size_t)i * step;
+        if (s->guard && mprotect(base, pg, PROT_NONE) < 0) return -1;
+        s->free_stacks[s->nfree++] = base + (s->guard ? pg : 0);
+    }
+    return 0;
+}
+
+static inline void co_push(struct co_sched *s, struct co *c)
+{
+    c->next = NULL;
+    if (s->tail) s->tail->next = c;
+    else         s->head = c;
+    s->tail = c;
+}
+
+/* Back to the scheduler; returns when someone makes this coroutine ready. */
+static inline void co_suspend(void)
+{
+    struct co_sched *s = co_self;
+    struct co *c = s->cur;
+    c->ops = 0;
+    co_switch(&c->ctx, &s->main);
+}
+
+/* Let the other ready coroutines run first. */
+static inline void co_yield(void)
+{
+    co_push(co_self, co_self->cur);
+    co_suspend();
+}
+
+/* Where a new coroutine starts: run it, then leave for good. */
+static inline void co_boot(void)
+{
+    struct co_sched *s = co_self;
+    struct co *c = s->cur;
+    c->fn(c->arg);
+    c->done = 1;
+    co_switch(&c->ctx, &s->main);
+    abort();                                     /* never resumed */
+}
+
+/* Start fn(arg) as a coroutine; it runs once the scheduler gets to it. */
+static inline int co_spawn(struct co_sched *s, void (*fn)(void *), void *arg)
+{
+    if (!s->nfree && co_stacks_grow(s) < 0) return -1;
+    char *stack = s->free_stacks[--s->nfree];
+    /* The coroutine's own record sits at the top of its stack. */
+    char *top = (char *)(((uintptr_t)(stack + s->stack_size) - sizeof(struct co)) & ~(uintptr_t)63);
+    struct co *c = (struct co *)top;
+    memset(c, 0, sizeof(*c));
+    c->fn    = fn;
+    c->arg   = arg;
+    c->stack = stack;
+    *(uint64_t *)stack = CO_CANARY;
+#ifdef CO_UCONTEXT
+    getcontext(&c->ctx.uc);
+    c->ctx.uc.uc_stack.ss_sp   = stack;
+    c->ctx.uc.uc_stack.ss_size = (size_t)(top - stack);
+    c->ctx.uc.uc_link          = NULL;
+    makecontext(&c->ctx.uc, co_boot, 0);
+#else
+    /*
+     * The frame co_switch() pops: MXCSR and control word, six registers,
+     * then co_boot() as the return address.  After the ret, the stack
+     * pointer is top - 8, as at the entry of a called function.
+     */
+    uint64_t *sp = (uint64_t *)top;
+    *--sp = 0;                                   /* co_boot()'s return address: none */
+    *--sp = (uint64_t)(uintptr_t)co_boot;
+    for (int i = 0; i < 6; i++) *--sp = 0;
+    *--sp = 0x037f00001f80ull;                   /* default x87 CW : MXCSR */
+    c->ctx.sp = sp;
+#endif
+    co_push(s, c);
+    s->spawned++;
+    if (++s->live > s->peak) s->peak = s->live;
+    return 0;
+}
+
+static inline struct co_fd *co_fd_get(struct co_sched *s, int fd)
+{
+    if (fd >= s->nfds) {
+        int n = s->nfds ? s->nfds : 1024;
+        while (n <= fd) n *= 2;
+        struct co_fd *t = realloc(s->fds, (size_t)n * sizeof(*t));
+        if (!t) return NULL;
+        memset(t + s->nfds, 0, (size_t)(n - s->nfds) * sizeof(*t));
+        s->fds  = t;
+        s->nfds = n;
+    }
+    return &s->fds[fd];
+}
+
+/* Park the current coroutine until fd may be readable (EPOLLIN) or writable. */
+static inline int co_wait(int fd, uint32_t dir)
+{
+    struct co_sched *s = co_self;
+    struct co_fd *f = co_fd_get(s, fd);
+    if (!f) return -1;
+    if (!f->added) {
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET };
+        ev.data.fd = fd;
+        if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) return -1;
+        f->added = 1;
+    }
+    if (dir == EPOLLIN) f->rd = s->cur;
+    else                f->wr = s->cur;
+    co_suspend();
+    return 0;
+}
+
+/* After CO_RUN_BUDGET calls that did not have to wait, yield anyway. */
+static inline void co_tick(void)
+{
+    if (++co_self->cur->ops >= CO_RUN_BUDGET) co_yield();
+}
+
+static inline ssize_t co_recv(int fd, void *buf, size_t len, int flags)
+{
+    for (;;) {
+        ssize_t r = recv(fd, buf, len, flags);
+        if (r >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            co_tick();
+            return r;
+        }
+        if (errno != EINTR && co_wait(fd, EPOLLIN) < 0) return -1;
+    }
+}
+
+/* All len bytes, like a blocking send(); -1 on error. */
+static inline ssize_t co_send(int fd, const void *buf, size_t len, int flags)
+{
+    const char *p = buf;
+    size_t left = len;
+    while (left > 0) {
+        ssize_t r = send(fd, p, left, flags | MSG_NOSIGNAL);
+        if (r >= 0) {
+            p    += r;
+            left -= (size_t)r;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (co_wait(fd, EPOLLOUT) < 0) return -1;
+        } else if (errno != EINTR) {
+            return -1;
+        }
+    }
+    co_tick();
+    return (ssize_t)len;
+}
+
+/*
+ * A non-blocking, close-on-exec connection from non-blocking listener lfd.
+ * -1 on an error other than EAGAIN: the caller must wait before it tries
+ * again, or an error that lasts (EMFILE) keeps it running forever.
+ */
+static inline int co_accept(int lfd, struct sockaddr *addr, socklen_t *addrlen)
+{
+    for (;;) {
+        int fd = accept4(lfd, addr, addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd >= 0) {
+            co_tick();
+            return fd;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (co_wait(lfd, EPOLLIN) < 0) return -1;
+        } else if (errno != EINTR && errno != ECONNABORTED) {
+            return -1;
+        }
+    }
+}
+
+/* close() for fds a coroutine waited on: forgets the fd first. */
+static inline int co_close(int fd)
+{
+    struct co_sched *s = co_self;
+    if (fd < s->nfds) memset(&s->fds[fd], 0, sizeof(s->fds[fd]));
+    return close(fd);                            /* also leaves the epoll set */
+}
+
+/* Make co_run() return once the ready coroutines have had their turn. */
+static inline void co_stop(struct co_sched *s)
+{
+    s->stop = 1;
+}
+
+static inline void co_wake(struct co_sched *s, struct co **w)
+{
+    if (*w) {
+        co_push(s, *w);
+        *w = NULL;
+    }
+}
+
+/*
+ * Park the current coroutine in *w until another one calls co_wake() on
+ * it: for waits on something other than an fd, such as a free fd slot.
+ */
+static inline void co_park(struct co **w)
+{
+    *w = co_self->cur;
+    co_suspend();
+}
+
+/* Run coroutines until none is left or co_stop().  -1 if epoll fails. */
+static inline int co_run(struct co_sched *s)
+{
+    struct epoll_event ev[CO_EVENTS];
+    struct co_sched *prev = co_self;
+    uint64_t polled = s->switches;
+    co_self = s;
+    s->stop = 0;
+    while (s->live > 0) {
+        /* One pass: those ready now.  Yielding puts one behind the pass. */
+        struct co *last = s->tail;
+        for (int end = !last; !end; ) {
+            struct co *c = s->head;
+            s->head = c->next;
+            if (!s->head) s->tail = NULL;
+            end    = c == last;
+            s->cur = c;
+            s->switches++;
+            co_switch(&s->main, &c->ctx);
+            s->cur = NULL;
+            if (*(uint64_t *)c->stack != CO_CANARY) {
+                fprintf(stderr, "coro: stack overflow (%zu bytes)\n", s->stack_size);
+                abort();
+            }
+            if (c->done) {
+                s->free_stacks[s->nfree++] = c->stack;   /* c with it */
+                s->live--;
+            }
+        }
+        if (s->live == 0 || (s->stop && !s->head)) break;
+        if (s->stop) continue;                   /* the ready ones finish first */
+        if (s->head && s->switches - polled < CO_RUN_BUDGET) continue;
+        polled = s->switches;
+        int n = epoll_wait(s->epfd, ev, CO_EVENTS, s->head ? 0 : -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            co_self = prev;
+            return -1;
+        }
+        s->waits++;
+        for (int i = 0; i < n; i++) {
+            struct co_fd *f = &s->fds[ev[i].data.fd];
+            uint32_t e = ev[i].events;
+            if (e & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) co_wake(s, &f->rd);
+            if (e & (EPOLLOUT | EPOLLHUP | EPOLLERR))             co_wake(s, &f->wr);
+        }
+    }
+    co_self = prev;
+    return 0;
+}
+
+/* Bytes of stack mapped, guard pages included. */
+static inline size_t co_stack_bytes(const struct co_sched *s)
+{
+    size_t pg = (size_t)sysconf(_SC_PAGESIZE);
+    return (size_t)s->nslabs * CO_SLAB * (s->stack_size + (s->guard ? pg : 0));
+}
+
+/* Frees every stack, and with them the coroutines still parked. */
+static inline void co_sched_destroy(struct co_sched *s)
+{
+    size_t pg = (size_t)sysconf(_SC_PAGESIZE);
+    for (int i = 0; i < s->nslabs; i++)
+        munmap(s->slabs[i], CO_SLAB * (s->stack_size + (s->guard ? pg : 0)));
+    free(s->slabs);
+    free(s->free_stacks);
+    free(s->fds);
+    if (s->epfd >= 0) close(s->epfd);
+    memset(s, 0, sizeof(*s));
+    s->epfd = -1;
+}
+
+#endif /* CORO_H */
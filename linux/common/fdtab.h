@@ -0,0 +1,68 @@
+#ifndef FDTAB_H
+#define FDTAB_H
+
+/*
+ * linux/common/fdtab.h
+ *
+ * Header-only storage for tables indexed by fd, sized for very many
+ * connections that are mostly idle.
+ *
+ * A table is an anonymous mapping.  Its pages are zero-filled and take no
+ * memory until an entry on them is first written, so a table with room
+ * for a million fds costs only the pages of the fds in use.  Growing it is
+ * one mremap(): the kernel moves page-table entries instead of copying
+ * the table, and never holds two copies of it, where realloc() and a
+ * memset() of the new half would touch all of it.  Transparent huge pages
+ * are turned off for the mapping, since one would make a single entry
+ * cost 2 MB.  mremap() needs _GNU_SOURCE; without it a table grows by a
+ * new mapping and a copy.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static inline size_t fdtab_round(size_t bytes)
+{
+    size_t pg = (size_t)sysconf(_SC_PAGESIZE);
+    return (bytes + pg - 1) & ~(pg - 1);
+}
+
+/*
+ * Resize a table from old_bytes to new_bytes (tab NULL and old_bytes 0 for
+ * a new one).  New entries read as zero.  Returns the table, which may
+ * have moved, or NULL with tab left as it was.
+ */
+static inline void *fdtab_grow(void *tab, size_t old_bytes, size_t new_bytes)
+{
+    size_t had = tab ? fdtab_round(old_bytes) : 0;
+    size_t len = fdtab_round(new_bytes);
+    void *p;
+    if (len <= had) return tab;
+    if (!tab) {
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    } else {
+#ifdef MREMAP_MAYMOVE
+        p = mremap(tab, had, len, MREMAP_MAYMOVE);
+#else
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED) {
+            memcpy(p, tab, old_bytes);
+            munmap(tab, had);
+        }
+#endif
+    }
+    if (p == MAP_FAILED) return NULL;
+#ifdef MADV_NOHUGEPAGE
+    madvise(p, len, MADV_NOHUGEPAGE);
+#endif
+    return p;
+}
+
+static inline void fdtab_free(void *tab, size_t bytes)
+{
+    if (tab) munmap(tab, fdtab_round(bytes));
+}
+
+#endif /* FDTAB_H */
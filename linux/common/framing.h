@@ -0,0 +1,296 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+/*
+ * linux/common/framing.h
+ *
+ * Header-only newline framing for the line protocol (docs/protocol.md).
+ *
+ * recv() returns arbitrary slices of the byte stream: one chunk may hold
+ * several lines, or only part of one.  framer_feed() splits a chunk into
+ * every complete line it contains and hands them back as (pointer, length)
+ * pairs into the caller's buffer — no copying.  Only a trailing partial
+ * line is copied into the per-connection carry buffer, and the line it
+ * eventually completes is returned from there.  framer_idle() frees the
+ * carry buffer once it is empty again.
+ *
+ * The newline scan works on 64-byte blocks: one compare + movemask turns a
+ * block into a bitmask of '\n' positions, and each set bit is a line end.
+ * AVX2 is picked at runtime when the CPU has it, SSE2 otherwise on x86,
+ * and a portable scalar loop everywhere else (or with -DFRAMING_NO_SIMD).
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(FRAMING_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && \
+    defined(__GNUC__)
+#  define FRAMING_X86 1
+#  include <immintrin.h>
+#endif
+
+#define FRAME_MAX_LINE (64 * 1024)     /* longer lines are a protocol error */
+
+/* One complete line, '\n' included. */
+struct frame_line {
+    const char *p;
+    size_t      len;
+};
+
+/* 32-bit sizes are plenty (carry <= 2 * FRAME_MAX_LINE) and keep it small. */
+struct framer {
+    char     *carry;          /* [emitted line][partial line] */
+    uint32_t  carry_len;
+    uint32_t  carry_cap;
+    uint32_t  carry_done;     /* emitted prefix, dropped on the next feed */
+};
+
+static inline void framer_init(struct framer *f)
+{
+    memset(f, 0, sizeof(*f));
+}
+
+static inline void framer_free(struct framer *f)
+{
+    free(f->carry);
+    framer_init(f);
+}
+
+/*
+ * Free the carry buffer unless it holds an unfinished line, so that an
+ * idle connection keeps no buffer.  Lines from the last framer_feed() must
+ * be done with.
+ */
+static inline void framer_idle(struct framer *f)
+{
+    if (f->carry_len == f->carry_done) framer_free(f);
+}
+
+/* The close command: any line starting with "bye" (prefix match). */
+static inline int frame_is_bye(const struct frame_line *l)
+{
+    return l->len >= 3 && memcmp(l->p, "bye", 3) == 0;
+}
+
+/* Bytes of an unfinished line currently held back. */
+static inline size_t framer_pending(const struct framer *f)
+{
+    return f->carry_len - f->carry_done;
+}
+
+/* ── Newline bitmask of a block ─────────────────────────────────────────── */
+
+static inline uint64_t frame_mask_scalar(const char *p, size_t n)
+{
+    uint64_t m = 0;
+    for (size_t i = 0; i < n; i++)
+        m |= (uint64_t)(p[i] == '\n') << i;
+    return m;
+}
+
+#ifdef FRAMING_X86
+static inline uint64_t frame_mask64_sse2(const char *p)
+{
+    const __m128i nl = _mm_set1_epi8('\n');
+    uint64_t m0 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), nl));
+    uint64_t m1 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 16)), nl));
+    uint64_t m2 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 32)), nl));
+    uint64_t m3 = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 48)), nl));
+    return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+}
+
+__attribute__((target("avx2")))
+static inline uint64_t frame_mask64_avx2(const char *p)
+{
+    const __m256i nl = _mm256_set1_epi8('\n');
+    uint64_t lo = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), nl));
+    uint64_t hi = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 32)), nl));
+    return lo | (hi << 32);
+}
+
+/* Non-zero if any of the 256 bytes at p is '\n' (long-line fast path). */
+static inline int frame_any256_sse2(const char *p)
+{
+    const __m128i nl = _mm_set1_epi8('\n');
+    __m128i acc = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), nl);
+    for (int i = 16; i < 256; i += 16)
+        acc = _mm_or_si128(acc, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + i)), nl));
+    return _mm_movemask_epi8(acc);
+}
+
+__attribute__((target("avx2")))
+static inline int frame_any256_avx2(const char *p)
+{
+    const __m256i nl = _mm256_set1_epi8('\n');
+    __m256i acc = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), nl);
+    for (int i = 32; i < 256; i += 32)
+        acc = _mm256_or_si256(acc, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + i)), nl));
+    return _mm256_movemask_epi8(acc);
+}
+#endif
+
+/*
+ * frame_split_<isa>(p, end, out, max, &stop): store up to max complete
+ * lines of [p, end) in out[] and return how many.  *stop is set to the
+ * first byte not consumed (start of the partial tail, or of the next line
+ * when out[] filled up).  Short lines cost one bit-clear each; once two
+ * blocks in a row had no newline, long lines are skipped 256 bytes at a
+ * time.
+ */
+#define FRAME_SPLIT_BODY(MASK64, ANY256)                                       \
+    const char *line = p, *q = p;                                              \
+    int n = 0, quiet = 0;                                                      \
+    while (q < end) {                                                          \
+        size_t left = (size_t)(end - q);                                       \
+        if (quiet >= 2 && left >= 256 && !ANY256(q)) { q += 256; continue; }   \
+        uint64_t m = left >= 64 ? MASK64(q) : frame_mask_scalar(q, left);      \
+        quiet = m ? 0 : quiet + 1;                                             \
+        while (m) {                                                            \
+            const char *nl = q + __builtin_ctzll(m);                           \
+            out[n].p   = line;                                                 \
+            out[n].len = (size_t)(nl + 1 - line);                              \
+            line = nl + 1;                                                     \
+            if (++n == max) { *stop = line; return n; }                        \
+            m &= m - 1;                                                        \
+        }                                                                      \
+        q += 64;                                                               \
+    }                                                                          \
+    *stop = line;                                                              \
+    return n;
+
+static inline uint64_t frame_mask64_scalar(const char *p)
+{
+    return frame_mask_scalar(p, 64);
+}
+
+static inline int frame_any256_scalar(const char *p)
+{
+    return memchr(p, '\n', 256) != NULL;
+}
+
+static inline int frame_split_scalar(const char *p, const char *end,
+                                     struct frame_line *out, int max,
+                                     const char **stop)
+{
+    FRAME_SPLIT_BODY(frame_mask64_scalar, frame_any256_scalar)
+}
+
+#ifdef FRAMING_X86
+static inline int frame_split_sse2(const char *p, const char *end,
+                                   struct frame_line *out, int max,
+                                   const char **stop)
+{
+    FRAME_SPLIT_BODY(frame_mask64_sse2, frame_any256_sse2)
+}
+
+__attribute__((target("avx2")))
+static inline int frame_split_avx2(const char *p, const char *end,
+                                   struct frame_line *out, int max,
+                                   const char **stop)
+{
+    FRAME_SPLIT_BODY(frame_mask64_avx2, frame_any256_avx2)
+}
+#endif
+
+/* 2 = AVX2, 1 = SSE2, 0 = scalar.  Probed once per translation unit. */
+static inline int frame_simd_level(void)
+{
+#ifdef FRAMING_X86
+    static int level = -1;
+    if (level < 0) {
+        __builtin_cpu_init();
+        level = __builtin_cpu_supports("avx2") ? 2 : 1;
+    }
+    return level;
+#else
+    return 0;
+#endif
+}
+
+static inline int frame_split(const char *p, const char *end,
+                              struct frame_line *out, int max, const char **stop)
+{
+#ifdef FRAMING_X86
+    if (frame_simd_level() == 2) return frame_split_avx2(p, end, out, max, stop);
+    return frame_split_sse2(p, end, out, max, stop);
+#else
+    return frame_split_scalar(p, end, out, max, stop);
+#endif
+}
+
+/* First '\n' in [p, end), or NULL. */
+static inline const char *frame_find_nl(const char *p, const char *end)
+{
+    struct frame_line l;
+    const char *stop;
+    return frame_split(p, end, &l, 1, &stop) ? stop - 1 : NULL;
+}
+
+/* Append to the held-back partial line.  Returns -1 if it gets too long. */
+static inline int framer_carry(struct framer *f, const char *p, size_t len)
+{
+    if (framer_pending(f) + len > FRAME_MAX_LINE) return -1;
+    if (f->carry_len + len > f->carry_cap) {
+        size_t cap = f->carry_cap ? f->carry_cap : 256;
+        while (cap < f->carry_len + len) cap *= 2;
+        char *c = (char *)realloc(f->carry, cap);
+        if (!c) return -1;
+        f->carry     = c;
+        f->carry_cap = (uint32_t)cap;
+    }
+    memcpy(f->carry + f->carry_len, p, len);
+    f->carry_len += (uint32_t)len;
+    return 0;
+}
+
+/*
+ * Split buf[0..len) into complete lines, continuing any partial line from
+ * earlier calls.  Up to max lines are stored in out[]; *used reports how
+ * many bytes of buf were consumed.  If *used < len, out[] filled up: call
+ * again with buf + *used once the lines have been handled.  A trailing
+ * partial line is copied into the carry buffer and always consumed.
+ *
+ * Lines point into buf, except possibly out[0], which may point into the
+ * carry buffer; either way they stay valid until the next framer_feed().
+ * Returns the number of lines, or -1 if a line exceeds FRAME_MAX_LINE.
+ */
+static inline int framer_feed(struct framer *f, const char *buf, size_t len,
+                              struct frame_line *out, int max, size_t *used)
+{
+    const char *p = buf, *end = buf + len;
+    int n = 0;
+
+    if (f->carry_done) {
+        f->carry_len -= f->carry_done;
+        memmove(f->carry, f->carry + f->carry_done, f->carry_len);
+        f->carry_done = 0;
+    }
+    if (f->carry_len > 0 && max > 0) {
+        const char *nl = frame_find_nl(p, end);
+        size_t take = nl ? (size_t)(nl + 1 - p) : len;
+        if (framer_carry(f, p, take) < 0) return -1;
+        p += take;
+        if (!nl) { *used = len; return 0; }
+        out[n].p      = f->carry;
+        out[n].len    = f->carry_len;
+        f->carry_done = f->carry_len;
+        n++;
+    }
+
+    if (n < max) {
+        const char *stop;
+        n += frame_split(p, end, out + n, max - n, &stop);
+        p = stop;
+    }
+    if (n < max && p < end) {
+        /* Partial tail: hold it back until its newline arrives. */
+        if (framer_carry(f, p, (size_t)(end - p)) < 0) return -1;
+        if (f->carry_done) out[0].p = f->carry;     /* realloc may move it */
+        p = end;
+    }
+    *used = (size_t)(p - buf);
+    return n;
+}
+
+#endif /* FRAMING_H */
@@ -0,0 +1,210 @@
+#ifndef GATHER_H
+#define GATHER_H
+
+/*
+ * linux/common/gather.h
+ *
+ * Header-only response gathering: collect everything one event-loop round
+ * wants to send, per connection, and write each connection's share with a
+ * single sendmsg().
+ *
+ * A pipelining client puts many requests into one segment, and an echo
+ * loop that answers each one as it is parsed makes one send() per answer.
+ * Here answers are only recorded — as (pointer, length) entries chained
+ * per connection — and gather_flush() hands the whole chain to the kernel
+ * in one sendmsg(), merging entries that sit back to back.  Answers that
+ * do not fit in one iovec batch go out in several, all but the last with
+ * MSG_MORE so TCP still builds full segments across them.
+ *
+ * Requests are recv()'d into the gather's arena (gather_space() and
+ * gather_commit()), so answers that echo request bytes point into memory
+ * that stays put until gather_reset(); anything else is copied into the
+ * arena.  When the arena or the entry table is full, gather_add() says so
+ * and the caller sends directly.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "outq.h"
+
+#define GATHER_IOV 64                        /* iovecs per sendmsg() */
+
+struct gather_ent {
+    const char *p;
+    size_t      len;
+    int         next;                        /* next entry of the queue, -1 = last */
+};
+
+/* One connection's answers, in order.  Lives with the connection. */
+struct gather_q {
+    int head, tail;                          /* entry indexes, -1 = empty */
+};
+
+struct gather {
+    char              *arena;
+    size_t             cap;
+    size_t             used;
+    struct gather_ent *ent;
+    int                n, max;
+    int               *touched;              /* ids of queues made non-empty */
+    int                ntouched;
+    unsigned long long added;                /* answers recorded */
+    unsigned long long sends;                /* sendmsg() calls made */
+    const void        *ctl;                  /* control data for the next flush, see below */
+    size_t             ctllen;
+};
+
+static inline void gather_q_init(struct gather_q *q)
+{
+    q->head = q->tail = -1;
+}
+
+static inline int gather_q_empty(const struct gather_q *q)
+{
+    return q->head < 0;
+}
+
+/* Returns 0, or -1 if memory ran out. */
+static inline int gather_init(struct gather *g, size_t arena, int max)
+{
+    memset(g, 0, sizeof(*g));
+    g->arena   = (char *)malloc(arena);
+    g->ent     = (struct gather_ent *)malloc((size_t)max * sizeof(*g->ent));
+    g->touched = (int *)malloc((size_t)max * sizeof(*g->touched));
+    if (!g->arena || !g->ent || !g->touched) return -1;
+    g->cap = arena;
+    g->max = max;
+    return 0;
+}
+
+static inline void gather_destroy(struct gather *g)
+{
+    free(g->arena);
+    free(g->ent);
+    free(g->touched);
+    memset(g, 0, sizeof(*g));
+}
+
+/* Free arena space to recv() into; commit what was received. */
+static inline char *gather_space(struct gather *g, size_t *avail)
+{
+    *avail = g->cap - g->used;
+    return g->arena + g->used;
+}
+
+static inline void gather_commit(struct gather *g, size_t n)
+{
+    g->used += n;
+}
+
+/*
+ * Record len bytes at p as the next answer on q, which the caller knows as
+ * id (it shows up in touched[] the first time q gains an entry).  Bytes
+ * outside the committed arena are copied into it.  Returns 0, or -1 if
+ * there is no room; nothing is recorded then.
+ */
+static inline int gather_add(struct gather *g, struct gather_q *q, int id,
+                             const char *p, size_t len)
+{
+    int in_arena = p >= g->arena && p + len <= g->arena + g->used;
+    if (q->tail >= 0) {
+        struct gather_ent *t = &g->ent[q->tail];
+        if (in_arena && t->p + t->len == p) {
+            t->len += len;
+            g->added++;
+            return 0;
+        }
+    }
+    if (g->n == g->max) return -1;
+    if (!in_arena) {
+        if (g->cap - g->used < len) return -1;
+        memcpy(g->arena + g->used, p, len);
+        p = g->arena + g->used;
+        g->used += len;
+    }
+    struct gather_ent *e = &g->ent[g->n];
+    e->p    = p;
+    e->len  = len;
+    e->next = -1;
+    if (q->tail >= 0) {
+        g->ent[q->tail].next = g->n;
+    } else {
+        q->head = g->n;
+        g->touched[g->ntouched++] = id;
+    }
+    q->tail = g->n++;
+    g->added++;
+    return 0;
+}
+
+/*
+ * Send q's answers behind whatever out already holds, and queue (copy)
+ * the part the socket does not take.  q is empty afterwards.  Returns 0
+ * when everything was sent, 1 if bytes are queued on out, -1 on a socket
+ * error (errno set).
+ *
+ * If g->ctl is set, it goes along as control data (e.g. a timestamp
+ * request, tstamp.h) with the first sendmsg() that sends anything, and
+ * is cleared then; a flush that sent nothing leaves it set.
+ */
+static inline int gather_flush(struct gather *g, struct gather_q *q, int fd,
+                               struct outq *out)
+{
+    int i = q->head;
+    gather_q_init(q);
+    if (i < 0) return outq_bytes(out) > 0;
+
+    while (i >= 0 && outq_bytes(out) == 0) {
+        struct iovec iov[GATHER_IOV];
+        int n = 0;
+        for (; i >= 0 && n < GATHER_IOV; i = g->ent[i].next, n++) {
+            iov[n].iov_base = (void *)g->ent[i].p;
+            iov[n].iov_len  = g->ent[i].len;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov        = iov;
+        msg.msg_iovlen     = (size_t)n;
+        msg.msg_control    = (void *)g->ctl;
+        msg.msg_controllen = g->ctl ? g->ctllen : 0;
+
+        ssize_t w;
+        do {
+            w = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT | (i >= 0 ? MSG_MORE : 0));
+        } while (w < 0 && errno == EINTR);
+        g->sends++;
+        if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK) return -1;
+        if (w < 0) w = 0;
+        if (w > 0) g->ctl = NULL;
+
+        /* Queue the part of this batch the socket did not take. */
+        for (int k = 0; k < n; k++) {
+            size_t l = iov[k].iov_len;
+            if ((size_t)w >= l) {
+                w -= (ssize_t)l;
+                continue;
+            }
+            if (outq_append(out, (const char *)iov[k].iov_base + w, l - (size_t)w) < 0)
+                return -1;
+            w = 0;
+        }
+    }
+    for (; i >= 0; i = g->ent[i].next)
+        if (outq_append(out, g->ent[i].p, g->ent[i].len) < 0) return -1;
+    return outq_bytes(out) > 0;
+}
+
+/* Forget every answer and reclaim the arena; all queues must be flushed. */
+static inline void gather_reset(struct gather *g)
+{
+    g->used     = 0;
+    g->n        = 0;
+    g->ntouched = 0;
+}
+
+#endif /* GATHER_H */
@@ -0,0 +1,225 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+/*
+ * linux/common/handoff.h
+ *
+ * Header-only file-descriptor handoff between two processes, for hot
+ * restarts.
+ *
+ * A running server listens on an abstract-namespace AF_UNIX
+ * SOCK_SEQPACKET socket; its replacement connects and is sent records:
+ * a byte string with up to HANDOFF_MAXFD descriptors attached as
+ * SCM_RIGHTS.  The descriptors arrive as new fds referring to the same
+ * open sockets, so a listening socket keeps its accept queue and a
+ * connection keeps everything the kernel buffered for it.  Closing the
+ * sender's copy after the send does not affect the receiver's.
+ *
+ * A record longer than one message is split into HANDOFF_MSG-byte
+ * messages; the first one carries the total length and the descriptors.
+ * Only a process of the same user may connect (SO_PEERCRED).
+ *
+ * All calls block: a handoff is a one-off, and both ends do nothing else
+ * while it runs.  accept4() and struct ucred are GNU extensions: define
+ * _GNU_SOURCE before the first #include.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define HANDOFF_MSG   (64 * 1024)            /* bytes per message */
+#define HANDOFF_MAXFD 8                      /* descriptors per record */
+
+static inline socklen_t handoff_addr(struct sockaddr_un *a, const char *name)
+{
+    memset(a, 0, sizeof(*a));
+    a->sun_family = AF_UNIX;
+    size_t n = strlen(name);
+    if (n > sizeof(a->sun_path) - 1) n = sizeof(a->sun_path) - 1;
+    memcpy(a->sun_path + 1, name, n);        /* sun_path[0] = 0: abstract */
+    return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + n);
+}
+
+/* Listen for a successor under name.  Returns the fd, or -1 with errno. */
+static inline int handoff_listen(const char *name)
+{
+    struct sockaddr_un a;
+    socklen_t al = handoff_addr(&a, name);
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+    if (bind(fd, (struct sockaddr *)&a, al) < 0 || listen(fd, 1) < 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Accept a successor on the listener, blocking from then on.  Returns -1
+ * with errno EAGAIN if none is waiting, EPERM if it runs as another user.
+ */
+static inline int handoff_accept(int lfd)
+{
+    int fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0) return -1;
+    struct ucred cr;
+    socklen_t cl = sizeof(cr);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cr, &cl) < 0 || cr.uid != geteuid()) {
+        close(fd);
+        errno = EPERM;
+        return -1;
+    }
+    return fd;
+}
+
+/* Connect to the process listening under name. */
+static inline int handoff_connect(const char *name)
+{
+    struct sockaddr_un a;
+    socklen_t al = handoff_addr(&a, name);
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&a, al) < 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    return fd;
+}
+
+/* One message, with fds attached if nfds > 0. */
+static inline int handoff_sendmsg(int sock, const int *fds, int nfds,
+                                  const void *a, size_t alen, const void *b, size_t blen)
+{
+    union {
+        char           buf[CMSG_SPACE(sizeof(int) * HANDOFF_MAXFD)];
+        struct cmsghdr align;
+    } ctl;
+    struct iovec iov[2] = {
+        { (void *)a, alen },
+        { (void *)b, blen },
+    };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = blen ? 2 : 1;
+    if (nfds > 0) {
+        memset(&ctl, 0, sizeof(ctl));
+        msg.msg_control    = ctl.buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * (size_t)nfds);
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type  = SCM_RIGHTS;
+        cm->cmsg_len   = CMSG_LEN(sizeof(int) * (size_t)nfds);
+        memcpy(CMSG_DATA(cm), fds, sizeof(int) * (size_t)nfds);
+    }
+    for (;;) {
+        ssize_t w = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        if (w >= 0) return 0;
+        if (errno != EINTR) return -1;
+    }
+}
+
+/*
+ * Send len bytes of buf with nfds descriptors (at most HANDOFF_MAXFD).
+ * The caller may close its descriptors once this returns.  Returns 0, or
+ * -1 with errno set.
+ */
+static inline int handoff_send(int sock, const int *fds, int nfds, const void *buf, size_t len)
+{
+    if (nfds < 0 || nfds > HANDOFF_MAXFD || len > UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    const char *p = (const char *)buf;
+    uint32_t total = (uint32_t)len;
+    size_t first = len < HANDOFF_MSG - sizeof(total) ? len : HANDOFF_MSG - sizeof(total);
+    if (handoff_sendmsg(sock, fds, nfds, &total, sizeof(total), p, first) < 0) return -1;
+    for (size_t off = first; off < len; ) {
+        size_t n = len - off < HANDOFF_MSG ? len - off : HANDOFF_MSG;
+        if (handoff_sendmsg(sock, NULL, 0, p + off, n, NULL, 0) < 0) return -1;
+        off += n;
+    }
+    return 0;
+}
+
+/*
+ * Receive one record: returns it in a malloc()'d buffer of *len bytes
+ * (free() it) and its descriptors in fds[0..*nfds), close-on-exec.
+ * Returns NULL with errno set on error, ECONNRESET if the sender went
+ * away; descriptors that came with a bad record are closed.
+ */
+static inline void *handoff_recv(int sock, int *fds, int maxfds, int *nfds, size_t *len)
+{
+    union {
+        char           buf[CMSG_SPACE(sizeof(int) * HANDOFF_MAXFD)];
+        struct cmsghdr align;
+    } ctl;
+    char *msgbuf = (char *)malloc(HANDOFF_MSG);
+    if (!msgbuf) return NULL;
+    struct iovec iov = { msgbuf, HANDOFF_MSG };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = ctl.buf;
+    msg.msg_controllen = sizeof(ctl.buf);
+
+    ssize_t r;
+    while ((r = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR) { }
+    *nfds = 0;
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); r >= 0 && cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS) continue;
+        int n = (int)((cm->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        for (int i = 0; i < n; i++) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cm) + i * sizeof(int), sizeof(int));
+            if (*nfds < maxfds) fds[(*nfds)++] = fd;
+            else                close(fd);
+        }
+    }
+
+    uint32_t total = 0;
+    char *out = NULL;
+    int err = 0;
+    if (r < 0)                                   err = errno;
+    else if (r == 0)                             err = ECONNRESET;
+    else if ((size_t)r < sizeof(total) || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+                                                 err = EPROTO;
+    if (!err) {
+        memcpy(&total, msgbuf, sizeof(total));
+        size_t got = (size_t)r - sizeof(total);
+        if (got > total || !(out = (char *)malloc(total ? total : 1))) {
+            err = got > total ? EPROTO : ENOMEM;
+        } else {
+            memcpy(out, msgbuf + sizeof(total), got);
+            while (!err && got < total) {
+                while ((r = recv(sock, out + got, total - got, 0)) < 0 && errno == EINTR) { }
+                if (r <= 0) err = r < 0 ? errno : ECONNRESET;
+                else        got += (size_t)r;
+            }
+        }
+    }
+    free(msgbuf);
+    if (err) {
+        free(out);
+        for (int i = 0; i < *nfds; i++) close(fds[i]);
+        *nfds = 0;
+        errno = err;
+        return NULL;
+    }
+    *len = total;
+    return out;
+}
+
+#endif /* HANDOFF_H */
@@ -0,0 +1,105 @@
+#ifndef HDR_HIST_H
+#define HDR_HIST_H
+
+/*
+ * linux/common/hdr_hist.h
+ *
+ * Header-only HDR-style latency histogram.
+ *
+ * Values (any unit, usually ns) are bucketed log-linearly: every power of
+ * two is split into HDR_SUB_COUNT / 2 linear sub-buckets, which bounds the
+ * relative error to 2 / HDR_SUB_COUNT (~1.6%) over the full uint64 range
+ * with a fixed, allocation-free counts array.  Recording is one clz, a
+ * shift and an increment.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#define HDR_SUB_BITS  7
+#define HDR_SUB_COUNT (1u << HDR_SUB_BITS)           /* 128 */
+#define HDR_HALF      (HDR_SUB_COUNT / 2)            /* 64  */
+#define HDR_COUNTS    ((64 - HDR_SUB_BITS + 2) * HDR_HALF)
+
+struct hdr_hist {
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+    uint64_t counts[HDR_COUNTS];
+};
+
+static inline void hdr_init(struct hdr_hist *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+static inline unsigned hdr_index(uint64_t v)
+{
+    if (v < HDR_SUB_COUNT) return (unsigned)v;
+    unsigned msb   = 63u - (unsigned)__builtin_clzll(v);
+    unsigned shift = msb - (HDR_SUB_BITS - 1);
+    return (shift + 1) * HDR_HALF + (unsigned)(v >> shift) - HDR_HALF;
+}
+
+/* Largest value that maps to bucket idx. */
+static inline uint64_t hdr_bucket_high(unsigned idx)
+{
+    if (idx < HDR_SUB_COUNT) return idx;
+    unsigned shift = idx / HDR_HALF - 1;
+    uint64_t sub   = idx % HDR_HALF + HDR_HALF;
+    return ((sub + 1) << shift) - 1;
+}
+
+static inline void hdr_record_n(struct hdr_hist *h, uint64_t v, uint64_t n)
+{
+    h->counts[hdr_index(v)] += n;
+    h->total += n;
+    h->sum   += v * n;
+    if (v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+}
+
+static inline void hdr_record(struct hdr_hist *h, uint64_t v)
+{
+    hdr_record_n(h, v, 1);
+}
+
+static inline void hdr_merge(struct hdr_hist *dst, const struct hdr_hist *src)
+{
+    for (unsigned i = 0; i < HDR_COUNTS; i++) dst->counts[i] += src->counts[i];
+    dst->total += src->total;
+    dst->sum   += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+/*
+ * Value at percentile p (0..100): the highest value equivalent to the
+ * bucket holding that rank, clamped to the exact recorded max.
+ */
+static inline uint64_t hdr_percentile(const struct hdr_hist *h, double p)
+{
+    if (h->total == 0) return 0;
+    uint64_t rank = (uint64_t)((p / 100.0) * (double)h->total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > h->total) rank = h->total;
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HDR_COUNTS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t v = hdr_bucket_high(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+static inline double hdr_mean(const struct hdr_hist *h)
+{
+    return h->total ? (double)h->sum / (double)h->total : 0.0;
+}
+
+#endif /* HDR_HIST_H */
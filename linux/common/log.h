@@ -0,0 +1,602 @@
+#ifndef LOG_H
+#define LOG_H
+
+/*
+ * linux/common/log.h
+ *
+ * Header-only asynchronous logger that keeps stdio off the I/O threads.
+ *
+ * LOG_INFO("[server] recv (fd=%d): %.*s", fd, len, p) does no formatting
+ * and takes no lock: it copies the format pointer and the raw argument
+ * values (string arguments by value) into a fixed-size binary record in
+ * the calling thread's single-producer/single-consumer ring.  The format
+ * is parsed once per call site, the first time it logs.  One background
+ * thread drains every ring, merging them by timestamp, runs the printf
+ * formatting and writes the text out in large batches — ERROR and WARN
+ * to stderr, the rest to stdout.  When a ring is full the record is dropped and counted,
+ * never waited for; the drop count is reported in the output.
+ *
+ * Levels are filtered twice: at compile time against LOG_COMPILE_LEVEL
+ * (calls above it compile to nothing) and at run time against the level
+ * set by log_init() from $LOG_LEVEL (error|warn|info|debug, default info).
+ *
+ * Formats must be string literals.  Supported conversions: d i u x X o c
+ * p s and e f g a (any case), with flags, width, precision ('*' too) and
+ * the hh h l ll z j t length modifiers.  Strings longer than fit in one
+ * record, and conversions past LOG_MAX_ARGS, are truncated.
+ *
+ * Logger state is static, so include this from the one translation unit
+ * that owns main().  Before log_init() (and after log_shutdown()) calls
+ * print synchronously.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define LOG_LVL_ERROR 0
+#define LOG_LVL_WARN  1
+#define LOG_LVL_INFO  2
+#define LOG_LVL_DEBUG 3
+
+#ifndef LOG_COMPILE_LEVEL
+#  define LOG_COMPILE_LEVEL LOG_LVL_DEBUG
+#endif
+
+#define LOG_RING_SLOTS 1024              /* records per thread, power of two */
+#define LOG_SLOT       256               /* bytes per record */
+#define LOG_MAX_RINGS  64                /* producer threads */
+#define LOG_IDLE_NS    1000000           /* consumer poll interval when idle */
+
+#define LOG_MAX_ARGS   16                /* conversions packed per call */
+
+/* Each call site parses its format once and keeps the result here. */
+#define LOG_AT(lvl, ...)                                                    \
+    do {                                                                    \
+        static struct log_site log_site_;                                   \
+        if ((lvl) <= LOG_COMPILE_LEVEL &&                                   \
+            (lvl) <= __atomic_load_n(&log_level, __ATOMIC_RELAXED))         \
+            log_write(&log_site_, (lvl), __VA_ARGS__);                      \
+    } while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LVL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...)  LOG_AT(LOG_LVL_WARN,  __VA_ARGS__)
+#define LOG_INFO(...)  LOG_AT(LOG_LVL_INFO,  __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LVL_DEBUG, __VA_ARGS__)
+
+/* How each argument of a format is fetched and packed. */
+enum {
+    LOG_A_INT, LOG_A_SHORT, LOG_A_SCHAR, LOG_A_LONG, LOG_A_LLONG,
+    LOG_A_UINT, LOG_A_USHORT, LOG_A_UCHAR, LOG_A_ULONG, LOG_A_ULLONG,
+    LOG_A_PTR, LOG_A_DOUBLE,
+    LOG_A_WIDTH,                         /* '*' width */
+    LOG_A_PREC,                          /* '*' precision, applies to a following %s */
+    LOG_A_STR,
+};
+
+struct log_sig {
+    uint8_t nargs;
+    uint8_t partial;                     /* more than LOG_MAX_ARGS conversions */
+    uint8_t kind[LOG_MAX_ARGS];
+    int16_t prec[LOG_MAX_ARGS];          /* fixed %.Ns precision, -1 if none */
+};
+
+struct log_site {
+    int            state;                /* 0 new, 1 being filled, 2 ready */
+    struct log_sig sig;
+};
+
+struct log_rec {
+    const char   *fmt;
+    uint64_t      ts;                    /* log_now() ticks, for merging */
+    uint16_t      len;                   /* bytes of data[] in use */
+    uint8_t       level;
+    uint8_t       truncated;             /* an argument did not fit */
+    unsigned char data[LOG_SLOT - 24];   /* packed argument values */
+};
+
+struct log_ring {
+    uint32_t       head __attribute__((aligned(64)));  /* consumer */
+    uint32_t       tail __attribute__((aligned(64)));  /* producer */
+    uint64_t       dropped;              /* producer-owned, read relaxed */
+    uint64_t       reported __attribute__((aligned(64)));  /* consumer */
+    struct log_rec slots[LOG_RING_SLOTS];
+};
+
+static int               log_level = LOG_LVL_INFO;
+static int               log_started;
+static int               log_stop;
+static pthread_t         log_thread;
+static struct log_ring  *log_rings[LOG_MAX_RINGS];
+static unsigned          log_nrings;
+static uint64_t          log_lost;       /* records with no ring to go to */
+static __thread struct log_ring *log_tls;
+
+static inline void log_set_level(int level)
+{
+    __atomic_store_n(&log_level, level, __ATOMIC_RELAXED);
+}
+
+/* ── Producer side ──────────────────────────────────────────────────────── */
+
+static inline struct log_ring *log_ring_get(void)
+{
+    if (log_tls) return log_tls;
+    unsigned idx = __atomic_load_n(&log_nrings, __ATOMIC_RELAXED);
+    do {
+        if (idx >= LOG_MAX_RINGS) return NULL;
+    } while (!__atomic_compare_exchange_n(&log_nrings, &idx, idx + 1, 0,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    struct log_ring *r;
+    if (posix_memalign((void **)&r, 64, sizeof(*r)) != 0) return NULL;
+    memset(r, 0, sizeof(*r));
+    __atomic_store_n(&log_rings[idx], r, __ATOMIC_RELEASE);
+    log_tls = r;
+    return r;
+}
+
+/* Append n bytes to the record; 0 if they do not fit. */
+static inline int log_put(struct log_rec *rec, const void *p, size_t n)
+{
+    if (rec->len + n > sizeof(rec->data)) return 0;
+    memcpy(rec->data + rec->len, p, n);
+    rec->len = (uint16_t)(rec->len + n);
+    return 1;
+}
+
+/*
+ * Merge key.  The TSC is a few ns to read against tens for a vDSO
+ * clock_gettime() on some hosts, and only the order matters; elsewhere
+ * fall back to the monotonic clock.
+ */
+static inline uint64_t log_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#endif
+}
+
+/* Work out what each conversion in fmt takes from the argument list. */
+static inline void log_sig_parse(struct log_sig *sig, const char *fmt)
+{
+    memset(sig, 0, sizeof(*sig));
+#define LOG_ARG(k, pr)                                                      \
+    do {                                                                    \
+        if (sig->nargs == LOG_MAX_ARGS) { sig->partial = 1; return; }       \
+        sig->prec[sig->nargs]   = (int16_t)(pr);                            \
+        sig->kind[sig->nargs++] = (uint8_t)(k);                             \
+    } while (0)
+
+    for (const char *p = fmt; *p; p++) {
+        if (*p != '%') continue;
+        if (*++p == '%') continue;
+        for (;; p++) {
+            switch (*p) {
+            case '-': case '+': case ' ': case '#': case '0': continue;
+            }
+            break;
+        }
+        if (*p == '*') { LOG_ARG(LOG_A_WIDTH, -1); p++; }
+        while (*p >= '0' && *p <= '9') p++;
+        long prec = -1;
+        if (*p == '.') {
+            p++;
+            if (*p == '*') {
+                LOG_ARG(LOG_A_PREC, -1);
+                p++;
+            } else {
+                for (prec = 0; *p >= '0' && *p <= '9'; p++)
+                    if (prec < INT16_MAX) prec = prec * 10 + (*p - '0');
+                if (prec > INT16_MAX) prec = INT16_MAX;
+            }
+        }
+        int longs = 0, shorts = 0;
+        for (;; p++) {
+            if (*p == 'l')                            longs++;
+            else if (*p == 'h')                       shorts++;
+            else if (*p == 'z' || *p == 'j' || *p == 't') longs = 1;
+            else break;
+        }
+        switch (*p) {
+        case 'd': case 'i':
+            LOG_ARG(shorts == 2 ? LOG_A_SCHAR : shorts ? LOG_A_SHORT
+                    : longs >= 2 ? LOG_A_LLONG : longs ? LOG_A_LONG : LOG_A_INT, -1);
+            break;
+        case 'u': case 'x': case 'X': case 'o': case 'c':
+            LOG_ARG(shorts == 2 ? LOG_A_UCHAR : shorts ? LOG_A_USHORT
+                    : longs >= 2 ? LOG_A_ULLONG : longs ? LOG_A_ULONG : LOG_A_UINT, -1);
+            break;
+        case 'p':
+            LOG_ARG(LOG_A_PTR, -1);
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            LOG_ARG(LOG_A_DOUBLE, -1);
+            break;
+        case 's':
+            LOG_ARG(LOG_A_STR, prec);
+            break;
+        default:
+            return;                      /* unsupported: stop packing */
+        }
+    }
+#undef LOG_ARG
+}
+
+/*
+ * Pack the arguments as sig describes them: integers as 64-bit, floating
+ * point as double, '*' widths and precisions as int, strings as a 16-bit
+ * length plus the bytes that will be printed.
+ */
+static inline void log_pack_sig(struct log_rec *rec, const struct log_sig *sig, va_list ap)
+{
+    int star = -1;
+    for (unsigned i = 0; i < sig->nargs; i++) {
+        uint64_t v;
+        switch (sig->kind[i]) {
+        case LOG_A_INT:    v = (uint64_t)(int64_t)va_arg(ap, int);                       break;
+        case LOG_A_SHORT:  v = (uint64_t)(int64_t)(short)va_arg(ap, int);                break;
+        case LOG_A_SCHAR:  v = (uint64_t)(int64_t)(signed char)va_arg(ap, int);          break;
+        case LOG_A_LONG:   v = (uint64_t)(int64_t)va_arg(ap, long);                      break;
+        case LOG_A_LLONG:  v = (uint64_t)va_arg(ap, long long);                          break;
+        case LOG_A_UINT:   v = va_arg(ap, unsigned);                                     break;
+        case LOG_A_USHORT: v = (unsigned short)va_arg(ap, unsigned);                     break;
+        case LOG_A_UCHAR:  v = (unsigned char)va_arg(ap, unsigned);                      break;
+        case LOG_A_ULONG:  v = va_arg(ap, unsigned long);                                break;
+        case LOG_A_ULLONG: v = va_arg(ap, unsigned long long);                           break;
+        case LOG_A_PTR:    v = (uint64_t)(uintptr_t)va_arg(ap, void *);                  break;
+        case LOG_A_DOUBLE: {
+            double d = va_arg(ap, double);
+            if (!log_put(rec, &d, sizeof(d))) goto full;
+            continue;
+        }
+        case LOG_A_WIDTH: case LOG_A_PREC: {
+            int w = va_arg(ap, int);
+            if (!log_put(rec, &w, sizeof(w))) goto full;
+            star = sig->kind[i] == LOG_A_PREC ? w : -1;
+            continue;
+        }
+        default: {                       /* LOG_A_STR */
+            const char *s = va_arg(ap, const char *);
+            if (!s) s = "(null)";
+            long prec = i > 0 && sig->kind[i - 1] == LOG_A_PREC ? star : sig->prec[i];
+            size_t room = sizeof(rec->data) - rec->len;
+            if (room < sizeof(uint16_t)) goto full;
+            room -= sizeof(uint16_t);
+            size_t lim = prec >= 0 && (size_t)prec < room ? (size_t)prec : room;
+            size_t n = strnlen(s, lim);
+            if (n == room && (prec < 0 || (size_t)prec > room) && s[n]) rec->truncated = 1;
+            uint16_t l = (uint16_t)n;
+            memcpy(rec->data + rec->len, &l, sizeof(l));
+            memcpy(rec->data + rec->len + sizeof(l), s, n);
+            rec->len = (uint16_t)(rec->len + sizeof(l) + n);
+            continue;
+        }
+        }
+        if (!log_put(rec, &v, sizeof(v))) goto full;
+    }
+    return;
+full:
+    rec->truncated = 1;
+}
+
+/* One-off packing without a call site (parses fmt every time). */
+static inline void log_pack(struct log_rec *rec, const char *fmt, va_list ap)
+{
+    struct log_sig sig;
+    log_sig_parse(&sig, fmt);
+    if (sig.partial) rec->truncated = 1;
+    log_pack_sig(rec, &sig, ap);
+}
+
+static inline void log_write(struct log_site *site, int level, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    if (!__atomic_load_n(&log_started, __ATOMIC_ACQUIRE)) {
+        vfprintf(level <= LOG_LVL_WARN ? stderr : stdout, fmt, ap);
+        va_end(ap);
+        return;
+    }
+
+    struct log_ring *r = log_ring_get();
+    if (!r) {
+        __atomic_fetch_add(&log_lost, 1, __ATOMIC_RELAXED);
+        va_end(ap);
+        return;
+    }
+    uint32_t tail = r->tail;
+    if (tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == LOG_RING_SLOTS) {
+        __atomic_store_n(&r->dropped, r->dropped + 1, __ATOMIC_RELAXED);
+        va_end(ap);
+        return;
+    }
+
+    /* First call from this site parses the format; one thread publishes it. */
+    struct log_sig local;
+    const struct log_sig *sig = &site->sig;
+    if (__atomic_load_n(&site->state, __ATOMIC_ACQUIRE) != 2) {
+        int fresh = 0;
+        log_sig_parse(&local, fmt);
+        sig = &local;
+        if (__atomic_compare_exchange_n(&site->state, &fresh, 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            site->sig = local;
+            __atomic_store_n(&site->state, 2, __ATOMIC_RELEASE);
+        }
+    }
+
+    struct log_rec *rec = &r->slots[tail & (LOG_RING_SLOTS - 1)];
+    rec->ts        = log_now();
+    rec->fmt       = fmt;
+    rec->level     = (uint8_t)level;
+    rec->len       = 0;
+    rec->truncated = sig->partial;
+    log_pack_sig(rec, sig, ap);
+    va_end(ap);
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/* ── Consumer side ──────────────────────────────────────────────────────── */
+
+struct log_out {
+    FILE  *f;
+    size_t n;
+    char   buf[64 * 1024];
+};
+
+static inline void log_out_flush(struct log_out *o)
+{
+    if (o->n == 0) return;
+    fwrite(o->buf, 1, o->n, o->f);
+    fflush(o->f);
+    o->n = 0;
+}
+
+/* Take n bytes from the record, or return 0 if it ran out. */
+static inline int log_take(const struct log_rec *rec, size_t *off, void *v, size_t n)
+{
+    if (*off + n > rec->len) return 0;
+    memcpy(v, rec->data + *off, n);
+    *off += n;
+    return 1;
+}
+
+/* Re-run the printf formatting of one record into o. */
+static inline void log_format(const struct log_rec *rec, struct log_out *o)
+{
+    if (sizeof(o->buf) - o->n < LOG_SLOT * 4) log_out_flush(o);
+
+    char  *out = o->buf + o->n;
+    size_t cap = sizeof(o->buf) - o->n - 1, n = 0, off = 0;
+    const char *p = rec->fmt;
+
+#define LOG_EMIT(...)                                                       \
+    do {                                                                    \
+        int k_ = snprintf(out + n, cap - n, __VA_ARGS__);                   \
+        if (k_ > 0) n += (size_t)k_ < cap - n ? (size_t)k_ : cap - n - 1;   \
+    } while (0)
+
+    while (*p && n < cap - 1) {
+        if (*p != '%') { out[n++] = *p++; continue; }
+        if (p[1] == '%') { out[n++] = '%'; p += 2; continue; }
+
+        /* Rebuild the conversion spec with values taken from the record. */
+        char spec[32];
+        size_t sl = 0;
+        spec[sl++] = *p++;
+        while (*p && strchr("-+ #0", *p) && sl < 8) spec[sl++] = *p++;
+        if (*p == '*') {
+            int w;
+            if (!log_take(rec, &off, &w, sizeof(w))) goto cut;
+            sl += (size_t)snprintf(spec + sl, sizeof(spec) - sl, "%d", w);
+            p++;
+        }
+        while (*p >= '0' && *p <= '9' && sl < 16) spec[sl++] = *p++;
+        int has_prec = 0;
+        char prec[16] = "";
+        if (*p == '.') {
+            has_prec = 1;
+            p++;
+            if (*p == '*') {
+                int v;
+                if (!log_take(rec, &off, &v, sizeof(v))) goto cut;
+                if (v < 0) has_prec = 0;
+                else snprintf(prec, sizeof(prec), ".%d", v);
+                p++;
+            } else {
+                size_t pl = 0;
+                prec[pl++] = '.';
+                while (*p >= '0' && *p <= '9' && pl < sizeof(prec) - 1) prec[pl++] = *p++;
+                prec[pl] = '\0';
+            }
+        }
+        while (*p && strchr("hlzjt", *p)) p++;
+        char conv = *p;
+        if (!conv) break;
+        p++;
+
+        switch (conv) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': {
+            uint64_t v;
+            if (!log_take(rec, &off, &v, sizeof(v))) goto cut;
+            snprintf(spec + sl, sizeof(spec) - sl, "%sll%c", has_prec ? prec : "", conv);
+            if (conv == 'd' || conv == 'i') LOG_EMIT(spec, (long long)v);
+            else                            LOG_EMIT(spec, (unsigned long long)v);
+            break;
+        }
+        case 'c': {
+            uint64_t v;
+            if (!log_take(rec, &off, &v, sizeof(v))) goto cut;
+            snprintf(spec + sl, sizeof(spec) - sl, "c");
+            LOG_EMIT(spec, (int)v);
+            break;
+        }
+        case 'p': {
+            uint64_t v;
+            if (!log_take(rec, &off, &v, sizeof(v))) goto cut;
+            snprintf(spec + sl, sizeof(spec) - sl, "p");
+            LOG_EMIT(spec, (void *)(uintptr_t)v);
+            break;
+        }
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A': {
+            double v;
+            if (!log_take(rec, &off, &v, sizeof(v))) goto cut;
+            snprintf(spec + sl, sizeof(spec) - sl, "%s%c", has_prec ? prec : "", conv);
+            LOG_EMIT(spec, v);
+            break;
+        }
+        case 's': {
+            uint16_t l;
+            if (!log_take(rec, &off, &l, sizeof(l)) || off + l > rec->len) goto cut;
+            snprintf(spec + sl, sizeof(spec) - sl, ".*s");
+            LOG_EMIT(spec, (int)l, (const char *)rec->data + off);
+            off += l;
+            break;
+        }
+        default:
+            goto cut;
+        }
+    }
+    if (rec->truncated) goto cut;
+    o->n += n;
+    return;
+
+cut:
+    /* Keep the line a line: mark where the record ran out. */
+    if (n > 0 && out[n - 1] == '\n') n--;
+    static const char mark[] = "...[truncated]\n";
+    if (n > cap - (sizeof(mark) - 1)) n = cap - (sizeof(mark) - 1);
+    memcpy(out + n, mark, sizeof(mark) - 1);
+    o->n += n + sizeof(mark) - 1;
+#undef LOG_EMIT
+}
+
+static inline void log_report_drops(struct log_ring *r, unsigned i, struct log_out *err)
+{
+    uint64_t d = __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+    if (d == r->reported) return;
+    char line[96];
+    snprintf(line, sizeof(line), "[log] %llu message(s) dropped, ring %u full\n",
+             (unsigned long long)(d - r->reported), i);
+    struct log_rec note = { "%s", 0, 0, LOG_LVL_WARN, 0, {0} };
+    uint16_t l = (uint16_t)strlen(line);
+    log_put(&note, &l, sizeof(l));
+    log_put(&note, line, l);
+    log_format(&note, err);
+    r->reported = d;
+}
+
+/*
+ * Background writer.  Each pass snapshots every ring's tail and emits the
+ * records up to it oldest first, so lines from different threads come out
+ * in time order (exact within a pass, best effort across passes).
+ */
+static inline void *log_main(void *arg)
+{
+    (void)arg;
+    static struct log_out out, err;
+    static uint32_t head[LOG_MAX_RINGS], tail[LOG_MAX_RINGS];
+    out.f = stdout;
+    err.f = stderr;
+
+    for (;;) {
+        int stop = __atomic_load_n(&log_stop, __ATOMIC_ACQUIRE);
+        unsigned nr = __atomic_load_n(&log_nrings, __ATOMIC_ACQUIRE);
+        if (nr > LOG_MAX_RINGS) nr = LOG_MAX_RINGS;
+
+        for (unsigned i = 0; i < nr; i++) {
+            struct log_ring *r = __atomic_load_n(&log_rings[i], __ATOMIC_ACQUIRE);
+            head[i] = tail[i] = 0;
+            if (!r) continue;
+            head[i] = r->head;
+            tail[i] = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        }
+
+        size_t got = 0;
+        for (;;) {
+            int best = -1;
+            uint64_t best_ts = UINT64_MAX;
+            for (unsigned i = 0; i < nr; i++) {
+                if (head[i] == tail[i]) continue;
+                const struct log_rec *rec = &log_rings[i]->slots[head[i] & (LOG_RING_SLOTS - 1)];
+                if (rec->ts < best_ts) { best_ts = rec->ts; best = (int)i; }
+            }
+            if (best < 0) break;
+
+            struct log_ring *r = log_rings[best];
+            const struct log_rec *rec = &r->slots[head[best] & (LOG_RING_SLOTS - 1)];
+            log_format(rec, rec->level <= LOG_LVL_WARN ? &err : &out);
+            head[best]++;
+            got++;
+            /* Hand slots back in batches, not one cache-line bounce each. */
+            if ((head[best] & 63) == 0) __atomic_store_n(&r->head, head[best], __ATOMIC_RELEASE);
+        }
+
+        for (unsigned i = 0; i < nr; i++) {
+            struct log_ring *r = __atomic_load_n(&log_rings[i], __ATOMIC_ACQUIRE);
+            if (!r) continue;
+            __atomic_store_n(&r->head, head[i], __ATOMIC_RELEASE);
+            log_report_drops(r, i, &err);
+        }
+        log_out_flush(&err);
+        log_out_flush(&out);
+
+        if (got == 0) {
+            if (stop) break;
+            struct timespec ts = { 0, LOG_IDLE_NS };
+            nanosleep(&ts, NULL);
+        }
+    }
+    return NULL;
+}
+
+/* Drain everything logged so far and stop the background thread. */
+static inline void log_shutdown(void)
+{
+    if (!__atomic_load_n(&log_started, __ATOMIC_ACQUIRE)) return;
+    __atomic_store_n(&log_stop, 1, __ATOMIC_RELEASE);
+    pthread_join(log_thread, NULL);
+    __atomic_store_n(&log_started, 0, __ATOMIC_RELEASE);
+
+    uint64_t lost = __atomic_load_n(&log_lost, __ATOMIC_RELAXED);
+    if (lost)
+        fprintf(stderr, "[log] %llu message(s) dropped, too many threads\n",
+                (unsigned long long)lost);
+    /* Rings stay allocated: a thread may still hold its log_tls pointer. */
+}
+
+static inline int log_parse_level(const char *s)
+{
+    if (!s || !*s)                 return LOG_LVL_INFO;
+    if (*s >= '0' && *s <= '3')    return *s - '0';
+    if (!strcmp(s, "error"))       return LOG_LVL_ERROR;
+    if (!strcmp(s, "warn"))        return LOG_LVL_WARN;
+    if (!strcmp(s, "debug"))       return LOG_LVL_DEBUG;
+    return LOG_LVL_INFO;
+}
+
+/*
+ * Start the background writer, with the runtime level from $LOG_LEVEL.
+ * Returns 0, or -1 if the thread could not be started (logging then stays
+ * synchronous).  log_shutdown() also runs at exit().
+ */
+static inline int log_init(void)
+{
+    log_set_level(log_parse_level(getenv("LOG_LEVEL")));
+    if (__atomic_load_n(&log_started, __ATOMIC_ACQUIRE)) return 0;
+    log_stop = 0;
+    if (pthread_create(&log_thread, NULL, log_main, NULL) != 0) return -1;
+    __atomic_store_n(&log_started, 1, __ATOMIC_RELEASE);
+    atexit(log_shutdown);
+    return 0;
+}
+
+#endif /* LOG_H */
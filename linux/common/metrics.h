@@ -0,0 +1,242 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+/*
+ * linux/common/metrics.h
+ *
+ * Header-only live metrics in a shared-memory segment.
+ *
+ * Each event-loop thread counts into a plain struct metrics of its own —
+ * an increment is one add to memory no other thread touches — and once per
+ * loop iteration copies it into its slot of a POSIX shared-memory segment
+ * with metrics_publish().  The copy is bracketed by a sequence counter
+ * (seqlock): odd while the copy is in progress, bumped to the next even
+ * value when it is done.  On x86 publishing is plain stores plus two
+ * compiler barriers; there is no lock, no atomic read-modify-write and no
+ * system call.
+ *
+ * A reader (tools/sockstat) maps the segment read-only and copies a slot
+ * out, retrying while the counter is odd or changes under it.  The server
+ * never waits for a reader and never learns that one exists.
+ *
+ * The segment is /dev/shm/sockdemo.<pid>, created by metrics_create() and
+ * removed by metrics_destroy().
+ *
+ * A server that timestamps requests (tstamp.h) also fills one latency
+ * histogram per stage of a request's way through it.  Until the first
+ * stamped request, publishing skips them, so servers that never stamp
+ * copy no more than before.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define METRICS_MAGIC    0x3274656d6b636f73ull   /* "sockmet2" */
+#define METRICS_PREFIX   "sockdemo."
+#define METRICS_HIST     16                      /* log2 buckets */
+#define METRICS_LAT_HIST 32                      /* log2 buckets of ns, up to 1 s */
+#define METRICS_MAX_SLOT 256
+
+enum {
+    M_ACCEPTS,                                   /* connections accepted */
+    M_CLOSES,                                    /* connections closed */
+    M_BYTES_IN,                                  /* recv()'d */
+    M_BYTES_OUT,                                 /* echoed, sent or queued */
+    M_MSGS,                                      /* lines or frames handled */
+    M_RX_EAGAIN,                                 /* recv() found nothing */
+    M_TX_EAGAIN,                                 /* send left bytes queued */
+    M_LOOPS,                                     /* epoll_wait() returns */
+    M_EVENTS,                                    /* events those returned */
+    M_TIMEOUTS,                                  /* closed on a deadline */
+    M_STAMPED,                                   /* recv()s with a kernel RX stamp */
+    M_NCOUNTERS
+};
+
+static const char *const metrics_names[M_NCOUNTERS] = {
+    "accepts", "closes", "bytes_in", "bytes_out", "msgs",
+    "rx_eagain", "tx_eagain", "loops", "events", "timeouts", "stamped",
+};
+
+/* Stages of a request, from the kernel's RX stamp to its TX stamp. */
+enum {
+    S_QUEUED,                                    /* RX stamp to epoll_wait() return, loop busy */
+    S_WAKEUP,                                    /* the same, loop asleep in epoll_wait() */
+    S_DISPATCH,                                  /* epoll_wait() return to recv() return */
+    S_HANDLER,                                   /* recv() return to the answer's sendmsg() */
+    S_TX,                                        /* sendmsg() to the kernel's TX stamp */
+    M_NSTAGES
+};
+
+static const char *const metrics_stages[M_NSTAGES] = {
+    "queued", "wakeup", "dispatch", "handler", "tx",
+};
+
+/* One thread's numbers since it started.  Written by that thread only. */
+struct metrics {
+    uint64_t c[M_NCOUNTERS];
+    uint64_t events_hist[METRICS_HIST];          /* events per epoll_wait() */
+    uint64_t recv_hist[METRICS_HIST];            /* bytes per recv() */
+    uint64_t stage_hist[M_NSTAGES][METRICS_LAT_HIST];   /* ns per stage */
+};
+
+struct metrics_slot {
+    uint32_t       seq;                          /* odd while being written */
+    uint32_t       used;                         /* a thread publishes here */
+    struct metrics m;
+} __attribute__((aligned(64)));
+
+struct metrics_shm {
+    uint64_t            magic;
+    uint32_t            nslots;
+    int32_t             pid;
+    uint64_t            start_ns;                /* CLOCK_MONOTONIC */
+    char                name[32];                /* which server */
+    struct metrics_slot slot[];
+};
+
+/* Histogram bucket of v: 0 for 0, else 1 + floor(log2(v)), capped. */
+static inline unsigned metrics_bucket(uint64_t v)
+{
+    unsigned b = v ? 64u - (unsigned)__builtin_clzll(v) : 0u;
+    return b < METRICS_HIST ? b : METRICS_HIST - 1;
+}
+
+/* metrics_bucket() for stage latencies in ns. */
+static inline unsigned metrics_lat_bucket(uint64_t ns)
+{
+    unsigned b = ns ? 64u - (unsigned)__builtin_clzll(ns) : 0u;
+    return b < METRICS_LAT_HIST ? b : METRICS_LAT_HIST - 1;
+}
+
+static inline size_t metrics_size(unsigned nslots)
+{
+    return sizeof(struct metrics_shm) + (size_t)nslots * sizeof(struct metrics_slot);
+}
+
+static inline void metrics_path(char *buf, size_t len, int pid)
+{
+    snprintf(buf, len, "/" METRICS_PREFIX "%d", pid);
+}
+
+/*
+ * Create this process's segment with nslots thread slots.  Returns NULL
+ * with errno set on failure; the server then runs without one.
+ */
+static inline struct metrics_shm *metrics_create(const char *name, unsigned nslots)
+{
+    char path[64];
+    if (nslots > METRICS_MAX_SLOT) nslots = METRICS_MAX_SLOT;
+    metrics_path(path, sizeof(path), (int)getpid());
+    shm_unlink(path);                            /* stale: a dead process had our pid */
+    int fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) return NULL;
+    size_t size = metrics_size(nslots);
+    if (ftruncate(fd, (off_t)size) < 0) {
+        close(fd);
+        shm_unlink(path);
+        return NULL;
+    }
+    struct metrics_shm *s = (struct metrics_shm *)mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                                       MAP_SHARED, fd, 0);
+    close(fd);
+    if (s == MAP_FAILED) {
+        shm_unlink(path);
+        return NULL;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    s->nslots   = nslots;
+    s->pid      = (int32_t)getpid();
+    s->start_ns = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    __atomic_store_n(&s->magic, METRICS_MAGIC, __ATOMIC_RELEASE);   /* readers check it last */
+    return s;
+}
+
+static inline void metrics_destroy(struct metrics_shm *s)
+{
+    if (!s) return;
+    char path[64];
+    metrics_path(path, sizeof(path), s->pid);
+    munmap(s, metrics_size(s->nslots));
+    shm_unlink(path);
+}
+
+/*
+ * Copy m into slot: the writer's whole cost, once per loop iteration.
+ * The stage histograms stay zero, and are not copied, until one is used.
+ */
+static inline void metrics_publish(struct metrics_slot *slot, const struct metrics *m)
+{
+    uint32_t seq = slot->seq;
+    size_t   len = m->c[M_STAMPED] ? sizeof(*m) : offsetof(struct metrics, stage_hist);
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);     /* odd seq before any data */
+    const uint64_t *src = (const uint64_t *)m;
+    uint64_t       *dst = (uint64_t *)&slot->m;
+    for (size_t i = 0; i < len / sizeof(uint64_t); i++)
+        __atomic_store_n(&dst[i], src[i], __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->used, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/*
+ * Attach read-only to pid's segment.  Returns NULL with errno set if there
+ * is none or it is not one of ours.
+ */
+static inline const struct metrics_shm *metrics_open(int pid)
+{
+    char path[64];
+    metrics_path(path, sizeof(path), pid);
+    int fd = shm_open(path, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct metrics_shm)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    const struct metrics_shm *s = (const struct metrics_shm *)mmap(NULL, (size_t)st.st_size,
+                                                                   PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (s == MAP_FAILED) return NULL;
+    if (__atomic_load_n(&s->magic, __ATOMIC_ACQUIRE) != METRICS_MAGIC ||
+        metrics_size(s->nslots) > (size_t)st.st_size) {
+        munmap((void *)s, (size_t)st.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+    return s;
+}
+
+/*
+ * A consistent copy of slot into *m; retries while a publish is under way,
+ * yielding after a few tries in case the writer was preempted mid-copy.
+ * Returns 0, or -1 if no thread has published to the slot yet.
+ */
+static inline int metrics_read(const struct metrics_slot *slot, struct metrics *m)
+{
+    uint64_t *dst = (uint64_t *)m;
+    const uint64_t *src = (const uint64_t *)&slot->m;
+    for (int tries = 0; ; tries++) {
+        if (tries > 64) sched_yield();
+        uint32_t s1 = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) continue;
+        for (size_t i = 0; i < sizeof(*m) / sizeof(uint64_t); i++)
+            dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+        int used = (int)__atomic_load_n(&slot->used, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);     /* data before the re-check */
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == s1) return used ? 0 : -1;
+    }
+}
+
+#endif /* METRICS_H */
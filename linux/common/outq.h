@@ -0,0 +1,204 @@
+#ifndef OUTQ_H
+#define OUTQ_H
+
+/*
+ * linux/common/outq.h
+ *
+ * Header-only per-connection output queue for non-blocking sockets.
+ *
+ * Bytes the kernel would not take are copied into a chain of fixed-size
+ * chunks and flushed later with one sendmsg() per batch of chunks when the
+ * socket becomes writable.  A queue that grows past OUTQ_HIGH_WATER tells
+ * the event loop to stop reading from that connection until it drains
+ * below OUTQ_LOW_WATER, so a slow reader cannot make the server buffer
+ * without bound.
+ *
+ * Chunks come from malloc(), or from a struct bufpool of OUTQ_CHUNK-sized
+ * buffers when the queue is set up with outq_init_pool().
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "bufpool.h"
+
+#define OUTQ_CHUNK      4096                 /* allocation unit, header included */
+#define OUTQ_IOV        16                   /* chunks per sendmsg() */
+#define OUTQ_HIGH_WATER (256 * 1024)         /* pause reading above this */
+#define OUTQ_LOW_WATER  (64 * 1024)          /* resume reading below this */
+
+struct outq_chunk {
+    struct outq_chunk *next;
+    unsigned           start;                /* first unsent byte */
+    unsigned           end;                  /* one past the last byte */
+    char               data[];
+};
+
+#define OUTQ_CHUNK_DATA (OUTQ_CHUNK - sizeof(struct outq_chunk))
+
+struct outq {
+    struct outq_chunk *head;
+    struct outq_chunk *tail;
+    size_t             bytes;                /* queued, not yet sent */
+    struct bufpool    *pool;                 /* chunk source; NULL = malloc */
+};
+
+static inline void outq_init(struct outq *q)
+{
+    q->head  = NULL;
+    q->tail  = NULL;
+    q->bytes = 0;
+    q->pool  = NULL;
+}
+
+/* pool must hand out OUTQ_CHUNK-byte buffers. */
+static inline void outq_init_pool(struct outq *q, struct bufpool *pool)
+{
+    outq_init(q);
+    q->pool = pool;
+}
+
+static inline struct outq_chunk *outq_chunk_new(struct outq *q)
+{
+    return (struct outq_chunk *)(q->pool ? bufpool_get(q->pool) : malloc(OUTQ_CHUNK));
+}
+
+static inline void outq_chunk_free(struct outq *q, struct outq_chunk *c)
+{
+    if (q->pool) bufpool_put(q->pool, c);
+    else         free(c);
+}
+
+static inline size_t outq_bytes(const struct outq *q)
+{
+    return q->bytes;
+}
+
+/* Copy every queued byte, in order, to dst (outq_bytes() of room). */
+static inline void outq_copy(const struct outq *q, void *dst)
+{
+    char *p = (char *)dst;
+    for (const struct outq_chunk *c = q->head; c; c = c->next) {
+        memcpy(p, c->data + c->start, c->end - c->start);
+        p += c->end - c->start;
+    }
+}
+
+/* Drop everything still queued (connection is going away). */
+static inline void outq_clear(struct outq *q)
+{
+    struct outq_chunk *c = q->head;
+    while (c) {
+        struct outq_chunk *next = c->next;
+        outq_chunk_free(q, c);
+        c = next;
+    }
+    q->head  = NULL;
+    q->tail  = NULL;
+    q->bytes = 0;
+}
+
+/*
+ * Copy len bytes to the end of the queue.
+ * Returns 0 on success, -1 if memory ran out.
+ */
+static inline int outq_append(struct outq *q, const void *buf, size_t len)
+{
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        struct outq_chunk *t = q->tail;
+        if (!t || t->end == OUTQ_CHUNK_DATA) {
+            t = outq_chunk_new(q);
+            if (!t) return -1;
+            t->next  = NULL;
+            t->start = 0;
+            t->end   = 0;
+            if (q->tail) q->tail->next = t;
+            else         q->head = t;
+            q->tail = t;
+        }
+        size_t n = OUTQ_CHUNK_DATA - t->end;
+        if (n > len) n = len;
+        memcpy(t->data + t->end, p, n);
+        t->end   += (unsigned)n;
+        q->bytes += n;
+        p        += n;
+        len      -= n;
+    }
+    return 0;
+}
+
+/*
+ * Send queued bytes until the queue is empty or the socket is full.
+ * Returns 0 when everything was sent, 1 if bytes remain (wait for
+ * EPOLLOUT), -1 on a socket error (errno set).
+ */
+static inline int outq_flush(struct outq *q, int fd)
+{
+    while (q->head) {
+        struct iovec iov[OUTQ_IOV];
+        int n = 0;
+        struct outq_chunk *rest = q->head;
+        for (; rest && n < OUTQ_IOV; rest = rest->next, n++) {
+            iov[n].iov_base = rest->data + rest->start;
+            iov[n].iov_len  = rest->end - rest->start;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = (size_t)n;
+
+        /* More batches follow: let TCP fill segments across them. */
+        ssize_t w = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT | (rest ? MSG_MORE : 0));
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 1;
+            return -1;
+        }
+        q->bytes -= (size_t)w;
+        while (w > 0) {
+            struct outq_chunk *c = q->head;
+            size_t avail = c->end - c->start;
+            if ((size_t)w < avail) {
+                c->start += (unsigned)w;
+                break;
+            }
+            w      -= (ssize_t)avail;
+            q->head = c->next;
+            outq_chunk_free(q, c);
+        }
+        if (!q->head) q->tail = NULL;
+    }
+    return 0;
+}
+
+/*
+ * Send len bytes now if nothing is queued ahead of them, and queue
+ * whatever the socket does not take.  Order is always preserved.
+ * Returns 0 when everything is sent, 1 if bytes are queued, -1 on error.
+ */
+static inline int outq_send(struct outq *q, int fd, const void *buf, size_t len)
+{
+    const char *p = (const char *)buf;
+    if (!q->head) {
+        while (len > 0) {
+            ssize_t w = send(fd, p, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                return -1;
+            }
+            p   += w;
+            len -= (size_t)w;
+        }
+        if (len == 0) return 0;
+    }
+    if (outq_append(q, p, len) < 0) return -1;
+    return 1;
+}
+
+#endif /* OUTQ_H */
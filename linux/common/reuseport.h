@@ -0,0 +1,82 @@
+#ifndef REUSEPORT_H
+#define REUSEPORT_H
+
+/*
+ * linux/common/reuseport.h
+ *
+ * Header-only SO_REUSEPORT steering: send each new connection to the
+ * listener of the worker pinned to the CPU that received it.
+ *
+ * Without a program the kernel picks a socket of a SO_REUSEPORT group by
+ * a hash of the connection's addresses and ports, which ignores where the
+ * flow is processed.  The SYN, and later every segment of the connection,
+ * is handled in softirq on the CPU the NIC queue (or, on loopback, the
+ * sender) interrupts; a worker on another CPU then takes each wakeup, the
+ * socket's lock and its buffers across CPUs.
+ *
+ * rp_steer_by_cpu() attaches a classic BPF program to the group
+ * (SO_ATTACH_REUSEPORT_CBPF) that loads the current CPU, the one running
+ * the SYN's softirq, and returns the index of the listener whose worker
+ * is pinned to it.  The index is a socket's position in the group, which
+ * is the order the listeners were bound and put into listen(): open them
+ * one after another, in worker order, before any connection can arrive.
+ * A CPU with no worker falls back to cpu % n.  With several workers on
+ * one CPU only the first is steered to; the others get no connections.
+ * An index the group does not have (a listener closed) makes the kernel
+ * fall back to its hash.
+ *
+ * Steering only pays off when the flows really come in on different
+ * CPUs: a multi-queue NIC with RSS spreading them, or RPS; with one queue
+ * every SYN lands on one CPU and so on one worker.  rp_incoming_cpu()
+ * reads back where an accepted connection's packets were processed
+ * (SO_INCOMING_CPU), to check.
+ */
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
+
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU          49
+#endif
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
+#define RP_MAX_CPUS 1024                      /* 2 instructions each, BPF_MAXINSNS 4096 */
+
+/*
+ * Steer connections of fd's SO_REUSEPORT group to listener i when they
+ * arrive on cpus[i], i < n.  Returns 0, or -1 (errno set) when the kernel
+ * refuses the program or n is out of range.
+ */
+static inline int rp_steer_by_cpu(int fd, const int *cpus, int n)
+{
+    if (n < 1 || n > RP_MAX_CPUS) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct sock_filter code[2 * RP_MAX_CPUS + 3];     /* 16 KB of stack */
+    int k = 0;
+    code[k++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU);
+    for (int i = 0; i < n; i++) {
+        code[k++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (unsigned)cpus[i], 0, 1);
+        code[k++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, (unsigned)i);
+    }
+    code[k++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (unsigned)n);
+    code[k++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_A, 0);
+
+    struct sock_fprog prog = { (unsigned short)k, code };
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+}
+
+/* CPU that processed the last packet of connected socket fd, or -1. */
+static inline int rp_incoming_cpu(int fd)
+{
+    int cpu = -1;
+    socklen_t len = sizeof(cpu);
+    if (getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0) return -1;
+    return cpu;
+}
+
+#endif /* REUSEPORT_H */
@@ -32,6 +32,8 @@ static inline void set_nonblocking(int fd)
 /*
  * Write exactly len bytes; retries on EINTR and partial writes.
  * Returns 0 on success, -1 on error.
+ * For blocking fds only: on a non-blocking socket EAGAIN is an error here,
+ * so the event-loop servers queue output with outq.h instead.
  */
 static inline int write_all(int fd, const void *buf, size_t len)
 {
@@ -0,0 +1,142 @@
+#ifndef TSTAMP_H
+#define TSTAMP_H
+
+/*
+ * linux/common/tstamp.h
+ *
+ * Header-only kernel software timestamps (SO_TIMESTAMPING) for breaking a
+ * request's latency into stages.
+ *
+ * With ts_enable(), every recvmsg() on the socket carries the time the
+ * kernel's network stack took in the last segment it returns, read with
+ * ts_recv().  The time from there to the recv() returning is time spent
+ * in the socket's receive queue and in waking the reader; the time up to
+ * the answer's sendmsg() is the application's.
+ *
+ * A send that carries ts_tx_ctl()'s request as control data gets a
+ * second stamp when the segment holding its last byte is handed to the
+ * device (for loopback, while sendmsg() is still running).  That stamp comes
+ * back on the socket's error queue, which shows up as EPOLLERR / POLLERR,
+ * and ts_reap_tx() reads it.  Only sends that ask are stamped, so a
+ * caller can sample: one stamped send per connection in flight keeps the
+ * error queue short and matching stamps to sends trivial.
+ *
+ * The stamps are CLOCK_REALTIME, so ts_now() reads that clock too; both
+ * ends of a stage must be on the same host.  OPT_TSONLY makes a TX stamp
+ * come back without a copy of the packet.  The error queue is shared with
+ * MSG_ZEROCOPY completions (zcopy.h): whichever reads it takes both kinds.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+
+#ifndef SO_TIMESTAMPING
+#  define SO_TIMESTAMPING 37
+#endif
+#ifndef SO_EE_ORIGIN_TIMESTAMPING
+#  define SO_EE_ORIGIN_TIMESTAMPING 4
+#endif
+
+/* Room for one SO_TIMESTAMPING request in a sendmsg()'s control data. */
+struct ts_ctl {
+    union {
+        char           buf[CMSG_SPACE(sizeof(uint32_t))];
+        struct cmsghdr align;
+    };
+};
+
+static inline uint64_t ts_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Report software RX stamps on fd, and TX stamps for the sends that ask.
+ * Returns 0, or -1 if the kernel refuses.
+ */
+static inline int ts_enable(int fd)
+{
+    uint32_t flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+                     SOF_TIMESTAMPING_OPT_TSONLY;
+    return setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+}
+
+/* The stamp in msg's control data, in ns, or 0 if it has none. */
+static inline uint64_t ts_parse(struct msghdr *msg)
+{
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(msg); cm; cm = CMSG_NXTHDR(msg, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SO_TIMESTAMPING) continue;
+        struct timespec ts[3];                   /* software, legacy, hardware */
+        memcpy(ts, CMSG_DATA(cm), sizeof(ts));
+        return (uint64_t)ts[0].tv_sec * 1000000000ull + (uint64_t)ts[0].tv_nsec;
+    }
+    return 0;
+}
+
+/*
+ * recv() that also returns the kernel's RX stamp of the data in *rx_ns
+ * (0 when there is none, e.g. nothing was read).
+ */
+static inline ssize_t ts_recv(int fd, void *buf, size_t len, int flags, uint64_t *rx_ns)
+{
+    char control[CMSG_SPACE(3 * sizeof(struct timespec))];
+    struct iovec  iov = { buf, len };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t r = recvmsg(fd, &msg, flags);
+    *rx_ns = r > 0 ? ts_parse(&msg) : 0;
+    return r;
+}
+
+/*
+ * Fill c with a request for a software TX stamp; a send that carries it
+ * (msg_control = c->buf, msg_controllen = sizeof(c->buf)) gets one.
+ */
+static inline void ts_tx_ctl(struct ts_ctl *c)
+{
+    uint32_t flags = SOF_TIMESTAMPING_TX_SOFTWARE;
+    memset(c, 0, sizeof(*c));
+    c->align.cmsg_level = SOL_SOCKET;
+    c->align.cmsg_type  = SO_TIMESTAMPING;
+    c->align.cmsg_len   = CMSG_LEN(sizeof(flags));
+    memcpy(CMSG_DATA(&c->align), &flags, sizeof(flags));
+}
+
+/*
+ * Read every pending TX stamp from fd's error queue; *tx_ns gets the
+ * latest.  Returns the number read, or -1 on a socket error (errno set).
+ */
+static inline int ts_reap_tx(int fd, uint64_t *tx_ns)
+{
+    int got = 0;
+    for (;;) {
+        char control[256];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return got;
+            return -1;
+        }
+        uint64_t ns = ts_parse(&msg);
+        if (!ns) continue;
+        *tx_ns = ns;
+        got++;
+    }
+}
+
+#endif /* TSTAMP_H */
@@ -0,0 +1,241 @@
+#ifndef TWHEEL_H
+#define TWHEEL_H
+
+/*
+ * linux/common/twheel.h
+ *
+ * Header-only hierarchical timing wheel for per-connection deadlines.
+ *
+ * Time is counted in ticks (the caller picks the unit; the servers use
+ * milliseconds).  Level 0 has one slot per tick for the next TW_SLOTS
+ * ticks, and each level above covers TW_SLOTS times the span of the one
+ * below.  A timer goes into the lowest level whose span reaches its
+ * expiry; when level 0 wraps, the next slot of level 1 is emptied into the
+ * levels below (and likewise upward), so every timer is handled at most
+ * TW_LEVELS times on its way down.  Arming, cancelling and expiring are
+ * O(1); tw_advance() costs one step per tick only while level 0 holds
+ * timers, and skips to the next wrap otherwise.
+ *
+ * Timers are identified by a small integer (the servers use the fd) and
+ * stored in a table that grows with tw_reserve().  Lists link entries by
+ * index, so growing the table does not invalidate them.  The table is an
+ * fdtab (fdtab.h) and an all-zero entry is a timer that is not armed, so
+ * ids that were never used cost no memory.
+ *
+ * Pushing a deadline later — an idle timeout re-armed on every request —
+ * only stores the new expiry: the timer stays in its old slot, and when
+ * that slot comes due the timer is put back according to its new expiry.
+ * A busy connection therefore costs one store per request and one
+ * re-insert per timeout period, however many requests it sends.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fdtab.h"
+
+#define TW_BITS   6
+#define TW_SLOTS  (1 << TW_BITS)                 /* slots per level */
+#define TW_MASK   (TW_SLOTS - 1)
+#define TW_LEVELS 4                              /* range: 2^24 ticks */
+#define TW_RANGE  (1ull << (TW_BITS * TW_LEVELS))
+#define TW_DUE    (TW_LEVELS * TW_SLOTS)         /* list of expired timers */
+
+struct tw_ent {
+    uint64_t expires;                            /* due tick, while armed */
+    int32_t  next, prev;                         /* list links, -1 = none */
+    int32_t  slot;                               /* list it is on + 1, 0 = not armed */
+    uint32_t tag;                                /* caller's: what it is for */
+};
+
+struct twheel {
+    uint64_t       now;                          /* ticks up to here are handled */
+    struct tw_ent *ent;
+    int            nent;
+    int32_t        head[TW_DUE + 1];             /* every slot, then the due list */
+    uint64_t       used[TW_LEVELS];              /* bit per non-empty slot */
+    size_t         pending;                      /* timers in slots, not due */
+};
+
+static inline void tw_init(struct twheel *w, uint64_t now)
+{
+    memset(w, 0, sizeof(*w));
+    w->now = now;
+    for (int i = 0; i <= TW_DUE; i++) w->head[i] = -1;
+}
+
+static inline void tw_destroy(struct twheel *w)
+{
+    fdtab_free(w->ent, (size_t)w->nent * sizeof(*w->ent));
+    w->ent  = NULL;
+    w->nent = 0;
+}
+
+/* Room for timer ids below n.  Returns -1 if out of memory. */
+static inline int tw_reserve(struct twheel *w, int n)
+{
+    if (n <= w->nent) return 0;
+    struct tw_ent *e = (struct tw_ent *)fdtab_grow(w->ent, (size_t)w->nent * sizeof(*e),
+                                                   (size_t)n * sizeof(*e));
+    if (!e) return -1;
+    w->ent  = e;
+    w->nent = n;
+    return 0;
+}
+
+static inline int tw_armed(const struct twheel *w, int id)
+{
+    return id < w->nent && w->ent[id].slot > 0;
+}
+
+/* The tag of id's timer; kept after it expires, until it is armed again. */
+static inline uint32_t tw_tag(const struct twheel *w, int id)
+{
+    return w->ent[id].tag;
+}
+
+/* id's due tick, while it is armed. */
+static inline uint64_t tw_expires(const struct twheel *w, int id)
+{
+    return w->ent[id].expires;
+}
+
+static inline void tw_link(struct twheel *w, int id, int slot)
+{
+    struct tw_ent *e = &w->ent[id];
+    e->slot = slot + 1;
+    e->prev = -1;
+    e->next = w->head[slot];
+    if (e->next >= 0) w->ent[e->next].prev = id;
+    w->head[slot] = id;
+    if (slot < TW_DUE) {
+        w->used[slot >> TW_BITS] |= 1ull << (slot & TW_MASK);
+        w->pending++;
+    }
+}
+
+static inline void tw_unlink(struct twheel *w, int id)
+{
+    struct tw_ent *e = &w->ent[id];
+    int slot = e->slot - 1;
+    if (e->prev >= 0) w->ent[e->prev].next = e->next;
+    else              w->head[slot]        = e->next;
+    if (e->next >= 0) w->ent[e->next].prev = e->prev;
+    e->slot = 0;
+    if (slot < TW_DUE) {
+        if (w->head[slot] < 0) w->used[slot >> TW_BITS] &= ~(1ull << (slot & TW_MASK));
+        w->pending--;
+    }
+}
+
+/*
+ * Put id in the slot for its expiry, but no earlier than tick `from`:
+ * w->now while emptying slots (the current level-0 slot is handled right
+ * after), w->now + 1 for new timers (it has been handled already).
+ */
+static inline void tw_place(struct twheel *w, int id, uint64_t from)
+{
+    uint64_t when  = w->ent[id].expires;
+    if (when < from) when = from;
+    uint64_t delta = when - w->now;
+    if (delta >= TW_RANGE) {                     /* put back when closer */
+        delta = TW_RANGE - 1;
+        when  = w->now + delta;
+    }
+    int level = 0;
+    while (level < TW_LEVELS - 1 && delta >= 1ull << (TW_BITS * (level + 1))) level++;
+    tw_link(w, id, level * TW_SLOTS + (int)((when >> (TW_BITS * level)) & TW_MASK));
+}
+
+/*
+ * Arm id to expire at tick `expires` (at the next tick if that has
+ * passed), replacing any earlier arming.
+ */
+static inline void tw_arm(struct twheel *w, int id, uint64_t expires, uint32_t tag)
+{
+    struct tw_ent *e = &w->ent[id];
+    e->tag = tag;
+    if (e->slot && e->slot - 1 < TW_DUE && expires >= e->expires) {
+        e->expires = expires;                    /* later: moved when its slot is due */
+        return;
+    }
+    if (e->slot) tw_unlink(w, id);
+    e->expires = expires;
+    tw_place(w, id, w->now + 1);
+}
+
+static inline void tw_cancel(struct twheel *w, int id)
+{
+    if (tw_armed(w, id)) tw_unlink(w, id);
+}
+
+/* Move every timer of one slot to where it belongs now. */
+static inline void tw_cascade(struct twheel *w, int slot)
+{
+    int id = w->head[slot];
+    while (id >= 0) {
+        int next = w->ent[id].next;
+        tw_unlink(w, id);
+        if (slot < TW_SLOTS && w->ent[id].expires <= w->now) tw_link(w, id, TW_DUE);
+        else                                                 tw_place(w, id, w->now);
+        id = next;
+    }
+}
+
+/*
+ * Bring the wheel up to tick `now`: timers due by then move to the due
+ * list, for tw_expired() to hand out.
+ */
+static inline void tw_advance(struct twheel *w, uint64_t now)
+{
+    while (w->now < now) {
+        if (!w->pending) {
+            w->now = now;
+            return;
+        }
+        if (!w->used[0]) {                       /* nothing before the next wrap */
+            uint64_t last = w->now | TW_MASK;
+            if (last >= now) {
+                w->now = now;
+                return;
+            }
+            w->now = last;
+        }
+        uint64_t t = ++w->now;
+        int top = 0;
+        while (top < TW_LEVELS - 1 && (t & TW_MASK) == 0) {
+            t >>= TW_BITS;
+            top++;
+        }
+        for (int level = top; level > 0; level--)
+            tw_cascade(w, level * TW_SLOTS + (int)((w->now >> (TW_BITS * level)) & TW_MASK));
+        tw_cascade(w, (int)(w->now & TW_MASK));
+    }
+}
+
+/* Next expired timer, disarmed, or -1 when there is none. */
+static inline int tw_expired(struct twheel *w)
+{
+    int id = w->head[TW_DUE];
+    if (id >= 0) tw_unlink(w, id);
+    return id;
+}
+
+/*
+ * Ticks until tw_advance() may have something to do — exact for timers
+ * within level 0, the next wrap otherwise — or -1 if nothing is armed.
+ * Suits an epoll_wait() timeout.
+ */
+static inline long tw_next(const struct twheel *w)
+{
+    if (w->head[TW_DUE] >= 0) return 0;
+    if (!w->pending) return -1;
+    unsigned s = (unsigned)((w->now + 1) & TW_MASK);
+    uint64_t r = w->used[0];
+    if (s) r = (r >> s) | (r << (TW_SLOTS - s));   /* bit 0 = the next tick */
+    if (r) return (long)__builtin_ctzll(r) + 1;
+    return (long)(TW_SLOTS - (w->now & TW_MASK));
+}
+
+#endif /* TWHEEL_H */
@@ -0,0 +1,186 @@
+#ifndef UDP_BATCH_H
+#define UDP_BATCH_H
+
+/*
+ * linux/common/udp_batch.h
+ *
+ * Header-only batched UDP I/O: recvmmsg()/sendmmsg() over a fixed set of
+ * message slots, with optional UDP GRO on receive and UDP GSO on send.
+ *
+ * One recvfrom()/sendto() per datagram makes the syscall the whole cost of
+ * a small packet.  recvmmsg() fills up to UDP_BATCH slots per call and
+ * sendmmsg() sends as many, so the per-call cost is spread over the batch.
+ * GRO and GSO go further and move many datagrams per *message*:
+ *
+ *   - with UDP_GRO set on the socket, the kernel may hand back several
+ *     datagrams of one flow coalesced into a single buffer; a UDP_GRO
+ *     control message gives the segment size, and every segment but the
+ *     last is exactly that long;
+ *   - a message sent with a UDP_SEGMENT control message is cut by the
+ *     kernel (or the NIC) into datagrams of that size.
+ *
+ * So a coalesced buffer echoed back with its own segment size leaves as
+ * the same datagrams it arrived as.
+ *
+ * Every slot owns bufsz bytes of one contiguous buffer, its peer address
+ * and its control buffer; the same slots serve receiving and replying.
+ * recvmmsg()/sendmmsg() are GNU extensions: define _GNU_SOURCE before the
+ * first #include.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+#ifndef UDP_SEGMENT
+#  define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#  define UDP_GRO 104
+#endif
+
+#define UDP_BATCH     64                     /* messages per recvmmsg()/sendmmsg() */
+#define UDP_MAX_SEGS  64                     /* GSO segments per message (kernel limit) */
+#define UDP_MAX_MSG   65507                  /* largest UDP payload over IPv4 */
+
+struct udp_batch {
+    size_t             bufsz;                /* bytes per slot */
+    char              *buf;                  /* UDP_BATCH * bufsz */
+    uint16_t           gso[UDP_BATCH];       /* segment size, 0 = one datagram */
+    struct sockaddr_in addr[UDP_BATCH];
+    struct iovec       iov[UDP_BATCH];
+    struct mmsghdr     msg[UDP_BATCH];
+    union {
+        char           buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctl[UDP_BATCH];
+};
+
+/* Returns 0, or -1 if memory ran out. */
+static inline int udp_batch_init(struct udp_batch *b, size_t bufsz)
+{
+    memset(b, 0, sizeof(*b));
+    b->buf = (char *)malloc(UDP_BATCH * bufsz);
+    if (!b->buf) return -1;
+    b->bufsz = bufsz;
+    return 0;
+}
+
+static inline void udp_batch_free(struct udp_batch *b)
+{
+    free(b->buf);
+    b->buf = NULL;
+}
+
+static inline char *udp_batch_data(struct udp_batch *b, int i)
+{
+    return b->buf + (size_t)i * b->bufsz;
+}
+
+/* Ask for coalesced receives.  Returns 0, or -1 if the kernel lacks it. */
+static inline int udp_gro_enable(int fd)
+{
+    int one = 1;
+    return setsockopt(fd, IPPROTO_UDP, UDP_GRO, &one, sizeof(one));
+}
+
+/* Datagrams in slot i: one, or one per segment of a coalesced buffer. */
+static inline unsigned udp_batch_segs(const struct udp_batch *b, int i)
+{
+    unsigned len = b->msg[i].msg_len, gso = b->gso[i];
+    if (!gso || len <= gso) return 1;
+    return (len + gso - 1) / gso;
+}
+
+/*
+ * Receive up to max (<= UDP_BATCH) messages into slots 0..; msg[i].msg_len
+ * is each one's length, addr[i] its sender and gso[i] its GRO segment
+ * size.  flags as for recvmmsg() (MSG_WAITFORONE, MSG_DONTWAIT).
+ * Returns the number received, or -1 with errno set.
+ */
+static inline int udp_batch_recv(int fd, struct udp_batch *b, int max, int flags)
+{
+    for (int i = 0; i < max; i++) {
+        struct msghdr *h = &b->msg[i].msg_hdr;
+        b->iov[i].iov_base = udp_batch_data(b, i);
+        b->iov[i].iov_len  = b->bufsz;
+        h->msg_name       = &b->addr[i];
+        h->msg_namelen    = sizeof(b->addr[i]);
+        h->msg_iov        = &b->iov[i];
+        h->msg_iovlen     = 1;
+        h->msg_control    = b->ctl[i].buf;
+        h->msg_controllen = sizeof(b->ctl[i].buf);
+        h->msg_flags      = 0;
+    }
+    int n;
+    do {
+        n = recvmmsg(fd, b->msg, (unsigned)max, flags, NULL);
+    } while (n < 0 && errno == EINTR);
+
+    for (int i = 0; i < n; i++) {
+        struct msghdr *h = &b->msg[i].msg_hdr;
+        b->gso[i] = 0;
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(h); cm; cm = CMSG_NXTHDR(h, cm)) {
+            if (cm->cmsg_level == IPPROTO_UDP && cm->cmsg_type == UDP_GRO) {
+                int gso;
+                memcpy(&gso, CMSG_DATA(cm), sizeof(gso));
+                b->gso[i] = (uint16_t)gso;
+            }
+        }
+    }
+    return n;
+}
+
+/*
+ * Set slot i up to send len bytes of its data, cut into gso-byte
+ * datagrams if gso is non-zero and smaller than len.  With to_sender the
+ * message goes to addr[i] (a reply); otherwise to the socket's connected
+ * peer.
+ */
+static inline void udp_batch_set(struct udp_batch *b, int i, size_t len,
+                                 uint16_t gso, int to_sender)
+{
+    struct msghdr *h = &b->msg[i].msg_hdr;
+    b->iov[i].iov_base = udp_batch_data(b, i);
+    b->iov[i].iov_len  = len;
+    h->msg_name       = to_sender ? &b->addr[i] : NULL;
+    h->msg_namelen    = to_sender ? sizeof(b->addr[i]) : 0;
+    h->msg_iov        = &b->iov[i];
+    h->msg_iovlen     = 1;
+    h->msg_control    = NULL;
+    h->msg_controllen = 0;
+    h->msg_flags      = 0;
+    b->gso[i]         = gso;
+    if (gso && len > gso) {
+        h->msg_control    = b->ctl[i].buf;
+        h->msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+        struct cmsghdr *cm = CMSG_FIRSTHDR(h);
+        cm->cmsg_level = IPPROTO_UDP;
+        cm->cmsg_type  = UDP_SEGMENT;
+        cm->cmsg_len   = CMSG_LEN(sizeof(uint16_t));
+        memcpy(CMSG_DATA(cm), &gso, sizeof(gso));
+    }
+}
+
+/*
+ * sendmmsg() slots first..first+n-1, as set up by udp_batch_set().
+ * Returns the number of messages sent, or -1 with errno set if the first
+ * one failed.  sendmmsg() stops at the first message that fails, so a
+ * short count means: call again from there to get that message's error.
+ */
+static inline int udp_batch_send(int fd, struct udp_batch *b, int first, int n, int flags)
+{
+    int r;
+    do {
+        r = sendmmsg(fd, b->msg + first, (unsigned)n, flags);
+    } while (r < 0 && errno == EINTR);
+    return r;
+}
+
+#endif /* UDP_BATCH_H */
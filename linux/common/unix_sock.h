@@ -0,0 +1,138 @@
+#ifndef UNIX_SOCK_H
+#define UNIX_SOCK_H
+
+/*
+ * linux/common/unix_sock.h
+ *
+ * Header-only AF_UNIX listeners and connections for same-host clients.
+ *
+ * A path names the socket: "/tmp/echo.sock" is a filesystem socket,
+ * "@echo" one in the abstract namespace (no file, gone with the last
+ * descriptor), the same spelling ss(8) uses.  Both work with SOCK_STREAM,
+ * a byte stream like TCP, and SOCK_SEQPACKET, which is connection-oriented
+ * but keeps message boundaries: each recv() returns exactly one message
+ * and each send() is delivered whole or not at all, so no framing is
+ * needed.
+ *
+ * A filesystem socket left behind by a process that died (connecting to it
+ * is refused) is removed before binding.  One with a live listener, or a
+ * path that is not a socket at all, is left alone and bind() fails with
+ * EADDRINUSE.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static inline int unix_is_abstract(const char *path)
+{
+    return path[0] == '@';
+}
+
+/* Fill a with path.  Returns the address length, or 0 if path is too long. */
+static inline socklen_t unix_addr(struct sockaddr_un *a, const char *path)
+{
+    size_t n = strlen(path);
+    if (n == 0 || n > sizeof(a->sun_path) - 1) return 0;
+    memset(a, 0, sizeof(*a));
+    a->sun_family = AF_UNIX;
+    memcpy(a->sun_path, path, n);
+    if (unix_is_abstract(path)) {
+        a->sun_path[0] = '\0';                   /* no trailing NUL: not part of the name */
+        return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + n);
+    }
+    return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + n + 1);
+}
+
+/*
+ * Listen on path with type SOCK_STREAM or SOCK_SEQPACKET; the listener is
+ * non-blocking and close-on-exec.  Returns the fd, or -1 with errno set.
+ */
+static inline int unix_listen(const char *path, int type, int backlog)
+{
+    struct sockaddr_un a;
+    socklen_t al = unix_addr(&a, path);
+    if (!al) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    struct stat st;
+    if (!unix_is_abstract(path) && lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int probe = socket(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (probe >= 0) {
+            if (connect(probe, (struct sockaddr *)&a, al) < 0 && errno == ECONNREFUSED)
+                unlink(path);                    /* stale: nobody is behind it */
+            close(probe);
+        }
+    }
+    int fd = socket(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (bind(fd, (struct sockaddr *)&a, al) < 0 || listen(fd, backlog) < 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    return fd;
+}
+
+/* Connect to path (blocking).  Returns the fd, or -1 with errno set. */
+static inline int unix_connect(const char *path, int type)
+{
+    struct sockaddr_un a;
+    socklen_t al = unix_addr(&a, path);
+    if (!al) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&a, al) < 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * The path a listener is bound to, in the same spelling, into buf.
+ * Lets a process that was handed a listener find out what it is.
+ * Returns 0, or -1 if fd is not a bound AF_UNIX socket.
+ */
+static inline int unix_path(int fd, char *buf, size_t cap)
+{
+    struct sockaddr_un a;
+    socklen_t al = sizeof(a);
+    if (cap < 2 || getsockname(fd, (struct sockaddr *)&a, &al) < 0 || a.sun_family != AF_UNIX)
+        return -1;
+    size_t n = al > offsetof(struct sockaddr_un, sun_path)
+             ? al - offsetof(struct sockaddr_un, sun_path) : 0;
+    if (n == 0) return -1;                       /* unbound */
+    if (a.sun_path[0] == '\0') {
+        buf[0] = '@';
+        n = n - 1 < cap - 2 ? n - 1 : cap - 2;
+        memcpy(buf + 1, a.sun_path + 1, n);
+        buf[n + 1] = '\0';
+    } else {
+        n = strnlen(a.sun_path, n);
+        if (n > cap - 1) n = cap - 1;
+        memcpy(buf, a.sun_path, n);
+        buf[n] = '\0';
+    }
+    return 0;
+}
+
+/* Remove a filesystem listener's path once it is closed; abstract names go by themselves. */
+static inline void unix_unlink(const char *path)
+{
+    if (path && !unix_is_abstract(path)) unlink(path);
+}
+
+#endif /* UNIX_SOCK_H */
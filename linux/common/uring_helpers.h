@@ -0,0 +1,286 @@
+#ifndef URING_HELPERS_H
+#define URING_HELPERS_H
+
+/*
+ * linux/common/uring_helpers.h
+ *
+ * Minimal header-only io_uring wrapper on top of the raw syscalls, so the
+ * demos need nothing beyond <linux/io_uring.h> (no liburing).
+ *
+ * Covers what the echo servers use: SQE allocation with batched submission,
+ * CQE iteration, and a provided-buffer ring (IORING_REGISTER_PBUF_RING)
+ * whose buffers sit in huge-page-backed memory from bufpool_map().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "bufpool.h"
+
+struct uring {
+    int                  fd;
+    unsigned             sq_mask;
+    unsigned             sq_entries;
+    unsigned            *sq_head;
+    unsigned            *sq_tail;
+    unsigned             sq_local;     /* tail including unsubmitted SQEs */
+    struct io_uring_sqe *sqes;
+    unsigned             cq_mask;
+    unsigned            *cq_head;
+    unsigned            *cq_tail;
+    struct io_uring_cqe *cqes;
+    void                *sq_ring;
+    size_t               sq_ring_sz;
+    void                *cq_ring;
+    size_t               cq_ring_sz;
+    size_t               sqes_sz;
+};
+
+/* Provided-buffer ring: nbufs buffers of bufsz bytes, group id bgid. */
+struct uring_bufring {
+    struct io_uring_buf_ring *br;
+    unsigned char            *base;
+    size_t                    base_sz;   /* mapping size, whole huge pages */
+    unsigned                  nbufs;     /* power of two */
+    unsigned                  bufsz;
+    unsigned                  mask;
+    unsigned short            bgid;
+    unsigned short            tail;      /* local copy, see uring_bufring_publish() */
+};
+
+static inline int uring_sys_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int uring_sys_enter(int fd, unsigned to_submit, unsigned min_complete,
+                                  unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                        NULL, 0);
+}
+
+static inline int uring_sys_register(int fd, unsigned op, void *arg, unsigned nr)
+{
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, nr);
+}
+
+/*
+ * Create a ring with the given setup flags.  If the kernel rejects the
+ * flags (EINVAL on older kernels) retry once with none.
+ * Returns 0 on success, -1 with errno set on failure.
+ */
+static inline int uring_init(struct uring *r, unsigned entries, unsigned flags)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = flags;
+    int fd = uring_sys_setup(entries, &p);
+    if (fd < 0 && errno == EINVAL && flags) {
+        memset(&p, 0, sizeof(p));
+        fd = uring_sys_setup(entries, &p);
+    }
+    if (fd < 0) return -1;
+
+    memset(r, 0, sizeof(*r));
+    r->fd         = fd;
+    r->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_ring_sz > r->sq_ring_sz) r->sq_ring_sz = r->cq_ring_sz;
+        r->cq_ring_sz = r->sq_ring_sz;
+    }
+
+    r->sq_ring = mmap(NULL, r->sq_ring_sz, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED) goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ring = r->sq_ring;
+    } else {
+        r->cq_ring = mmap(NULL, r->cq_ring_sz, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (r->cq_ring == MAP_FAILED) goto fail;
+    }
+    r->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) goto fail;
+
+    unsigned char *sq = r->sq_ring, *cq = r->cq_ring;
+    r->sq_head    = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail    = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask    = *(unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_entries = p.sq_entries;
+    r->sq_local   = *r->sq_tail;
+    r->cq_head    = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail    = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask    = *(unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes       = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    /* Identity-map the SQ index array once; we always fill SQEs in order. */
+    unsigned *array = (unsigned *)(sq + p.sq_off.array);
+    for (unsigned i = 0; i < p.sq_entries; i++) array[i] = i;
+    return 0;
+
+fail:
+    close(fd);
+    return -1;
+}
+
+static inline void uring_exit(struct uring *r)
+{
+    munmap(r->sqes, r->sqes_sz);
+    if (r->cq_ring != r->sq_ring) munmap(r->cq_ring, r->cq_ring_sz);
+    munmap(r->sq_ring, r->sq_ring_sz);
+    close(r->fd);
+}
+
+/* Number of SQEs filled in but not yet handed to the kernel. */
+static inline unsigned uring_pending(const struct uring *r)
+{
+    return r->sq_local - *r->sq_tail;
+}
+
+/* Free SQ slots, counting SQEs the kernel has not consumed yet. */
+static inline unsigned uring_sq_space(const struct uring *r)
+{
+    return r->sq_entries - (r->sq_local - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE));
+}
+
+/*
+ * Publish pending SQEs and enter the kernel once: submit them and, if
+ * wait_nr > 0, block until at least that many CQEs are ready.
+ * Returns the number of SQEs consumed, or -1 with errno set.
+ */
+static inline int uring_submit_and_wait(struct uring *r, unsigned wait_nr)
+{
+    unsigned n = uring_pending(r);
+    __atomic_store_n(r->sq_tail, r->sq_local, __ATOMIC_RELEASE);
+    if (n == 0 && wait_nr == 0) return 0;
+    for (;;) {
+        int rc = uring_sys_enter(r->fd, n, wait_nr,
+                                 wait_nr ? IORING_ENTER_GETEVENTS : 0);
+        if (rc >= 0 || errno != EINTR) return rc;
+    }
+}
+
+/*
+ * Return a zeroed SQE.  When the SQ is full the pending batch is submitted
+ * first, so callers never see NULL unless the kernel refuses the batch.
+ */
+static inline struct io_uring_sqe *uring_get_sqe(struct uring *r)
+{
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if (r->sq_local - head >= r->sq_entries) {
+        if (uring_submit_and_wait(r, 0) < 0) return NULL;
+        head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+        if (r->sq_local - head >= r->sq_entries) return NULL;
+    }
+    struct io_uring_sqe *sqe = &r->sqes[r->sq_local & r->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_local++;
+    return sqe;
+}
+
+/* Next completed CQE, or NULL.  Call uring_cq_advance() once consumed. */
+static inline struct io_uring_cqe *uring_peek_cqe(struct uring *r)
+{
+    unsigned head = *r->cq_head;
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+    return &r->cqes[head & r->cq_mask];
+}
+
+static inline void uring_cq_advance(struct uring *r, unsigned n)
+{
+    __atomic_store_n(r->cq_head, *r->cq_head + n, __ATOMIC_RELEASE);
+}
+
+/* ── Provided-buffer ring ───────────────────────────────────────────────── */
+
+/*
+ * Allocate nbufs (power of two) buffers of bufsz bytes, register them as
+ * buffer group bgid and hand them all to the kernel.
+ * Returns 0 on success, -1 with errno set on failure.
+ */
+static inline int uring_bufring_setup(struct uring *r, struct uring_bufring *b,
+                                      unsigned short bgid, unsigned nbufs,
+                                      unsigned bufsz)
+{
+    memset(b, 0, sizeof(*b));
+    size_t ring_sz = nbufs * sizeof(struct io_uring_buf);
+    void *ring = mmap(NULL, ring_sz, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) return -1;
+    int huge;
+    b->base_sz = ((size_t)nbufs * bufsz + BUFPOOL_SLAB - 1) & ~(size_t)(BUFPOOL_SLAB - 1);
+    b->base    = (unsigned char *)bufpool_map(b->base_sz, &huge);
+    if (!b->base) { munmap(ring, ring_sz); return -1; }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr    = (unsigned long)ring;
+    reg.ring_entries = nbufs;
+    reg.bgid         = bgid;
+    if (uring_sys_register(r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        int e = errno;
+        bufpool_unmap(b->base, b->base_sz);
+        munmap(ring, ring_sz);
+        errno = e;
+        return -1;
+    }
+
+    b->br    = ring;
+    b->nbufs = nbufs;
+    b->bufsz = bufsz;
+    b->mask  = nbufs - 1;
+    b->bgid  = bgid;
+    for (unsigned i = 0; i < nbufs; i++) {
+        struct io_uring_buf *e = &b->br->bufs[(b->tail + i) & b->mask];
+        e->addr = (unsigned long)(b->base + (size_t)i * bufsz);
+        e->len  = bufsz;
+        e->bid  = (unsigned short)i;
+    }
+    b->tail = (unsigned short)(b->tail + nbufs);
+    __atomic_store_n(&b->br->tail, b->tail, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static inline void uring_bufring_free(struct uring *r, struct uring_bufring *b)
+{
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = b->bgid;
+    uring_sys_register(r->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    munmap(b->br, b->nbufs * sizeof(struct io_uring_buf));
+    bufpool_unmap(b->base, b->base_sz);
+}
+
+static inline unsigned char *uring_bufring_addr(const struct uring_bufring *b,
+                                                unsigned bid)
+{
+    return b->base + (size_t)bid * b->bufsz;
+}
+
+/* Give buffer bid back to the kernel (visible on the next publish). */
+static inline void uring_bufring_recycle(struct uring_bufring *b, unsigned bid)
+{
+    struct io_uring_buf *e = &b->br->bufs[b->tail & b->mask];
+    e->addr = (unsigned long)uring_bufring_addr(b, bid);
+    e->len  = b->bufsz;
+    e->bid  = (unsigned short)bid;
+    b->tail++;
+}
+
+/* Publish every recycled buffer with a single release store. */
+static inline void uring_bufring_publish(struct uring_bufring *b)
+{
+    __atomic_store_n(&b->br->tail, b->tail, __ATOMIC_RELEASE);
+}
+
+#endif /* URING_HELPERS_H */
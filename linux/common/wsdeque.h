@@ -0,0 +1,145 @@
+#ifndef WSDEQUE_H
+#define WSDEQUE_H
+
+/*
+ * linux/common/wsdeque.h
+ *
+ * Header-only Chase-Lev work-stealing deque (Chase & Lev, SPAA 2005, with
+ * the C11 memory orders of Lê et al., PPoPP 2013).
+ *
+ * One thread owns the deque: it pushes and takes at the bottom, last in
+ * first out, with plain loads and stores and no atomic read-modify-write
+ * except when it takes the last item.  Any other thread may steal from the
+ * top, first in first out, with one compare-and-swap; a thief that loses a
+ * race gets WSD_ABORT and should look elsewhere.  Items are non-NULL
+ * pointers.
+ *
+ * The ring grows when full: the owner copies it into one twice the size.
+ * A thief may still be reading the old ring, so old rings are kept until
+ * wsd_destroy().  top and bottom sit on separate cache lines, so thieves
+ * polling top do not slow the owner's pushes.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#define WSD_ABORT ((void *)1)                    /* lost a race: try another victim */
+
+struct wsd_ring {
+    int64_t          cap;                        /* power of two */
+    struct wsd_ring *prev;                       /* outgrown ring, freed at destroy */
+    _Atomic(void *)  slot[];
+};
+
+struct wsdeque {
+    _Alignas(64) _Atomic int64_t top;            /* thieves take here */
+    _Alignas(64) _Atomic int64_t bottom;         /* the owner pushes and takes here */
+    _Atomic(struct wsd_ring *)   ring;
+};
+
+static inline struct wsd_ring *wsd_ring_new(int64_t cap)
+{
+    struct wsd_ring *r = (struct wsd_ring *)malloc(sizeof(*r) + (size_t)cap * sizeof(void *));
+    if (!r) return NULL;
+    r->cap  = cap;
+    r->prev = NULL;
+    return r;
+}
+
+/* cap: initial slots, rounded up to a power of two.  Returns -1 if out of memory. */
+static inline int wsd_init(struct wsdeque *d, int64_t cap)
+{
+    int64_t c = 16;
+    while (c < cap) c *= 2;
+    struct wsd_ring *r = wsd_ring_new(c);
+    if (!r) return -1;
+    atomic_init(&d->top, 0);
+    atomic_init(&d->bottom, 0);
+    atomic_init(&d->ring, r);
+    return 0;
+}
+
+static inline void wsd_destroy(struct wsdeque *d)
+{
+    struct wsd_ring *r = atomic_load_explicit(&d->ring, memory_order_relaxed);
+    while (r) {
+        struct wsd_ring *prev = r->prev;
+        free(r);
+        r = prev;
+    }
+    atomic_store_explicit(&d->ring, NULL, memory_order_relaxed);
+}
+
+/* Owner only.  Returns -1 if the ring had to grow and could not. */
+static inline int wsd_push(struct wsdeque *d, void *x)
+{
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    struct wsd_ring *r = atomic_load_explicit(&d->ring, memory_order_relaxed);
+    if (b - t > r->cap - 1) {
+        struct wsd_ring *g = wsd_ring_new(r->cap * 2);
+        if (!g) return -1;
+        for (int64_t i = t; i < b; i++)
+            atomic_store_explicit(&g->slot[i & (g->cap - 1)],
+                                  atomic_load_explicit(&r->slot[i & (r->cap - 1)],
+                                                       memory_order_relaxed),
+                                  memory_order_relaxed);
+        g->prev = r;
+        atomic_store_explicit(&d->ring, g, memory_order_release);
+        r = g;
+    }
+    atomic_store_explicit(&r->slot[b & (r->cap - 1)], x, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return 0;
+}
+
+/* Owner only: the newest item, or NULL if the deque is empty. */
+static inline void *wsd_take(struct wsdeque *d)
+{
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    struct wsd_ring *r = atomic_load_explicit(&d->ring, memory_order_relaxed);
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    void *x = NULL;
+    if (t <= b) {
+        x = atomic_load_explicit(&r->slot[b & (r->cap - 1)], memory_order_relaxed);
+        if (t == b) {                            /* the last one: race the thieves for it */
+            if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                         memory_order_seq_cst,
+                                                         memory_order_relaxed))
+                x = NULL;
+            atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return x;
+}
+
+/* Any thread: the oldest item, NULL if empty, WSD_ABORT if another thread won it. */
+static inline void *wsd_steal(struct wsdeque *d)
+{
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b) return NULL;
+    struct wsd_ring *r = atomic_load_explicit(&d->ring, memory_order_acquire);
+    void *x = atomic_load_explicit(&r->slot[t & (r->cap - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed))
+        return WSD_ABORT;
+    return x;
+}
+
+/* Items in the deque; exact only for the owner, a hint for anyone else. */
+static inline int64_t wsd_size(struct wsdeque *d)
+{
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_seq_cst);
+    return b > t ? b - t : 0;
+}
+
+#endif /* WSDEQUE_H */
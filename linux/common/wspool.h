@@ -0,0 +1,253 @@
+#ifndef WSPOOL_H
+#define WSPOOL_H
+
+/*
+ * linux/common/wspool.h
+ *
+ * Header-only work-stealing thread pool for an event loop's slow handlers.
+ *
+ * The loop thread hands a task over with wsp_submit(), which pushes it onto
+ * a Chase-Lev deque (linux/common/wsdeque.h) that the loop thread owns: no
+ * lock and no system call, unless a worker is asleep and has to be woken.
+ * Each worker owns a deque too, for tasks that a running task splits off
+ * with wsp_spawn().  A worker takes its own newest task first, cache-warm;
+ * when it has none it steals the oldest task of a victim picked at random
+ * among the other workers and the loop thread, trying each once from there
+ * on.  Work stays spread without a shared queue for the threads to contend
+ * on, and the loop's requests leave in the order they came.
+ *
+ * A submitted task, once run, goes onto a lock-free completion list and the
+ * pool's eventfd becomes readable.  The eventfd is written only when the
+ * list was empty, so a burst of completions costs one write and one wakeup
+ * of the loop.  Put it in the loop's epoll set and call wsp_reap() when it
+ * fires: that returns the finished tasks in the order they finished.
+ * Spawned tasks are not reported.
+ *
+ * Workers with nothing to steal sleep on a condition variable.  A submit
+ * signals it only when some worker has announced it is going to sleep,
+ * and a worker checks every deque again after announcing, so no wakeup is
+ * lost and a busy pool never makes a futex call.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+
+#include "wsdeque.h"
+
+#define WSP_SPIN 64                              /* steal rounds before sleeping */
+
+struct ws_task {
+    void          (*fn)(struct ws_task *);
+    struct ws_task *next;                        /* completion list */
+    unsigned char   report;                      /* submitted, not spawned */
+};
+
+struct wspool;
+
+struct ws_worker {
+    struct wsdeque  dq;                          /* tasks this worker spawned */
+    struct wspool  *pool;
+    pthread_t       tid;
+    int             id;
+    uint64_t        rng;                         /* victim picking */
+    uint64_t        ran, stolen;                 /* tasks run; how many were stolen */
+} __attribute__((aligned(64)));
+
+struct wspool {
+    struct wsdeque            inject;            /* owned by the submitting thread */
+    struct ws_worker         *w;
+    int                       nworkers;
+    int                       efd;               /* readable: completions to reap */
+    _Atomic(struct ws_task *) done;              /* finished, newest first */
+    atomic_int                sleepers;
+    atomic_int                stop;
+    pthread_mutex_t           mu;
+    pthread_cond_t            cv;
+};
+
+static __thread struct ws_worker *wsp_self;      /* the worker running this thread */
+
+static inline void wsp_complete(struct wspool *p, struct ws_task *t)
+{
+    struct ws_task *old = atomic_load_explicit(&p->done, memory_order_relaxed);
+    do t->next = old;
+    while (!atomic_compare_exchange_weak_explicit(&p->done, &old, t,
+                                                  memory_order_release, memory_order_relaxed));
+    if (!old) {                                  /* first one: wake the loop */
+        uint64_t one = 1;
+        if (write(p->efd, &one, sizeof(one)) < 0) { /* counter full: already readable */ }
+    }
+}
+
+/* Any deque (the loop's is index nworkers) non-empty? */
+static inline int wsp_has_work(struct wspool *p)
+{
+    if (wsd_size(&p->inject) > 0) return 1;
+    for (int i = 0; i < p->nworkers; i++)
+        if (wsd_size(&p->w[i].dq) > 0) return 1;
+    return 0;
+}
+
+/* One pass over every victim, starting at a random one. */
+static inline struct ws_task *wsp_steal(struct ws_worker *self)
+{
+    struct wspool *p = self->pool;
+    int n = p->nworkers + 1;
+    self->rng ^= self->rng << 13;
+    self->rng ^= self->rng >> 7;
+    self->rng ^= self->rng << 17;
+    int start = (int)(self->rng % (uint64_t)n);
+    for (int k = 0; k < n; k++) {
+        int v = (start + k) % n;
+        if (v == self->id) continue;
+        struct wsdeque *d = v == p->nworkers ? &p->inject : &p->w[v].dq;
+        void *x = wsd_steal(d);
+        if (x && x != WSD_ABORT) {
+            self->stolen++;
+            return (struct ws_task *)x;
+        }
+    }
+    return NULL;
+}
+
+static inline void *wsp_worker_main(void *arg)
+{
+    struct ws_worker *self = (struct ws_worker *)arg;
+    struct wspool *p = self->pool;
+    wsp_self = self;
+    int idle = 0;
+    while (!atomic_load_explicit(&p->stop, memory_order_relaxed)) {
+        struct ws_task *t = (struct ws_task *)wsd_take(&self->dq);
+        if (!t) t = wsp_steal(self);
+        if (t) {
+            idle = 0;
+            self->ran++;
+            unsigned char report = t->report;    /* t may be gone once fn returns */
+            t->fn(t);
+            if (report) wsp_complete(p, t);
+            continue;
+        }
+        if (++idle < WSP_SPIN) {
+            sched_yield();
+            continue;
+        }
+        pthread_mutex_lock(&p->mu);
+        atomic_fetch_add(&p->sleepers, 1);
+        if (!atomic_load(&p->stop) && !wsp_has_work(p)) pthread_cond_wait(&p->cv, &p->mu);
+        atomic_fetch_sub(&p->sleepers, 1);
+        pthread_mutex_unlock(&p->mu);
+        idle = 0;
+    }
+    return NULL;
+}
+
+static inline void wsp_wake(struct wspool *p)
+{
+    atomic_thread_fence(memory_order_seq_cst);   /* the push before the sleeper count */
+    if (atomic_load(&p->sleepers) > 0) {
+        pthread_mutex_lock(&p->mu);
+        pthread_cond_signal(&p->cv);
+        pthread_mutex_unlock(&p->mu);
+    }
+}
+
+/*
+ * Start nworkers threads.  The calling thread becomes the one that may
+ * wsp_submit() and wsp_reap().  Returns 0, or -1 with errno set.
+ */
+static inline int wsp_init(struct wspool *p, int nworkers)
+{
+    memset(p, 0, sizeof(*p));
+    p->nworkers = nworkers;
+    p->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    p->w   = (struct ws_worker *)aligned_alloc(64, (size_t)nworkers * sizeof(*p->w));
+    if (p->efd < 0 || !p->w || wsd_init(&p->inject, 1024) < 0) return -1;
+    atomic_init(&p->done, NULL);
+    atomic_init(&p->sleepers, 0);
+    atomic_init(&p->stop, 0);
+    pthread_mutex_init(&p->mu, NULL);
+    pthread_cond_init(&p->cv, NULL);
+    memset(p->w, 0, (size_t)nworkers * sizeof(*p->w));
+    for (int i = 0; i < nworkers; i++) {
+        struct ws_worker *w = &p->w[i];
+        w->pool = p;
+        w->id   = i;
+        w->rng  = 0x9e3779b97f4a7c15ull * (uint64_t)(i + 1);
+        if (wsd_init(&w->dq, 64) < 0) return -1;
+    }
+    for (int i = 0; i < nworkers; i++) {
+        int rc = pthread_create(&p->w[i].tid, NULL, wsp_worker_main, &p->w[i]);
+        if (rc != 0) {
+            errno = rc;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Loop thread: run t on the pool; it comes back from wsp_reap().  -1 if out of memory. */
+static inline int wsp_submit(struct wspool *p, struct ws_task *t)
+{
+    t->report = 1;
+    if (wsd_push(&p->inject, t) < 0) return -1;
+    wsp_wake(p);
+    return 0;
+}
+
+/*
+ * From inside a running task: run t on the pool too, unreported — the
+ * spawning task arranges how it learns t is done.  -1 if out of memory.
+ */
+static inline int wsp_spawn(struct ws_task *t)
+{
+    t->report = 0;
+    if (wsd_push(&wsp_self->dq, t) < 0) return -1;
+    wsp_wake(wsp_self->pool);
+    return 0;
+}
+
+/* Loop thread: every finished task, oldest first, linked by next; NULL if none. */
+static inline struct ws_task *wsp_reap(struct wspool *p)
+{
+    uint64_t n;
+    if (read(p->efd, &n, sizeof(n)) < 0) { /* EAGAIN: nothing signalled */ }
+    struct ws_task *t = atomic_exchange_explicit(&p->done, NULL, memory_order_acquire);
+    struct ws_task *fifo = NULL;
+    while (t) {
+        struct ws_task *next = t->next;
+        t->next = fifo;
+        fifo = t;
+        t = next;
+    }
+    return fifo;
+}
+
+/* Stop and join the workers.  Tasks not started yet are dropped. */
+static inline void wsp_destroy(struct wspool *p)
+{
+    if (p->w) {
+        atomic_store(&p->stop, 1);
+        pthread_mutex_lock(&p->mu);
+        pthread_cond_broadcast(&p->cv);
+        pthread_mutex_unlock(&p->mu);
+        for (int i = 0; i < p->nworkers; i++)
+            if (p->w[i].tid) pthread_join(p->w[i].tid, NULL);
+        for (int i = 0; i < p->nworkers; i++) wsd_destroy(&p->w[i].dq);
+        pthread_mutex_destroy(&p->mu);
+        pthread_cond_destroy(&p->cv);
+        free(p->w);
+        p->w = NULL;
+    }
+    wsd_destroy(&p->inject);
+    if (p->efd >= 0) close(p->efd);
+    p->efd = -1;
+}
+
+#endif /* WSPOOL_H */
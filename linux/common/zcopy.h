@@ -0,0 +1,195 @@
+#ifndef ZCOPY_H
+#define ZCOPY_H
+
+/*
+ * linux/common/zcopy.h
+ *
+ * Header-only MSG_ZEROCOPY send path (Linux 4.14+).
+ *
+ * send(..., MSG_ZEROCOPY) on a socket with SO_ZEROCOPY set pins the user
+ * pages instead of copying them into the socket buffer, so the bytes must
+ * stay untouched until the kernel is done with them — after the peer ACKed
+ * them, not when send() returns.  The kernel numbers every successful
+ * zero-copy send on a socket 0, 1, 2, ... and reports finished ones as a
+ * range [lo, hi] on the socket's error queue (recvmsg(MSG_ERRQUEUE)),
+ * which shows up as EPOLLERR / POLLERR.
+ *
+ * Payloads live in reference-counted struct zc_buf buffers from a
+ * struct bufpool.  struct zc_tx keeps, per socket, the buffer each
+ * outstanding send pins, and zc_reap() drops those references as
+ * completions come in; a buffer goes back to the pool when the last one
+ * is gone.  Pinning pages and reading completions costs more than a
+ * memcpy of a few KB, so callers only use this above a size threshold.
+ * When the kernel had to copy anyway (loopback, or a device without
+ * scatter-gather), the completion says so and zc_tx turns itself off.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+
+#include "bufpool.h"
+
+#ifndef SO_ZEROCOPY
+#  define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#  define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#  define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#  define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+#define ZC_INFLIGHT 32               /* outstanding sends per socket, power of two */
+
+/* A pool buffer with a reference count: one for its owner, one per send. */
+struct zc_buf {
+    unsigned refs;
+    unsigned len;                    /* bytes of data[] in use */
+    char     data[];
+};
+
+struct zc_tx {
+    uint32_t       next;             /* kernel sequence number of the next send */
+    unsigned       inflight;         /* sends not completed yet */
+    unsigned char  off;              /* kernel copied: stop asking for zero-copy */
+    uint64_t       sends;            /* zero-copy sends made */
+    uint64_t       bytes;
+    uint64_t       copied;           /* completions the kernel had to copy */
+    struct zc_buf *pinned[ZC_INFLIGHT];  /* by sequence number */
+};
+
+static inline void zc_tx_init(struct zc_tx *z)
+{
+    memset(z, 0, sizeof(*z));
+}
+
+/* Allow MSG_ZEROCOPY on fd.  Returns 0, or -1 if the kernel lacks it. */
+static inline int zc_enable(int fd)
+{
+    int one = 1;
+    return setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+}
+
+/* Payload capacity of a buffer from pool. */
+static inline size_t zc_buf_cap(const struct bufpool *pool)
+{
+    return pool->bufsz - sizeof(struct zc_buf);
+}
+
+/* A fresh buffer holding one reference (the caller's), or NULL. */
+static inline struct zc_buf *zc_buf_get(struct bufpool *pool)
+{
+    struct zc_buf *b = (struct zc_buf *)bufpool_get(pool);
+    if (b) {
+        b->refs = 1;
+        b->len  = 0;
+    }
+    return b;
+}
+
+static inline void zc_buf_unref(struct bufpool *pool, struct zc_buf *b)
+{
+    if (--b->refs == 0) bufpool_put(pool, b);
+}
+
+/* Non-zero if a zero-copy send may be started now. */
+static inline int zc_ready(const struct zc_tx *z)
+{
+    return !z->off && z->inflight < ZC_INFLIGHT;
+}
+
+/*
+ * Send up to len bytes at p, which must lie inside b->data, without
+ * copying.  b gains a reference until the kernel reports the send
+ * complete.  Returns the bytes sent, or -1 with errno set (EAGAIN: the
+ * socket is full; ENOBUFS: out of notification memory, send by copy).
+ */
+static inline ssize_t zc_send(struct zc_tx *z, int fd, struct zc_buf *b,
+                              const char *p, size_t len, int flags)
+{
+    ssize_t w;
+    do {
+        w = send(fd, p, len, flags | MSG_ZEROCOPY | MSG_NOSIGNAL);
+    } while (w < 0 && errno == EINTR);
+    if (w <= 0) return w;
+
+    b->refs++;
+    z->pinned[z->next & (ZC_INFLIGHT - 1)] = b;
+    z->next++;
+    z->inflight++;
+    z->sends++;
+    z->bytes += (uint64_t)w;
+    return w;
+}
+
+/*
+ * Read every pending completion from fd's error queue and release the
+ * buffers they cover.  Returns the number of sends completed, or -1 on a
+ * socket error (errno set).
+ */
+static inline int zc_reap(struct zc_tx *z, int fd, struct bufpool *pool)
+{
+    int done = 0;
+    for (;;) {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return done;
+            return -1;
+        }
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!((cm->cmsg_level == SOL_IP   && cm->cmsg_type == IP_RECVERR) ||
+                  (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+                continue;
+            struct sock_extended_err serr;
+            memcpy(&serr, CMSG_DATA(cm), sizeof(serr));
+            if (serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr.ee_errno != 0) continue;
+
+            /* [ee_info, ee_data], inclusive; the numbers wrap at 2^32. */
+            for (uint32_t id = serr.ee_info; ; id++) {
+                struct zc_buf **slot = &z->pinned[id & (ZC_INFLIGHT - 1)];
+                if (*slot) {
+                    zc_buf_unref(pool, *slot);
+                    *slot = NULL;
+                    z->inflight--;
+                    done++;
+                }
+                if (id == serr.ee_data) break;
+            }
+            if (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                z->copied++;
+                z->off = 1;
+            }
+        }
+    }
+}
+
+/*
+ * Drop every outstanding send without waiting for it (the connection is
+ * being torn down and its data no longer matters).
+ */
+static inline void zc_tx_abort(struct zc_tx *z, struct bufpool *pool)
+{
+    for (unsigned i = 0; i < ZC_INFLIGHT; i++) {
+        if (z->pinned[i]) {
+            zc_buf_unref(pool, z->pinned[i]);
+            z->pinned[i] = NULL;
+        }
+    }
+    z->inflight = 0;
+}
+
+#endif /* ZCOPY_H */
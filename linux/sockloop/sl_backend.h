@@ -0,0 +1,81 @@
+#ifndef SL_BACKEND_H
+#define SL_BACKEND_H
+
+/*
+ * linux/sockloop/sl_backend.h
+ *
+ * Inside libsockloop: the loop's state and what a backend provides.
+ *
+ * A backend only tracks interest and waits.  set() is called whenever the
+ * interest of an fd changes — from nothing when it is added, to nothing
+ * before it is closed — and wait() calls sl_ready() for every fd that is
+ * ready, then returns how many there were.  sl_ready() may change the
+ * interest of the fd at hand, or close it, before it returns.
+ */
+
+#include <stdint.h>
+
+#include "sockloop.h"
+#include "../common/outq.h"
+#include "../common/bufpool.h"
+#include "../common/twheel.h"
+
+#define SL_RD  1u
+#define SL_WR  2u
+#define SL_ERR 4u                /* error or hang-up: read to find out */
+
+#define SL_RBUF (64 * 1024)      /* one recv() */
+#define SL_MAX_LISTEN 8
+
+enum { SL_FREE, SL_LISTENER, SL_CONN };
+
+/* Per-fd state, indexed by fd. */
+struct sl_fd {
+    unsigned char kind;          /* SL_FREE / SL_LISTENER / SL_CONN */
+    unsigned char want;          /* interest the backend has now */
+    unsigned char paused;        /* out above high water: stop reading */
+    unsigned char closing;       /* sl_close(): close once out drains */
+    unsigned char dead;          /* failed: close after the callback */
+    unsigned char dirty;         /* on the settle list */
+    unsigned char more;          /* listener: accept budget ran out;
+                                    connection: read budget ran out, on again[] */
+    struct outq   out;
+};
+
+struct sl_ops {
+    const char *name;
+    int  (*init)(struct sl_loop *l);
+    void (*fini)(struct sl_loop *l);
+    int  (*set)(struct sl_loop *l, int fd, unsigned old, unsigned want);
+    int  (*wait)(struct sl_loop *l, int timeout_ms);
+};
+
+struct sl_loop {
+    const struct sl_ops *ops;
+    void                *be;     /* the backend's own state */
+    struct sl_handlers   h;
+    void                *ctx;
+    struct sl_fd        *fds;
+    int                  nfds;
+    int                  lfds[SL_MAX_LISTEN];
+    int                  nlisten;
+    int                 *settle; /* fds whose state changed in a callback */
+    int                  nsettle;
+    int                 *again;  /* connections to read again next round */
+    int                  nagain;
+    int                  stop;
+    struct bufpool       pool;   /* OUTQ_CHUNK buffers for every outq */
+    struct twheel        wheel;  /* one deadline per fd, in milliseconds */
+    struct sl_stats      st;
+    char                *rbuf;
+};
+
+/* Called by wait() for each ready fd; ev is SL_RD | SL_WR | SL_ERR. */
+void sl_ready(struct sl_loop *l, int fd, unsigned ev);
+
+extern const struct sl_ops sl_ops_select, sl_ops_poll, sl_ops_epoll, sl_ops_epoll_et;
+#ifdef SL_HAVE_URING
+extern const struct sl_ops sl_ops_uring;
+#endif
+
+#endif /* SL_BACKEND_H */
@@ -0,0 +1,141 @@
+#ifndef SL_ECHO_H
+#define SL_ECHO_H
+
+/*
+ * linux/sockloop/sl_echo.h
+ *
+ * The line echo (docs/protocol.md) written once on libsockloop, for every
+ * demo that serves it through the library: 02, 03 with -b, and 06.
+ *
+ * Each connection gets a line framer (linux/common/framing.h) in an
+ * fd-indexed table; every complete line is echoed, runs of back-to-back
+ * lines in one sl_send(), and the connection is closed once "bye" has
+ * gone out.  An idle connection keeps no framer buffer.  Accepting,
+ * reading, queued sends with backpressure and the idle deadline are the
+ * library's, so the demos differ only in their listeners and backend.
+ *
+ * Header-only, unlike the rest of the library, because it logs: include
+ * it from the demo's one translation unit, after linux/common/log.h.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+
+#include "sockloop.h"
+#include "../common/framing.h"
+#include "../common/fdtab.h"
+
+#define SL_ECHO_MAX_LINES 64
+
+struct sl_echo {
+    struct framer *in;           /* per fd (an fdtab): partial line between recv()s */
+    int            nin;
+    int            nclients;
+    long           idle_ms;      /* 0 = no idle deadline */
+};
+
+static inline int sl_echo_accept(struct sl_loop *l, int fd, int listener)
+{
+    struct sl_echo *e = sl_ctx(l);
+    (void)listener;
+    if (fd >= e->nin) {
+        int n = e->nin ? e->nin : 64;
+        while (n <= fd) n *= 2;
+        struct framer *p = fdtab_grow(e->in, (size_t)e->nin * sizeof(*p), (size_t)n * sizeof(*p));
+        if (!p) return -1;
+        e->in  = p;
+        e->nin = n;
+    }
+    framer_init(&e->in[fd]);
+    e->nclients++;
+    sl_timeout(l, fd, e->idle_ms);
+    LOG_DEBUG("[server] client connected (fd=%d)\n", fd);
+    return 0;
+}
+
+/* Echo every complete line, up to and including "bye". */
+static inline int sl_echo_data(struct sl_loop *l, int fd, const char *buf, size_t len)
+{
+    struct sl_echo *e = sl_ctx(l);
+    struct frame_line lines[SL_ECHO_MAX_LINES];
+    int closing = 0;
+
+    sl_timeout(l, fd, e->idle_ms);
+    while (len > 0 && !closing) {
+        size_t used;
+        int n = framer_feed(&e->in[fd], buf, len, lines, SL_ECHO_MAX_LINES, &used);
+        if (n < 0) {
+            LOG_WARN("[server] line too long (fd=%d)\n", fd);
+            return -1;
+        }
+        for (int i = 0; i < n && !closing; ) {
+            const char *p = lines[i].p;
+            size_t      k = 0;
+            do {
+                LOG_DEBUG("[server] recv (fd=%d): %.*s", fd, (int)lines[i].len, lines[i].p);
+                if (frame_is_bye(&lines[i])) closing = 1;
+                k += lines[i++].len;
+            } while (!closing && i < n && lines[i].p == p + k);
+            if (sl_send(l, fd, p, k) < 0) {
+                perror("send");
+                return -1;
+            }
+        }
+        buf += used;
+        len -= used;
+    }
+    framer_idle(&e->in[fd]);                     /* an idle connection keeps no buffer */
+    if (closing) sl_close(l, fd);
+    return 0;
+}
+
+static inline void sl_echo_timeout(struct sl_loop *l, int fd)
+{
+    LOG_INFO("[server] idle timeout (fd=%d)\n", fd);
+    sl_close(l, fd);
+}
+
+static inline void sl_echo_closed(struct sl_loop *l, int fd)
+{
+    struct sl_echo *e = sl_ctx(l);
+    LOG_DEBUG("[server] client disconnected (fd=%d)\n", fd);
+    framer_free(&e->in[fd]);
+    if (--e->nclients == 0) sl_stop(l);
+}
+
+/*
+ * Serve the line echo on the n listening sockets lfds with backend b until
+ * the last client disconnects.  A connection silent for idle_ms is closed;
+ * 0 means never.  The backend's counters are logged at the end.  Returns
+ * 0, or -1 (errno set) if the loop could not be started or failed.  The
+ * listeners are left open.
+ */
+static inline int sl_echo_serve(enum sl_backend b, const int *lfds, int n, long idle_ms)
+{
+    static const struct sl_handlers h = {
+        .on_accept  = sl_echo_accept,
+        .on_data    = sl_echo_data,
+        .on_timeout = sl_echo_timeout,
+        .on_close   = sl_echo_closed,
+    };
+    struct sl_echo e = { .idle_ms = idle_ms };
+    struct sl_loop *l = sl_create(b, &h, &e);
+    if (!l) return -1;
+
+    int rc = 0;
+    for (int i = 0; i < n && rc == 0; i++) rc = sl_listen(l, lfds[i]);
+    if (rc == 0) rc = sl_run(l);
+    int err = errno;
+
+    struct sl_stats st;
+    sl_get_stats(l, &st);
+    LOG_INFO("[server] %s: %llu wait(s), %.2f event(s) per wait, %llu interest change(s)\n",
+             sl_backend_name(b), (unsigned long long)st.waits,
+             st.waits ? (double)st.events / (double)st.waits : 0.0, (unsigned long long)st.ctl);
+    sl_destroy(l);
+    fdtab_free(e.in, (size_t)e.nin * sizeof(*e.in));
+    errno = err;
+    return rc;
+}
+
+#endif /* SL_ECHO_H */
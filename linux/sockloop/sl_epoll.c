@@ -0,0 +1,88 @@
+/*
+ * linux/sockloop/sl_epoll.c
+ *
+ * epoll backends, level- and edge-triggered.  Interest lives in the
+ * kernel, so a change costs one epoll_ctl() and a wait costs nothing per
+ * idle fd.  Edge-triggered, an fd is reported once per change of state;
+ * the core reads every connection until EAGAIN and re-registers on every
+ * change of interest (EPOLL_CTL_MOD re-checks readiness), so no edge is
+ * lost.  Level-triggered, an fd still ready is reported again each wait.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "sl_backend.h"
+
+#define SL_EPOLL_EVENTS 64
+
+struct sl_epoll {
+    int                epfd;
+    unsigned           et;       /* EPOLLET or 0 */
+    struct epoll_event ev[SL_EPOLL_EVENTS];
+};
+
+static int ep_init_mode(struct sl_loop *l, unsigned et)
+{
+    struct sl_epoll *e = calloc(1, sizeof(*e));
+    if (!e) return -1;
+    e->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (e->epfd < 0) {
+        free(e);
+        return -1;
+    }
+    e->et = et;
+    l->be = e;
+    return 0;
+}
+
+static int ep_init(struct sl_loop *l)    { return ep_init_mode(l, 0); }
+static int ep_init_et(struct sl_loop *l) { return ep_init_mode(l, EPOLLET); }
+
+static void ep_fini(struct sl_loop *l)
+{
+    struct sl_epoll *e = l->be;
+    close(e->epfd);
+    free(e);
+}
+
+static int ep_set(struct sl_loop *l, int fd, unsigned old, unsigned want)
+{
+    struct sl_epoll *e = l->be;
+    if (!want) return epoll_ctl(e->epfd, EPOLL_CTL_DEL, fd, NULL);
+    struct epoll_event ev;
+    ev.events  = e->et | (want & SL_RD ? EPOLLIN : 0) | (want & SL_WR ? EPOLLOUT : 0);
+    ev.data.fd = fd;
+    return epoll_ctl(e->epfd, old ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+}
+
+static int ep_wait(struct sl_loop *l, int timeout_ms)
+{
+    struct sl_epoll *e = l->be;
+    int n = epoll_wait(e->epfd, e->ev, SL_EPOLL_EVENTS, timeout_ms);
+    for (int i = 0; i < n; i++) {
+        uint32_t re = e->ev[i].events;
+        sl_ready(l, e->ev[i].data.fd, (re & EPOLLIN ? SL_RD : 0) | (re & EPOLLOUT ? SL_WR : 0) |
+                                      (re & (EPOLLERR | EPOLLHUP) ? SL_ERR : 0));
+    }
+    return n;
+}
+
+const struct sl_ops sl_ops_epoll = {
+    .name = "epoll",
+    .init = ep_init,
+    .fini = ep_fini,
+    .set  = ep_set,
+    .wait = ep_wait,
+};
+
+const struct sl_ops sl_ops_epoll_et = {
+    .name = "epoll-et",
+    .init = ep_init_et,
+    .fini = ep_fini,
+    .set  = ep_set,
+    .wait = ep_wait,
+};
@@ -0,0 +1,81 @@
+/*
+ * linux/sockloop/sl_poll.c
+ *
+ * poll() backend.  The pollfd array is indexed by fd and kept between
+ * rounds: changing interest is a store, and an fd not watched has a
+ * negative fd field, which poll() skips.  Each call still hands the kernel
+ * every entry up to the highest fd registered.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+
+#include "sl_backend.h"
+
+struct sl_poll {
+    struct pollfd *pfd;
+    int            cap;
+    int            n;            /* entries up to the highest fd registered */
+};
+
+static int pl_init(struct sl_loop *l)
+{
+    struct sl_poll *p = calloc(1, sizeof(*p));
+    if (!p) return -1;
+    l->be = p;
+    return 0;
+}
+
+static void pl_fini(struct sl_loop *l)
+{
+    struct sl_poll *p = l->be;
+    free(p->pfd);
+    free(p);
+}
+
+static int pl_set(struct sl_loop *l, int fd, unsigned old, unsigned want)
+{
+    struct sl_poll *p = l->be;
+    (void)old;
+    if (fd >= p->cap) {
+        int cap = p->cap ? p->cap : 64;
+        while (cap <= fd) cap *= 2;
+        struct pollfd *t = realloc(p->pfd, (size_t)cap * sizeof(*t));
+        if (!t) return -1;
+        for (int i = p->cap; i < cap; i++) t[i] = (struct pollfd){ -1, 0, 0 };
+        p->pfd = t;
+        p->cap = cap;
+    }
+    struct pollfd *e = &p->pfd[fd];
+    e->fd     = want ? fd : -1;
+    e->events = (short)((want & SL_RD ? POLLIN : 0) | (want & SL_WR ? POLLOUT : 0));
+    if (want && fd >= p->n) p->n = fd + 1;
+    while (p->n > 0 && p->pfd[p->n - 1].fd < 0) p->n--;
+    return 0;
+}
+
+static int pl_wait(struct sl_loop *l, int timeout_ms)
+{
+    struct sl_poll *p = l->be;
+    int n = poll(p->pfd, (nfds_t)p->n, timeout_ms);
+    if (n <= 0) return n;
+    int seen = 0;
+    for (int fd = 0; fd < p->n && seen < n; fd++) {
+        short re = p->pfd[fd].revents;
+        if (!re || p->pfd[fd].fd < 0) continue;
+        seen++;
+        sl_ready(l, fd, (re & POLLIN ? SL_RD : 0) | (re & POLLOUT ? SL_WR : 0) |
+                        (re & (POLLERR | POLLHUP | POLLNVAL) ? SL_ERR : 0));
+    }
+    return n;
+}
+
+const struct sl_ops sl_ops_poll = {
+    .name = "poll",
+    .init = pl_init,
+    .fini = pl_fini,
+    .set  = pl_set,
+    .wait = pl_wait,
+};
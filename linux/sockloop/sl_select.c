@@ -0,0 +1,77 @@
+/*
+ * linux/sockloop/sl_select.c
+ *
+ * select() backend.  The interest sets live here between rounds and are
+ * copied for each call, which then scans every fd up to the highest one
+ * registered.  fds at or above FD_SETSIZE cannot be watched: adding one
+ * fails with EMFILE and the connection is refused.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/select.h>
+
+#include "sl_backend.h"
+
+struct sl_select {
+    fd_set rd, wr;
+    int    maxfd;                /* highest fd ever registered */
+};
+
+static int sel_init(struct sl_loop *l)
+{
+    struct sl_select *s = calloc(1, sizeof(*s));
+    if (!s) return -1;
+    FD_ZERO(&s->rd);
+    FD_ZERO(&s->wr);
+    s->maxfd = -1;
+    l->be = s;
+    return 0;
+}
+
+static void sel_fini(struct sl_loop *l)
+{
+    free(l->be);
+}
+
+static int sel_set(struct sl_loop *l, int fd, unsigned old, unsigned want)
+{
+    struct sl_select *s = l->be;
+    (void)old;
+    if (fd >= FD_SETSIZE) {
+        errno = EMFILE;
+        return -1;
+    }
+    if (want & SL_RD) FD_SET(fd, &s->rd);
+    else              FD_CLR(fd, &s->rd);
+    if (want & SL_WR) FD_SET(fd, &s->wr);
+    else              FD_CLR(fd, &s->wr);
+    if (want && fd > s->maxfd) s->maxfd = fd;
+    return 0;
+}
+
+static int sel_wait(struct sl_loop *l, int timeout_ms)
+{
+    struct sl_select *s = l->be;
+    fd_set rd = s->rd, wr = s->wr;
+    struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+    int n = select(s->maxfd + 1, &rd, &wr, NULL, timeout_ms < 0 ? NULL : &tv);
+    if (n <= 0) return n;
+    int seen = 0;
+    for (int fd = 0; fd <= s->maxfd && seen < n; fd++) {
+        unsigned ev = (FD_ISSET(fd, &rd) ? SL_RD : 0) | (FD_ISSET(fd, &wr) ? SL_WR : 0);
+        if (!ev) continue;
+        seen += (ev & SL_RD ? 1 : 0) + (ev & SL_WR ? 1 : 0);
+        sl_ready(l, fd, ev);
+    }
+    return n;
+}
+
+const struct sl_ops sl_ops_select = {
+    .name = "select",
+    .init = sel_init,
+    .fini = sel_fini,
+    .set  = sel_set,
+    .wait = sel_wait,
+};
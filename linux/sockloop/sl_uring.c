@@ -0,0 +1,195 @@
+/*
+ * linux/sockloop/sl_uring.c
+ *
+ * io_uring backend: readiness through IORING_OP_POLL_ADD, so the core and
+ * the application are the same as with epoll.  A poll request fires once;
+ * fds that fired, or whose interest changed, are re-armed in one batch by
+ * the io_uring_enter() that also waits for the next completions, so a
+ * round costs one system call however many fds it touches.  A change of
+ * interest on an armed fd cancels its request (IORING_OP_POLL_REMOVE) in
+ * that same batch, or at once when the fd is dropped before close(); each
+ * request carries a per-fd generation in its
+ * user_data, so completions of cancelled requests are told apart and
+ * dropped.  Waiting with a timeout needs IORING_ENTER_EXT_ARG (Linux 5.11).
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+
+#include "sl_backend.h"
+#include "../common/uring_helpers.h"
+
+#define SL_URING_ENTRIES 256
+#define SL_URING_IGNORE  UINT64_MAX              /* user_data of POLL_REMOVE */
+
+struct sl_uring {
+    struct uring   r;
+    uint32_t      *gen;          /* per fd: the live request's generation */
+    unsigned char *want, *armed, *queued;
+    int           *rearm;        /* fds to arm before the next wait */
+    int            nrearm, cap;
+};
+
+static uint64_t ud(struct sl_uring *u, int fd)
+{
+    return (uint64_t)u->gen[fd] << 32 | (uint32_t)fd;
+}
+
+static int ur_enter(struct sl_uring *u, unsigned wait_nr, int timeout_ms)
+{
+    struct __kernel_timespec ts = { timeout_ms / 1000, (long long)(timeout_ms % 1000) * 1000000 };
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts         = timeout_ms >= 0 ? (uint64_t)(uintptr_t)&ts : 0;
+    unsigned n = uring_pending(&u->r);
+    __atomic_store_n(u->r.sq_tail, u->r.sq_local, __ATOMIC_RELEASE);
+    return (int)syscall(__NR_io_uring_enter, u->r.fd, n, wait_nr,
+                        IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+/* Submit what is queued without waiting. */
+static int ur_submit(struct sl_uring *u)
+{
+    unsigned n = uring_pending(&u->r);
+    __atomic_store_n(u->r.sq_tail, u->r.sq_local, __ATOMIC_RELEASE);
+    return n ? (int)syscall(__NR_io_uring_enter, u->r.fd, n, 0, 0, NULL, 0) : 0;
+}
+
+static void ur_fini(struct sl_loop *l)
+{
+    struct sl_uring *u = l->be;
+    uring_exit(&u->r);
+    free(u->gen);
+    free(u->want);
+    free(u->armed);
+    free(u->queued);
+    free(u->rearm);
+    free(u);
+}
+
+static int ur_init(struct sl_loop *l)
+{
+    struct sl_uring *u = calloc(1, sizeof(*u));
+    if (!u) return -1;
+    if (uring_init(&u->r, SL_URING_ENTRIES, 0) < 0) {
+        free(u);
+        return -1;
+    }
+    l->be = u;
+    /* Kernels without EXT_ARG reject the flag: no timeouts, so no backend. */
+    if (ur_enter(u, 0, 0) < 0) {
+        int e = errno;
+        ur_fini(l);
+        errno = e;
+        return -1;
+    }
+    return 0;
+}
+
+static int ur_grow(struct sl_uring *u, int fd)
+{
+    int cap = u->cap ? u->cap : 64;
+    while (cap <= fd) cap *= 2;
+    uint32_t      *g = realloc(u->gen, (size_t)cap * sizeof(*g));
+    if (g) u->gen = g;
+    unsigned char *w = g ? realloc(u->want, (size_t)cap) : NULL;
+    if (w) u->want = w;
+    unsigned char *a = w ? realloc(u->armed, (size_t)cap) : NULL;
+    if (a) u->armed = a;
+    unsigned char *q = a ? realloc(u->queued, (size_t)cap) : NULL;
+    if (q) u->queued = q;
+    int           *r = q ? realloc(u->rearm, (size_t)cap * sizeof(*r)) : NULL;
+    if (!r) return -1;
+    u->rearm = r;
+    size_t more = (size_t)(cap - u->cap);
+    memset(g + u->cap, 0, more * sizeof(*g));
+    memset(w + u->cap, 0, more);
+    memset(a + u->cap, 0, more);
+    memset(q + u->cap, 0, more);
+    u->cap = cap;
+    return 0;
+}
+
+static void ur_queue(struct sl_uring *u, int fd)
+{
+    if (u->queued[fd]) return;
+    u->queued[fd] = 1;
+    u->rearm[u->nrearm++] = fd;
+}
+
+static int ur_set(struct sl_loop *l, int fd, unsigned old, unsigned want)
+{
+    struct sl_uring *u = l->be;
+    (void)old;
+    if (fd >= u->cap && ur_grow(u, fd) < 0) return -1;
+    u->want[fd] = (unsigned char)want;
+    if (u->armed[fd]) {
+        struct io_uring_sqe *sqe = uring_get_sqe(&u->r);
+        if (!sqe && (ur_submit(u) < 0 || !(sqe = uring_get_sqe(&u->r)))) return -1;
+        sqe->opcode    = IORING_OP_POLL_REMOVE;
+        sqe->fd        = -1;
+        sqe->addr      = ud(u, fd);
+        sqe->user_data = SL_URING_IGNORE;
+        u->armed[fd]   = 0;
+        /*
+         * An armed request holds the socket open: dropping the fd is the
+         * step before close(), which sends no FIN until the request is gone.
+         */
+        if (!want && ur_submit(u) < 0) return -1;
+    }
+    u->gen[fd]++;                                /* whatever is in flight is stale now */
+    if (want) ur_queue(u, fd);
+    return 0;
+}
+
+static int ur_wait(struct sl_loop *l, int timeout_ms)
+{
+    struct sl_uring *u = l->be;
+    for (int i = 0; i < u->nrearm; i++) {
+        int fd = u->rearm[i];
+        u->queued[fd] = 0;
+        if (!u->want[fd] || u->armed[fd]) continue;
+        struct io_uring_sqe *sqe = uring_get_sqe(&u->r);
+        if (!sqe && (ur_submit(u) < 0 || !(sqe = uring_get_sqe(&u->r)))) return -1;
+        sqe->opcode        = IORING_OP_POLL_ADD;
+        sqe->fd            = fd;
+        sqe->poll32_events = (u->want[fd] & SL_RD ? POLLIN : 0) | (u->want[fd] & SL_WR ? POLLOUT : 0);
+        sqe->user_data     = ud(u, fd);
+        u->armed[fd]       = 1;
+    }
+    u->nrearm = 0;
+
+    if (ur_enter(u, timeout_ms == 0 ? 0 : 1, timeout_ms) < 0 && errno != ETIME) return -1;
+
+    int n = 0;
+    for (struct io_uring_cqe *cqe; (cqe = uring_peek_cqe(&u->r)) != NULL; ) {
+        uint64_t d   = cqe->user_data;
+        int      res = cqe->res;
+        uring_cq_advance(&u->r, 1);
+        if (d == SL_URING_IGNORE) continue;
+        int fd = (int)(uint32_t)d;
+        if (fd >= u->cap || (uint32_t)(d >> 32) != u->gen[fd] || !u->armed[fd]) continue;
+        u->armed[fd] = 0;
+        ur_queue(u, fd);                         /* fired once: arm again next round */
+        unsigned ev = res < 0 ? SL_ERR
+                    : (res & POLLIN ? SL_RD : 0) | (res & POLLOUT ? SL_WR : 0) |
+                      (res & (POLLERR | POLLHUP) ? SL_ERR : 0);
+        n++;
+        sl_ready(l, fd, ev);
+    }
+    return n;
+}
+
+const struct sl_ops sl_ops_uring = {
+    .name = "uring",
+    .init = ur_init,
+    .fini = ur_fini,
+    .set  = ur_set,
+    .wait = ur_wait,
+};
@@ -0,0 +1,382 @@
+/*
+ * linux/sockloop/sockloop.c
+ *
+ * libsockloop core: the fd table, accepting, reading, queued sends,
+ * deadlines and the run loop.  Backends (sl_*.c) only report readiness.
+ *
+ * Callbacks never see a connection disappear under them: sl_send() and
+ * sl_close() only mark it, and the table is settled — the connection
+ * closed or its interest updated — once the callback has returned.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "sl_backend.h"
+#include "../common/fdtab.h"
+
+static const struct sl_ops *const backends[SL_NBACKENDS] = {
+    [SL_SELECT]   = &sl_ops_select,
+    [SL_POLL]     = &sl_ops_poll,
+    [SL_EPOLL]    = &sl_ops_epoll,
+    [SL_EPOLL_ET] = &sl_ops_epoll_et,
+#ifdef SL_HAVE_URING
+    [SL_URING]    = &sl_ops_uring,
+#endif
+};
+
+static const char *const backend_names[SL_NBACKENDS] = {
+    "select", "poll", "epoll", "epoll-et", "uring"
+};
+
+int sl_backend_parse(const char *name)
+{
+    for (int b = 0; b < SL_NBACKENDS; b++)
+        if (strcmp(name, backend_names[b]) == 0) return b;
+    return -1;
+}
+
+const char *sl_backend_name(enum sl_backend b)
+{
+    return (unsigned)b < SL_NBACKENDS ? backend_names[b] : "?";
+}
+
+int sl_backend_built(enum sl_backend b)
+{
+    return (unsigned)b < SL_NBACKENDS && backends[b] != NULL;
+}
+
+static uint64_t clock_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+struct sl_loop *sl_create(enum sl_backend b, const struct sl_handlers *h, void *ctx)
+{
+    if (!sl_backend_built(b)) {
+        errno = ENOSYS;
+        return NULL;
+    }
+    struct sl_loop *l = calloc(1, sizeof(*l));
+    if (!l) return NULL;
+    l->ops  = backends[b];
+    l->h    = *h;
+    l->ctx  = ctx;
+    l->rbuf = malloc(SL_RBUF);
+    bufpool_init(&l->pool, OUTQ_CHUNK);
+    tw_init(&l->wheel, clock_ms());
+    if (!l->rbuf || l->ops->init(l) < 0) {
+        int e = errno;
+        free(l->rbuf);
+        bufpool_destroy(&l->pool);
+        tw_destroy(&l->wheel);
+        free(l);
+        errno = e;
+        return NULL;
+    }
+    return l;
+}
+
+void *sl_ctx(struct sl_loop *l)
+{
+    return l->ctx;
+}
+
+void sl_stop(struct sl_loop *l)
+{
+    l->stop = 1;
+}
+
+void sl_get_stats(struct sl_loop *l, struct sl_stats *s)
+{
+    *s = l->st;
+}
+
+/*
+ * Table entry for fd, growing the table (and the wheel) to hold it.  The
+ * tables are fdtabs: entries of fds never used cost no memory.
+ */
+static struct sl_fd *fd_get(struct sl_loop *l, int fd)
+{
+    if (fd >= l->nfds) {
+        int n = l->nfds ? l->nfds : 64;
+        while (n <= fd) n *= 2;
+        struct sl_fd *t = fdtab_grow(l->fds, (size_t)l->nfds * sizeof(*t), (size_t)n * sizeof(*t));
+        if (t) l->fds = t;
+        int *s = t ? fdtab_grow(l->settle, (size_t)l->nfds * sizeof(*s), (size_t)n * sizeof(*s)) : NULL;
+        if (s) l->settle = s;
+        int *a = s ? fdtab_grow(l->again, (size_t)l->nfds * sizeof(*a), (size_t)n * sizeof(*a)) : NULL;
+        if (a) l->again = a;
+        if (!a || tw_reserve(&l->wheel, n) < 0) return NULL;
+        l->nfds = n;
+    }
+    return &l->fds[fd];
+}
+
+static void mark(struct sl_loop *l, int fd)
+{
+    struct sl_fd *c = &l->fds[fd];
+    if (c->dirty || c->kind != SL_CONN) return;
+    c->dirty = 1;
+    l->settle[l->nsettle++] = fd;
+}
+
+/* Change what the backend watches fd for. */
+static int set_want(struct sl_loop *l, int fd, unsigned want)
+{
+    struct sl_fd *c = &l->fds[fd];
+    if (want == c->want) return 0;
+    l->st.ctl++;
+    if (l->ops->set(l, fd, c->want, want) < 0) return -1;
+    c->want = (unsigned char)want;
+    return 0;
+}
+
+static void conn_close(struct sl_loop *l, int fd, int notify)
+{
+    struct sl_fd *c = &l->fds[fd];
+    c->kind = SL_FREE;                           /* nothing more to send from on_close */
+    if (notify && l->h.on_close) l->h.on_close(l, fd);
+    set_want(l, fd, 0);
+    tw_cancel(&l->wheel, fd);
+    outq_clear(&c->out);
+    close(fd);
+    l->st.closes++;
+}
+
+/* Close a connection that is done or failed; else register what it needs. */
+static void conn_settle(struct sl_loop *l, int fd)
+{
+    struct sl_fd *c = &l->fds[fd];
+    c->dirty = 0;
+    if (c->kind != SL_CONN) return;
+    if (c->dead || (c->closing && outq_bytes(&c->out) == 0)) {
+        conn_close(l, fd, 1);
+        return;
+    }
+    unsigned want = 0;
+    if (!c->paused && !c->closing) want |= SL_RD;
+    if (outq_bytes(&c->out) > 0)   want |= SL_WR;
+    if (set_want(l, fd, want) < 0) conn_close(l, fd, 1);
+}
+
+static void settle_all(struct sl_loop *l)
+{
+    /* on_close, called from here, may mark other connections. */
+    for (int i = 0; i < l->nsettle; i++) conn_settle(l, l->settle[i]);
+    l->nsettle = 0;
+}
+
+int sl_listen(struct sl_loop *l, int lfd)
+{
+    if (l->nlisten == SL_MAX_LISTEN) {
+        errno = ENOSPC;
+        return -1;
+    }
+    struct sl_fd *c = fd_get(l, lfd);
+    if (!c) return -1;
+    memset(c, 0, sizeof(*c));
+    c->kind = SL_LISTENER;
+    if (set_want(l, lfd, SL_RD) < 0) return -1;
+    l->lfds[l->nlisten++] = lfd;
+    return 0;
+}
+
+int sl_send(struct sl_loop *l, int fd, const void *buf, size_t len)
+{
+    struct sl_fd *c = &l->fds[fd];
+    if (c->kind != SL_CONN || c->dead) {
+        errno = EBADF;
+        return -1;
+    }
+    int r = outq_send(&c->out, fd, buf, len);
+    if (r < 0) c->dead = 1;
+    else if (outq_bytes(&c->out) > OUTQ_HIGH_WATER) c->paused = 1;
+    if (r != 0) mark(l, fd);
+    return r;
+}
+
+size_t sl_queued(struct sl_loop *l, int fd)
+{
+    return fd < l->nfds && l->fds[fd].kind == SL_CONN ? outq_bytes(&l->fds[fd].out) : 0;
+}
+
+void sl_close(struct sl_loop *l, int fd)
+{
+    if (fd >= l->nfds || l->fds[fd].kind != SL_CONN) return;
+    l->fds[fd].closing = 1;
+    mark(l, fd);
+}
+
+void sl_timeout(struct sl_loop *l, int fd, long ms)
+{
+    /* The wheel's own time is as old as the last wait: read the clock. */
+    if (ms > 0) tw_arm(&l->wheel, fd, clock_ms() + (uint64_t)ms, 0);
+    else        tw_cancel(&l->wheel, fd);
+}
+
+/* Up to SL_ACCEPT_BUDGET connections from listener lfd. */
+static void accept_some(struct sl_loop *l, int lfd)
+{
+    l->fds[lfd].more = 0;
+    for (int k = 0; k < SL_ACCEPT_BUDGET; k++) {
+        int cfd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (cfd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept4");
+            return;
+        }
+        struct sl_fd *c = fd_get(l, cfd);
+        if (!c) {
+            close(cfd);
+            continue;
+        }
+        unsigned char more = c->more;            /* the fd may still be on again[] */
+        memset(c, 0, sizeof(*c));
+        c->kind = SL_CONN;
+        c->more = more;
+        outq_init_pool(&c->out, &l->pool);
+        l->st.accepts++;
+        if (set_want(l, cfd, SL_RD) < 0 || (l->h.on_accept && l->h.on_accept(l, cfd, lfd) < 0)) {
+            conn_close(l, cfd, 0);
+            continue;
+        }
+        settle_all(l);
+    }
+    l->fds[lfd].more = 1;                        /* come back next round */
+}
+
+/*
+ * Read until EAGAIN, backpressure, a close or an error, or SL_READ_BUDGET
+ * bytes: then the connection goes on again[] for the next round.
+ */
+static void conn_read(struct sl_loop *l, int fd)
+{
+    struct sl_fd *c = &l->fds[fd];
+    size_t took = 0;
+    while (!c->paused && !c->closing && !c->dead) {
+        if (took >= SL_READ_BUDGET) {
+            if (!c->more) {
+                c->more = 1;
+                l->again[l->nagain++] = fd;
+            }
+            l->st.rereads++;
+            return;
+        }
+        ssize_t r = recv(fd, l->rbuf, SL_RBUF, 0);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) c->dead = 1;
+            return;
+        }
+        if (r == 0 || l->h.on_data(l, fd, l->rbuf, (size_t)r) < 0) {
+            c->dead = 1;
+            return;
+        }
+        took += (size_t)r;
+    }
+}
+
+/*
+ * The connections whose read budget ran out last round, in that order.
+ * Ones that run out again go to the back, behind those added meanwhile.
+ * An fd closed since it was listed is skipped; one reused by a new
+ * connection kept its more flag, so it is listed once and read once.
+ */
+static void read_again(struct sl_loop *l)
+{
+    int n = l->nagain;
+    for (int i = 0; i < n; i++) {
+        int fd = l->again[i];
+        struct sl_fd *c = &l->fds[fd];
+        if (c->kind == SL_LISTENER) continue;
+        c->more = 0;
+        if (c->kind != SL_CONN) continue;
+        conn_read(l, fd);
+        mark(l, fd);
+        settle_all(l);
+    }
+    memmove(l->again, l->again + n, (size_t)(l->nagain - n) * sizeof(*l->again));
+    l->nagain -= n;
+}
+
+void sl_ready(struct sl_loop *l, int fd, unsigned ev)
+{
+    if (fd >= l->nfds) return;
+    struct sl_fd *c = &l->fds[fd];
+    l->st.events++;
+    if (c->kind == SL_LISTENER) {
+        c->more = 1;                             /* after the connections, in sl_run() */
+        return;
+    }
+    if (c->kind != SL_CONN) return;
+    if (ev & SL_WR) {
+        if (outq_flush(&c->out, fd) < 0) c->dead = 1;
+        if (c->paused && outq_bytes(&c->out) < OUTQ_LOW_WATER) {
+            c->paused = 0;
+            if (l->h.on_writable && !c->dead) l->h.on_writable(l, fd);
+        }
+    }
+    /* On again[], it is read there: once a round, whatever the backend. */
+    if ((ev & (SL_RD | SL_ERR)) && !c->more) conn_read(l, fd);
+    mark(l, fd);
+    settle_all(l);
+}
+
+int sl_run(struct sl_loop *l)
+{
+    l->stop = 0;
+    while (!l->stop) {
+        int more = 0;
+        for (int i = 0; i < l->nlisten; i++) more |= l->fds[l->lfds[i]].more;
+        int timeout = more || l->nagain ? 0 : (int)tw_next(&l->wheel);
+        int n = l->ops->wait(l, timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        l->st.waits++;
+        read_again(l);
+        for (int i = 0; i < l->nlisten && !l->stop; i++)
+            if (l->fds[l->lfds[i]].more) accept_some(l, l->lfds[i]);
+
+        tw_advance(&l->wheel, clock_ms());
+        for (int fd; (fd = tw_expired(&l->wheel)) >= 0; ) {
+            if (fd >= l->nfds || l->fds[fd].kind != SL_CONN) continue;
+            if (l->h.on_timeout) l->h.on_timeout(l, fd);
+            else                 l->fds[fd].dead = 1;
+            mark(l, fd);
+            settle_all(l);
+        }
+    }
+    return 0;
+}
+
+void sl_destroy(struct sl_loop *l)
+{
+    if (!l) return;
+    for (int fd = 0; fd < l->nfds; fd++) {
+        if (l->fds[fd].kind == SL_CONN) {
+            conn_close(l, fd, 1);
+        } else if (l->fds[fd].kind == SL_LISTENER) {
+            set_want(l, fd, 0);              /* the caller owns the listener */
+            l->fds[fd].kind = SL_FREE;
+        }
+    }
+    l->ops->fini(l);
+    tw_destroy(&l->wheel);
+    bufpool_destroy(&l->pool);
+    fdtab_free(l->fds, (size_t)l->nfds * sizeof(*l->fds));
+    fdtab_free(l->settle, (size_t)l->nfds * sizeof(*l->settle));
+    fdtab_free(l->again, (size_t)l->nfds * sizeof(*l->again));
+    free(l->rbuf);
+    free(l);
+}
@@ -0,0 +1,101 @@
+#ifndef SOCKLOOP_H
+#define SOCKLOOP_H
+
+/*
+ * linux/sockloop/sockloop.h
+ *
+ * libsockloop: one callback API for a single-threaded TCP/Unix stream
+ * server, on top of a readiness backend chosen at startup.
+ *
+ * The loop owns the sockets and does the I/O.  Listeners added with
+ * sl_listen() are accepted from (accept4(), at most SL_ACCEPT_BUDGET per
+ * listener per round); every connection is read until EAGAIN, or for at
+ * most SL_READ_BUDGET bytes a round, and its bytes handed to on_data as
+ * they arrive.  A connection that used up its budget is read again next
+ * round, after the others, so one that never stops sending cannot starve
+ * them.  sl_send() writes at once and queues
+ * what the socket does not take (linux/common/outq.h); a connection whose
+ * queue passes OUTQ_HIGH_WATER is not read from until it drains below
+ * OUTQ_LOW_WATER, and on_writable then says so.  Each connection may have
+ * one deadline, on a timing wheel (linux/common/twheel.h).
+ *
+ * The application code is the same whatever the backend, so backends can
+ * be compared under identical work:
+ *
+ *   select    select(), fds below FD_SETSIZE, sets copied every round
+ *   poll      poll(), one pollfd per fd, kept in place between rounds
+ *   epoll     epoll, level-triggered
+ *   epoll-et  epoll, edge-triggered
+ *   uring     io_uring poll requests, re-armed in the same io_uring_enter()
+ *             that waits (needs IORING_FEAT_EXT_ARG, Linux 5.11)
+ *
+ * Callbacks run on the loop's thread and may call any sl_* function,
+ * including sl_close() on the connection at hand.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SL_ACCEPT_BUDGET 64      /* accept4() calls per listener per round */
+#define SL_READ_BUDGET (64 * 1024)  /* bytes read from one connection per round */
+
+enum sl_backend { SL_SELECT, SL_POLL, SL_EPOLL, SL_EPOLL_ET, SL_URING, SL_NBACKENDS };
+
+struct sl_loop;
+
+struct sl_handlers {
+    /* A new connection on fd.  Return -1 to close it at once. */
+    int  (*on_accept)(struct sl_loop *l, int fd, int listener);
+    /* Bytes from fd.  Return -1 to close the connection. */
+    int  (*on_data)(struct sl_loop *l, int fd, const char *buf, size_t len);
+    /* fd's queued output went below low water; reading has resumed. */
+    void (*on_writable)(struct sl_loop *l, int fd);
+    /* fd's deadline passed.  NULL: close it. */
+    void (*on_timeout)(struct sl_loop *l, int fd);
+    /* fd is closed: by the peer, an error, sl_close() or a deadline. */
+    void (*on_close)(struct sl_loop *l, int fd);
+};
+
+/* NULL if the backend is unavailable here (errno set). */
+struct sl_loop *sl_create(enum sl_backend b, const struct sl_handlers *h, void *ctx);
+void            sl_destroy(struct sl_loop *l);
+
+/* "select", "poll", "epoll", "epoll-et", "uring"; -1 if unknown. */
+int             sl_backend_parse(const char *name);
+const char     *sl_backend_name(enum sl_backend b);
+/* 1 if this build has the backend at all; sl_create() may still fail. */
+int             sl_backend_built(enum sl_backend b);
+
+void           *sl_ctx(struct sl_loop *l);
+
+/* Accept connections from a listening, non-blocking socket.  -1 on error. */
+int             sl_listen(struct sl_loop *l, int lfd);
+
+/*
+ * Send len bytes on fd; what the socket does not take is queued and sent
+ * when it is writable.  Returns 0 if all went out, 1 if some were queued,
+ * -1 if the connection failed (it is closed after the current callback).
+ */
+int             sl_send(struct sl_loop *l, int fd, const void *buf, size_t len);
+size_t          sl_queued(struct sl_loop *l, int fd);
+
+/* Stop reading fd and close it once its queued output is sent. */
+void            sl_close(struct sl_loop *l, int fd);
+
+/* Give fd a deadline ms from now; 0 cancels it. */
+void            sl_timeout(struct sl_loop *l, int fd, long ms);
+
+/* Run until sl_stop() or an error.  Returns 0, or -1 with errno set. */
+int             sl_run(struct sl_loop *l);
+void            sl_stop(struct sl_loop *l);
+
+struct sl_stats {
+    uint64_t waits;              /* backend waits */
+    uint64_t events;             /* readiness events they returned */
+    uint64_t ctl;                /* interest changes sent to the kernel */
+    uint64_t accepts, closes;
+    uint64_t rereads;            /* reads cut off by SL_READ_BUDGET */
+};
+void            sl_get_stats(struct sl_loop *l, struct sl_stats *s);
+
+#endif /* SOCKLOOP_H */
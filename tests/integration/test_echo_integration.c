@@ -1,7 +1,7 @@
 /*
  * tests/integration/test_echo_integration.c
  *
- * End-to-end integration test for all three Linux echo demos.
+ * End-to-end integration test for the Linux echo demos.
  *
  * For each demo pair (server + client):
  *   1. fork() a server process
@@ -17,13 +17,18 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <signal.h>
 #include <sys/wait.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
 #include <time.h>
 
 /* CMake injects these as -DSERVER_01="..." etc. */
@@ -45,6 +50,25 @@
 #ifndef CLIENT_03
 #  define CLIENT_03 "linux03_client"
 #endif
+#ifndef REACTOR_03
+#  define REACTOR_03 "linux03_reactor"
+#endif
+#ifndef SERVER_05
+#  define SERVER_05 "linux05_server"
+#endif
+#ifndef CLIENT_05
+#  define CLIENT_05 "linux05_client"
+#endif
+#ifndef SERVER_06
+#  define SERVER_06 "linux06_server"
+#endif
+#ifndef SERVER_07
+#  define SERVER_07 "linux07_server"
+#endif
+
+#ifdef HAVE_DEMO_04
+#  include <linux/io_uring.h>
+#endif
 
 static int failures = 0;
 
@@ -57,9 +81,54 @@ static void sleep_ms(int ms)
     nanosleep(&ts, NULL);
 }
 
+/* 1 if binding a socket of this type to port fails with EADDRINUSE. */
+static int port_in_use(int port, int type)
+{
+    int fd = socket(AF_INET, type, 0);
+    if (fd < 0) return 0;
+
+    /* Ignore TIME_WAIT left behind by an earlier demo on the same port.
+     * Not for UDP, where it would let us share the server's port. */
+    int opt = 1;
+    if (type == SOCK_STREAM)
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port        = htons((uint16_t)port);
+
+    int rc = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    int err = errno;
+    close(fd);
+    return rc < 0 && err == EADDRINUSE;
+}
+
+/* 1 if binding a Unix socket of this type to @name fails with EADDRINUSE. */
+static int unix_in_use(const char *name, int type)
+{
+    int fd = socket(AF_UNIX, type, 0);
+    if (fd < 0) return 0;
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    size_t n = strlen(name);
+    memcpy(addr.sun_path + 1, name, n);          /* sun_path[0] = 0: abstract */
+    int rc = bind(fd, (struct sockaddr *)&addr,
+                  (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + n));
+    int err = errno;
+    close(fd);
+    return rc < 0 && err == EADDRINUSE;
+}
+
+/* Abstract Unix socket the next server must also have bound, or NULL. */
+static const char *ready_unix;
+static int         ready_unix_type;
+
 /*
- * Poll until the given TCP port is in use (server has called bind+listen).
- * Detects readiness by attempting to bind to the same port ourselves:
+ * Poll until the given port is in use (server has called bind), TCP or
+ * UDP.  Detects readiness by attempting to bind to the same port ourselves:
  *   - bind succeeds  → port is still free → not ready yet, retry
  *   - bind fails with EADDRINUSE → server is listening → ready
  * This approach never establishes a TCP connection so it cannot consume
@@ -70,20 +139,9 @@ static int wait_for_server(int port, int timeout_ms)
 {
     int elapsed = 0;
     while (elapsed < timeout_ms) {
-        int fd = socket(AF_INET, SOCK_STREAM, 0);
-        if (fd < 0) { sleep_ms(20); elapsed += 20; continue; }
-
-        struct sockaddr_in addr;
-        memset(&addr, 0, sizeof(addr));
-        addr.sin_family      = AF_INET;
-        addr.sin_addr.s_addr = INADDR_ANY;
-        addr.sin_port        = htons((uint16_t)port);
-
-        int rc = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
-        close(fd);
-
-        if (rc < 0 && errno == EADDRINUSE)
-            return 1;   /* server has the port bound — ready to accept */
+        if ((port_in_use(port, SOCK_STREAM) || port_in_use(port, SOCK_DGRAM)) &&
+            (!ready_unix || unix_in_use(ready_unix, ready_unix_type)))
+            return 1;   /* server has the port bound — ready */
 
         sleep_ms(20);
         elapsed += 20;
@@ -92,10 +150,12 @@ static int wait_for_server(int port, int timeout_ms)
 }
 
 /*
- * Run one server+client pair.
+ * Run one server+client pair.  server_opt and client_opt, if not NULL,
+ * are passed as the only argument (e.g. "-z1", "-b").
  * Returns 0 on success, non-zero on failure.
  */
-static int run_pair(const char *server_bin, const char *client_bin,
+static int run_pair(const char *server_bin, const char *server_opt,
+                    const char *client_bin, const char *client_opt,
                     const char *name, int port)
 {
     printf("[integration] running %s\n", name);
@@ -104,7 +164,7 @@ static int run_pair(const char *server_bin, const char *client_bin,
     pid_t spid = fork();
     if (spid < 0) { perror("fork server"); return 1; }
     if (spid == 0) {
-        execl(server_bin, server_bin, (char *)NULL);
+        execl(server_bin, server_bin, server_opt, (char *)NULL);
         perror("execl server");
         _exit(127);
     }
@@ -127,7 +187,7 @@ static int run_pair(const char *server_bin, const char *client_bin,
         return 1;
     }
     if (cpid == 0) {
-        execl(client_bin, client_bin, (char *)NULL);
+        execl(client_bin, client_bin, client_opt, (char *)NULL);
         perror("execl client");
         _exit(127);
     }
@@ -159,11 +219,262 @@ static int run_pair(const char *server_bin, const char *client_bin,
     return ok ? 0 : 1;
 }
 
+/*
+ * A client that connects and never sends: the server must close it on its
+ * own (a deadline), within 2 s, and then exit.  server_opt sets the
+ * deadline short.
+ */
+static int run_silent(const char *server_bin, const char *server_opt,
+                      const char *name, int port)
+{
+    printf("[integration] running %s\n", name);
+
+    pid_t spid = fork();
+    if (spid < 0) { perror("fork server"); return 1; }
+    if (spid == 0) {
+        execl(server_bin, server_bin, server_opt, (char *)NULL);
+        perror("execl server");
+        _exit(127);
+    }
+
+    int ok = 0;
+    if (wait_for_server(port, 2000)) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port        = htons((uint16_t)port);
+        struct timeval tv = { 2, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+            char c;
+            ok = recv(fd, &c, 1, 0) == 0;       /* EOF, not the 2 s timeout */
+        }
+        if (fd >= 0) close(fd);
+    }
+
+    int sstatus = 0;
+    for (int i = 0; i < 20; i++) {
+        if (waitpid(spid, &sstatus, WNOHANG) == spid) break;
+        sleep_ms(100);
+    }
+    if (kill(spid, 0) == 0) {
+        kill(spid, SIGTERM);
+        waitpid(spid, NULL, 0);
+        ok = 0;
+    }
+
+    if (ok) {
+        printf("[integration] %s PASSED\n", name);
+        return 0;
+    }
+    fprintf(stderr, "[integration] %s FAILED (silent client not closed)\n", name);
+    failures++;
+    return 1;
+}
+
+/* Send text, then expect exactly want back within the socket's timeout. */
+static int exchange(int fd, const char *text, const char *want)
+{
+    size_t n = strlen(want), got = 0;
+    char buf[256];
+    if (send(fd, text, strlen(text), MSG_NOSIGNAL) != (ssize_t)strlen(text)) return 0;
+    while (got < n) {
+        ssize_t r = recv(fd, buf + got, n - got, 0);
+        if (r <= 0) return 0;
+        got += (size_t)r;
+    }
+    return memcmp(buf, want, n) == 0;
+}
+
+/* Wait up to ms for pid to exit; 1 if it exited with status 0. */
+static int exited_ok(pid_t pid, int ms)
+{
+    int status = 0;
+    for (int i = 0; i < ms / 20; i++) {
+        if (waitpid(pid, &status, WNOHANG) == pid)
+            return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        sleep_ms(20);
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    return 0;
+}
+
+/*
+ * Hot restart: a client sends half a line, a second server started with
+ * -R takes over, the old one exits, and the client finishes the line with
+ * the new one, on the same connection.
+ */
+static int run_restart(const char *server_bin, const char *name, int port)
+{
+    printf("[integration] running %s\n", name);
+
+    pid_t old = fork();
+    if (old < 0) { perror("fork server"); return 1; }
+    if (old == 0) {
+        execl(server_bin, server_bin, (char *)NULL);
+        perror("execl server");
+        _exit(127);
+    }
+
+    int ok = 0, fd = -1;
+    pid_t new = -1;
+    if (wait_for_server(port, 2000) && (fd = socket(AF_INET, SOCK_STREAM, 0)) >= 0) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port        = htons((uint16_t)port);
+        struct timeval tv = { 2, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        ok = connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+             exchange(fd, "hello\n", "hello\n") &&
+             send(fd, "par", 3, MSG_NOSIGNAL) == 3;
+        if (ok && (new = fork()) == 0) {
+            execl(server_bin, server_bin, "-R", (char *)NULL);
+            perror("execl server");
+            _exit(127);
+        }
+        ok = ok && new > 0 && exited_ok(old, 2000);
+        old = -1;
+        ok = ok && exchange(fd, "tial\n", "partial\n") && exchange(fd, "bye\n", "bye\n");
+    }
+    if (fd >= 0) close(fd);
+    if (old > 0) exited_ok(old, 0);
+    if (new > 0) ok = exited_ok(new, 2000) && ok;
+
+    if (ok) {
+        printf("[integration] %s PASSED\n", name);
+        return 0;
+    }
+    fprintf(stderr, "[integration] %s FAILED\n", name);
+    failures++;
+    return 1;
+}
+
+/* A TCP connection to the loopback port with a 2 s receive timeout, or -1. */
+static int dial(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons((uint16_t)port);
+    struct timeval tv = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Worker pool: one client's slow request must not hold up another's
+ * quick one, and the slow client still gets its answers in order.
+ */
+static int run_pool(const char *server_bin, const char *name, int port)
+{
+    printf("[integration] running %s\n", name);
+
+    pid_t spid = fork();
+    if (spid < 0) { perror("fork server"); return 1; }
+    if (spid == 0) {
+        execl(server_bin, server_bin, "-W2", (char *)NULL);
+        perror("execl server");
+        _exit(127);
+    }
+
+    int ok = 0, a = -1, b = -1;
+    if (wait_for_server(port, 2000) && (a = dial(port)) >= 0 && (b = dial(port)) >= 0) {
+        struct timespec t0, t1;
+        ok = send(a, "work 500000\nafter\n", 18, MSG_NOSIGNAL) == 18;
+        sleep_ms(20);                            /* the slow one is running */
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        ok = ok && exchange(b, "ping\n", "ping\n");
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        long ms = (t1.tv_sec - t0.tv_sec) * 1000 + (t1.tv_nsec - t0.tv_nsec) / 1000000;
+        if (ok && ms > 250) {
+            fprintf(stderr, "[integration] %s: quick request took %ld ms\n", name, ms);
+            ok = 0;
+        }
+        ok = ok && exchange(a, "", "work 500000\nafter\n") &&
+             exchange(a, "bye\n", "bye\n") && exchange(b, "bye\n", "bye\n");
+    }
+    if (a >= 0) close(a);
+    if (b >= 0) close(b);
+    ok = exited_ok(spid, 2000) && ok;
+
+    if (ok) {
+        printf("[integration] %s PASSED\n", name);
+        return 0;
+    }
+    fprintf(stderr, "[integration] %s FAILED\n", name);
+    failures++;
+    return 1;
+}
+
+#ifdef HAVE_DEMO_04
+/* io_uring may be compiled in yet disabled at runtime (seccomp, sysctl). */
+static int io_uring_available(void)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int)syscall(__NR_io_uring_setup, 1, &p);
+    if (fd < 0) return 0;
+    close(fd);
+    return 1;
+}
+#endif
+
 int main(void)
 {
-    run_pair(SERVER_01, CLIENT_01, "01_blocking_sync",           9001);
-    run_pair(SERVER_02, CLIENT_02, "02_nonblocking_select_sync", 9002);
-    run_pair(SERVER_03, CLIENT_03, "03_epoll",                   9003);
+    run_pair(SERVER_01,  NULL,  CLIENT_01, NULL, "01_blocking_sync",           9001);
+    run_pair(SERVER_02,  NULL,  CLIENT_02, NULL, "02_nonblocking_select_sync", 9002);
+    run_pair(SERVER_03,  NULL,  CLIENT_03, NULL, "03_epoll",                   9003);
+    run_pair(SERVER_03,  NULL,  CLIENT_03, "-b", "03_epoll_binary",            9003);
+    run_pair(SERVER_03,  "-z1", CLIENT_03, NULL, "03_epoll_zerocopy",          9003);
+    run_pair(SERVER_03,  NULL,  CLIENT_03, "-P64", "03_epoll_pipelined",       9003);
+    run_pair(SERVER_03,  "-d200", CLIENT_03, "-bP16", "03_epoll_pipelined_deadline", 9003);
+    run_pair(SERVER_03,  "-B50", CLIENT_03, "-P64", "03_epoll_busy_poll",     9003);
+    run_pair(SERVER_03,  "-W2", CLIENT_03, "-P64", "03_epoll_worker_pool",    9003);
+    run_pair(SERVER_03,  "-T",  CLIENT_03, "-P64", "03_epoll_timestamps",     9003);
+    run_pool(SERVER_03, "03_epoll_slow_handler", 9003);
+    run_silent(SERVER_03, "-a200", "03_epoll_first_request_deadline", 9003);
+    run_restart(SERVER_03, "03_epoll_hot_restart", 9003);
+    run_pair(SERVER_03, "-bepoll-et", CLIENT_03, "-P64", "03_epoll_sockloop",  9003);
+    run_pair(REACTOR_03, NULL,  CLIENT_03, NULL, "03_epoll_reactor",           9003);
+    run_pair(REACTOR_03, "-C",  CLIENT_03, NULL, "03_epoll_reactor_steered",   9003);
+    ready_unix = "itest03", ready_unix_type = SOCK_STREAM;
+    run_pair(SERVER_03, "-u@itest03", CLIENT_03, "-u@itest03", "03_epoll_unix", 9003);
+    run_pair(REACTOR_03, "-u@itest03", CLIENT_03, "-u@itest03", "03_epoll_reactor_unix", 9003);
+    ready_unix_type = SOCK_SEQPACKET;
+    run_pair(SERVER_03, "-q@itest03", CLIENT_03, "-q@itest03", "03_epoll_seqpacket", 9003);
+    ready_unix = NULL;
+#ifdef HAVE_DEMO_04
+    if (io_uring_available())
+        run_pair(SERVER_04,  NULL,  CLIENT_04, NULL, "04_io_uring",                9004);
+    else
+        printf("[integration] 04_io_uring SKIPPED (io_uring unavailable)\n");
+#endif
+    run_pair(SERVER_05,  NULL,  CLIENT_05, NULL, "05_udp",                     9005);
+    run_pair(SERVER_05,  "-1",  CLIENT_05, NULL, "05_udp_single",              9005);
+    run_pair(SERVER_05,  "-g",  CLIENT_05, "-g", "05_udp_gso_gro",             9005);
+    /* 06 speaks 03's protocol, so 03's client drives every backend. */
+    run_pair(SERVER_06, "-bselect",   CLIENT_03, "-p9006", "06_sockloop_select",   9006);
+    run_pair(SERVER_06, "-bpoll",     CLIENT_03, "-p9006", "06_sockloop_poll",     9006);
+    run_pair(SERVER_06, "-bepoll",    CLIENT_03, "-p9006", "06_sockloop_epoll",    9006);
+    run_pair(SERVER_06, "-bepoll-et", CLIENT_03, "-p9006", "06_sockloop_epoll_et", 9006);
+#ifdef HAVE_DEMO_04
+    if (io_uring_available())                    /* libsockloop's uring backend: same condition */
+        run_pair(SERVER_06, "-buring", CLIENT_03, "-p9006", "06_sockloop_uring",   9006);
+#endif
+    run_pair(SERVER_07, NULL,  CLIENT_03, "-p9007", "07_coroutine",               9007);
+    run_pair(SERVER_07, "-g",  CLIENT_03, "-p9007", "07_coroutine_guard_pages",   9007);
 
     if (failures == 0) {
         printf("[integration] all tests PASSED\n");
@@ -0,0 +1,234 @@
+/*
+ * tests/unit/test_binframe.c
+ *
+ * Unit tests for the length-prefixed binary framing in
+ * linux/common/binframe.h: header encoding, splitting, frames cut at
+ * every possible byte, oversized frames, the buffer given back when
+ * idle, in-place body reads, and a buffer that grows with the bytes
+ * received rather than with the length a header announces.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../linux/common/binframe.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+/* Append one frame to buf; returns its size. */
+static size_t put_frame(char *buf, uint16_t type, uint64_t id, const void *body, uint32_t len)
+{
+    struct bin_hdr h = { len, type, 0, id };
+    bin_hdr_encode(buf, &h);
+    memcpy(buf + BIN_HDR, body, len);
+    return BIN_HDR + len;
+}
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static void test_header_roundtrip_big_endian(void)
+{
+    struct bin_hdr h = { 0x01020304u, 0x0506, 0, 0x1122334455667788ull }, d;
+    unsigned char raw[BIN_HDR];
+    bin_hdr_encode(raw, &h);
+    ASSERT(raw[0] == 0x01 && raw[3] == 0x04);      /* network order */
+    ASSERT(raw[4] == 0x05 && raw[5] == 0x06);
+    ASSERT(raw[8] == 0x11 && raw[15] == 0x88);
+    bin_hdr_decode(raw, &d);
+    ASSERT(d.len == h.len && d.type == h.type && d.flags == 0 && d.id == h.id);
+}
+
+static void test_whole_frames_in_one_buffer(void)
+{
+    char buf[256];
+    size_t n = 0;
+    n += put_frame(buf + n, BIN_ECHO, 1, "a\nb\0c", 5);   /* body is opaque */
+    n += put_frame(buf + n, BIN_ECHO, 2, "", 0);
+    n += put_frame(buf + n, BIN_BYE, 3, "bye", 3);
+
+    struct bin_rx rx;
+    bin_rx_init(&rx);
+    struct bin_frame f[8];
+    size_t used;
+    ASSERT(bin_feed(&rx, buf, n, f, 8, &used) == 3);
+    ASSERT(used == n);
+    ASSERT(f[0].p == buf && f[0].len == BIN_HDR + 5 && f[0].h.id == 1);
+    ASSERT(memcmp(f[0].p + BIN_HDR, "a\nb\0c", 5) == 0);
+    ASSERT(f[1].len == BIN_HDR && f[1].h.len == 0);
+    ASSERT(f[2].h.type == BIN_BYE && f[2].p == f[1].p + f[1].len);
+    ASSERT(rx.got == 0 && rx.buf == NULL);          /* nothing was copied */
+    bin_rx_free(&rx);
+}
+
+static void test_split_at_every_byte(void)
+{
+    char body[300], buf[1024];
+    for (int i = 0; i < 300; i++) body[i] = (char)i;
+    size_t n = 0;
+    n += put_frame(buf + n, BIN_ECHO, 7, body, 300);
+    n += put_frame(buf + n, BIN_ECHO, 8, body, 10);
+
+    for (size_t cut = 1; cut < n; cut++) {
+        struct bin_rx rx;
+        bin_rx_init(&rx);
+        struct bin_frame f[4];
+        uint64_t ids[4];
+        int got = 0;
+        size_t off = 0, used = 0;
+        while (off < n) {
+            size_t end = off < cut ? cut : n;
+            const char *p = buf + off;
+            size_t len = end - off;
+            while (len > 0) {
+                int k = bin_feed(&rx, p, len, f, 4, &used);
+                ASSERT(k >= 0);
+                if (k < 0) break;                   /* used is not set */
+                for (int i = 0; i < k; i++) {
+                    ASSERT(f[i].len == BIN_HDR + f[i].h.len);
+                    ASSERT(memcmp(f[i].p + BIN_HDR, body, f[i].h.len) == 0);
+                    if (got < 4) ids[got++] = f[i].h.id;
+                }
+                p += used;
+                len -= used;
+            }
+            off = end;
+        }
+        ASSERT(got == 2 && ids[0] == 7 && ids[1] == 8);
+        bin_rx_free(&rx);
+    }
+}
+
+static void test_oversized_frame_rejected(void)
+{
+    struct bin_hdr h = { BIN_MAX_BODY + 1, BIN_ECHO, 0, 1 };
+    char raw[BIN_HDR];
+    bin_hdr_encode(raw, &h);
+    struct bin_rx rx;
+    bin_rx_init(&rx);
+    struct bin_frame f[1];
+    size_t used;
+    ASSERT(bin_feed(&rx, raw, BIN_HDR, f, 1, &used) == -1);
+    ASSERT(bin_feed(&rx, raw, 5, f, 1, &used) == 0);      /* header not in yet */
+    ASSERT(bin_feed(&rx, raw + 5, BIN_HDR - 5, f, 1, &used) == -1);
+    bin_rx_free(&rx);
+}
+
+static void test_idle_frees_buffer(void)
+{
+    char frame[BIN_HDR + 4];
+    put_frame(frame, BIN_ECHO, 7, "ping", 4);
+    struct bin_rx rx;
+    bin_rx_init(&rx);
+    struct bin_frame f[1];
+    size_t used;
+    ASSERT(bin_feed(&rx, frame, 5, f, 1, &used) == 0);
+    bin_rx_idle(&rx);                               /* half a header stays */
+    ASSERT(rx.buf != NULL && rx.got == 5);
+    ASSERT(bin_feed(&rx, frame + 5, sizeof(frame) - 5, f, 1, &used) == 1);
+    ASSERT(f[0].h.id == 7 && f[0].len == sizeof(frame));
+    bin_rx_idle(&rx);                               /* emitted: given back */
+    ASSERT(rx.buf == NULL && rx.cap == 0 && rx.got == 0 && !rx.done);
+    ASSERT(bin_feed(&rx, frame, sizeof(frame), f, 1, &used) == 1 && rx.buf == NULL);
+    bin_rx_free(&rx);
+}
+
+static void test_large_body_read_in_place(void)
+{
+    size_t blen = 100000;
+    char *frame = malloc(BIN_HDR + blen);
+    char *body  = malloc(blen);
+    for (size_t i = 0; i < blen; i++) body[i] = (char)(i * 13);
+    put_frame(frame, BIN_ECHO, 42, body, (uint32_t)blen);
+
+    struct bin_rx rx;
+    bin_rx_init(&rx);
+    struct bin_frame f[1];
+    size_t used;
+    /* First recv: header plus a little body. */
+    ASSERT(bin_feed(&rx, frame, 1000, f, 1, &used) == 0 && used == 1000);
+    ASSERT(rx.need == BIN_HDR + blen && rx.cap < rx.need);
+
+    /* The rest in place, the buffer doubling as it fills. */
+    char *dst;
+    size_t want;
+    int reads = 0;
+    while ((want = bin_rx_direct(&rx, &dst)) > 0) {
+        ASSERT(dst == rx.buf + rx.got && rx.got + want <= rx.need);
+        memcpy(dst, frame + rx.got, want);          /* stands in for recv() */
+        bin_rx_commit(&rx, want);
+        reads++;
+    }
+    ASSERT(reads >= 2 && reads <= 4);
+    ASSERT(rx.got == rx.need && rx.cap == rx.need);
+
+    ASSERT(bin_feed(&rx, NULL, 0, f, 1, &used) == 1);
+    ASSERT(f[0].p == rx.buf && f[0].h.id == 42 && f[0].len == BIN_HDR + blen);
+    ASSERT(memcmp(f[0].p + BIN_HDR, body, blen) == 0);
+
+    /* The next feed recycles the buffer; a large one is given back. */
+    ASSERT(bin_feed(&rx, NULL, 0, f, 1, &used) == 0);
+    ASSERT(rx.buf == NULL && rx.got == 0);
+    bin_rx_free(&rx);
+    free(frame);
+    free(body);
+}
+
+/* Headers announcing huge bodies that never come cost a chunk each. */
+static void test_header_alone_reserves_little(void)
+{
+    char hdr[BIN_HDR];
+    struct bin_hdr h = { BIN_MAX_BODY, BIN_ECHO, 0, 9 };
+    bin_hdr_encode(hdr, &h);
+
+    struct bin_rx rx;
+    bin_rx_init(&rx);
+    struct bin_frame f[1];
+    size_t used;
+    ASSERT(bin_feed(&rx, hdr, sizeof(hdr), f, 1, &used) == 0 && used == sizeof(hdr));
+    ASSERT(rx.need == BIN_HDR + BIN_MAX_BODY && rx.cap <= BIN_HDR + BIN_RX_CHUNK);
+
+    /* Split header, then a trickle of body: growth follows the bytes. */
+    bin_rx_free(&rx);
+    ASSERT(bin_feed(&rx, hdr, 10, f, 1, &used) == 0 && rx.cap == BIN_HDR);
+    ASSERT(bin_feed(&rx, hdr + 10, BIN_HDR - 10, f, 1, &used) == 0);
+    ASSERT(rx.cap == BIN_HDR);
+    char body[1000];
+    memset(body, 'b', sizeof(body));
+    for (int i = 0; i < 100; i++) {
+        ASSERT(bin_feed(&rx, body, sizeof(body), f, 1, &used) == 0);
+        ASSERT(rx.cap <= 2 * (size_t)rx.got + BIN_HDR + BIN_RX_CHUNK);
+    }
+    char *dst;
+    ASSERT(bin_rx_direct(&rx, &dst) > 0);
+    ASSERT(rx.cap <= 2 * ((size_t)rx.got + BIN_DIRECT_MIN));
+    bin_rx_free(&rx);
+}
+
+int main(void)
+{
+    test_header_roundtrip_big_endian();
+    test_whole_frames_in_one_buffer();
+    test_split_at_every_byte();
+    test_oversized_frame_rejected();
+    test_idle_frees_buffer();
+    test_large_body_read_in_place();
+    test_header_alone_reserves_little();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
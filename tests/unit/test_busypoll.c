@@ -0,0 +1,154 @@
+/*
+ * tests/unit/test_busypoll.c
+ *
+ * Unit tests for the adaptive spin in linux/common/busypoll.h: the budget
+ * follows the gap between event rounds and drops to zero when traffic
+ * thins out, a spinning wait returns events written meanwhile, and a wait
+ * with no budget or a zero timeout does not spin.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "../../linux/common/busypoll.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+#define US 1000ull
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static void test_budget_follows_gaps(void)
+{
+    struct busypoll b;
+    bp_init(&b, 50 * US);
+    ASSERT(b.budget_ns == 0);                    /* blocks until traffic says otherwise */
+
+    uint64_t t = 1000000 * US;
+    for (int i = 0; i < 100; i++) bp_event(&b, t += 10 * US);
+    ASSERT(b.gap_ns > 9 * US && b.gap_ns < 11 * US);
+    ASSERT(b.budget_ns == 2 * b.gap_ns);         /* twice the average gap */
+
+    for (int i = 0; i < 100; i++) bp_event(&b, t += 40 * US);
+    ASSERT(b.budget_ns == 50 * US);              /* capped at the ceiling */
+
+    /* Requests further apart than the ceiling: no spin at all. */
+    for (int i = 0; i < 40; i++) bp_event(&b, t += 1000 * US);
+    ASSERT(b.budget_ns == 0);
+
+    /* A long quiet spell counts as twice the ceiling: a burst wins it back. */
+    bp_event(&b, t += 60000000 * US);
+    int rounds = 0;
+    while (b.budget_ns == 0 && rounds < 100) {
+        bp_event(&b, t += 5 * US);
+        rounds++;
+    }
+    ASSERT(b.budget_ns > 0 && rounds <= 12);
+}
+
+struct writer {
+    int                     efd;
+    unsigned                delay_us;
+    const struct busypoll  *spinner;     /* wait until it has polled once first */
+};
+
+static void *write_later(void *arg)
+{
+    struct writer *w = arg;
+    if (w->spinner)
+        for (int i = 0; i < 5000 && __atomic_load_n(&w->spinner->polls, __ATOMIC_RELAXED) == 0; i++)
+            usleep(1000);
+    usleep(w->delay_us);
+    uint64_t one = 1;
+    if (write(w->efd, &one, sizeof(one)) != sizeof(one)) perror("write");
+    return NULL;
+}
+
+static void test_spin_catches_event(void)
+{
+    int efd = eventfd(0, EFD_NONBLOCK);
+    int ep  = epoll_create1(0);
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = efd }, out[4];
+    ASSERT(epoll_ctl(ep, EPOLL_CTL_ADD, efd, &ev) == 0);
+
+    struct busypoll b;
+    bp_init(&b, 200000 * US);                    /* a budget long enough to never run out */
+    b.budget_ns = 200000 * US;
+    struct writer w = { efd, 2000, &b };         /* after the spin has begun */
+    pthread_t t;
+    ASSERT(pthread_create(&t, NULL, write_later, &w) == 0);
+    int n = bp_wait(&b, ep, out, 4, 1000);
+    pthread_join(t, NULL);
+    ASSERT(n == 1 && out[0].data.fd == efd);
+    ASSERT(b.hits == 1 && b.misses == 0 && b.polls > 1);
+    ASSERT(b.last_ns != 0);
+
+    uint64_t v;
+    ASSERT(read(efd, &v, sizeof(v)) == sizeof(v));
+    close(ep);
+    close(efd);
+}
+
+static void test_spin_runs_out_then_blocks(void)
+{
+    int efd = eventfd(0, EFD_NONBLOCK);
+    int ep  = epoll_create1(0);
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = efd }, out[4];
+    ASSERT(epoll_ctl(ep, EPOLL_CTL_ADD, efd, &ev) == 0);
+
+    struct busypoll b;
+    bp_init(&b, 100 * US);
+    b.budget_ns = 100 * US;
+    struct writer w = { efd, 20000, NULL };      /* well after the budget */
+    pthread_t t;
+    ASSERT(pthread_create(&t, NULL, write_later, &w) == 0);
+    int n = bp_wait(&b, ep, out, 4, 1000);
+    pthread_join(t, NULL);
+    ASSERT(n == 1);
+    ASSERT(b.hits == 0 && b.misses == 1);
+    ASSERT(b.spin_ns >= 100 * US && b.spin_ns < 20000 * US);
+
+    /* Nothing pending and no budget: straight to a blocking wait. */
+    uint64_t v;
+    ASSERT(read(efd, &v, sizeof(v)) == sizeof(v));
+    b.budget_ns = 0;
+    uint64_t polls = b.polls;
+    ASSERT(bp_wait(&b, ep, out, 4, 10) == 0);
+    ASSERT(b.polls == polls && b.blocks == 1);
+
+    /* A zero timeout is a poll already: never spun on. */
+    b.budget_ns = 100 * US;
+    ASSERT(bp_wait(&b, ep, out, 4, 0) == 0);
+    ASSERT(b.polls == polls && b.misses == 1);
+    close(ep);
+    close(efd);
+}
+
+int main(void)
+{
+    test_budget_follows_gaps();
+    test_spin_catches_event();
+    test_spin_runs_out_then_blocks();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,360 @@
+/*
+ * tests/unit/test_coro.c
+ *
+ * Unit tests for the coroutines in linux/common/coro.h: yields interleave
+ * in order, coroutines that only ever yield still let a parked one be
+ * woken, stacks are reused, co_send()/co_recv() carry a payload bigger
+ * than the socket buffers through EAGAIN with a reader and a writer on one
+ * socket, co_accept() takes a backlog of connections, an acceptor out of
+ * fds parks until one is closed instead of spinning, and a stack
+ * overflow is caught by the canary or by a guard page.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../../linux/common/coro.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+static void nonblock(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static char order[64];
+static int  norder;
+
+static void yielder(void *arg)
+{
+    for (int i = 0; i < 3; i++) {
+        order[norder++] = *(char *)arg;
+        co_yield();
+    }
+}
+
+static void test_yield_order(void)
+{
+    struct co_sched s;
+    ASSERT(co_sched_init(&s, 0, 0) == 0);
+    char a = 'a', b = 'b';
+    norder = 0;
+    ASSERT(co_spawn(&s, yielder, &a) == 0);
+    ASSERT(co_spawn(&s, yielder, &b) == 0);
+    ASSERT(co_run(&s) == 0);
+    order[norder] = '\0';
+    ASSERT(strcmp(order, "ababab") == 0);
+    ASSERT(s.live == 0 && s.peak == 2);
+    co_sched_destroy(&s);
+}
+
+#define SPIN_MAX (100 * CO_RUN_BUDGET)
+
+static int spin_fd[2], spun, woken;
+
+/* Never waits: yields until the reader has its byte, or gives up. */
+static void spinner(void *arg)
+{
+    if (arg && send(spin_fd[0], "x", 1, 0) != 1) return;   /* the reader has parked */
+    while (!woken && spun < SPIN_MAX) {
+        spun++;
+        co_yield();
+    }
+}
+
+static void parked_reader(void *arg)
+{
+    char b;
+    (void)arg;
+    if (co_recv(spin_fd[1], &b, 1, 0) == 1) woken = 1;
+}
+
+static void test_spinners_let_poll(void)
+{
+    struct co_sched s;
+    ASSERT(co_sched_init(&s, 0, 0) == 0);
+    ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, spin_fd) == 0);
+    nonblock(spin_fd[1]);
+    spun = woken = 0;
+    ASSERT(co_spawn(&s, parked_reader, NULL) == 0);   /* parks: nothing to read yet */
+    ASSERT(co_spawn(&s, spinner, &s) == 0);      /* sends its byte */
+    ASSERT(co_spawn(&s, spinner, NULL) == 0);
+    ASSERT(co_run(&s) == 0);
+    ASSERT(woken);
+    ASSERT(spun <= 4 * CO_RUN_BUDGET);           /* woken at the first poll, not after */
+    close(spin_fd[0]);
+    close(spin_fd[1]);
+    co_sched_destroy(&s);
+}
+
+static long sum;
+
+static void adder(void *arg)
+{
+    sum += (long)(intptr_t)arg;
+    co_yield();
+    sum += (long)(intptr_t)arg;
+}
+
+static void test_stacks_reused(void)
+{
+    struct co_sched s;
+    ASSERT(co_sched_init(&s, 8192, 0) == 0);
+    sum = 0;
+    for (int round = 0; round < 3; round++) {
+        for (long i = 1; i <= 1000; i++) ASSERT(co_spawn(&s, adder, (void *)(intptr_t)i) == 0);
+        ASSERT(co_run(&s) == 0);
+    }
+    ASSERT(sum == 3 * 2 * 500500);
+    ASSERT(s.nslabs == (1000 + CO_SLAB - 1) / CO_SLAB);   /* rounds 2 and 3 took pooled stacks */
+    ASSERT(s.spawned == 3000 && s.live == 0);
+    co_sched_destroy(&s);
+}
+
+#define PAIRS   16
+#define PAYLOAD (1024 * 1024)
+
+static char *payload;
+
+struct pair {
+    int fd[2];                                   /* [0] client end, [1] echo end */
+    int ok;
+};
+
+static void echo(void *arg)
+{
+    struct pair *p = arg;
+    char buf[4096];
+    ssize_t n;
+    while ((n = co_recv(p->fd[1], buf, sizeof(buf), 0)) > 0)
+        if (co_send(p->fd[1], buf, (size_t)n, 0) < 0) break;
+    co_close(p->fd[1]);
+}
+
+static void writer(void *arg)
+{
+    struct pair *p = arg;
+    if (co_send(p->fd[0], payload, PAYLOAD, 0) != PAYLOAD) p->ok = 0;
+    shutdown(p->fd[0], SHUT_WR);
+}
+
+static void reader(void *arg)
+{
+    struct pair *p = arg;
+    char *in = malloc(PAYLOAD);
+    size_t got = 0;
+    ssize_t n;
+    while (got < PAYLOAD && (n = co_recv(p->fd[0], in + got, PAYLOAD - got, 0)) > 0) got += (size_t)n;
+    p->ok = p->ok && got == PAYLOAD && memcmp(in, payload, PAYLOAD) == 0 &&
+            co_recv(p->fd[0], in, 1, 0) == 0;
+    free(in);
+    co_close(p->fd[0]);
+}
+
+static void test_echo_through_eagain(void)
+{
+    struct co_sched s;
+    ASSERT(co_sched_init(&s, 0, 0) == 0);
+    payload = malloc(PAYLOAD);
+    for (int i = 0; i < PAYLOAD; i++) payload[i] = (char)(i * 7);
+    struct pair p[PAIRS];
+    for (int i = 0; i < PAIRS; i++) {
+        ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, p[i].fd) == 0);
+        nonblock(p[i].fd[0]);
+        nonblock(p[i].fd[1]);
+        p[i].ok = 1;
+        co_spawn(&s, echo, &p[i]);
+        co_spawn(&s, writer, &p[i]);
+        co_spawn(&s, reader, &p[i]);
+    }
+    ASSERT(co_run(&s) == 0);
+    int bad = 0;
+    for (int i = 0; i < PAIRS; i++) bad += !p[i].ok;
+    ASSERT(bad == 0);
+    ASSERT(s.waits > 0);                         /* 1 MB does not fit: they had to wait */
+    free(payload);
+    co_sched_destroy(&s);
+}
+
+#define CONNS 32
+
+static int accepted;
+
+static void acceptor(void *arg)
+{
+    int lfd = *(int *)arg;
+    for (int i = 0; i < CONNS; i++) {
+        int fd = co_accept(lfd, NULL, NULL);
+        if (fd < 0) break;
+        char b;
+        if (co_recv(fd, &b, 1, 0) == 1 && b == 'x') accepted++;
+        co_close(fd);
+    }
+}
+
+static void test_accept(void)
+{
+    struct co_sched s;
+    ASSERT(co_sched_init(&s, 0, 0) == 0);
+    int lfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t al = sizeof(a);
+    ASSERT(bind(lfd, (struct sockaddr *)&a, sizeof(a)) == 0 && listen(lfd, CONNS) == 0);
+    getsockname(lfd, (struct sockaddr *)&a, &al);
+    accepted = 0;
+    ASSERT(co_spawn(&s, acceptor, &lfd) == 0);
+    int c[CONNS];
+    for (int i = 0; i < CONNS; i++) {
+        c[i] = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT(connect(c[i], (struct sockaddr *)&a, sizeof(a)) == 0);
+        ASSERT(send(c[i], "x", 1, 0) == 1);
+    }
+    ASSERT(co_run(&s) == 0);
+    ASSERT(accepted == CONNS);
+    for (int i = 0; i < CONNS; i++) close(c[i]);
+    close(lfd);
+    co_sched_destroy(&s);
+}
+
+/* Out of fds: the acceptor parks instead of retrying, and each close wakes it. */
+static struct co *parked;
+static int        emfiles, held[2];
+
+static void fd_acceptor(void *arg)
+{
+    int lfd = *(int *)arg;
+    while (accepted < 2) {
+        int fd = co_accept(lfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EMFILE) break;
+            emfiles++;
+            co_park(&parked);
+            continue;
+        }
+        held[accepted++] = fd;
+    }
+}
+
+static void fd_closer(void *arg)
+{
+    struct co_sched *s = co_self;
+    int *spare = arg;
+    for (int i = 0; i < 2; i++) {
+        for (int k = 0; k < 10; k++) co_yield();    /* a spinning acceptor would run meanwhile */
+        close(spare[i]);
+        co_wake(s, &parked);
+    }
+}
+
+static void test_accept_out_of_fds(void)
+{
+    struct co_sched s;
+    ASSERT(co_sched_init(&s, 0, 0) == 0);
+    int lfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t al = sizeof(a);
+    ASSERT(bind(lfd, (struct sockaddr *)&a, sizeof(a)) == 0 && listen(lfd, 2) == 0);
+    getsockname(lfd, (struct sockaddr *)&a, &al);
+    int c[2];
+    for (int i = 0; i < 2; i++) {
+        c[i] = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT(connect(c[i], (struct sockaddr *)&a, sizeof(a)) == 0);
+    }
+
+    /* Use up every fd below a lowered limit; the last two are given back. */
+    struct rlimit old, low;
+    getrlimit(RLIMIT_NOFILE, &old);
+    low = old;
+    low.rlim_cur = 256;
+    ASSERT(setrlimit(RLIMIT_NOFILE, &low) == 0);
+    int fill[256], n = 0;
+    while (n < 256 && (fill[n] = dup(lfd)) >= 0) n++;
+    ASSERT(n >= 2 && errno == EMFILE);
+    int spare[2] = { fill[n - 1], fill[n - 2] };
+    n -= 2;
+
+    accepted = emfiles = 0;
+    parked   = NULL;
+    ASSERT(co_spawn(&s, fd_acceptor, &lfd) == 0);
+    ASSERT(co_spawn(&s, fd_closer, spare) == 0);
+    ASSERT(co_run(&s) == 0);
+    ASSERT(accepted == 2);
+    ASSERT(emfiles == 2);                        /* once per fd it waited for */
+
+    while (n > 0) close(fill[--n]);
+    for (int i = 0; i < accepted; i++) close(held[i]);
+    setrlimit(RLIMIT_NOFILE, &old);
+    for (int i = 0; i < 2; i++) close(c[i]);
+    close(lfd);
+    co_sched_destroy(&s);
+}
+
+static void overflow(void *arg)
+{
+    volatile char big[24 * 1024];                /* more than the 16 KB stack */
+    for (size_t i = sizeof(big); i-- > 0; ) big[i] = 1;   /* from the top, as a stack grows */
+    co_yield();
+    (void)arg;
+}
+
+/* Overflow a stack in a child; the signal it dies of. */
+static int overflow_signal(int guard)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(open("/dev/null", O_WRONLY), 2);    /* the abort message is expected */
+        struct co_sched s;
+        co_sched_init(&s, 16 * 1024, guard);
+        co_spawn(&s, overflow, NULL);            /* the top stack of a slab: mapped below */
+        co_run(&s);
+        _exit(0);
+    }
+    int st = 0;
+    waitpid(pid, &st, 0);
+    return WIFSIGNALED(st) ? WTERMSIG(st) : 0;
+}
+
+static void test_overflow_caught(void)
+{
+    fflush(stderr);
+    ASSERT(overflow_signal(0) == SIGABRT);       /* canary, when the coroutine switches out */
+    ASSERT(overflow_signal(1) == SIGSEGV);       /* guard page, at once */
+}
+
+int main(void)
+{
+    test_yield_order();
+    test_spinners_let_poll();
+    test_stacks_reused();
+    test_echo_through_eagain();
+    test_accept();
+    test_accept_out_of_fds();
+    test_overflow_caught();
+
+    if (failures == 0) {
+        printf("All tests passed (%s switch).\n", CO_SWITCH_NAME);
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,205 @@
+/*
+ * tests/unit/test_framing.c
+ *
+ * Unit tests for the newline framer in linux/common/framing.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../linux/common/framing.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+/*
+ * Feed stream[0..len) to a fresh framer in chunks of chunk bytes, taking at
+ * most max lines per call, and concatenate every line returned into out.
+ * Returns the number of lines.
+ */
+static int reassemble(const char *stream, size_t len, size_t chunk, int max,
+                      char *out, size_t *out_len)
+{
+    struct framer f;
+    framer_init(&f);
+    struct frame_line lines[64];
+    int total = 0;
+    *out_len = 0;
+
+    for (size_t off = 0; off < len; off += chunk) {
+        size_t n = len - off < chunk ? len - off : chunk;
+        const char *p = stream + off;
+        while (n > 0) {
+            size_t used = 0;
+            int k = framer_feed(&f, p, n, lines, max, &used);
+            ASSERT(k >= 0);
+            if (k < 0) break;                       /* used is not set */
+            for (int i = 0; i < k; i++) {
+                ASSERT(lines[i].len > 0 && lines[i].p[lines[i].len - 1] == '\n');
+                memcpy(out + *out_len, lines[i].p, lines[i].len);
+                *out_len += lines[i].len;
+            }
+            total += k;
+            p += used;
+            n -= used;
+        }
+    }
+    framer_free(&f);
+    return total;
+}
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static void test_coalesced_lines(void)
+{
+    struct framer f;
+    framer_init(&f);
+    struct frame_line l[8];
+    size_t used;
+    const char *buf = "hello\nping\nbye\n";
+    ASSERT(framer_feed(&f, buf, strlen(buf), l, 8, &used) == 3);
+    ASSERT(used == strlen(buf));
+    ASSERT(l[0].p == buf && l[0].len == 6);     /* zero-copy */
+    ASSERT(l[2].len == 4 && memcmp(l[2].p, "bye\n", 4) == 0);
+    ASSERT(!frame_is_bye(&l[0]) && !frame_is_bye(&l[1]) && frame_is_bye(&l[2]));
+    ASSERT(framer_pending(&f) == 0);
+    framer_free(&f);
+}
+
+static void test_split_line(void)
+{
+    struct framer f;
+    framer_init(&f);
+    struct frame_line l[8];
+    size_t used;
+    ASSERT(framer_feed(&f, "he", 2, l, 8, &used) == 0);
+    ASSERT(used == 2 && framer_pending(&f) == 2);
+    ASSERT(framer_feed(&f, "llo\nby", 6, l, 8, &used) == 1);
+    ASSERT(l[0].len == 6 && memcmp(l[0].p, "hello\n", 6) == 0);
+    ASSERT(framer_pending(&f) == 2);
+    ASSERT(framer_feed(&f, "e\n", 2, l, 8, &used) == 1);
+    ASSERT(l[0].len == 4 && memcmp(l[0].p, "bye\n", 4) == 0);
+    ASSERT(frame_is_bye(&l[0]));            /* "bye" split across two feeds */
+    ASSERT(framer_pending(&f) == 0);
+    framer_free(&f);
+}
+
+static void test_idle_frees_carry(void)
+{
+    struct framer f;
+    framer_init(&f);
+    struct frame_line l[8];
+    size_t used;
+    framer_idle(&f);                        /* nothing held: nothing to do */
+    ASSERT(framer_feed(&f, "he", 2, l, 8, &used) == 0);
+    framer_idle(&f);                        /* an unfinished line stays */
+    ASSERT(f.carry != NULL && framer_pending(&f) == 2);
+    ASSERT(framer_feed(&f, "llo\n", 4, l, 8, &used) == 1);
+    ASSERT(l[0].len == 6 && memcmp(l[0].p, "hello\n", 6) == 0);
+    framer_idle(&f);                        /* the line is done with: freed */
+    ASSERT(f.carry == NULL && f.carry_cap == 0 && framer_pending(&f) == 0);
+    ASSERT(framer_feed(&f, "a\nb", 3, l, 8, &used) == 1 && framer_pending(&f) == 1);
+    ASSERT(framer_feed(&f, "\n", 1, l, 8, &used) == 1 && l[0].len == 2 && l[0].p[0] == 'b');
+    framer_free(&f);
+}
+
+static void test_batch_limit_resumes(void)
+{
+    struct framer f;
+    framer_init(&f);
+    struct frame_line l[2];
+    size_t used;
+    const char *buf = "a\nb\nc\nd";
+    ASSERT(framer_feed(&f, buf, 7, l, 2, &used) == 2);
+    ASSERT(used == 4);
+    ASSERT(framer_feed(&f, buf + 4, 3, l, 2, &used) == 1);
+    ASSERT(used == 3 && l[0].len == 2 && l[0].p[0] == 'c');
+    ASSERT(framer_pending(&f) == 1);
+    framer_free(&f);
+}
+
+static void test_line_too_long(void)
+{
+    struct framer f;
+    framer_init(&f);
+    struct frame_line l[1];
+    size_t used;
+    static char junk[FRAME_MAX_LINE / 2];
+    memset(junk, 'x', sizeof(junk));
+    ASSERT(framer_feed(&f, junk, sizeof(junk), l, 1, &used) == 0);
+    ASSERT(framer_feed(&f, junk, sizeof(junk), l, 1, &used) == 0);
+    ASSERT(framer_feed(&f, junk, 1, l, 1, &used) == -1);
+    framer_free(&f);
+}
+
+static void test_any_chunking_reassembles(void)
+{
+    /* Mixed line lengths, including ones longer than a SIMD block. */
+    static char stream[20000], out[20000];
+    size_t len = 0;
+    int lines = 0;
+    srand(1);
+    while (len < sizeof(stream) - 300) {
+        int n = rand() % 200;
+        for (int i = 0; i < n; i++) stream[len++] = (char)('a' + rand() % 26);
+        stream[len++] = '\n';
+        lines++;
+    }
+
+    size_t chunks[] = { 1, 2, 3, 7, 63, 64, 65, 100, 4096, sizeof(stream) };
+    int maxes[] = { 1, 3, 64 };
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        for (size_t m = 0; m < sizeof(maxes) / sizeof(maxes[0]); m++) {
+            size_t out_len;
+            int k = reassemble(stream, len, chunks[c], maxes[m], out, &out_len);
+            ASSERT(k == lines);
+            ASSERT(out_len == len && memcmp(out, stream, len) == 0);
+        }
+    }
+}
+
+static void test_simd_matches_scalar(void)
+{
+    static char buf[4096];
+    srand(2);
+    for (size_t i = 0; i < sizeof(buf); i++)
+        buf[i] = rand() % 8 == 0 ? '\n' : (char)(rand() & 0x7f);
+
+    for (size_t start = 0; start < 70; start++) {
+        struct frame_line a[4096], b[4096];
+        const char *sa, *sb;
+        int na = frame_split_scalar(buf + start, buf + sizeof(buf), a, 4096, &sa);
+        int nb = frame_split(buf + start, buf + sizeof(buf), b, 4096, &sb);
+        ASSERT(na == nb && sa == sb);
+        ASSERT(memcmp(a, b, (size_t)na * sizeof(a[0])) == 0);
+    }
+    ASSERT(frame_find_nl("abc", "abc" + 3) == NULL);
+}
+
+int main(void)
+{
+    test_coalesced_lines();
+    test_split_line();
+    test_idle_frees_carry();
+    test_batch_limit_resumes();
+    test_line_too_long();
+    test_any_chunking_reassembles();
+    test_simd_matches_scalar();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,221 @@
+/*
+ * tests/unit/test_gather.c
+ *
+ * Unit tests for response gathering in linux/common/gather.h: merging and
+ * copying answers, one sendmsg() per queue, batches beyond GATHER_IOV, and
+ * what happens when the socket or the gather runs out of room.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include "../../linux/common/gather.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+/* Non-blocking socketpair; small buffers if small is set. */
+static void make_pair(int sv[2], int small)
+{
+    ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    if (small) {
+        int sz = 4096;
+        setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+        setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+    }
+    fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+}
+
+static size_t drain(int fd, char *buf, size_t cap)
+{
+    size_t got = 0;
+    for (;;) {
+        ssize_t n = recv(fd, buf + got, cap - got, MSG_DONTWAIT);
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    return got;
+}
+
+/* "Receive" len bytes into the arena, as a server would with recv(). */
+static char *receive(struct gather *g, const char *data, size_t len)
+{
+    size_t avail;
+    char *p = gather_space(g, &avail);
+    ASSERT(avail >= len);
+    memcpy(p, data, len);
+    gather_commit(g, len);
+    return p;
+}
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static void test_add_merges_and_copies(void)
+{
+    struct gather g;
+    ASSERT(gather_init(&g, 4096, 16) == 0);
+    struct gather_q a, b;
+    gather_q_init(&a);
+    gather_q_init(&b);
+    ASSERT(gather_q_empty(&a));
+
+    char *in = receive(&g, "one\ntwo\n", 8);
+    ASSERT(gather_add(&g, &a, 7, in, 4) == 0);
+    ASSERT(gather_add(&g, &a, 7, in + 4, 4) == 0);    /* adjacent: merged */
+    ASSERT(g.n == 1 && g.ent[a.head].len == 8);
+
+    char stack[] = "three\n";
+    ASSERT(gather_add(&g, &b, 9, stack, 6) == 0);     /* not in the arena: copied */
+    ASSERT(g.ent[b.head].p != stack && memcmp(g.ent[b.head].p, "three\n", 6) == 0);
+    ASSERT(g.used == 14);
+
+    ASSERT(g.ntouched == 2 && g.touched[0] == 7 && g.touched[1] == 9);
+    ASSERT(g.added == 3);
+    gather_destroy(&g);
+}
+
+static void test_flush_is_one_sendmsg(void)
+{
+    int sv[2];
+    make_pair(sv, 0);
+    struct gather g;
+    ASSERT(gather_init(&g, 4096, 16) == 0);
+    struct gather_q q;
+    gather_q_init(&q);
+    struct outq out;
+    outq_init(&out);
+
+    char *in = receive(&g, "aaaa", 4);
+    ASSERT(gather_add(&g, &q, 0, in, 2) == 0);
+    ASSERT(gather_add(&g, &q, 0, "bbb", 3) == 0);     /* copied, not adjacent */
+    ASSERT(gather_add(&g, &q, 0, in + 2, 2) == 0);    /* not after the copy */
+    ASSERT(g.n == 3);
+
+    ASSERT(gather_flush(&g, &q, sv[0], &out) == 0);
+    ASSERT(g.sends == 1);
+    ASSERT(gather_q_empty(&q) && outq_bytes(&out) == 0);
+
+    char buf[64];
+    ASSERT(drain(sv[1], buf, sizeof(buf)) == 7);
+    ASSERT(memcmp(buf, "aabbbaa", 7) == 0);
+
+    gather_reset(&g);
+    ASSERT(g.used == 0 && g.n == 0 && g.ntouched == 0);
+    gather_destroy(&g);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+static void test_flush_batches_in_order(void)
+{
+    int sv[2];
+    make_pair(sv, 0);
+    enum { N = 3 * GATHER_IOV + 5 };
+    struct gather g;
+    ASSERT(gather_init(&g, 64 * 1024, N) == 0);
+    struct gather_q q;
+    gather_q_init(&q);
+    struct outq out;
+    outq_init(&out);
+
+    for (int i = 0; i < N; i++) {
+        char c = (char)('A' + i % 26);
+        ASSERT(gather_add(&g, &q, 0, &c, 1) == 0);    /* each copy is adjacent... */
+    }
+    /* ...to the previous copy, but copies are never merged: N entries. */
+    ASSERT(g.n == N);
+    ASSERT(gather_flush(&g, &q, sv[0], &out) == 0);
+    ASSERT(g.sends == 4);
+
+    char buf[N];
+    ASSERT(drain(sv[1], buf, sizeof(buf)) == N);
+    int ok = 1;
+    for (int i = 0; i < N; i++) ok &= buf[i] == (char)('A' + i % 26);
+    ASSERT(ok);
+    gather_destroy(&g);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+static void test_full_socket_queues_rest(void)
+{
+    int sv[2];
+    make_pair(sv, 1);
+    struct gather g;
+    ASSERT(gather_init(&g, 1024 * 1024, 64) == 0);
+    struct gather_q q;
+    gather_q_init(&q);
+    struct outq out;
+    outq_init(&out);
+
+    static char big[256 * 1024], back[512 * 1024];
+    for (size_t i = 0; i < sizeof(big); i++) big[i] = (char)(i * 31);
+    ASSERT(gather_add(&g, &q, 0, big, sizeof(big)) == 0);
+    ASSERT(gather_flush(&g, &q, sv[0], &out) == 1);    /* socket filled up */
+    size_t queued = outq_bytes(&out);
+    ASSERT(queued > 0 && queued < sizeof(big));
+
+    /* Later answers go behind the queued bytes, never around them. */
+    ASSERT(gather_add(&g, &q, 0, "tail", 4) == 0);
+    ASSERT(gather_flush(&g, &q, sv[0], &out) == 1);
+    ASSERT(outq_bytes(&out) == queued + 4);
+
+    size_t got = 0;
+    while (outq_bytes(&out) > 0) {
+        got += drain(sv[1], back + got, sizeof(back) - got);
+        ASSERT(outq_flush(&out, sv[0]) >= 0);
+    }
+    got += drain(sv[1], back + got, sizeof(back) - got);
+    ASSERT(got == sizeof(big) + 4);
+    ASSERT(memcmp(back, big, sizeof(big)) == 0);
+    ASSERT(memcmp(back + sizeof(big), "tail", 4) == 0);
+
+    outq_clear(&out);
+    gather_destroy(&g);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+static void test_out_of_room(void)
+{
+    struct gather g;
+    ASSERT(gather_init(&g, 8, 2) == 0);
+    struct gather_q q;
+    gather_q_init(&q);
+    ASSERT(gather_add(&g, &q, 0, "123456789", 9) == -1);   /* arena too small */
+    ASSERT(gather_q_empty(&q) && g.ntouched == 0);
+    ASSERT(gather_add(&g, &q, 0, "ab", 2) == 0);
+    ASSERT(gather_add(&g, &q, 0, "cd", 2) == 0);
+    ASSERT(gather_add(&g, &q, 0, "ef", 2) == -1);          /* entry table full */
+    ASSERT(g.n == 2 && g.added == 2);
+    gather_destroy(&g);
+}
+
+int main(void)
+{
+    test_add_merges_and_copies();
+    test_flush_is_one_sendmsg();
+    test_flush_batches_in_order();
+    test_full_socket_queues_rest();
+    test_out_of_room();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,152 @@
+/*
+ * tests/unit/test_handoff.c
+ *
+ * Unit tests for the descriptor handoff in linux/common/handoff.h:
+ * descriptors arrive working, records longer than one message arrive
+ * whole, listen / connect / accept by name, and a vanished sender is
+ * reported.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../../linux/common/handoff.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static void test_fds_and_bytes(void)
+{
+    int sv[2], p1[2], p2[2];
+    ASSERT(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) == 0);
+    ASSERT(pipe(p1) == 0 && pipe(p2) == 0);
+
+    int fds[2] = { p1[1], p2[1] };
+    ASSERT(handoff_send(sv[0], fds, 2, "hello", 5) == 0);
+    close(p1[1]);                                /* the receiver's copies stay open */
+    close(p2[1]);
+
+    int got[HANDOFF_MAXFD], n = -1;
+    size_t len = 0;
+    char *rec = handoff_recv(sv[1], got, HANDOFF_MAXFD, &n, &len);
+    ASSERT(rec && len == 5 && memcmp(rec, "hello", 5) == 0);
+    ASSERT(n == 2);
+    if (n == 2) {
+        char c = 0;
+        ASSERT(write(got[1], "z", 1) == 1);
+        ASSERT(read(p2[0], &c, 1) == 1 && c == 'z');
+        ASSERT(write(got[0], "a", 1) == 1);
+        ASSERT(read(p1[0], &c, 1) == 1 && c == 'a');
+        close(got[0]);
+        close(got[1]);
+    }
+    free(rec);
+
+    /* No descriptors, no bytes. */
+    ASSERT(handoff_send(sv[0], NULL, 0, NULL, 0) == 0);
+    rec = handoff_recv(sv[1], got, HANDOFF_MAXFD, &n, &len);
+    ASSERT(rec && len == 0 && n == 0);
+    free(rec);
+
+    close(p1[0]);
+    close(p2[0]);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+struct big {
+    int         sock;
+    const char *buf;
+    size_t      len;
+    int         rc;
+};
+
+static void *send_big(void *arg)
+{
+    struct big *b = arg;
+    b->rc = handoff_send(b->sock, &b->sock, 1, b->buf, b->len);
+    return NULL;
+}
+
+static void test_record_over_many_messages(void)
+{
+    int sv[2];
+    ASSERT(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) == 0);
+    size_t len = 5 * HANDOFF_MSG + 123;          /* more than the socket buffer */
+    char *buf = malloc(len);
+    for (size_t i = 0; i < len; i++) buf[i] = (char)(i * 131 + 7);
+
+    struct big b = { sv[0], buf, len, -1 };
+    pthread_t t;
+    ASSERT(pthread_create(&t, NULL, send_big, &b) == 0);
+    int got[HANDOFF_MAXFD], n = 0;
+    size_t rlen = 0;
+    char *rec = handoff_recv(sv[1], got, HANDOFF_MAXFD, &n, &rlen);
+    pthread_join(t, NULL);
+    ASSERT(b.rc == 0);
+    ASSERT(rec && rlen == len && memcmp(rec, buf, len) == 0);
+    ASSERT(n == 1);
+    if (n == 1) close(got[0]);
+    free(rec);
+    free(buf);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+static void test_listen_connect_accept(void)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "test_handoff.%d", (int)getpid());
+    int lfd = handoff_listen(name);
+    ASSERT(lfd >= 0);
+    if (lfd < 0) return;
+    ASSERT(handoff_accept(lfd) < 0 && errno == EAGAIN);  /* nobody yet */
+    ASSERT(handoff_listen(name) < 0 && errno == EADDRINUSE);
+
+    int c = handoff_connect(name);
+    ASSERT(c >= 0);
+    int s = handoff_accept(lfd);
+    ASSERT(s >= 0);
+    ASSERT(handoff_send(c, NULL, 0, "ok", 2) == 0);
+    int fds[1], n;
+    size_t len;
+    char *rec = handoff_recv(s, fds, 1, &n, &len);
+    ASSERT(rec && len == 2 && memcmp(rec, "ok", 2) == 0);
+    free(rec);
+
+    /* The sender goes away: reported, not mistaken for a record. */
+    close(c);
+    errno = 0;
+    ASSERT(handoff_recv(s, fds, 1, &n, &len) == NULL && errno == ECONNRESET);
+    close(s);
+    close(lfd);
+    ASSERT(handoff_connect(name) < 0);           /* name released */
+}
+
+int main(void)
+{
+    test_fds_and_bytes();
+    test_record_over_many_messages();
+    test_listen_connect_accept();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,96 @@
+/*
+ * tests/unit/test_hdr_hist.c
+ *
+ * Unit tests for the HDR-style latency histogram in
+ * linux/common/hdr_hist.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "../../linux/common/hdr_hist.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+static struct hdr_hist h, h2;
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static void test_index_monotonic(void)
+{
+    /* Buckets are contiguous and every value lies inside its own bucket. */
+    unsigned prev = 0;
+    for (uint64_t v = 0; v < 1000000; v += 7) {
+        unsigned idx = hdr_index(v);
+        ASSERT(idx >= prev);
+        ASSERT(idx < HDR_COUNTS);
+        ASSERT(hdr_bucket_high(idx) >= v);
+        prev = idx;
+    }
+    ASSERT(hdr_index(UINT64_MAX) == HDR_COUNTS - 1);
+}
+
+static void test_relative_error(void)
+{
+    for (uint64_t v = 1; v < (1ull << 40); v = v * 3 + 1) {
+        uint64_t hi = hdr_bucket_high(hdr_index(v));
+        ASSERT((double)(hi - v) / (double)v <= 2.0 / HDR_SUB_COUNT);
+    }
+}
+
+static void test_percentiles(void)
+{
+    hdr_init(&h);
+    ASSERT(hdr_percentile(&h, 50.0) == 0);
+
+    for (uint64_t v = 1; v <= 10000; v++) hdr_record(&h, v);
+    ASSERT(h.total == 10000);
+    ASSERT(h.min == 1);
+    ASSERT(h.max == 10000);
+
+    uint64_t p50 = hdr_percentile(&h, 50.0);
+    uint64_t p99 = hdr_percentile(&h, 99.0);
+    ASSERT(p50 >= 5000 && p50 <= 5000 + 5000 / 64);
+    ASSERT(p99 >= 9900 && p99 <= 9900 + 9900 / 64);
+    ASSERT(hdr_percentile(&h, 100.0) == 10000);
+    ASSERT(hdr_mean(&h) > 5000.0 && hdr_mean(&h) < 5001.0);
+}
+
+static void test_merge(void)
+{
+    hdr_init(&h);
+    hdr_init(&h2);
+    hdr_record_n(&h, 100, 99);
+    hdr_record(&h2, 1000000);
+    hdr_merge(&h, &h2);
+    ASSERT(h.total == 100);
+    ASSERT(h.max == 1000000);
+    ASSERT(hdr_percentile(&h, 50.0) == 100);
+    ASSERT(hdr_percentile(&h, 99.9) == 1000000);
+}
+
+int main(void)
+{
+    test_index_monotonic();
+    test_relative_error();
+    test_percentiles();
+    test_merge();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
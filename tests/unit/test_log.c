@@ -0,0 +1,151 @@
+/*
+ * tests/unit/test_log.c
+ *
+ * Unit tests for the asynchronous logger in linux/common/log.h: argument
+ * packing and deferred formatting, per-call-site format caching, level
+ * filtering, and drop-on-full.
+ * The ring is inspected directly; the background thread is not started.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../linux/common/log.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+static void pack_into(struct log_rec *rec, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    log_pack(rec, fmt, ap);
+    va_end(ap);
+}
+
+/* Pack like a producer, format like the consumer, return the text. */
+static const char *roundtrip(const char *fmt, ...)
+{
+    static struct log_out o;
+    static struct log_rec rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.fmt = fmt;
+    va_list ap;
+    va_start(ap, fmt);
+    log_pack(&rec, fmt, ap);
+    va_end(ap);
+    o.n = 0;
+    log_format(&rec, &o);
+    o.buf[o.n] = '\0';
+    return o.buf;
+}
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static void test_deferred_format_matches_printf(void)
+{
+    const char *line = "hello\nping\n";
+    ASSERT(strcmp(roundtrip("[server] recv (fd=%d): %.*s", 5, 6, line),
+                  "[server] recv (fd=5): hello\n") == 0);
+    ASSERT(strcmp(roundtrip("%5lu|%-4s|%zu|%x|%c|%%", 42ul, "ab", (size_t)7, 255u, 'Z'),
+                  "   42|ab  |7|ff|Z|%") == 0);
+    ASSERT(strcmp(roundtrip("%lld %hhu %.2f %*d", -5ll, 300u, 2.5, 4, 9),
+                  "-5 44 2.50    9") == 0);        /* hh narrows like printf */
+}
+
+static void test_string_copied_by_value(void)
+{
+    /* The producer's buffer is reused right after the call returns. */
+    static struct log_rec rec;
+    char buf[16];
+    strcpy(buf, "before");
+    memset(&rec, 0, sizeof(rec));
+    rec.fmt = "%s\n";
+    pack_into(&rec, "%s\n", buf);
+    strcpy(buf, "after!");
+
+    static struct log_out o;
+    o.n = 0;
+    log_format(&rec, &o);
+    ASSERT(o.n == 7 && memcmp(o.buf, "before\n", 7) == 0);
+}
+
+static void test_long_string_truncated(void)
+{
+    char big[1000];
+    memset(big, 'q', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    const char *out = roundtrip("x %s\n", big);
+    size_t n = strlen(out);
+    ASSERT(n < LOG_SLOT + 32);
+    ASSERT(strcmp(out + n - 15, "...[truncated]\n") == 0);
+}
+
+static void test_level_filter(void)
+{
+    log_started = 1;                     /* route to the ring, no consumer */
+    log_set_level(LOG_LVL_INFO);
+    LOG_DEBUG("filtered %d\n", 1);
+    ASSERT(log_tls == NULL || log_tls->tail == 0);
+    LOG_INFO("kept %d\n", 2);
+    ASSERT(log_tls != NULL && log_tls->tail == 1);
+    ASSERT(log_tls->slots[0].level == LOG_LVL_INFO);
+    log_started = 0;
+}
+
+static void test_call_site_parsed_once(void)
+{
+    log_started = 1;
+    struct log_ring *r = log_ring_get();
+    r->head = r->tail;
+    static struct log_out o;
+    o.n = 0;
+    for (int i = 0; i < 2; i++)          /* second pass uses the cached signature */
+        LOG_INFO("[%d] %.*s|%hd\n", i, 3, "abcdef", (short)-7);
+    log_format(&r->slots[(r->tail - 2) & (LOG_RING_SLOTS - 1)], &o);
+    log_format(&r->slots[(r->tail - 1) & (LOG_RING_SLOTS - 1)], &o);
+    o.buf[o.n] = '\0';
+    ASSERT(strcmp(o.buf, "[0] abc|-7\n[1] abc|-7\n") == 0);
+    r->head = r->tail;
+    log_started = 0;
+}
+
+static void test_full_ring_drops_and_counts(void)
+{
+    log_started = 1;
+    struct log_ring *r = log_ring_get();
+    r->head = r->tail;                   /* start from an empty ring */
+    uint64_t before = r->dropped;
+    for (int i = 0; i < LOG_RING_SLOTS + 10; i++)
+        LOG_INFO("n=%d\n", i);
+    ASSERT(r->tail - r->head == LOG_RING_SLOTS);    /* never overwrites */
+    ASSERT(r->dropped == 10 + before);
+    log_started = 0;
+}
+
+int main(void)
+{
+    test_deferred_format_matches_printf();
+    test_string_copied_by_value();
+    test_long_string_truncated();
+    test_level_filter();
+    test_call_site_parsed_once();
+    test_full_ring_drops_and_counts();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
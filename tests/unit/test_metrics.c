@@ -0,0 +1,140 @@
+/*
+ * tests/unit/test_metrics.c
+ *
+ * Unit tests for the shared-memory metrics in linux/common/metrics.h:
+ * histogram buckets, create / publish / attach / read, stage histograms
+ * published only once a request was stamped, and a writer thread
+ * publishing while the reader checks that every copy is consistent.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../../linux/common/metrics.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static void test_buckets(void)
+{
+    ASSERT(metrics_bucket(0) == 0);
+    ASSERT(metrics_bucket(1) == 1);
+    ASSERT(metrics_bucket(2) == 2 && metrics_bucket(3) == 2);
+    ASSERT(metrics_bucket(4) == 3 && metrics_bucket(7) == 3);
+    ASSERT(metrics_bucket(4096) == 13);
+    ASSERT(metrics_bucket(1ull << 40) == METRICS_HIST - 1);
+    ASSERT(metrics_lat_bucket(1000) == 10);
+    ASSERT(metrics_lat_bucket(1ull << 40) == METRICS_LAT_HIST - 1);
+}
+
+static void test_publish_and_read(void)
+{
+    struct metrics_shm *w = metrics_create("test", 2);
+    ASSERT(w != NULL);
+    if (!w) return;
+    const struct metrics_shm *r = metrics_open((int)getpid());
+    ASSERT(r != NULL);
+    if (!r) {
+        metrics_destroy(w);
+        return;
+    }
+    ASSERT(r->nslots == 2 && r->pid == (int)getpid() && strcmp(r->name, "test") == 0);
+
+    struct metrics m, out;
+    ASSERT(metrics_read(&r->slot[0], &out) == -1);          /* nothing yet */
+    memset(&m, 0, sizeof(m));
+    m.c[M_ACCEPTS] = 3;
+    m.c[M_BYTES_IN] = 12345;
+    m.events_hist[metrics_bucket(5)]++;
+    metrics_publish(&w->slot[1], &m);
+    ASSERT(metrics_read(&r->slot[1], &out) == 0);
+    ASSERT(memcmp(&m, &out, sizeof(m)) == 0);
+    ASSERT(w->slot[1].seq == 2);
+
+    metrics_destroy(w);
+    ASSERT(metrics_open((int)getpid()) == NULL);            /* unlinked */
+}
+
+static void test_stages_published_once_stamped(void)
+{
+    struct metrics_slot s;
+    struct metrics m, out;
+    memset(&s, 0, sizeof(s));
+    memset(&m, 0, sizeof(m));
+    m.c[M_MSGS] = 1;
+    m.stage_hist[S_HANDLER][metrics_lat_bucket(1500)] = 7;
+    metrics_publish(&s, &m);
+    ASSERT(metrics_read(&s, &out) == 0);
+    ASSERT(out.c[M_MSGS] == 1);
+    ASSERT(out.stage_hist[S_HANDLER][metrics_lat_bucket(1500)] == 0);   /* skipped */
+
+    m.c[M_STAMPED] = 1;
+    metrics_publish(&s, &m);
+    ASSERT(metrics_read(&s, &out) == 0);
+    ASSERT(memcmp(&m, &out, sizeof(m)) == 0);
+}
+
+/* Every word of each published copy holds the same number. */
+static struct metrics_slot slot;
+static volatile int        stop;
+
+static void *writer(void *arg)
+{
+    (void)arg;
+    struct metrics m;
+    for (uint64_t v = 1; !stop; v++) {
+        uint64_t *p = (uint64_t *)&m;
+        for (size_t i = 0; i < sizeof(m) / sizeof(uint64_t); i++) p[i] = v;
+        metrics_publish(&slot, &m);
+    }
+    return NULL;
+}
+
+static void test_concurrent_reads_are_consistent(void)
+{
+    pthread_t t;
+    ASSERT(pthread_create(&t, NULL, writer, NULL) == 0);
+    int torn = 0, reads = 0;
+    uint64_t last = 0;
+    while (reads < 200000) {
+        struct metrics m;
+        if (metrics_read(&slot, &m) < 0) continue;
+        const uint64_t *p = (const uint64_t *)&m;
+        for (size_t i = 1; i < sizeof(m) / sizeof(uint64_t); i++)
+            if (p[i] != p[0]) torn++;
+        if (p[0] < last) torn++;                            /* never goes back */
+        last = p[0];
+        reads++;
+    }
+    stop = 1;
+    pthread_join(t, NULL);
+    ASSERT(torn == 0);
+}
+
+int main(void)
+{
+    test_buckets();
+    test_publish_and_read();
+    test_stages_published_once_stamped();
+    test_concurrent_reads_are_consistent();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
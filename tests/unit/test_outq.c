@@ -0,0 +1,141 @@
+/*
+ * tests/unit/test_outq.c
+ *
+ * Unit tests for the per-connection output queue in linux/common/outq.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include "../../linux/common/outq.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+/* Non-blocking socketpair with small buffers so it fills up quickly. */
+static void small_pair(int sv[2])
+{
+    ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    int sz = 4096;
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+    setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+    fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+}
+
+/* Read everything currently available on fd into buf. */
+static size_t drain(int fd, char *buf, size_t cap)
+{
+    size_t got = 0;
+    for (;;) {
+        ssize_t n = recv(fd, buf + got, cap - got, MSG_DONTWAIT);
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    return got;
+}
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static void test_append_spans_chunks(void)
+{
+    struct outq q;
+    outq_init(&q);
+    static char big[3 * OUTQ_CHUNK];
+    memset(big, 'x', sizeof(big));
+    ASSERT(outq_append(&q, big, sizeof(big)) == 0);
+    ASSERT(outq_bytes(&q) == sizeof(big));
+    ASSERT(q.head != q.tail);
+    outq_clear(&q);
+    ASSERT(outq_bytes(&q) == 0);
+    ASSERT(q.head == NULL && q.tail == NULL);
+}
+
+static void test_send_direct_when_empty(void)
+{
+    int sv[2];
+    small_pair(sv);
+    struct outq q;
+    outq_init(&q);
+    ASSERT(outq_send(&q, sv[0], "hello\n", 6) == 0);
+    ASSERT(outq_bytes(&q) == 0);
+
+    char buf[16];
+    ASSERT(drain(sv[1], buf, sizeof(buf)) == 6);
+    ASSERT(memcmp(buf, "hello\n", 6) == 0);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+static void test_queue_and_flush_preserves_order(void)
+{
+    int sv[2];
+    small_pair(sv);
+    struct outq q;
+    outq_init(&q);
+
+    /* Push far more than the socket buffers hold. */
+    enum { TOTAL = 256 * 1024 };
+    static char out[TOTAL], in[TOTAL];
+    for (size_t i = 0; i < TOTAL; i++) out[i] = (char)('a' + i % 26);
+
+    int rc = 0;
+    for (size_t off = 0; off < TOTAL; off += 1000) {
+        size_t len = TOTAL - off < 1000 ? TOTAL - off : 1000;
+        rc = outq_send(&q, sv[0], out + off, len);
+        ASSERT(rc >= 0);
+    }
+    ASSERT(rc == 1);                     /* socket filled up, rest queued */
+    ASSERT(outq_bytes(&q) > 0);
+
+    size_t got = 0;
+    for (int rounds = 0; rounds < 100000 && got < TOTAL; rounds++) {
+        got += drain(sv[1], in + got, TOTAL - got);
+        ASSERT(outq_flush(&q, sv[0]) >= 0);
+    }
+    ASSERT(got == TOTAL);
+    ASSERT(outq_bytes(&q) == 0);
+    ASSERT(memcmp(in, out, TOTAL) == 0);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+static void test_flush_error_on_closed_peer(void)
+{
+    int sv[2];
+    small_pair(sv);
+    struct outq q;
+    outq_init(&q);
+    ASSERT(outq_append(&q, "data", 4) == 0);
+    close(sv[1]);
+    ASSERT(outq_flush(&q, sv[0]) == -1);   /* EPIPE, and no SIGPIPE */
+    outq_clear(&q);
+    close(sv[0]);
+}
+
+int main(void)
+{
+    test_append_spans_chunks();
+    test_send_direct_when_empty();
+    test_queue_and_flush_preserves_order();
+    test_flush_error_on_closed_peer();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
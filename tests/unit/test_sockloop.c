@@ -0,0 +1,265 @@
+/*
+ * tests/unit/test_sockloop.c
+ *
+ * Unit tests for libsockloop (linux/sockloop), run against every backend
+ * built: lines are echoed and "bye" closes, a client that does not read
+ * pauses its connection until it drains (on_writable) and one that sends
+ * more than SL_READ_BUDGET at once is read over several rounds, and a
+ * silent connection is closed by its deadline.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sockloop.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+#define BIG (4 * 1024 * 1024)
+
+struct app {
+    int    accepts, closes, writable, timeouts;
+    size_t echoed;
+    long   deadline_ms;
+    struct sl_stats st;
+};
+
+static int on_accept(struct sl_loop *l, int fd, int listener)
+{
+    struct app *a = sl_ctx(l);
+    (void)listener;
+    a->accepts++;
+    if (a->deadline_ms) sl_timeout(l, fd, a->deadline_ms);
+    return 0;
+}
+
+/* Echo everything; a chunk ending in "bye\n" closes. */
+static int on_data(struct sl_loop *l, int fd, const char *buf, size_t len)
+{
+    struct app *a = sl_ctx(l);
+    if (sl_send(l, fd, buf, len) < 0) return -1;
+    a->echoed += len;
+    if (len >= 4 && memcmp(buf + len - 4, "bye\n", 4) == 0) sl_close(l, fd);
+    return 0;
+}
+
+static void on_writable(struct sl_loop *l, int fd)
+{
+    struct app *a = sl_ctx(l);
+    (void)fd;
+    a->writable++;
+}
+
+static void on_timeout(struct sl_loop *l, int fd)
+{
+    struct app *a = sl_ctx(l);
+    a->timeouts++;
+    sl_close(l, fd);
+}
+
+static void on_close(struct sl_loop *l, int fd)
+{
+    struct app *a = sl_ctx(l);
+    (void)fd;
+    a->closes++;
+    sl_stop(l);                                  /* one client per test */
+}
+
+static const struct sl_handlers handlers = {
+    .on_accept   = on_accept,
+    .on_data     = on_data,
+    .on_writable = on_writable,
+    .on_timeout  = on_timeout,
+    .on_close    = on_close,
+};
+
+static int listen_any(int *port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t al = sizeof(a);
+    if (fd < 0) return -1;
+    if (bind(fd, (struct sockaddr *)&a, sizeof(a)) < 0 || listen(fd, 16) < 0) {
+        close(fd);
+        return -1;
+    }
+    getsockname(fd, (struct sockaddr *)&a, &al);
+    *port = ntohs(a.sin_port);
+    return fd;
+}
+
+static int dial(int port, int rcvbuf)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (rcvbuf) setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port),
+                             .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    if (fd < 0 || connect(fd, (struct sockaddr *)&a, sizeof(a)) < 0) return -1;
+    struct timeval tv = { 5, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+static int read_n(int fd, char *buf, size_t n)
+{
+    for (size_t got = 0; got < n; ) {
+        ssize_t r = recv(fd, buf + got, n - got, 0);
+        if (r <= 0) return -1;
+        got += (size_t)r;
+    }
+    return 0;
+}
+
+/* Client threads; each returns 1 on success. */
+struct client {
+    int port;
+    int ok;
+};
+
+static void *client_lines(void *arg)
+{
+    struct client *c = arg;
+    int fd = dial(c->port, 0);
+    char buf[64];
+    c->ok = fd >= 0 &&
+            send(fd, "hello\nping\n", 11, 0) == 11 && read_n(fd, buf, 11) == 0 &&
+            memcmp(buf, "hello\nping\n", 11) == 0 &&
+            send(fd, "bye\n", 4, 0) == 4 && read_n(fd, buf, 4) == 0 &&
+            recv(fd, buf, 1, 0) == 0;            /* closed after bye */
+    if (fd >= 0) close(fd);
+    return NULL;
+}
+
+struct writer {
+    int         fd;
+    const char *buf;
+    int         ok;
+};
+
+static void *write_all_of(void *arg)
+{
+    struct writer *w = arg;
+    w->ok = send(w->fd, w->buf, BIG, 0) == BIG;
+    return NULL;
+}
+
+/* Sends BIG bytes but reads nothing for a while, through a small buffer. */
+static void *client_slow_reader(void *arg)
+{
+    struct client *c = arg;
+    int fd = dial(c->port, 16384);
+    char *out = malloc(BIG), *in = malloc(BIG);
+    for (size_t i = 0; i < BIG; i++) out[i] = (char)('a' + i % 26);
+    struct writer w = { fd, out, 0 };
+    pthread_t t;
+    c->ok = fd >= 0 && pthread_create(&t, NULL, write_all_of, &w) == 0;
+    if (c->ok) {
+        usleep(200000);                          /* the server's queue fills meanwhile */
+        c->ok = read_n(fd, in, BIG) == 0 && memcmp(in, out, BIG) == 0;
+        pthread_join(t, NULL);
+        c->ok = c->ok && w.ok && send(fd, "bye\n", 4, 0) == 4 && read_n(fd, in, 4) == 0;
+    }
+    if (fd >= 0) close(fd);
+    free(out);
+    free(in);
+    return NULL;
+}
+
+static void *client_silent(void *arg)
+{
+    struct client *c = arg;
+    int fd = dial(c->port, 0);
+    char b;
+    c->ok = fd >= 0 && recv(fd, &b, 1, 0) == 0;  /* EOF, not the 5 s timeout */
+    if (fd >= 0) close(fd);
+    return NULL;
+}
+
+/* Serve one client on backend b until it is closed; the app's counters out. */
+static int run_one(enum sl_backend b, void *(*client)(void *), struct app *a)
+{
+    int port = 0, lfd = listen_any(&port);
+    ASSERT(lfd >= 0);
+    if (lfd < 0) return 0;                       /* a failure, not a skipped backend */
+    struct sl_loop *l = sl_create(b, &handlers, a);
+    if (!l) {
+        close(lfd);
+        return -1;
+    }
+    ASSERT(sl_listen(l, lfd) == 0);
+    struct client c = { port, 0 };
+    pthread_t t;
+    pthread_create(&t, NULL, client, &c);
+    ASSERT(sl_run(l) == 0);
+    pthread_join(t, NULL);
+    sl_get_stats(l, &a->st);
+    ASSERT(a->st.accepts == 1 && a->st.closes == 1);
+    sl_destroy(l);
+    close(lfd);
+    return c.ok;
+}
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static void test_backend(enum sl_backend b)
+{
+    struct app a = {0};
+    int ok = run_one(b, client_lines, &a);
+    if (ok < 0) {
+        printf("  %-8s skipped: %s\n", sl_backend_name(b), strerror(errno));
+        return;
+    }
+    printf("  %s\n", sl_backend_name(b));
+    ASSERT(ok == 1);
+    ASSERT(a.accepts == 1 && a.closes == 1 && a.echoed == 15);
+
+    memset(&a, 0, sizeof(a));
+    ASSERT(run_one(b, client_slow_reader, &a) == 1);
+    ASSERT(a.echoed == BIG + 4);
+    ASSERT(a.writable >= 1);                     /* paused, then resumed */
+    ASSERT(a.st.rereads >= 1);                   /* BIG is more than one round's budget */
+
+    memset(&a, 0, sizeof(a));
+    a.deadline_ms = 50;
+    ASSERT(run_one(b, client_silent, &a) == 1);
+    ASSERT(a.timeouts == 1 && a.closes == 1);
+}
+
+static void test_names(void)
+{
+    for (int b = 0; b < SL_NBACKENDS; b++) ASSERT(sl_backend_parse(sl_backend_name(b)) == b);
+    ASSERT(sl_backend_parse("kqueue") == -1);
+    ASSERT(sl_backend_built(SL_SELECT) && sl_backend_built(SL_EPOLL_ET));
+}
+
+int main(void)
+{
+    test_names();
+    for (int b = 0; b < SL_NBACKENDS; b++)
+        if (sl_backend_built(b)) test_backend(b);
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
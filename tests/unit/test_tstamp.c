@@ -0,0 +1,177 @@
+/*
+ * tests/unit/test_tstamp.c
+ *
+ * Unit tests for the kernel timestamp helpers in linux/common/tstamp.h
+ * over loopback TCP: a read carries an RX stamp taken between the send
+ * and the read, a send that asks gets a TX stamp on the error queue and
+ * one that does not ask gets none, and a gathered flush (gather.h) sends
+ * the request once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../../linux/common/tstamp.h"
+#include "../../linux/common/gather.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+/* Connected loopback TCP pair; AF_UNIX sockets are not stamped. */
+static int tcp_pair(int sv[2])
+{
+    struct sockaddr_in a;
+    socklen_t al = sizeof(a);
+    memset(&a, 0, sizeof(a));
+    a.sin_family      = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int l = socket(AF_INET, SOCK_STREAM, 0);
+    if (l < 0 || bind(l, (struct sockaddr *)&a, sizeof(a)) < 0 || listen(l, 1) < 0 ||
+        getsockname(l, (struct sockaddr *)&a, &al) < 0) return -1;
+    sv[0] = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(sv[0], (struct sockaddr *)&a, sizeof(a)) < 0) return -1;
+    sv[1] = accept(l, NULL, NULL);
+    close(l);
+    return sv[1] < 0 ? -1 : 0;
+}
+
+/* Stamps from the error queue, waiting up to about a second for one. */
+static int wait_tx(int fd, uint64_t *tx)
+{
+    int got = 0;
+    for (int i = 0; i < 100 && got == 0; i++) {
+        struct pollfd p = { fd, 0, 0 };      /* POLLERR is always reported */
+        poll(&p, 1, 10);
+        got = ts_reap_tx(fd, tx);
+        ASSERT(got >= 0);
+    }
+    return got;
+}
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static void test_rx_stamp(void)
+{
+    int sv[2];
+    ASSERT(tcp_pair(sv) == 0);
+    ASSERT(ts_enable(sv[1]) == 0);
+
+    uint64_t before = ts_now();
+    ASSERT(send(sv[0], "ping", 4, 0) == 4);
+    struct pollfd p = { sv[1], POLLIN, 0 };
+    ASSERT(poll(&p, 1, 1000) == 1);
+    char buf[16];
+    uint64_t rx = 0;
+    ASSERT(ts_recv(sv[1], buf, sizeof(buf), 0, &rx) == 4);
+    uint64_t after = ts_now();
+    ASSERT(rx >= before && rx <= after);
+
+    /* Nothing read, no stamp. */
+    rx = 1;
+    ASSERT(ts_recv(sv[1], buf, sizeof(buf), MSG_DONTWAIT, &rx) < 0);
+    ASSERT(rx == 0);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+static void test_tx_stamp_only_when_asked(void)
+{
+    int sv[2];
+    ASSERT(tcp_pair(sv) == 0);
+    ASSERT(ts_enable(sv[0]) == 0);
+    uint64_t tx = 0;
+
+    ASSERT(send(sv[0], "plain", 5, 0) == 5);
+    ASSERT(ts_reap_tx(sv[0], &tx) == 0 && tx == 0);
+
+    struct ts_ctl ctl;
+    struct iovec  iov = { (void *)"stamped", 7 };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    ts_tx_ctl(&ctl);
+    msg.msg_control    = ctl.buf;
+    msg.msg_controllen = sizeof(ctl.buf);
+    uint64_t before = ts_now();
+    ASSERT(sendmsg(sv[0], &msg, 0) == 7);
+    ASSERT(wait_tx(sv[0], &tx) == 1);
+    ASSERT(tx >= before && tx <= ts_now());
+    ASSERT(ts_reap_tx(sv[0], &tx) == 0);         /* one send, one stamp */
+
+    /* The error queue held only stamps: the data is all there. */
+    char buf[32];
+    size_t got = 0;
+    while (got < 12) {
+        ssize_t r = recv(sv[1], buf + got, sizeof(buf) - got, 0);
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    ASSERT(got == 12 && memcmp(buf, "plainstamped", 12) == 0);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+static void test_gather_sends_request_once(void)
+{
+    int sv[2];
+    ASSERT(tcp_pair(sv) == 0);
+    ASSERT(ts_enable(sv[0]) == 0);
+
+    struct gather g;
+    struct gather_q q;
+    struct outq out;
+    ASSERT(gather_init(&g, 4096, 16) == 0);
+    gather_q_init(&q);
+    outq_init(&out);
+
+    struct ts_ctl ctl;
+    ts_tx_ctl(&ctl);
+    g.ctl    = ctl.buf;
+    g.ctllen = sizeof(ctl.buf);
+    ASSERT(gather_add(&g, &q, 0, "one\n", 4) == 0);
+    ASSERT(gather_flush(&g, &q, sv[0], &out) == 0);
+    ASSERT(g.ctl == NULL);                       /* went out with the bytes */
+    uint64_t tx = 0;
+    ASSERT(wait_tx(sv[0], &tx) == 1);
+
+    gather_reset(&g);
+    ASSERT(gather_add(&g, &q, 0, "two\n", 4) == 0);
+    ASSERT(gather_flush(&g, &q, sv[0], &out) == 0);
+    ASSERT(ts_reap_tx(sv[0], &tx) == 0);         /* not asked again */
+
+    gather_destroy(&g);
+    outq_clear(&out);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+int main(void)
+{
+    test_rx_stamp();
+    test_tx_stamp_only_when_asked();
+    test_gather_sends_request_once();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,248 @@
+/*
+ * tests/unit/test_twheel.c
+ *
+ * Unit tests for the hierarchical timing wheel in linux/common/twheel.h:
+ * expiry at the exact tick on every level, cancel and re-arm, deadlines
+ * pushed later without moving, the epoll_wait() hint, a table grown under
+ * armed timers, and a randomized run against a plain array of deadlines.
+ */
+
+#define _GNU_SOURCE                         /* mremap(), as the servers grow it */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../../linux/common/twheel.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+/* Advance one tick at a time; the tick at which id expired, or 0. */
+static uint64_t run_until_expired(struct twheel *w, int id, uint64_t limit)
+{
+    while (w->now < limit) {
+        tw_advance(w, w->now + 1);
+        int e;
+        while ((e = tw_expired(w)) >= 0)
+            if (e == id) return w->now;
+    }
+    return 0;
+}
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static void test_exact_expiry_on_every_level(void)
+{
+    static const uint64_t delays[] = { 1, 2, 63, 64, 65, 100, 4095, 4096, 4097,
+                                       70000, 262143, 262144, 300000, 5000000 };
+    for (size_t i = 0; i < sizeof(delays) / sizeof(delays[0]); i++) {
+        struct twheel w;
+        tw_init(&w, 1000 + i * 7);               /* not on a wrap boundary */
+        ASSERT(tw_reserve(&w, 1) == 0);
+        uint64_t due = w.now + delays[i];
+        tw_arm(&w, 0, due, 5);
+        ASSERT(tw_armed(&w, 0));
+        ASSERT(run_until_expired(&w, 0, due + 10) == due);
+        ASSERT(!tw_armed(&w, 0) && tw_tag(&w, 0) == 5);
+        tw_destroy(&w);
+    }
+}
+
+static void test_big_steps(void)
+{
+    /* One tw_advance() over many ticks hands out everything due by then. */
+    struct twheel w;
+    tw_init(&w, 0);
+    ASSERT(tw_reserve(&w, 3) == 0);
+    tw_arm(&w, 0, 10, 0);
+    tw_arm(&w, 1, 5000, 0);
+    tw_arm(&w, 2, 90000, 0);
+    tw_advance(&w, 6000);
+    int a = tw_expired(&w), b = tw_expired(&w);
+    ASSERT(tw_expired(&w) == -1);
+    ASSERT((a == 0 && b == 1) || (a == 1 && b == 0));
+    ASSERT(tw_armed(&w, 2));
+    tw_advance(&w, 89999);
+    ASSERT(tw_expired(&w) == -1);
+    tw_advance(&w, 90000);
+    ASSERT(tw_expired(&w) == 2);
+    tw_destroy(&w);
+}
+
+static void test_cancel_and_rearm(void)
+{
+    struct twheel w;
+    tw_init(&w, 0);
+    ASSERT(tw_reserve(&w, 2) == 0);
+    tw_arm(&w, 0, 100, 0);
+    tw_arm(&w, 1, 100, 0);
+    tw_cancel(&w, 0);
+    tw_cancel(&w, 0);                            /* twice is harmless */
+    ASSERT(!tw_armed(&w, 0));
+    tw_advance(&w, 200);
+    ASSERT(tw_expired(&w) == 1);
+    ASSERT(tw_expired(&w) == -1);
+
+    /* Earlier deadline: moved at once. */
+    tw_arm(&w, 0, 5000, 1);
+    tw_arm(&w, 0, 250, 2);
+    ASSERT(run_until_expired(&w, 0, 6000) == 250 && tw_tag(&w, 0) == 2);
+
+    /* Expired but not collected yet: re-arming takes it off the due list. */
+    tw_arm(&w, 1, w.now + 3, 0);
+    tw_advance(&w, w.now + 3);
+    tw_arm(&w, 1, w.now + 50, 0);
+    ASSERT(tw_expired(&w) == -1);
+    uint64_t due = w.now + 50;
+    ASSERT(run_until_expired(&w, 1, due + 1) == due);
+
+    /* In the past: due on the next tick. */
+    tw_arm(&w, 0, 1, 0);
+    ASSERT(run_until_expired(&w, 0, w.now + 2) == due + 1);
+    tw_destroy(&w);
+}
+
+static void test_lazy_extension(void)
+{
+    /* An idle timer pushed later on every "request" stays in place and
+     * expires only after the last one, at the last deadline. */
+    struct twheel w;
+    tw_init(&w, 0);
+    ASSERT(tw_reserve(&w, 1) == 0);
+    tw_arm(&w, 0, 1000, 0);
+    int slot = w.ent[0].slot;
+    for (uint64_t t = 1; t <= 5000; t++) {
+        tw_advance(&w, t);
+        ASSERT(tw_expired(&w) == -1);
+        tw_arm(&w, 0, t + 1000, 0);
+        if (t < 900) ASSERT(w.ent[0].slot == slot);   /* not moved yet */
+    }
+    ASSERT(run_until_expired(&w, 0, 10000) == 6000);
+    tw_destroy(&w);
+}
+
+static void test_next_hint(void)
+{
+    struct twheel w;
+    tw_init(&w, 10);
+    ASSERT(tw_reserve(&w, 2) == 0);
+    ASSERT(tw_next(&w) == -1);
+    tw_arm(&w, 0, 30, 0);
+    ASSERT(tw_next(&w) == 20);
+    tw_arm(&w, 1, 12, 0);
+    ASSERT(tw_next(&w) == 2);
+    tw_advance(&w, 12);
+    ASSERT(tw_next(&w) == 0);                    /* 1 waits to be collected */
+    ASSERT(tw_expired(&w) == 1);
+    ASSERT(tw_next(&w) == 18);
+    tw_cancel(&w, 0);
+    tw_arm(&w, 0, 100000, 0);                    /* beyond level 0: next wrap */
+    ASSERT(tw_next(&w) == 64 - 12);
+    tw_destroy(&w);
+}
+
+static void test_beyond_range(void)
+{
+    struct twheel w;
+    tw_init(&w, 0);
+    ASSERT(tw_reserve(&w, 1) == 0);
+    uint64_t due = TW_RANGE * 3 + 17;
+    tw_arm(&w, 0, due, 0);
+    tw_advance(&w, due - 1);
+    ASSERT(tw_expired(&w) == -1 && tw_armed(&w, 0));
+    tw_advance(&w, due);
+    ASSERT(tw_expired(&w) == 0);
+    tw_destroy(&w);
+}
+
+static void test_grow_keeps_timers(void)
+{
+    /* Growing moves the table; armed timers and lists come along. */
+    struct twheel w;
+    tw_init(&w, 0);
+    ASSERT(tw_reserve(&w, 2) == 0);
+    tw_arm(&w, 0, 100, 0);
+    tw_arm(&w, 1, 200, 7);
+    ASSERT(tw_reserve(&w, 1 << 20) == 0);
+    ASSERT(tw_armed(&w, 0) && tw_armed(&w, 1) && tw_tag(&w, 1) == 7);
+    ASSERT(!tw_armed(&w, 2) && !tw_armed(&w, (1 << 20) - 1));   /* zero = not armed */
+    tw_arm(&w, (1 << 20) - 1, 150, 0);
+    tw_advance(&w, 200);
+    ASSERT(tw_expired(&w) >= 0 && tw_expired(&w) >= 0 && tw_expired(&w) >= 0);
+    ASSERT(tw_expired(&w) == -1);
+    tw_destroy(&w);
+}
+
+static void test_random_against_reference(void)
+{
+    enum { N = 2000, STEPS = 200000 };
+    static uint64_t ref[N];                      /* 0 = not armed */
+    struct twheel w;
+    tw_init(&w, 0);
+    ASSERT(tw_reserve(&w, N) == 0);
+    memset(ref, 0, sizeof(ref));
+    srand(12345);
+
+    int bad = 0;
+    for (uint64_t t = 1; t <= STEPS && !bad; t++) {
+        for (int k = 0; k < 8; k++) {
+            int id = rand() % N;
+            int op = rand() % 10;
+            if (op == 0) {
+                tw_cancel(&w, id);
+                ref[id] = 0;
+            } else {
+                uint64_t d = op < 6 ? (uint64_t)(rand() % 100) + 1
+                           : op < 9 ? (uint64_t)(rand() % 10000) + 1
+                                    : (uint64_t)(rand() % 1000000) + 1;
+                tw_arm(&w, id, w.now + d, 0);
+                ref[id] = w.now + d;
+            }
+        }
+        /* Jump now and then, as an event loop woken late would. */
+        uint64_t to = (rand() % 100 == 0) ? t + (uint64_t)(rand() % 500) : t;
+        tw_advance(&w, to);
+        t = to;
+        int id;
+        while ((id = tw_expired(&w)) >= 0) {
+            if (ref[id] == 0 || ref[id] > t) bad++;
+            ref[id] = 0;
+        }
+        if (t % 64) continue;
+        for (int i = 0; i < N; i++) {
+            if (ref[i] && ref[i] <= t) bad++;    /* due but not handed out */
+            if (!!ref[i] != tw_armed(&w, i)) bad++;
+        }
+    }
+    ASSERT(bad == 0);
+    tw_destroy(&w);
+}
+
+int main(void)
+{
+    test_exact_expiry_on_every_level();
+    test_big_steps();
+    test_cancel_and_rearm();
+    test_lazy_extension();
+    test_next_hint();
+    test_beyond_range();
+    test_grow_keeps_timers();
+    test_random_against_reference();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,147 @@
+/*
+ * tests/unit/test_udp_batch.c
+ *
+ * Unit tests for the batched UDP helpers in linux/common/udp_batch.h over
+ * loopback: several datagrams per recvmmsg(), replies to each sender with
+ * one sendmmsg(), and a GSO send that arrives GRO-coalesced and goes back
+ * out as the same datagrams.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../../linux/common/udp_batch.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+/* A UDP socket on a free loopback port; its address goes to *a. */
+static int udp_socket(struct sockaddr_in *a)
+{
+    socklen_t al = sizeof(*a);
+    memset(a, 0, sizeof(*a));
+    a->sin_family      = AF_INET;
+    a->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT(fd >= 0);
+    ASSERT(bind(fd, (struct sockaddr *)a, sizeof(*a)) == 0);
+    ASSERT(getsockname(fd, (struct sockaddr *)a, &al) == 0);
+    struct timeval tv = { 1, 0 };                 /* never hang the test */
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static void test_batch_recv_and_reply(void)
+{
+    struct sockaddr_in sa, ca;
+    int srv = udp_socket(&sa), cli = udp_socket(&ca);
+    ASSERT(connect(cli, (struct sockaddr *)&sa, sizeof(sa)) == 0);
+
+    const char *msgs[] = { "hello\n", "ping\n", "bye\n" };
+    for (int i = 0; i < 3; i++) ASSERT(send(cli, msgs[i], strlen(msgs[i]), 0) > 0);
+
+    static struct udp_batch b;
+    ASSERT(udp_batch_init(&b, 2048) == 0);
+    int n = udp_batch_recv(srv, &b, UDP_BATCH, MSG_WAITFORONE);
+    ASSERT(n == 3);                                /* one call for all three */
+    for (int i = 0; i < n && i < 3; i++) {
+        ASSERT(b.msg[i].msg_len == strlen(msgs[i]));
+        ASSERT(memcmp(udp_batch_data(&b, i), msgs[i], strlen(msgs[i])) == 0);
+        ASSERT(b.addr[i].sin_port == ca.sin_port && b.gso[i] == 0);
+        ASSERT(udp_batch_segs(&b, i) == 1);
+        udp_batch_set(&b, i, b.msg[i].msg_len, 0, 1);
+    }
+    ASSERT(udp_batch_send(srv, &b, 0, n, 0) == n);
+
+    for (int i = 0; i < 3; i++) {
+        char buf[64];
+        ssize_t r = recv(cli, buf, sizeof(buf), 0);
+        ASSERT(r == (ssize_t)strlen(msgs[i]) && memcmp(buf, msgs[i], (size_t)r) == 0);
+    }
+    udp_batch_free(&b);
+    close(srv);
+    close(cli);
+}
+
+static void test_gso_send_gro_receive(void)
+{
+    struct sockaddr_in sa, ca;
+    int srv = udp_socket(&sa), cli = udp_socket(&ca);
+    ASSERT(connect(cli, (struct sockaddr *)&sa, sizeof(sa)) == 0);
+    int gro = udp_gro_enable(srv) == 0;
+
+    enum { SEG = 100, NSEG = 10 };
+    static struct udp_batch tx, b;
+    ASSERT(udp_batch_init(&tx, SEG * NSEG) == 0);
+    ASSERT(udp_batch_init(&b, 65536) == 0);
+    char *p = udp_batch_data(&tx, 0);
+    for (int i = 0; i < SEG * NSEG; i++) p[i] = (char)('a' + i / SEG);
+    udp_batch_set(&tx, 0, SEG * NSEG - 30, SEG, 0);  /* last datagram is short */
+    if (udp_batch_send(cli, &tx, 0, 1, 0) != 1) {
+        printf("UDP_SEGMENT not supported, skipping\n");
+        goto out;
+    }
+
+    /* With GRO the ten datagrams may come back as one buffer; either way
+     * the segments add up to the same bytes. */
+    int got = 0, msgs = 0;
+    while (got < NSEG) {
+        int n = udp_batch_recv(srv, &b, UDP_BATCH, MSG_WAITFORONE);
+        ASSERT(n > 0);
+        if (n <= 0) break;
+        for (int i = 0; i < n; i++) {
+            ASSERT(b.gso[i] == 0 || b.gso[i] == SEG);
+            ASSERT(memcmp(udp_batch_data(&b, i), p + got * SEG, b.msg[i].msg_len) == 0);
+            got += (int)udp_batch_segs(&b, i);
+            udp_batch_set(&b, i, b.msg[i].msg_len, b.gso[i], 1);
+        }
+        msgs += n;
+        ASSERT(udp_batch_send(srv, &b, 0, n, 0) == n);
+    }
+    ASSERT(got == NSEG);
+    if (gro) ASSERT(msgs < NSEG);                  /* loopback keeps GSO packets whole */
+
+    /* Echoed with the same segment size: the client sees ten datagrams. */
+    for (int i = 0; i < NSEG; i++) {
+        char buf[SEG];
+        ssize_t r = recv(cli, buf, sizeof(buf), 0);
+        ASSERT(r == (i < NSEG - 1 ? SEG : SEG - 30));
+        ASSERT(r > 0 && memcmp(buf, p + i * SEG, (size_t)r) == 0);
+    }
+out:
+    udp_batch_free(&tx);
+    udp_batch_free(&b);
+    close(srv);
+    close(cli);
+}
+
+int main(void)
+{
+    test_batch_recv_and_reply();
+    test_gso_send_gro_receive();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,147 @@
+/*
+ * tests/unit/test_unix_sock.c
+ *
+ * Unit tests for linux/common/unix_sock.h: filesystem and abstract paths,
+ * message boundaries on SOCK_SEQPACKET, a stale path replaced but a live
+ * one or a plain file left alone, and the path read back from a listener.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include "../../linux/common/unix_sock.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+/* Connect to path, accept the other end; 0 on success. */
+static int pair_on(const char *path, int type, int *lfd, int *c, int *s)
+{
+    *lfd = unix_listen(path, type, 4);
+    if (*lfd < 0) return -1;
+    *c = unix_connect(path, type);
+    if (*c < 0) return -1;
+    *s = accept(*lfd, NULL, NULL);
+    return *s < 0 ? -1 : 0;
+}
+
+static void test_stream_paths(void)
+{
+    char fs[64], ab[64], got[108];
+    snprintf(fs, sizeof(fs), "/tmp/test_unix_sock.%d", (int)getpid());
+    snprintf(ab, sizeof(ab), "@test_unix_sock.%d", (int)getpid());
+    const char *paths[] = { fs, ab };
+
+    for (int i = 0; i < 2; i++) {
+        int lfd = -1, c = -1, s = -1;
+        ASSERT(pair_on(paths[i], SOCK_STREAM, &lfd, &c, &s) == 0);
+        char buf[8];
+        ASSERT(write(c, "hi\n", 3) == 3);
+        ASSERT(read(s, buf, sizeof(buf)) == 3 && memcmp(buf, "hi\n", 3) == 0);
+        ASSERT(unix_path(lfd, got, sizeof(got)) == 0 && strcmp(got, paths[i]) == 0);
+        ASSERT(unix_path(c, got, sizeof(got)) < 0);   /* the client end is unbound */
+        ASSERT(fcntl(lfd, F_GETFL) & O_NONBLOCK);
+        close(c);
+        close(s);
+        close(lfd);
+        unix_unlink(paths[i]);
+    }
+    ASSERT(access(fs, F_OK) < 0);                /* removed */
+    ASSERT(unix_connect(ab, SOCK_STREAM) < 0);   /* gone with the listener */
+}
+
+static void test_seqpacket_keeps_boundaries(void)
+{
+    char ab[64];
+    snprintf(ab, sizeof(ab), "@test_unix_sock.seq.%d", (int)getpid());
+    int lfd = -1, c = -1, s = -1;
+    ASSERT(pair_on(ab, SOCK_SEQPACKET, &lfd, &c, &s) == 0);
+
+    /* Three sends, back to back, no separators: three recv()s. */
+    ASSERT(send(c, "one", 3, 0) == 3);
+    ASSERT(send(c, "two!", 4, 0) == 4);
+    ASSERT(send(c, "3", 1, 0) == 1);
+    char buf[64];
+    ASSERT(recv(s, buf, sizeof(buf), 0) == 3 && memcmp(buf, "one", 3) == 0);
+    ASSERT(recv(s, buf, sizeof(buf), 0) == 4 && memcmp(buf, "two!", 4) == 0);
+    ASSERT(recv(s, buf, sizeof(buf), 0) == 1 && buf[0] == '3');
+
+    /* A message larger than the buffer is cut off, and says so. */
+    char big[100];
+    memset(big, 'x', sizeof(big));
+    ASSERT(send(c, big, sizeof(big), 0) == (ssize_t)sizeof(big));
+    struct iovec iov = { buf, sizeof(buf) };
+    struct msghdr m;
+    memset(&m, 0, sizeof(m));
+    m.msg_iov    = &iov;
+    m.msg_iovlen = 1;
+    ASSERT(recvmsg(s, &m, 0) == (ssize_t)sizeof(buf) && (m.msg_flags & MSG_TRUNC));
+
+    close(c);
+    close(s);
+    close(lfd);
+}
+
+static void test_stale_live_and_foreign_paths(void)
+{
+    char fs[64];
+    snprintf(fs, sizeof(fs), "/tmp/test_unix_sock.stale.%d", (int)getpid());
+
+    /* Left behind: the listener closed without unlinking. */
+    int lfd = unix_listen(fs, SOCK_STREAM, 4);
+    ASSERT(lfd >= 0);
+    close(lfd);
+    ASSERT(access(fs, F_OK) == 0);
+    lfd = unix_listen(fs, SOCK_STREAM, 4);
+    ASSERT(lfd >= 0);
+
+    /* Still served: the second listener must not take it over. */
+    errno = 0;
+    ASSERT(unix_listen(fs, SOCK_STREAM, 4) < 0 && errno == EADDRINUSE);
+    int c = unix_connect(fs, SOCK_STREAM);
+    ASSERT(c >= 0);
+    close(c);
+    close(lfd);
+    unix_unlink(fs);
+
+    /* Not a socket: never removed. */
+    int f = open(fs, O_CREAT | O_WRONLY, 0600);
+    ASSERT(f >= 0);
+    close(f);
+    errno = 0;
+    ASSERT(unix_listen(fs, SOCK_STREAM, 4) < 0 && errno == EADDRINUSE);
+    ASSERT(access(fs, F_OK) == 0);
+    unlink(fs);
+
+    char longp[200];
+    memset(longp, 'a', sizeof(longp) - 1);
+    longp[sizeof(longp) - 1] = '\0';
+    ASSERT(unix_listen(longp, SOCK_STREAM, 4) < 0 && errno == ENAMETOOLONG);
+}
+
+int main(void)
+{
+    test_stream_paths();
+    test_seqpacket_keeps_boundaries();
+    test_stale_live_and_foreign_paths();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
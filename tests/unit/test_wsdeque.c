@@ -0,0 +1,129 @@
+/*
+ * tests/unit/test_wsdeque.c
+ *
+ * Unit tests for the Chase-Lev deque in linux/common/wsdeque.h: LIFO for
+ * the owner, FIFO for thieves, growth past the initial ring, and an owner
+ * pushing and taking against several thieves with every item taken
+ * exactly once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "../../linux/common/wsdeque.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+/* Items are small integers disguised as pointers, offset past WSD_ABORT. */
+#define ITEM(i)  ((void *)(uintptr_t)((i) + 2))
+#define INDEX(x) ((long)((uintptr_t)(x) - 2))
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static void test_owner_and_thief_ends(void)
+{
+    struct wsdeque d;
+    ASSERT(wsd_init(&d, 4) == 0);
+    ASSERT(wsd_take(&d) == NULL && wsd_steal(&d) == NULL);
+    for (long i = 0; i < 4; i++) ASSERT(wsd_push(&d, ITEM(i)) == 0);
+    ASSERT(wsd_size(&d) == 4);
+    ASSERT(INDEX(wsd_take(&d)) == 3);            /* owner: newest */
+    ASSERT(INDEX(wsd_steal(&d)) == 0);           /* thief: oldest */
+    ASSERT(INDEX(wsd_steal(&d)) == 1);
+    ASSERT(INDEX(wsd_take(&d)) == 2);
+    ASSERT(wsd_take(&d) == NULL && wsd_size(&d) == 0);
+    wsd_destroy(&d);
+}
+
+static void test_grows(void)
+{
+    struct wsdeque d;
+    ASSERT(wsd_init(&d, 16) == 0);
+    for (long i = 0; i < 1000; i++) ASSERT(wsd_push(&d, ITEM(i)) == 0);
+    ASSERT(wsd_size(&d) == 1000);
+    for (long i = 0; i < 500; i++) ASSERT(INDEX(wsd_steal(&d)) == i);
+    for (long i = 999; i >= 500; i--) ASSERT(INDEX(wsd_take(&d)) == i);
+    ASSERT(wsd_take(&d) == NULL);
+    wsd_destroy(&d);
+}
+
+#define N_ITEMS   200000
+#define N_THIEVES 3
+
+static struct wsdeque    shared;
+static unsigned char     seen[N_ITEMS];
+static atomic_int        owner_done;
+static atomic_long       taken;
+
+static void mark(void *x)
+{
+    long i = INDEX(x);
+    if (i < 0 || i >= N_ITEMS) {
+        failures++;
+        return;
+    }
+    seen[i]++;                                   /* each index by one thread only, once */
+    atomic_fetch_add(&taken, 1);
+}
+
+static void *thief(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        void *x = wsd_steal(&shared);
+        if (x == WSD_ABORT) continue;
+        if (x) mark(x);
+        else if (atomic_load(&owner_done) && wsd_size(&shared) == 0) break;
+    }
+    return NULL;
+}
+
+static void test_concurrent_exactly_once(void)
+{
+    ASSERT(wsd_init(&shared, 16) == 0);          /* grows while thieves read */
+    pthread_t t[N_THIEVES];
+    for (int i = 0; i < N_THIEVES; i++) ASSERT(pthread_create(&t[i], NULL, thief, NULL) == 0);
+    for (long i = 0; i < N_ITEMS; i++) {
+        ASSERT(wsd_push(&shared, ITEM(i)) == 0);
+        if (i % 3 == 0) {                        /* the owner takes some back */
+            void *x = wsd_take(&shared);
+            if (x) mark(x);
+        }
+    }
+    for (void *x; (x = wsd_take(&shared)) != NULL; ) mark(x);
+    atomic_store(&owner_done, 1);
+    for (int i = 0; i < N_THIEVES; i++) pthread_join(t[i], NULL);
+
+    ASSERT(atomic_load(&taken) == N_ITEMS);
+    int bad = 0;
+    for (long i = 0; i < N_ITEMS; i++) bad += seen[i] != 1;
+    ASSERT(bad == 0);
+    wsd_destroy(&shared);
+}
+
+int main(void)
+{
+    test_owner_and_thief_ends();
+    test_grows();
+    test_concurrent_exactly_once();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
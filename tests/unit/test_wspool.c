@@ -0,0 +1,172 @@
+/*
+ * tests/unit/test_wspool.c
+ *
+ * Unit tests for the work-stealing pool in linux/common/wspool.h: every
+ * submitted task comes back once through the eventfd, spawned tasks run
+ * on the pool, sleeping workers wake for new work, and a slow task does
+ * not hold up the quick ones behind it.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+
+#include "../../linux/common/wspool.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+struct job {
+    struct ws_task task;                         /* first */
+    int            id;
+    int            sleep_ms;
+    int            runs;
+};
+
+static atomic_int ran;
+
+static void job_run(struct ws_task *t)
+{
+    struct job *j = (struct job *)t;
+    if (j->sleep_ms) {
+        struct timespec ts = { 0, (long)j->sleep_ms * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+    j->runs++;
+    atomic_fetch_add(&ran, 1);
+}
+
+/* Reap until want tasks are back or timeout_ms passes; appends ids to order. */
+static int reap_until(struct wspool *p, int want, int timeout_ms, int *order)
+{
+    int got = 0;
+    struct pollfd pfd = { p->efd, POLLIN, 0 };
+    while (got < want && poll(&pfd, 1, timeout_ms) > 0)
+        for (struct ws_task *t = wsp_reap(p); t; t = t->next)
+            order[got++] = ((struct job *)t)->id;
+    return got;
+}
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+#define N_JOBS 20000
+
+static void test_every_task_back_once(void)
+{
+    struct wspool p;
+    ASSERT(wsp_init(&p, 4) == 0);
+    struct job *jobs = calloc(N_JOBS, sizeof(*jobs));
+    int *order = calloc(N_JOBS, sizeof(int));
+    for (int i = 0; i < N_JOBS; i++) {
+        jobs[i].task.fn = job_run;
+        jobs[i].id      = i;
+        ASSERT(wsp_submit(&p, &jobs[i].task) == 0);
+    }
+    ASSERT(reap_until(&p, N_JOBS, 2000, order) == N_JOBS);
+    int bad = 0;
+    for (int i = 0; i < N_JOBS; i++) bad += jobs[i].runs != 1;
+    ASSERT(bad == 0);
+    uint64_t total = 0;
+    for (int i = 0; i < p.nworkers; i++) total += p.w[i].ran;
+    ASSERT(total == N_JOBS);
+    wsp_destroy(&p);
+    free(order);
+    free(jobs);
+}
+
+/* A task that splits into children on its worker's deque. */
+#define N_CHILDREN 64
+static struct job children[N_CHILDREN];
+
+static void parent_run(struct ws_task *t)
+{
+    for (int i = 0; i < N_CHILDREN; i++) {
+        children[i].task.fn  = job_run;
+        children[i].sleep_ms = 1;
+        if (wsp_spawn(&children[i].task) < 0) failures++;
+    }
+    (void)t;
+}
+
+static void test_spawned_tasks_are_stolen(void)
+{
+    struct wspool p;
+    ASSERT(wsp_init(&p, 4) == 0);
+    atomic_store(&ran, 0);
+    struct job parent = { .task = { .fn = parent_run }, .id = 1 };
+    int order[1];
+    ASSERT(wsp_submit(&p, &parent.task) == 0);
+    ASSERT(reap_until(&p, 1, 2000, order) == 1);   /* only the parent is reported */
+    for (int i = 0; i < 200 && atomic_load(&ran) < N_CHILDREN; i++) {
+        struct timespec ts = { 0, 10000000L };
+        nanosleep(&ts, NULL);
+    }
+    ASSERT(atomic_load(&ran) == N_CHILDREN);
+    int bad = 0;
+    for (int i = 0; i < N_CHILDREN; i++) bad += children[i].runs != 1;
+    ASSERT(bad == 0);
+    uint64_t stolen = 0;
+    for (int i = 0; i < p.nworkers; i++) stolen += p.w[i].stolen;
+    ASSERT(stolen >= 1);                         /* at least the parent, from the loop */
+    wsp_destroy(&p);
+}
+
+static void test_sleepers_wake(void)
+{
+    struct wspool p;
+    ASSERT(wsp_init(&p, 2) == 0);
+    for (int i = 0; i < 500 && atomic_load(&p.sleepers) < 2; i++) {
+        struct timespec ts = { 0, 10000000L };   /* a loaded host may take a while */
+        nanosleep(&ts, NULL);
+    }
+    ASSERT(atomic_load(&p.sleepers) == 2);
+    struct job j = { .task = { .fn = job_run }, .id = 7 };
+    int order[1] = { -1 };
+    ASSERT(wsp_submit(&p, &j.task) == 0);
+    ASSERT(reap_until(&p, 1, 1000, order) == 1 && order[0] == 7);
+    wsp_destroy(&p);
+}
+
+static void test_slow_task_does_not_block_others(void)
+{
+    struct wspool p;
+    ASSERT(wsp_init(&p, 2) == 0);
+    struct job slow = { .task = { .fn = job_run }, .id = 0, .sleep_ms = 300 };
+    struct job quick[100];
+    int order[101];
+    ASSERT(wsp_submit(&p, &slow.task) == 0);
+    for (int i = 0; i < 100; i++) {
+        quick[i] = (struct job){ .task = { .fn = job_run }, .id = i + 1 };
+        ASSERT(wsp_submit(&p, &quick[i].task) == 0);
+    }
+    ASSERT(reap_until(&p, 101, 2000, order) == 101);
+    ASSERT(order[100] == 0);                     /* the slow one finished last */
+    wsp_destroy(&p);
+}
+
+int main(void)
+{
+    test_every_task_back_once();
+    test_spawned_tasks_are_stolen();
+    test_sleepers_wake();
+    test_slow_task_does_not_block_others();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
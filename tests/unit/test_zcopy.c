@@ -0,0 +1,172 @@
+/*
+ * tests/unit/test_zcopy.c
+ *
+ * Unit tests for the MSG_ZEROCOPY helpers in linux/common/zcopy.h: buffer
+ * reference counting, and a send over loopback TCP that keeps its buffer
+ * pinned until the completion is read from the error queue.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../../linux/common/zcopy.h"
+
+/* ── Minimal test runner ─────────────────────────────────────────────────── */
+static int failures = 0;
+
+#define ASSERT(cond)                                               \
+    do {                                                           \
+        if (!(cond)) {                                             \
+            fprintf(stderr, "FAIL: %s:%d: %s\n",                  \
+                    __FILE__, __LINE__, #cond);                    \
+            failures++;                                            \
+        }                                                          \
+    } while (0)
+
+#define PAYLOAD (32 * 1024)
+
+/* Connected loopback TCP pair; zero-copy does not work on AF_UNIX. */
+static int tcp_pair(int sv[2])
+{
+    struct sockaddr_in a;
+    socklen_t al = sizeof(a);
+    memset(&a, 0, sizeof(a));
+    a.sin_family      = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int l = socket(AF_INET, SOCK_STREAM, 0);
+    if (l < 0 || bind(l, (struct sockaddr *)&a, sizeof(a)) < 0 || listen(l, 1) < 0 ||
+        getsockname(l, (struct sockaddr *)&a, &al) < 0) return -1;
+    sv[0] = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(sv[0], (struct sockaddr *)&a, sizeof(a)) < 0) return -1;
+    sv[1] = accept(l, NULL, NULL);
+    close(l);
+    return sv[1] < 0 ? -1 : 0;
+}
+
+static void read_exactly(int fd, size_t n)
+{
+    char buf[8192];
+    while (n > 0) {
+        ssize_t r = recv(fd, buf, n < sizeof(buf) ? n : sizeof(buf), 0);
+        if (r <= 0) break;
+        n -= (size_t)r;
+    }
+    ASSERT(n == 0);
+}
+
+/* Reap until nothing is in flight, or give up after about a second. */
+static void wait_completions(struct zc_tx *z, int fd, struct bufpool *pool)
+{
+    for (int i = 0; i < 100 && z->inflight > 0; i++) {
+        struct pollfd p = { fd, 0, 0 };      /* POLLERR is always reported */
+        poll(&p, 1, 10);
+        ASSERT(zc_reap(z, fd, pool) >= 0);
+    }
+}
+
+/* ── Tests ───────────────────────────────────────────────────────────────── */
+
+static void test_buf_refcount(void)
+{
+    struct bufpool pool;
+    bufpool_init(&pool, 64 * 1024);
+    struct zc_buf *b = zc_buf_get(&pool);
+    ASSERT(b && b->refs == 1 && b->len == 0);
+    ASSERT(zc_buf_cap(&pool) == 64 * 1024 - sizeof(struct zc_buf));
+    b->refs++;                               /* as a send would */
+    zc_buf_unref(&pool, b);
+    ASSERT(pool.in_use == 1);                /* still pinned */
+    zc_buf_unref(&pool, b);
+    ASSERT(pool.in_use == 0);
+    bufpool_destroy(&pool);
+}
+
+static void test_send_pinned_until_completion(void)
+{
+    int sv[2];
+    ASSERT(tcp_pair(sv) == 0);
+    if (zc_enable(sv[0]) < 0) {
+        printf("SO_ZEROCOPY not supported, skipping\n");
+        close(sv[0]);
+        close(sv[1]);
+        return;
+    }
+
+    struct bufpool pool;
+    bufpool_init(&pool, 64 * 1024);
+    struct zc_tx z;
+    zc_tx_init(&z);
+
+    struct zc_buf *b = zc_buf_get(&pool);
+    memset(b->data, 'z', PAYLOAD);
+    b->len = PAYLOAD;
+    ASSERT(zc_ready(&z));
+    ASSERT(zc_send(&z, sv[0], b, b->data, PAYLOAD, 0) == PAYLOAD);
+    ASSERT(b->refs == 2 && z.inflight == 1 && z.next == 1);
+    ASSERT(z.sends == 1 && z.bytes == PAYLOAD);
+
+    zc_buf_unref(&pool, b);                  /* the owner lets go first */
+    ASSERT(pool.in_use == 1);                /* the kernel still has it */
+
+    read_exactly(sv[1], PAYLOAD);
+    wait_completions(&z, sv[0], &pool);
+    ASSERT(z.inflight == 0);
+    ASSERT(pool.in_use == 0);                /* released by the completion */
+    ASSERT(z.pinned[0] == NULL);
+    /* Loopback delivery copies the pages, and says so. */
+    ASSERT(z.copied == 0 || z.off);
+
+    bufpool_destroy(&pool);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+static void test_abort_releases(void)
+{
+    int sv[2];
+    ASSERT(tcp_pair(sv) == 0);
+    if (zc_enable(sv[0]) < 0) {
+        close(sv[0]);
+        close(sv[1]);
+        return;
+    }
+    struct bufpool pool;
+    bufpool_init(&pool, 64 * 1024);
+    struct zc_tx z;
+    zc_tx_init(&z);
+
+    struct zc_buf *b = zc_buf_get(&pool);
+    memset(b->data, 'a', 1024);
+    ASSERT(zc_send(&z, sv[0], b, b->data, 1024, 0) == 1024);
+    ASSERT(zc_send(&z, sv[0], b, b->data, 1024, 0) == 1024);
+    ASSERT(b->refs == 3 && z.inflight == 2);
+    zc_tx_abort(&z, &pool);
+    ASSERT(b->refs == 1 && z.inflight == 0);
+    zc_buf_unref(&pool, b);
+    ASSERT(pool.in_use == 0);
+
+    bufpool_destroy(&pool);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+int main(void)
+{
+    test_buf_refcount();
+    test_send_pinned_until_completion();
+    test_abort_releases();
+
+    if (failures == 0) {
+        printf("All tests passed.\n");
+        return EXIT_SUCCESS;
+    }
+    fprintf(stderr, "%d test(s) failed.\n", failures);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,246 @@
+/*
+ * tools/sockstat.c
+ *
+ * Live view of an echo server's counters (linux/common/metrics.h).
+ *
+ * Maps the server's shared-memory segment read-only and, every -i
+ * seconds, prints rates over the last interval: connections accepted and
+ * closed, messages, bytes in and out, recv() calls that found nothing and
+ * sends that left bytes queued, epoll_wait() returns and events per
+ * return.  -t adds one row per thread, -H the interval's histograms of
+ * events per epoll_wait() and bytes per recv(), -S the latency of each
+ * stage of a request for a server that timestamps them (linux03_server
+ * -T): a count, the buckets holding the median and the 99th percentile,
+ * and the histogram.
+ *
+ * Reading costs the server nothing: no system call, no lock, no shared
+ * write — each slot is copied under its seqlock, retried if the server
+ * was publishing at that moment.
+ *
+ * Without a pid, attaches to the only /dev/shm/sockdemo.* segment of a
+ * live process.  Exits when the server does.
+ *
+ * Usage: sockstat [-i secs] [-c count] [-t] [-H] [-S] [pid]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <dirent.h>
+#include <time.h>
+
+#include "../linux/common/sock_helpers.h"
+#include "../linux/common/metrics.h"
+
+static double interval = 1.0;
+static long   count    = -1;          /* samples, -1 = until the server exits */
+static int    per_thread;
+static int    hists;
+static int    stages;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int alive(int pid)
+{
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+/* The pid of the only live process with a segment, or -1. */
+static int find_server(void)
+{
+    DIR *d = opendir("/dev/shm");
+    if (!d) return -1;
+    int pid = -1, found = 0;
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        if (strncmp(e->d_name, METRICS_PREFIX, strlen(METRICS_PREFIX)) != 0) continue;
+        int p = atoi(e->d_name + strlen(METRICS_PREFIX));
+        if (p <= 0 || !alive(p)) continue;
+        pid = p;
+        found++;
+    }
+    closedir(d);
+    if (found > 1) {
+        fprintf(stderr, "sockstat: %d servers running, pick one by pid\n", found);
+        return -1;
+    }
+    return pid;
+}
+
+/* Sum of every slot, and each slot into per[] when per is not NULL. */
+static void sample(const struct metrics_shm *s, struct metrics *sum, struct metrics *per)
+{
+    memset(sum, 0, sizeof(*sum));
+    for (unsigned i = 0; i < s->nslots; i++) {
+        struct metrics m;
+        if (metrics_read(&s->slot[i], &m) < 0) memset(&m, 0, sizeof(m));
+        if (per) per[i] = m;
+        const uint64_t *src = (const uint64_t *)&m;
+        uint64_t       *dst = (uint64_t *)sum;
+        for (size_t k = 0; k < sizeof(m) / sizeof(uint64_t); k++) dst[k] += src[k];
+    }
+}
+
+static void header(void)
+{
+    printf("%8s %7s %8s %8s %10s %9s %9s %9s %9s %9s %7s %6s\n",
+           "thread", "conns", "accept/s", "close/s", "msg/s", "in MB/s", "out MB/s",
+           "rxagain/s", "txagain/s", "loops/s", "ev/loop", "tmo/s");
+}
+
+static void row(const char *who, const struct metrics *a, const struct metrics *b, double secs)
+{
+    uint64_t d[M_NCOUNTERS];
+    for (int k = 0; k < M_NCOUNTERS; k++) d[k] = b->c[k] - a->c[k];
+    printf("%8s %7lld %8.0f %8.0f %10.0f %9.2f %9.2f %9.0f %9.0f %9.0f %7.2f %6.0f\n",
+           who, (long long)(b->c[M_ACCEPTS] - b->c[M_CLOSES]),
+           d[M_ACCEPTS] / secs, d[M_CLOSES] / secs, d[M_MSGS] / secs,
+           d[M_BYTES_IN] / secs / 1e6, d[M_BYTES_OUT] / secs / 1e6,
+           d[M_RX_EAGAIN] / secs, d[M_TX_EAGAIN] / secs, d[M_LOOPS] / secs,
+           d[M_LOOPS] ? (double)d[M_EVENTS] / (double)d[M_LOOPS] : 0.0,
+           d[M_TIMEOUTS] / secs);
+}
+
+/* One histogram's change over the interval, as "range:count" pairs. */
+static void hist(const char *what, const uint64_t *a, const uint64_t *b)
+{
+    printf("  %-16s", what);
+    for (int i = 0; i < METRICS_HIST; i++) {
+        uint64_t n = b[i] - a[i];
+        if (!n) continue;
+        if (i <= 1)
+            printf(" %d:%llu", i, (unsigned long long)n);
+        else if (i == METRICS_HIST - 1)
+            printf(" %llu+:%llu", 1ull << (i - 1), (unsigned long long)n);
+        else
+            printf(" %llu-%llu:%llu", 1ull << (i - 1), (1ull << i) - 1, (unsigned long long)n);
+    }
+    printf("\n");
+}
+
+/* A latency in ns, short: "512ns", "16us", "1.0ms". */
+static const char *lat_str(char *buf, size_t len, uint64_t ns)
+{
+    if (ns < 1000)            snprintf(buf, len, "%lluns", (unsigned long long)ns);
+    else if (ns < 1000000)    snprintf(buf, len, "%.0fus", (double)ns / 1e3);
+    else if (ns < 1000000000) snprintf(buf, len, "%.1fms", (double)ns / 1e6);
+    else                      snprintf(buf, len, "%.2fs", (double)ns / 1e9);
+    return buf;
+}
+
+/*
+ * One stage's change over the interval.  Bucket i holds latencies below
+ * 2^i ns, so a percentile is known to within a factor of two: "<16us".
+ */
+static void stage(const char *what, const uint64_t *a, const uint64_t *b)
+{
+    uint64_t d[METRICS_LAT_HIST], total = 0;
+    for (int i = 0; i < METRICS_LAT_HIST; i++) total += d[i] = b[i] - a[i];
+    printf("  %-10s %9llu", what, (unsigned long long)total);
+    if (!total) {
+        printf("\n");
+        return;
+    }
+    char l1[16], l2[16];
+    int  p50 = -1, p99 = -1;
+    uint64_t run = 0;
+    for (int i = 0; i < METRICS_LAT_HIST; i++) {
+        run += d[i];
+        if (p50 < 0 && run * 2 >= total)        p50 = i;
+        if (p99 < 0 && run * 100 >= total * 99) p99 = i;
+    }
+    printf("  p50 <%-7s p99 <%-7s", lat_str(l1, sizeof(l1), 1ull << p50),
+           lat_str(l2, sizeof(l2), 1ull << p99));
+    for (int i = 0; i < METRICS_LAT_HIST; i++) {
+        if (!d[i]) continue;
+        if (i == METRICS_LAT_HIST - 1)
+            printf(" %s+:%llu", lat_str(l1, sizeof(l1), 1ull << (i - 1)), (unsigned long long)d[i]);
+        else
+            printf(" <%s:%llu", lat_str(l1, sizeof(l1), 1ull << i), (unsigned long long)d[i]);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    while ((c = getopt(argc, argv, "i:c:tHS")) != -1) {
+        switch (c) {
+        case 'i': interval   = atof(optarg); break;
+        case 'c': count      = atol(optarg); break;
+        case 't': per_thread = 1;            break;
+        case 'H': hists      = 1;            break;
+        case 'S': stages     = 1;            break;
+        default:
+            fprintf(stderr, "usage: %s [-i secs] [-c count] [-t] [-H] [-S] [pid]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (interval <= 0) interval = 1.0;
+
+    int pid = optind < argc ? atoi(argv[optind]) : find_server();
+    if (pid <= 0) {
+        fprintf(stderr, "sockstat: no server with metrics found\n");
+        return EXIT_FAILURE;
+    }
+    const struct metrics_shm *s = metrics_open(pid);
+    if (!s) die("metrics_open");
+    printf("sockstat: %s, pid %d, %u thread(s)\n", s->name, (int)s->pid, s->nslots);
+
+    struct metrics  prev, cur;
+    struct metrics *pprev = calloc(s->nslots, sizeof(*pprev));
+    struct metrics *pcur  = calloc(s->nslots, sizeof(*pcur));
+    if (!pprev || !pcur) die("calloc");
+    sample(s, &prev, pprev);
+    uint64_t t_prev = now_ns();
+
+    for (long n = 0; count < 0 || n < count; n++) {
+        struct timespec ts = { (time_t)interval, (long)((interval - (double)(time_t)interval) * 1e9) };
+        nanosleep(&ts, NULL);
+        int gone = !alive(pid);
+        sample(s, &cur, pcur);
+        uint64_t t = now_ns();
+        double secs = (double)(t - t_prev) / 1e9;
+
+        if (n % 20 == 0 || per_thread || hists || stages) header();
+        if (per_thread) {
+            for (unsigned i = 0; i < s->nslots; i++) {
+                char who[16];
+                snprintf(who, sizeof(who), "%u", i);
+                row(who, &pprev[i], &pcur[i], secs);
+            }
+        }
+        row("all", &prev, &cur, secs);
+        if (hists) {
+            hist("events/wait", prev.events_hist, cur.events_hist);
+            hist("bytes/recv", prev.recv_hist, cur.recv_hist);
+        }
+        if (stages) {
+            printf("  %-10s %9s  (%llu stamped read(s)/s)\n", "stage", "requests",
+                   (unsigned long long)((double)(cur.c[M_STAMPED] - prev.c[M_STAMPED]) / secs));
+            for (int k = 0; k < M_NSTAGES; k++)
+                stage(metrics_stages[k], prev.stage_hist[k], cur.stage_hist[k]);
+        }
+        fflush(stdout);
+
+        if (gone) {
+            printf("sockstat: server exited\n");
+            break;
+        }
+        prev   = cur;
+        t_prev = t;
+        memcpy(pprev, pcur, s->nslots * sizeof(*pcur));
+    }
+    free(pprev);
+    free(pcur);
+    return 0;
+}